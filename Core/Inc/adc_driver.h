@@ -5,6 +5,7 @@
  * Includes
  *********************************************************************************************************************/
 #include <stdbool.h>
+#include <stdint.h>
 /**********************************************************************************************************************
  * Exported definitions and macros
  *********************************************************************************************************************/
@@ -22,6 +23,8 @@ typedef enum {
 /**********************************************************************************************************************
  * Exported types
  *********************************************************************************************************************/
+/* timestamp: timebase ticks of the trigger that started the block's last conversion, see ADC_Driver_GetUntimedBlocks */
+typedef void (*AdcBlockCb_t) (eAdc_t adc, const uint16_t *samples, uint32_t sample_count, uint64_t timestamp);
 
 /**********************************************************************************************************************
  * Exported variables
@@ -33,5 +36,10 @@ typedef enum {
 bool ADC_Driver_Init (eAdc_t adc);
 bool ADC_Driver_ReadChannels (eAdc_t adc);
 bool ADC_Driver_GetChannelValue (eAdcChannel_t channel, uint16_t *value);
+bool ADC_Driver_StartStream (eAdc_t adc, uint16_t *buffer, uint32_t sample_count, uint32_t sample_rate, AdcBlockCb_t block_cb);
+bool ADC_Driver_StopStream (eAdc_t adc);
+uint32_t ADC_Driver_GetSampleRate (eAdc_t adc);
+/* Blocks whose trigger time was lost to coalesced DMA interrupts, stamped one block period after the one before */
+uint32_t ADC_Driver_GetUntimedBlocks (eAdc_t adc);
 
 #endif /* INC_ADC_DRIVER_H_ */
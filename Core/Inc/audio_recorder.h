@@ -0,0 +1,72 @@
+#ifndef INC_AUDIO_RECORDER_H_
+#define INC_AUDIO_RECORDER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_stream.h"
+#include "sd_card_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* MBR type of the partition that takes back-to-back recordings when the card has no FAT32 volume */
+#define AUDIO_RECORDER_PARTITION_TYPE	0xDBU
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef enum {
+	eAudioRecorderCodec_First = 0,
+	eAudioRecorderCodec_Pcm16 = eAudioRecorderCodec_First,
+	eAudioRecorderCodec_ImaAdpcm,
+	eAudioRecorderCodec_Rice,
+	eAudioRecorderCodec_Last
+} eAudioRecorderCodec_t;
+
+typedef struct {
+	uint32_t first_lba;
+	uint32_t sector_count;
+} sAudioRecorderExtent_t;
+
+/*
+ * Hands out one contiguous extent per file and is told the final length once the file is closed. Optionally prepares
+ * the next extent ahead of time from Audio_Recorder_Process, and drops it again when recording stops.
+ */
+typedef struct {
+	bool (*open) (eSdCard_t card, uint32_t sector_count, sAudioRecorderExtent_t *extent);
+	bool (*close) (eSdCard_t card, const sAudioRecorderExtent_t *extent, uint32_t byte_count);
+	bool (*prepare) (eSdCard_t card, uint32_t sector_count);
+	void (*release) (eSdCard_t card);
+} sAudioRecorderStorage_t;
+
+typedef struct {
+	uint32_t max_file_bytes;
+	uint32_t max_file_seconds;
+	eAudioRecorderCodec_t codec;
+} sAudioRecorderConfig_t;
+
+typedef struct {
+	uint32_t files_closed;
+	uint32_t blocks_written;
+	uint32_t write_errors;
+} sAudioRecorderStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Audio_Recorder_Init (eSdCard_t card, const sAudioRecorderConfig_t *config, const sAudioRecorderStorage_t *storage);
+bool Audio_Recorder_Start (void);
+bool Audio_Recorder_Stop (void);
+bool Audio_Recorder_IsRecording (void);
+/* Closes the open file, the next one is written with the new codec */
+bool Audio_Recorder_SetCodec (eAudioRecorderCodec_t codec);
+bool Audio_Recorder_WriteBlock (const sAudioBlock_t *block);
+/* Storage task: gets the next file ready so a roll inside the DSP task never scans the card */
+void Audio_Recorder_Process (void);
+bool Audio_Recorder_GetStats (sAudioRecorderStats_t *stats);
+
+#endif /* INC_AUDIO_RECORDER_H_ */
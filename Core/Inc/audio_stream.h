@@ -0,0 +1,45 @@
+#ifndef INC_AUDIO_STREAM_H_
+#define INC_AUDIO_STREAM_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define AUDIO_STREAM_BLOCK_SAMPLES		256U
+#define AUDIO_STREAM_DEFAULT_RATE_HZ	16000U
+#define AUDIO_STREAM_ADC_MIDSCALE		2048
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+/* Called from the DMA interrupt each time a block is ready */
+typedef void (*AudioStreamBlockCb_t) (void);
+
+typedef struct {
+	const uint16_t *samples;
+	uint32_t sample_count;
+	uint32_t sequence;
+	/* Timebase ticks of the last sample's conversion trigger */
+	uint64_t timestamp;
+} sAudioBlock_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Audio_Stream_Start (uint32_t sample_rate);
+bool Audio_Stream_Stop (void);
+bool Audio_Stream_SetBlockCallback (AudioStreamBlockCb_t block_cb);
+bool Audio_Stream_GetBlock (sAudioBlock_t *block);
+void Audio_Stream_ReleaseBlock (void);
+uint32_t Audio_Stream_GetSampleRate (void);
+uint32_t Audio_Stream_GetOverrunCount (void);
+/* Blocks with an extrapolated rather than a captured timestamp */
+uint32_t Audio_Stream_GetUntimedCount (void);
+
+#endif /* INC_AUDIO_STREAM_H_ */
@@ -0,0 +1,78 @@
+#ifndef INC_CLOCK_MANAGER_H_
+#define INC_CLOCK_MANAGER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+typedef enum {
+	eClockSource_First = 0,
+	/* What SystemClock_Config starts from; within about 1 % over temperature */
+	eClockSource_Hsi = eClockSource_First,
+	/* 8 MHz external clock, crystal accurate sample rates and filter corners */
+	eClockSource_Hse,
+	eClockSource_Last
+} eClockSource_t;
+
+/* Slowest first; the last one is the frequency SystemClock_Config sets up */
+typedef enum {
+	eClockPoint_First = 0,
+	eClockPoint_16MHz = eClockPoint_First,
+	eClockPoint_42MHz,
+	eClockPoint_84MHz,
+	eClockPoint_Last
+} eClockPoint_t;
+
+/* Drivers whose timing derives from the bus clocks, told in this order after every switch */
+typedef enum {
+	eClockClient_First = 0,
+	eClockClient_Tim = eClockClient_First,
+	eClockClient_Adc,
+	eClockClient_Spi,
+	eClockClient_Uart,
+	eClockClient_Timebase,
+	eClockClient_Last
+} eClockClient_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*ClockChangeCb_t) (void);
+
+typedef struct {
+	uint32_t switches;
+	/* Switches put off because a UART transfer was in flight */
+	uint32_t deferred;
+	/* Share of the last window the core spent awake, from the sleep time the power manager measures */
+	uint32_t busy_percent;
+} sClockStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Call right after SystemClock_Config and before the drivers register their callbacks; falls back to HSI if HSE fails */
+bool Clock_Manager_Init (eClockSource_t source);
+eClockSource_t Clock_Manager_GetSource (void);
+bool Clock_Manager_SetCallback (eClockClient_t client, ClockChangeCb_t callback);
+/* Lowest point the load governor may pick; above the current point, the next Clock_Manager_Process switches up */
+bool Clock_Manager_SetFloor (eClockPoint_t floor);
+/* Thread context only, never while an SPI transfer is in progress; a failing HSE drops the source to HSI for good */
+bool Clock_Manager_SetPoint (eClockPoint_t point);
+/*
+ * After SystemClock_Config brought back full speed, e.g. on wake from STOP: returns to the point in use before. Needs
+ * SysTick running to time out the oscillator waits, so not with interrupts masked.
+ */
+void Clock_Manager_Resync (void);
+eClockPoint_t Clock_Manager_GetPoint (void);
+uint32_t Clock_Manager_GetFrequency (eClockPoint_t point);
+/* Load governor, call periodically from a task; decides once per window and never while a UART frame is in flight */
+void Clock_Manager_Process (void);
+bool Clock_Manager_GetStats (sClockStats_t *stats);
+
+#endif /* INC_CLOCK_MANAGER_H_ */
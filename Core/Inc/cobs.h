@@ -0,0 +1,37 @@
+#ifndef INC_COBS_H_
+#define INC_COBS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Consistent overhead byte stuffing: the encoded block never contains 0x00, which is left free as frame delimiter */
+#define COBS_MAX_ENCODED(length)	((length) + ((length) / 254U) + 1U)
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Returns the encoded length, out must hold COBS_MAX_ENCODED(length) bytes; no delimiter is appended */
+size_t COBS_Encode (const uint8_t *in, size_t length, uint8_t *out);
+/* Returns the decoded length or 0 for a malformed block, out must hold length bytes; may decode in place */
+size_t COBS_Decode (const uint8_t *in, size_t length, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_COBS_H_ */
@@ -0,0 +1,40 @@
+#ifndef INC_CONFIG_SHELL_H_
+#define INC_CONFIG_SHELL_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_recorder.h"
+#include "sound_level.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t sample_rate;
+	eSoundLevelWeighting_t weighting;
+	int16_t event_threshold_cdb;
+	int16_t calibration_cdb;
+	uint32_t interval_ms;
+	bool is_recording;
+	eAudioRecorderCodec_t codec;
+} sConfigShellSettings_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Config_Shell_Init (const sConfigShellSettings_t *initial);
+/* Answers the host's get/set frames from the foreground; accepted sets are only staged */
+bool Config_Shell_Process (void);
+/* Hands out the staged settings once, to be applied between two audio blocks */
+bool Config_Shell_TakePending (sConfigShellSettings_t *settings);
+
+#endif /* INC_CONFIG_SHELL_H_ */
@@ -0,0 +1,34 @@
+#ifndef INC_CRC16_H_
+#define INC_CRC16_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define CRC16_INIT	0xFFFFU
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+uint16_t CRC16_Update (uint16_t crc, const void *data, size_t length);
+uint16_t CRC16_Compute (const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CRC16_H_ */
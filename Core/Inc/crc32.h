@@ -0,0 +1,34 @@
+#ifndef INC_CRC32_H_
+#define INC_CRC32_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define CRC32_INIT	0xFFFFFFFFUL
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+uint32_t CRC32_Update (uint32_t crc, const void *data, size_t length);
+uint32_t CRC32_Compute (const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CRC32_H_ */
@@ -0,0 +1,48 @@
+#ifndef INC_DEFERRED_WORK_H_
+#define INC_DEFERRED_WORK_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Bottom halves, run in this order from PendSV */
+typedef enum {
+	eDeferredWork_First = 0,
+	eDeferredWork_Dma = eDeferredWork_First,
+	eDeferredWork_Uart,
+	eDeferredWork_Gpio,
+	eDeferredWork_Last
+} eDeferredWork_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*DeferredWorkCb_t) (void);
+
+typedef struct {
+	uint32_t posts;
+	uint32_t runs;
+} sDeferredWorkStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* PendSV at the lowest priority; call before the drivers register their bottom halves */
+bool Deferred_Work_Init (void);
+bool Deferred_Work_SetCallback (eDeferredWork_t work, DeferredWorkCb_t callback);
+/* From a top half: marks the work pending and pends PendSV */
+void Deferred_Work_Post (eDeferredWork_t work);
+/* Called from PendSV_Handler, runs until nothing is pending */
+void Deferred_Work_Run (void);
+/* Atomic helpers for the event counters top halves hand to their bottom halves */
+void Deferred_Work_Add (volatile uint32_t *counter, uint32_t value);
+uint32_t Deferred_Work_Take (volatile uint32_t *counter);
+bool Deferred_Work_GetStats (eDeferredWork_t work, sDeferredWorkStats_t *stats);
+
+#endif /* INC_DEFERRED_WORK_H_ */
@@ -1,22 +1,40 @@
 #ifndef INC_DMA_DRIVER_H_
 #define INC_DMA_DRIVER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef enum {
 	eDmaStream_First = 0,
 	eDmaStream_1 = eDmaStream_First,
+	eDmaStream_UartDebugTx,
+	eDmaStream_UartDebugRx,
 	eDmaStream_Last
 } eDmaStream_t;
 
+typedef enum {
+	eDmaEvent_First = 0,
+	eDmaEvent_HalfTransfer = eDmaEvent_First,
+	eDmaEvent_TransferComplete,
+	eDmaEvent_TransferError,
+	eDmaEvent_Last
+} eDmaEvent_t;
+
 typedef struct {
 	eDmaStream_t dma_stream;
 	void *periph_or_src_addr;
 	void *dest_addr;
 	uint32_t data_amount;
-	void (*IT_cb) (eDmaStream_t);
+	void (*IT_cb) (eDmaStream_t, eDmaEvent_t);
 } sDmaInit_t;
 
 bool DMA_Driver_Init (sDmaInit_t *dma_init_data);
 bool DMA_Driver_EnableStream (eDmaStream_t dma_stream);
 bool DMA_Driver_DisableStream (eDmaStream_t dma_stream);
+bool DMA_Driver_SetMemory (eDmaStream_t dma_stream, void *memory_addr, uint32_t data_amount);
+uint32_t DMA_Driver_GetRemaining (eDmaStream_t dma_stream);
+/* Timestamped streams, from the event callback: timebase ticks of that event; false where coalescing lost its time */
+bool DMA_Driver_GetEventTicks (eDmaStream_t dma_stream, eDmaEvent_t event, uint64_t *ticks);
+void DMA_Driver_IRQHandler (eDmaStream_t dma_stream);
 
 #endif /* INC_DMA_DRIVER_H_ */
@@ -0,0 +1,63 @@
+#ifndef INC_FAT32_H_
+#define INC_FAT32_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sd_card_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define FAT32_FILE_MAX_RUNS		8U
+#define FAT32_MAX_OPEN_FILES	4U
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t sync_interval_ms;
+	uint32_t prealloc_clusters;
+} sFat32Config_t;
+
+/* Cached cluster chain of a file, kept as contiguous runs so appends never walk the FAT */
+typedef struct {
+	uint32_t first_cluster;
+	uint32_t cluster_count;
+} sFat32Run_t;
+
+typedef struct {
+	bool is_open;
+	bool is_dir_dirty;
+	uint32_t dir_lba;
+	uint16_t dir_offset;
+	uint32_t size;
+	uint32_t allocated_clusters;
+	uint8_t run_count;
+	sFat32Run_t runs[FAT32_FILE_MAX_RUNS];
+	uint32_t sector_fill;
+	uint8_t sector[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+} sFat32File_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool FAT32_Mount (eSdCard_t card, const sFat32Config_t *config);
+bool FAT32_IsMounted (void);
+bool FAT32_CreateFile (const char *name, uint32_t prealloc_bytes, bool is_contiguous, sFat32File_t *file);
+bool FAT32_Exists (const char *name);
+bool FAT32_Write (sFat32File_t *file, const uint8_t *data, uint32_t byte_count);
+bool FAT32_GetExtent (const sFat32File_t *file, uint32_t *first_lba, uint32_t *sector_count);
+bool FAT32_SetSize (sFat32File_t *file, uint32_t size);
+/* Puts the file's chain and directory entry on the card, so it checks clean if power fails while it is open */
+bool FAT32_Flush (sFat32File_t *file);
+bool FAT32_Close (sFat32File_t *file);
+/* Closes the file and deletes it, its clusters go back to the free pool */
+bool FAT32_Discard (sFat32File_t *file);
+bool FAT32_Sync (void);
+void FAT32_Process (void);
+
+#endif /* INC_FAT32_H_ */
@@ -8,6 +8,7 @@ extern "C" {
  * Includes
  *********************************************************************************************************************/
 #include <stdbool.h>
+#include <stdint.h>
 /**********************************************************************************************************************
  * Exported definitions and macros
  *********************************************************************************************************************/
@@ -26,6 +27,7 @@ typedef enum {
 /**********************************************************************************************************************
  * Exported types
  *********************************************************************************************************************/
+typedef void (*GpioIrqCb_t) (eGpioPin_t pin);
 
 /**********************************************************************************************************************
  * Exported variables
@@ -38,6 +40,9 @@ bool GPIO_Driver_Init (void);
 bool GPIO_Driver_TogglePin (eGpioPin_t pin);
 bool GPIO_Driver_ReadPin (eGpioPin_t pin, bool *state);
 bool GPIO_Driver_WritePin (eGpioPin_t pin, bool state);
+bool GPIO_Driver_SetIrqCallback (eGpioPin_t pin, GpioIrqCb_t irq_cb);
+/* Timebase ticks of the pin's latest interrupt edge */
+bool GPIO_Driver_GetIrqTicks (eGpioPin_t pin, uint64_t *ticks);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,42 @@
+#ifndef INC_IMA_ADPCM_H_
+#define INC_IMA_ADPCM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define IMA_ADPCM_WAVE_FORMAT		0x0011U
+#define IMA_ADPCM_BITS_PER_SAMPLE	4U
+#define IMA_ADPCM_BLOCK_HEADER_SIZE	4U
+
+/* Mono block: 4-byte header holding the first sample, then two samples per byte */
+#define IMA_ADPCM_SAMPLES_PER_BLOCK(block_size)	((((block_size) - IMA_ADPCM_BLOCK_HEADER_SIZE) * 2U) + 1U)
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	int16_t predictor;
+	uint8_t step_index;
+} sImaAdpcmState_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool IMA_ADPCM_EncodeBlock (sImaAdpcmState_t *state, const int16_t *pcm, uint32_t block_size, uint8_t *block);
+bool IMA_ADPCM_DecodeBlock (const uint8_t *block, uint32_t block_size, int16_t *pcm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_IMA_ADPCM_H_ */
@@ -0,0 +1,49 @@
+#ifndef INC_IRQ_MAP_H_
+#define INC_IRQ_MAP_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Every interrupt source in the firmware, highest priority first */
+typedef enum {
+	eIrqSource_First = 0,
+	eIrqSource_AdcDma = eIrqSource_First,
+	eIrqSource_SpiDma,
+	eIrqSource_UartRx,
+	eIrqSource_UartTxDma,
+	eIrqSource_Exti,
+	eIrqSource_SysTick,
+	eIrqSource_Timebase,
+	eIrqSource_PendSV,
+	eIrqSource_Last
+} eIrqSource_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t count;
+	uint32_t max_cycles;
+	uint32_t over_budget;
+} sIrqStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Sets the grouping and re-applies the SysTick priority HAL_Init left behind; call before any driver init */
+bool IRQ_Map_Init (void);
+/* Encoded for NVIC_SetPriority under the map's grouping */
+uint32_t IRQ_Map_GetPriority (eIrqSource_t source);
+/* Bracket a handler body; the cycles in between are checked against the source's budget */
+uint32_t IRQ_Map_Enter (void);
+void IRQ_Map_Exit (eIrqSource_t source, uint32_t enter_cycles);
+bool IRQ_Map_GetStats (eIrqSource_t source, sIrqStats_t *stats);
+
+#endif /* INC_IRQ_MAP_H_ */
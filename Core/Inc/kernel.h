@@ -0,0 +1,110 @@
+#ifndef INC_KERNEL_H_
+#define INC_KERNEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define KERNEL_WAIT_FOREVER	UINT32_MAX
+/* Smallest stack the port accepts, enough for the saved context including the FPU registers */
+#define KERNEL_MIN_STACK_BYTES	256U
+
+/* In priority order, the first thread has the highest priority; the idle thread is created by Kernel_Start */
+typedef enum {
+	eKernelThread_First = 0,
+	eKernelThread_Dsp = eKernelThread_First,
+	eKernelThread_Storage,
+	eKernelThread_Telemetry,
+	eKernelThread_Housekeeping,
+	eKernelThread_Idle,
+	eKernelThread_Last
+} eKernelThread_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*KernelThreadCb_t) (void);
+
+typedef struct {
+	eKernelThread_t thread;
+	/* Must not return */
+	KernelThreadCb_t entry;
+	/* Statically allocated by the caller, 8 byte aligned */
+	uint64_t *stack;
+	size_t stack_bytes;
+} sKernelThreadInit_t;
+
+typedef struct {
+	volatile uint32_t count;
+	uint32_t max_count;
+	/* Bit N set while thread N waits */
+	volatile uint32_t waiters;
+} sKernelSem_t;
+
+/* Owned by the thread that locked it; whoever it holds up lends the owner its priority until the unlock */
+typedef struct {
+	/* eKernelThread_Last while unlocked */
+	volatile eKernelThread_t owner;
+	volatile uint32_t waiters;
+} sKernelMutex_t;
+
+typedef struct {
+	uint8_t *buffer;
+	size_t item_size;
+	size_t capacity;
+	size_t head;
+	size_t tail;
+	volatile size_t count;
+	volatile uint32_t rx_waiters;
+	volatile uint32_t tx_waiters;
+} sKernelQueue_t;
+
+typedef struct {
+	uint32_t switches;
+	/* Never written since the thread was created, the stack's high-water mark */
+	size_t stack_free_bytes;
+} sKernelThreadStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Kernel_Init (void);
+bool Kernel_InitThread (const sKernelThreadInit_t *init);
+/* Switches to the highest priority thread on its own stack; returns only when the kernel cannot start */
+bool Kernel_Start (void);
+bool Kernel_IsRunning (void);
+/* Called from SysTick_Handler */
+void Kernel_OnTick (void);
+/* Thread context only */
+void Kernel_Delay (uint32_t delay_ms);
+/* Sleeps until *wake_tick + period_ms and advances *wake_tick, so periodic threads do not drift */
+void Kernel_DelayUntil (uint32_t *wake_tick, uint32_t period_ms);
+/* Take and Receive/Send block in threads; from interrupts they never wait, whatever the timeout */
+bool Kernel_SemInit (sKernelSem_t *sem, uint32_t count, uint32_t max_count);
+bool Kernel_SemTake (sKernelSem_t *sem, uint32_t timeout_ms);
+/* Safe from interrupts; gives beyond max_count are dropped */
+bool Kernel_SemGive (sKernelSem_t *sem);
+/* Threads only, not recursive; a thread holds one mutex at a time, the boost is not passed down a chain of owners */
+bool Kernel_MutexInit (sKernelMutex_t *mutex);
+bool Kernel_MutexLock (sKernelMutex_t *mutex, uint32_t timeout_ms);
+bool Kernel_MutexUnlock (sKernelMutex_t *mutex);
+bool Kernel_QueueInit (sKernelQueue_t *queue, void *buffer, size_t item_size, size_t capacity);
+bool Kernel_QueueSend (sKernelQueue_t *queue, const void *item, uint32_t timeout_ms);
+bool Kernel_QueueReceive (sKernelQueue_t *queue, void *item, uint32_t timeout_ms);
+bool Kernel_GetStats (eKernelThread_t thread, sKernelThreadStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_KERNEL_H_ */
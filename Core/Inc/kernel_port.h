@@ -0,0 +1,41 @@
+#ifndef INC_KERNEL_PORT_H_
+#define INC_KERNEL_PORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+#include "kernel.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Builds the frame the first switch to the thread unstacks, returns the saved stack pointer */
+uint32_t *Kernel_Port_InitStack (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit);
+/* Leaves the startup stack for the thread's own, never returns */
+void Kernel_Port_Start (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit);
+/* Pends the switch, taken once nothing of higher priority is running */
+void Kernel_Port_Yield (void);
+
+/* Implemented by the kernel, called from the port's PendSV: stores the outgoing stack, returns the incoming one */
+uint32_t *Kernel_SwitchContext (uint32_t *stack_pointer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_KERNEL_PORT_H_ */
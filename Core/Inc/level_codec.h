@@ -0,0 +1,54 @@
+#ifndef INC_LEVEL_CODEC_H_
+#define INC_LEVEL_CODEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "log_format.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Columns are Leq, Lmax, Lmin, then band levels starting at first_band */
+#define LEVEL_CODEC_FIXED_COLUMNS	3U
+#define LEVEL_CODEC_MAX_COLUMNS		(LEVEL_CODEC_FIXED_COLUMNS + LOG_SPECTRUM_MAX_BANDS)
+#define LEVEL_CODEC_MAX_VARINT		3U
+/* Two full records fill a sector payload exactly */
+#define LEVEL_CODEC_MAX_RECORD		((LOG_SECTOR_PAYLOAD_SIZE / 2U) - LOG_RECORD_HEADER_SIZE)
+#define LEVEL_CODEC_MAX_DATA		(LEVEL_CODEC_MAX_RECORD - sizeof(sLogLevels_t))
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	sLogLevels_t header;
+	uint64_t timestamp_ms;
+	int16_t previous[LEVEL_CODEC_MAX_COLUMNS];
+	uint8_t record[LEVEL_CODEC_MAX_RECORD];
+	size_t fill;
+} sLevelPacker_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+int16_t Level_Codec_CdbToDdb (int16_t cdb);
+size_t Level_Codec_EncodeRow (const int16_t *values, const int16_t *previous, uint32_t count, uint8_t *out, size_t capacity);
+size_t Level_Codec_DecodeRow (const uint8_t *in, size_t length, const int16_t *previous, uint32_t count, int16_t *values);
+
+bool Level_Packer_Init (sLevelPacker_t *packer, uint8_t column_count, uint8_t first_band);
+bool Level_Packer_IsEmpty (const sLevelPacker_t *packer);
+bool Level_Packer_Append (sLevelPacker_t *packer, const int16_t *values_ddb, uint64_t timestamp_ms, uint32_t interval_ms);
+size_t Level_Packer_Finish (sLevelPacker_t *packer, uint64_t *timestamp_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LEVEL_CODEC_H_ */
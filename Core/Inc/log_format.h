@@ -0,0 +1,166 @@
+#ifndef INC_LOG_FORMAT_H_
+#define INC_LOG_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/*
+ * On-card layout of the raw log partition, shared by the firmware and the host tools.
+ * The partition is a ring of 512 byte sectors written strictly in order. Every sector is self-describing:
+ * a header with sequence number, timestamp of its first record, record count and CRC, followed by packed records.
+ * Records never straddle sectors and all multi-byte fields are little-endian. Timestamps are UTC milliseconds since
+ * 1970 from the RTC; a logger whose clock was never set counts from 2000-01-01, one without the LSE from power-up.
+ */
+#define LOG_PARTITION_TYPE			0xDAU
+#define LOG_SECTOR_SIZE				512U
+#define LOG_SECTOR_MAGIC			0x474C4E53UL
+#define LOG_SECTOR_HEADER_SIZE		24U
+#define LOG_SECTOR_PAYLOAD_SIZE		(LOG_SECTOR_SIZE - LOG_SECTOR_HEADER_SIZE)
+#define LOG_RECORD_HEADER_SIZE		2U
+#define LOG_RECORD_MAX_PAYLOAD		(LOG_SECTOR_PAYLOAD_SIZE - LOG_RECORD_HEADER_SIZE)
+#define LOG_SPECTRUM_MAX_BANDS		33U
+
+/*
+ * The first sectors of the partition hold two superblock copies written alternately (A for even generations,
+ * B for odd), so a power cut mid-write always leaves the previous checkpoint readable. The sparse index follows
+ * them, then the ring.
+ */
+#define LOG_SUPERBLOCK_MAGIC		0x42534C53UL
+#define LOG_SUPERBLOCK_VERSION		2U
+#define LOG_SUPERBLOCK_COPIES		2U
+#define LOG_INDEX_FIRST_SECTOR		LOG_SUPERBLOCK_COPIES
+
+/* One index entry per LOG_INDEX_INTERVAL ring sectors: entry n describes ring sector n * LOG_INDEX_INTERVAL */
+#define LOG_INDEX_INTERVAL			64U
+#define LOG_INDEX_ENTRIES_PER_SECTOR	42U
+
+typedef enum {
+	eLogRecord_End = 0,
+	eLogRecord_First = 1,
+	eLogRecord_LeqInterval = eLogRecord_First,
+	eLogRecord_Event,
+	eLogRecord_Spectrum,
+	eLogRecord_Status,
+	eLogRecord_Levels,
+	eLogRecord_Checkpoint,
+	eLogRecord_Last
+} eLogRecord_t;
+
+typedef enum {
+	eLogEvent_First = 0,
+	eLogEvent_Threshold = eLogEvent_First,
+	eLogEvent_SensorTrigger,
+	eLogEvent_Last
+} eLogEvent_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint32_t sequence;
+	uint64_t timestamp_ms;
+	uint16_t record_count;
+	uint16_t payload_bytes;
+	/* CRC-32 of the whole sector computed with this field set to zero */
+	uint32_t crc32;
+} sLogSectorHeader_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t type;
+	uint8_t length;
+} sLogRecordHeader_t;
+
+/* Every record payload starts with its signed offset from the sector timestamp */
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint32_t duration_ms;
+	int16_t leq_cdb;
+	int16_t lmax_cdb;
+	int16_t lmin_cdb;
+} sLogLeqInterval_t;
+
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint32_t duration_ms;
+	int16_t peak_cdb;
+	uint8_t kind;
+	uint8_t count;
+} sLogEvent_t;
+
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint8_t first_band;
+	uint8_t band_count;
+	int16_t band_cdb[LOG_SPECTRUM_MAX_BANDS];
+} sLogSpectrum_t;
+
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint32_t uptime_s;
+	uint32_t audio_overruns;
+	uint32_t storage_errors;
+	uint32_t sectors_written;
+} sLogStatus_t;
+
+/* Run of equally spaced level rows in 0.1 dB, followed by zig-zag varints: first row as deltas across columns, then deltas on the row before */
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint16_t interval_ms;
+	uint8_t column_count;
+	uint8_t row_count;
+	uint8_t first_band;
+} sLogLevels_t;
+
+/* Marks the point a superblock generation was written, everything before it was already on the card */
+typedef struct __attribute__((packed)) {
+	int32_t time_offset_ms;
+	uint32_t generation;
+	uint32_t records_written;
+} sLogCheckpoint_t;
+
+/* Ring indices are relative to data_first; head and sequence name the sector being filled at checkpoint time */
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t generation;
+	uint32_t site_id;
+	uint32_t index_first;
+	uint32_t index_sectors;
+	uint32_t data_first;
+	uint32_t data_count;
+	uint32_t head;
+	uint32_t sequence;
+	uint64_t timestamp_ms;
+	/* CRC-32 of this structure computed with this field set to zero */
+	uint32_t crc32;
+} sLogSuperblock_t;
+
+/* An entry is current only while the ring sector it names still carries its sequence number */
+typedef struct __attribute__((packed)) {
+	uint64_t timestamp_ms;
+	uint32_t sequence;
+} sLogIndexEntry_t;
+
+typedef struct __attribute__((packed)) {
+	sLogIndexEntry_t entries[LOG_INDEX_ENTRIES_PER_SECTOR];
+	uint32_t reserved;
+	/* CRC-32 of the whole sector computed with this field set to zero */
+	uint32_t crc32;
+} sLogIndexSector_t;
+
+typedef char sLogIndexSectorSizeCheck_t[(sizeof(sLogIndexSector_t) == LOG_SECTOR_SIZE) ? 1 : -1];
+typedef char sLogSectorHeaderSizeCheck_t[(sizeof(sLogSectorHeader_t) == LOG_SECTOR_HEADER_SIZE) ? 1 : -1];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_FORMAT_H_ */
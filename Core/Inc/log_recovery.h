@@ -0,0 +1,44 @@
+#ifndef INC_LOG_RECOVERY_H_
+#define INC_LOG_RECOVERY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "log_format.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Sectors probed past the binary search result, enough to step over a few dropped writes */
+#define LOG_RECOVERY_PROBE_SECTORS	8U
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+/* Reads ring sector index (relative to data_first) into a 512 byte buffer */
+typedef bool (*LogSectorReadCb_t) (void *context, uint32_t index, uint8_t *sector);
+
+typedef struct {
+	uint32_t head;
+	uint32_t sequence;
+} sLogPosition_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Log_Recovery_IsValidSector (const uint8_t *sector, sLogSectorHeader_t *header);
+void Log_Recovery_SealSuperblock (sLogSuperblock_t *superblock);
+bool Log_Recovery_PickSuperblock (const uint8_t *copy_a, const uint8_t *copy_b, sLogSuperblock_t *superblock);
+bool Log_Recovery_FindHead (LogSectorReadCb_t read_cb, void *context, uint32_t data_count, const sLogPosition_t *checkpoint, sLogPosition_t *head, uint32_t *reads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_RECOVERY_H_ */
@@ -0,0 +1,40 @@
+#ifndef INC_LOG_WRITER_H_
+#define INC_LOG_WRITER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "log_format.h"
+#include "sd_card_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t sectors_written;
+	uint32_t records_written;
+	uint32_t write_errors;
+	uint32_t checkpoints;
+	uint32_t index_updates;
+	uint32_t recovery_reads;
+} sLogWriterStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Log_Writer_Init (eSdCard_t card, uint32_t site_id);
+bool Log_Writer_IsReady (void);
+bool Log_Writer_Append (eLogRecord_t type, const void *payload, uint8_t length, uint64_t timestamp_ms);
+bool Log_Writer_Flush (void);
+bool Log_Writer_Checkpoint (uint64_t timestamp_ms);
+bool Log_Writer_GetStats (sLogWriterStats_t *stats);
+
+#endif /* INC_LOG_WRITER_H_ */
@@ -0,0 +1,34 @@
+#ifndef INC_PARTITION_H_
+#define INC_PARTITION_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sd_card_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define PARTITION_TYPE_FAT32_CHS	0x0BU
+#define PARTITION_TYPE_FAT32_LBA	0x0CU
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint8_t type;
+	uint32_t first_lba;
+	uint32_t sector_count;
+} sPartition_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Partition_Find (eSdCard_t card, const uint8_t *types, uint8_t type_count, sPartition_t *partition);
+/* Blank means sector 0 carries neither a partition table nor a boot sector; false if it cannot be read */
+bool Partition_IsBlank (eSdCard_t card, bool *is_blank);
+
+#endif /* INC_PARTITION_H_ */
@@ -0,0 +1,62 @@
+#ifndef INC_POWER_MANAGER_H_
+#define INC_POWER_MANAGER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+typedef enum {
+	ePowerMode_First = 0,
+	/* Sleep between interrupts, DMA and ADC keep running */
+	ePowerMode_Continuous = ePowerMode_First,
+	/* STOP while nothing holds the clocks, only EXTI wakes the core: no SysTick, no UART receive */
+	ePowerMode_EventOnly,
+	ePowerMode_Last
+} ePowerMode_t;
+
+/* Activity STOP would corrupt, each held by its driver while it runs */
+typedef enum {
+	ePowerHold_First = 0,
+	ePowerHold_Audio = ePowerHold_First,
+	ePowerHold_UartTx,
+	/* A thread sleeping out a busy SD card needs SysTick to wake it */
+	ePowerHold_SdBusy,
+	ePowerHold_Last
+} ePowerHold_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*PowerRestoreClocksCb_t) (void);
+
+typedef struct {
+	uint32_t sleeps;
+	uint32_t stops;
+	/* Time spent asleep in microseconds, wraps every 71 minutes; the load measure of the clock manager */
+	uint32_t idle_us;
+} sPowerStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* restore_clocks brings the PLL back after STOP, which always wakes on HSI */
+bool Power_Manager_Init (PowerRestoreClocksCb_t restore_clocks);
+bool Power_Manager_SetMode (ePowerMode_t mode);
+ePowerMode_t Power_Manager_GetMode (void);
+/* Safe from interrupts */
+void Power_Manager_Hold (ePowerHold_t hold, bool is_held);
+bool Power_Manager_IsHeld (ePowerHold_t hold);
+/*
+ * Called with interrupts masked once the caller found nothing to run; returns when an interrupt is pending. After STOP
+ * the handlers already run while the clocks are restored, PendSV still waits for the caller to unmask.
+ */
+void Power_Manager_Idle (void);
+bool Power_Manager_GetStats (sPowerStats_t *stats);
+
+#endif /* INC_POWER_MANAGER_H_ */
@@ -0,0 +1,93 @@
+#ifndef INC_PROFILER_H_
+#define INC_PROFILER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "stm32f4xx.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Debug builds only unless forced, a release image carries neither the table nor the probes */
+#ifndef PROFILER_ENABLED
+#ifdef DEBUG
+#define PROFILER_ENABLED	1
+#else
+#define PROFILER_ENABLED	0
+#endif
+#endif
+
+/* Interrupt probes come first and are fed by IRQ_Map_Exit, the rest bracket pipeline stages and task bodies */
+typedef enum {
+	eProfilerProbe_First = 0,
+	eProfilerProbe_AdcDmaIrq = eProfilerProbe_First,
+	eProfilerProbe_SpiDmaIrq,
+	eProfilerProbe_UartRxIrq,
+	eProfilerProbe_UartTxDmaIrq,
+	eProfilerProbe_ExtiIrq,
+	eProfilerProbe_SysTickIrq,
+	eProfilerProbe_TimebaseIrq,
+	eProfilerProbe_PendSVIrq,
+	/* One audio block through the recorder and the level meter */
+	eProfilerProbe_DspBlock,
+	eProfilerProbe_RecorderBlock,
+	eProfilerProbe_LevelFilters,
+	/* One sector handed to the card, including the wait for the previous one */
+	eProfilerProbe_SdWrite,
+	eProfilerProbe_DspTask,
+	eProfilerProbe_StorageTask,
+	eProfilerProbe_TelemetryTask,
+	eProfilerProbe_HousekeepingTask,
+	eProfilerProbe_Last
+} eProfilerProbe_t;
+
+/*
+ * PROFILER_BEGIN and PROFILER_END bracket a section within one block, each probe is fed from a single context. Relies
+ * on the DWT cycle counter IRQ_Map_Init starts; the cycles include anything that preempts the section.
+ */
+#if PROFILER_ENABLED
+#define PROFILER_BEGIN(probe) \
+	const uint32_t profiler_start_##probe = DWT->CYCCNT
+#define PROFILER_END(probe) \
+	Profiler_Record((probe), DWT->CYCCNT - profiler_start_##probe)
+#define PROFILER_RECORD(probe, cycles) \
+	Profiler_Record((probe), (cycles))
+#define PROFILER_RESET() \
+	Profiler_Reset()
+#define PROFILER_DUMP(deadline_cycles) \
+	Profiler_Dump(deadline_cycles)
+#else
+#define PROFILER_BEGIN(probe)			do { } while (0)
+#define PROFILER_END(probe)				do { } while (0)
+#define PROFILER_RECORD(probe, cycles)	do { (void) (cycles); } while (0)
+#define PROFILER_RESET()				do { } while (0)
+#define PROFILER_DUMP(deadline_cycles)	do { (void) (deadline_cycles); } while (0)
+#endif
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+} sProfilerStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+#if PROFILER_ENABLED
+void Profiler_Record (eProfilerProbe_t probe, uint32_t cycles);
+/* Starts a new measurement, e.g. after the sample rate changed */
+void Profiler_Reset (void);
+bool Profiler_GetStats (eProfilerProbe_t probe, sProfilerStats_t *stats);
+/* Traces every probe that ran, the worst case also as a share of deadline_cycles */
+void Profiler_Dump (uint32_t deadline_cycles);
+#endif
+
+#endif /* INC_PROFILER_H_ */
@@ -0,0 +1,56 @@
+#ifndef INC_RICE_CODEC_H_
+#define INC_RICE_CODEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define RICE_CODEC_FRAME_SYNC		0xA5U
+#define RICE_CODEC_FRAME_HEADER_SIZE	8U
+#define RICE_CODEC_MAX_ORDER		3U
+#define RICE_CODEC_PARTITIONS		4U
+#define RICE_CODEC_MAX_FRAME_SAMPLES	1024U
+
+/* Verbatim fallback caps every frame at header plus raw samples, whatever the input */
+#define RICE_CODEC_MAX_FRAME_BYTES(samples)	(RICE_CODEC_FRAME_HEADER_SIZE + ((samples) * sizeof(int16_t)))
+
+/* .SLC container: one header sector, then frames back to back with no padding */
+#define RICE_CODEC_FILE_MAGIC		0x31434C53UL
+#define RICE_CODEC_FILE_VERSION		1U
+#define RICE_CODEC_FILE_HEADER_SIZE	512U
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t channels;
+	uint32_t sample_rate;
+	uint32_t frame_samples;
+	uint32_t sample_count;
+	uint32_t data_bytes;
+	uint16_t bits_per_sample;
+} sRiceFileHeader_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+size_t Rice_Codec_EncodeFrame (const int16_t *pcm, uint32_t sample_count, uint8_t *frame, size_t capacity);
+size_t Rice_Codec_DecodeFrame (const uint8_t *frame, size_t length, int16_t *pcm, uint32_t capacity, uint32_t *sample_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_RICE_CODEC_H_ */
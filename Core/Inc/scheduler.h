@@ -0,0 +1,59 @@
+#ifndef INC_SCHEDULER_H_
+#define INC_SCHEDULER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* In priority order, the first task has the highest priority */
+typedef enum {
+	eSchedulerTask_First = 0,
+	eSchedulerTask_Dsp = eSchedulerTask_First,
+	eSchedulerTask_Storage,
+	eSchedulerTask_Telemetry,
+	eSchedulerTask_Housekeeping,
+	eSchedulerTask_Last
+} eSchedulerTask_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*SchedulerTaskCb_t) (void);
+
+typedef struct {
+	eSchedulerTask_t task;
+	SchedulerTaskCb_t callback;
+	/* Posted from SysTick every period, 0 for event-only tasks */
+	uint32_t period_ms;
+	/* Longest acceptable wait from the first post to the start of the run, 0 to not check */
+	uint32_t deadline_ms;
+} sSchedulerTaskInit_t;
+
+typedef struct {
+	uint32_t runs;
+	/* Posts that found the task still pending and were merged into the earlier one */
+	uint32_t coalesced;
+	uint32_t deadline_misses;
+	uint32_t max_latency_ms;
+} sSchedulerStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Scheduler_Init (void);
+bool Scheduler_InitTask (const sSchedulerTaskInit_t *init);
+/* Safe from interrupts; a task posted several times before it runs runs once */
+bool Scheduler_Post (eSchedulerTask_t task);
+/* Called from SysTick_Handler */
+void Scheduler_OnTick (void);
+/* Runs the highest priority pending task to completion, over and over, idling in between; never returns */
+void Scheduler_Run (void);
+bool Scheduler_GetStats (eSchedulerTask_t task, sSchedulerStats_t *stats);
+
+#endif /* INC_SCHEDULER_H_ */
@@ -0,0 +1,40 @@
+#ifndef INC_SD_CARD_DRIVER_H_
+#define INC_SD_CARD_DRIVER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define SD_CARD_SECTOR_SIZE 512U
+
+typedef enum {
+	eSdCard_First = 0,
+	eSdCard_Main = eSdCard_First,
+	eSdCard_Last
+} eSdCard_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool SD_Card_Driver_Init (eSdCard_t card);
+bool SD_Card_Driver_IsReady (eSdCard_t card);
+uint32_t SD_Card_Driver_GetSectorCount (eSdCard_t card);
+bool SD_Card_Driver_ReadBlocks (eSdCard_t card, uint32_t lba, uint8_t *buffer, uint32_t sector_count);
+bool SD_Card_Driver_WriteBlocks (eSdCard_t card, uint32_t lba, const uint8_t *buffer, uint32_t sector_count);
+bool SD_Card_Driver_StreamOpen (eSdCard_t card, uint32_t lba, uint32_t pre_erase_count);
+bool SD_Card_Driver_StreamWrite (eSdCard_t card, const uint8_t *buffer, uint32_t sector_count);
+bool SD_Card_Driver_StreamClose (eSdCard_t card);
+bool SD_Card_Driver_IsStreamOpen (eSdCard_t card, uint32_t *next_lba);
+
+#endif /* INC_SD_CARD_DRIVER_H_ */
@@ -0,0 +1,50 @@
+#ifndef INC_SECTOR_CACHE_H_
+#define INC_SECTOR_CACHE_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sd_card_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define SECTOR_CACHE_SLOTS				8U
+/* Flush sizes are binned as 1, 2, 3-4 and 5 or more sectors */
+#define SECTOR_CACHE_HISTOGRAM_BINS		4U
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t flush_deadline_ms;
+} sSectorCacheConfig_t;
+
+typedef struct {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t commits;
+	uint32_t sectors_flushed;
+	uint32_t deadline_flushes;
+	uint32_t full_flushes;
+	uint32_t barrier_flushes;
+	uint32_t write_errors;
+	uint32_t flush_histogram[SECTOR_CACHE_HISTOGRAM_BINS];
+} sSectorCacheStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Sector_Cache_Init (eSdCard_t card, const sSectorCacheConfig_t *config);
+uint8_t *Sector_Cache_Prepare (uint32_t lba, bool is_overwrite);
+bool Sector_Cache_Commit (uint32_t lba);
+bool Sector_Cache_Write (uint32_t lba, uint32_t offset, const void *data, uint32_t length);
+bool Sector_Cache_Read (uint32_t lba, uint32_t offset, void *data, uint32_t length);
+bool Sector_Cache_Barrier (void);
+bool Sector_Cache_Process (void);
+bool Sector_Cache_GetStats (sSectorCacheStats_t *stats);
+
+#endif /* INC_SECTOR_CACHE_H_ */
@@ -0,0 +1,65 @@
+#ifndef INC_SOUND_LEVEL_H_
+#define INC_SOUND_LEVEL_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_stream.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+typedef enum {
+	eSoundLevelWeighting_First = 0,
+	eSoundLevelWeighting_Z = eSoundLevelWeighting_First,
+	eSoundLevelWeighting_A,
+	eSoundLevelWeighting_C,
+	eSoundLevelWeighting_Last
+} eSoundLevelWeighting_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t interval_ms;
+	int16_t calibration_cdb;
+	int16_t event_threshold_cdb;
+	eSoundLevelWeighting_t weighting;
+} sSoundLevelConfig_t;
+
+/*
+ * Times are UTC milliseconds from the block times passed in; intervals are cut where those cross a multiple of
+ * interval_ms.
+ * Interval ends are the nominal boundaries; the block that crosses one is counted whole in the interval it ends.
+ */
+typedef struct {
+	uint64_t end_ms;
+	uint32_t duration_ms;
+	int16_t leq_cdb;
+	int16_t lmax_cdb;
+	int16_t lmin_cdb;
+	uint32_t sensor_triggers;
+} sSoundLevelInterval_t;
+
+typedef struct {
+	uint64_t start_ms;
+	uint32_t duration_ms;
+	int16_t peak_cdb;
+} sSoundLevelEvent_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Sound_Level_Init (const sSoundLevelConfig_t *config);
+/* Takes effect from the next block; the running interval continues with the new length and threshold */
+bool Sound_Level_SetConfig (const sSoundLevelConfig_t *config);
+/* time_ms: wall-clock time of the block's last sample, a step of the clock is absorbed by the running interval */
+bool Sound_Level_ProcessBlock (const sAudioBlock_t *block, uint32_t sample_rate, uint64_t time_ms);
+bool Sound_Level_GetInterval (sSoundLevelInterval_t *interval);
+bool Sound_Level_GetEvent (sSoundLevelEvent_t *event);
+void Sound_Level_OnSensorTrigger (void);
+
+#endif /* INC_SOUND_LEVEL_H_ */
@@ -2,6 +2,8 @@
 #define INC_SPI_DRIVER_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef enum {
 	eSpi_First = 0,
@@ -14,5 +16,6 @@ bool SPI_Driver_Select (eSpi_t spi);
 bool SPI_Driver_Deselect (eSpi_t spi);
 bool SPI_Driver_Write (eSpi_t spi, uint8_t *buffer, size_t byte_count);
 bool SPI_Driver_Read (eSpi_t spi, uint8_t *buffer, size_t byte_count);
+bool SPI_Driver_SetBaudrate (eSpi_t spi, uint32_t max_frequency_hz);
 
 #endif /* INC_SPI_DRIVER_H_ */
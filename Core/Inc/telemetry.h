@@ -0,0 +1,50 @@
+#ifndef INC_TELEMETRY_H_
+#define INC_TELEMETRY_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cobs.h"
+#include "telemetry_format.h"
+#include "uart_driver.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Encoded frame plus its delimiter, the most one frame takes from the UART ring */
+#define TELEMETRY_MAX_WIRE		(COBS_MAX_ENCODED(TELEMETRY_MAX_FRAME) + 1U)
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t frames_sent;
+	uint32_t frames_dropped;
+	uint32_t frames_received;
+	uint32_t rx_errors;
+	uint32_t text_bytes_dropped;
+} sTelemetryStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Telemetry_Init (eUart_t uart);
+/* Frames are dropped whole when the UART ring is full, the caller never waits */
+bool Telemetry_SendLevels (const sTelemetryLevels_t *levels);
+bool Telemetry_SendSpectrum (const sTelemetrySpectrum_t *spectrum);
+bool Telemetry_SendEvent (const sTelemetryEvent_t *event);
+bool Telemetry_SendStatus (sTelemetryStatus_t *status);
+bool Telemetry_SendConfig (const sTelemetryConfig_t *config);
+/* A run of whole trace records, see trace_format.h */
+bool Telemetry_SendTrace (const uint32_t *words, size_t count);
+/* Backs stdout; the whole text goes out as consecutive text frames or is dropped */
+bool Telemetry_SendText (const char *text, size_t length);
+/* Polled from the foreground; returns true with the next intact config frame from the host */
+bool Telemetry_ReceiveConfig (sTelemetryConfig_t *config);
+bool Telemetry_GetStats (sTelemetryStats_t *stats);
+
+#endif /* INC_TELEMETRY_H_ */
@@ -0,0 +1,133 @@
+#ifndef INC_TELEMETRY_FORMAT_H_
+#define INC_TELEMETRY_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/*
+ * Live telemetry frames on the debug UART, shared by the firmware and the host tools.
+ * A frame is a header (type, 16-bit sequence number), the payload and a CRC-16/CCITT-FALSE over both, COBS encoded
+ * and terminated by a 0x00 delimiter. Every frame the firmware builds takes the next sequence number, including
+ * frames dropped on a full UART ring, so gaps on the host count lost frames. All fields are little-endian.
+ */
+#define TELEMETRY_DELIMITER			0x00U
+#define TELEMETRY_HEADER_SIZE		3U
+#define TELEMETRY_CRC_SIZE			2U
+#define TELEMETRY_MAX_PAYLOAD		96U
+#define TELEMETRY_MAX_FRAME			(TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE)
+#define TELEMETRY_MAX_SPECTRUM_BANDS	33U
+
+typedef enum {
+	eTelemetryFrame_First = 1,
+	eTelemetryFrame_Levels = eTelemetryFrame_First,
+	eTelemetryFrame_Spectrum,
+	eTelemetryFrame_Event,
+	eTelemetryFrame_Status,
+	eTelemetryFrame_Config,
+	/* printf output, split into payload-sized pieces without regard to lines */
+	eTelemetryFrame_Text,
+	eTelemetryFrame_Trace,
+	eTelemetryFrame_Last
+} eTelemetryFrame_t;
+
+typedef enum {
+	eTelemetryConfigOp_First = 0,
+	eTelemetryConfigOp_Get = eTelemetryConfigOp_First,
+	eTelemetryConfigOp_Set,
+	/* Replies from the logger: the current value, or a refused request */
+	eTelemetryConfigOp_Value,
+	eTelemetryConfigOp_Reject,
+	eTelemetryConfigOp_Last
+} eTelemetryConfigOp_t;
+
+/* Config frames travel in both directions; the host sends Get and Set, the logger answers each with Value or Reject */
+typedef enum {
+	eTelemetryConfigKey_First = 0,
+	/* Hz */
+	eTelemetryConfigKey_SampleRate = eTelemetryConfigKey_First,
+	/* 0 Z, 1 A, 2 C */
+	eTelemetryConfigKey_Weighting,
+	/* 0.01 dB */
+	eTelemetryConfigKey_EventThreshold,
+	/* ms */
+	eTelemetryConfigKey_Interval,
+	/* 0 off, 1 PCM16, 2 IMA ADPCM, 3 Rice */
+	eTelemetryConfigKey_RecordingMode,
+	/* 0.01 dB */
+	eTelemetryConfigKey_Calibration,
+	/* UTC seconds since 1970, set on a second boundary; applied at once, not at the next block */
+	eTelemetryConfigKey_Time,
+	/* RTC trim in parts per billion, positive runs faster; applied at once */
+	eTelemetryConfigKey_ClockTrim,
+	eTelemetryConfigKey_Last
+} eTelemetryConfigKey_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct __attribute__((packed)) {
+	uint8_t type;
+	uint16_t sequence;
+} sTelemetryHeader_t;
+
+/* Times are the low 32 bits of the log timestamps (UTC milliseconds), levels in 0.1 dB */
+typedef struct __attribute__((packed)) {
+	uint32_t end_ms;
+	uint16_t duration_ms;
+	int16_t leq_ddb;
+	int16_t lmax_ddb;
+	int16_t lmin_ddb;
+} sTelemetryLevels_t;
+
+/* Only band_count entries of band_ddb are sent */
+typedef struct __attribute__((packed)) {
+	uint32_t end_ms;
+	uint8_t first_band;
+	uint8_t band_count;
+	int16_t band_ddb[TELEMETRY_MAX_SPECTRUM_BANDS];
+} sTelemetrySpectrum_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t start_ms;
+	uint32_t duration_ms;
+	int16_t peak_ddb;
+	uint8_t kind;
+	uint8_t count;
+} sTelemetryEvent_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t uptime_s;
+	uint32_t audio_overruns;
+	uint32_t storage_errors;
+	uint32_t sectors_written;
+	uint32_t frames_dropped;
+} sTelemetryStatus_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t op;
+	uint8_t key;
+	uint16_t reserved;
+	int32_t value;
+} sTelemetryConfig_t;
+
+typedef char sTelemetryHeaderSizeCheck_t[(sizeof(sTelemetryHeader_t) == TELEMETRY_HEADER_SIZE) ? 1 : -1];
+typedef char sTelemetrySpectrumSizeCheck_t[(sizeof(sTelemetrySpectrum_t) <= TELEMETRY_MAX_PAYLOAD) ? 1 : -1];
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TELEMETRY_FORMAT_H_ */
@@ -0,0 +1,34 @@
+#ifndef INC_TIM_DRIVER_H_
+#define INC_TIM_DRIVER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+typedef enum {
+	eTim_First = 0,
+	eTim_AdcTrigger = eTim_First,
+	eTim_Last
+} eTim_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool TIM_Driver_Init (eTim_t tim);
+bool TIM_Driver_SetFrequency (eTim_t tim, uint32_t frequency_hz);
+bool TIM_Driver_Start (eTim_t tim);
+bool TIM_Driver_Stop (eTim_t tim);
+uint32_t TIM_Driver_GetFrequency (eTim_t tim);
+
+#endif /* INC_TIM_DRIVER_H_ */
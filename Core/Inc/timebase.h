@@ -0,0 +1,45 @@
+#ifndef INC_TIMEBASE_H_
+#define INC_TIMEBASE_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#define TIMEBASE_TICK_HZ	1000000U
+
+/* Events the timer latches in hardware, the interrupt that reads them can come late */
+typedef enum {
+	eTimebaseCapture_First = 0,
+	/* Every ADC conversion trigger, TIM3 TRGO through the internal trigger */
+	eTimebaseCapture_AdcTrigger = eTimebaseCapture_First,
+	/* Rising edge of the sound sensor's digital output on PA1 */
+	eTimebaseCapture_SoundSensor,
+	/* RTC wakeup event, for correlating the timebase with the calendar */
+	eTimebaseCapture_RtcWakeup,
+	eTimebaseCapture_Last
+} eTimebaseCapture_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Call after Clock_Manager_Init, the tick rate follows every clock point change */
+bool Timebase_Init (void);
+/* Monotonic since Timebase_Init, safe from interrupts; the timer does not count in STOP mode */
+uint64_t Timebase_GetTicks (void);
+/* Low word only, a single register read that wraps every 71 minutes */
+uint32_t Timebase_GetTicks32 (void);
+/* Latest capture of the event, false if it has not fired since the last call; valid for 71 minutes after the event */
+bool Timebase_GetCapture (eTimebaseCapture_t capture, uint64_t *ticks);
+
+#endif /* INC_TIMEBASE_H_ */
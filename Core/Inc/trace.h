@@ -0,0 +1,66 @@
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "trace_format.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED	1
+#endif
+
+/*
+ * TRACEn(fmt, ...) stores the format string's ID, a microsecond stamp and n raw argument words; the text itself never
+ * leaves the ELF. Arguments are printed on the host with the integer conversions of printf (d i u x X o c p), no %s or %f.
+ * Safe in interrupts, records that do not fit are counted and dropped.
+ */
+#if TRACE_ENABLED
+#define TRACE_ID(fmt) \
+	({ static const char trace_fmt_[] __attribute__((section(TRACE_FORMAT_SECTION), used)) = fmt; \
+	(uint16_t) (uintptr_t) trace_fmt_; })
+#define TRACE0(fmt) \
+	Trace_Write(TRACE_ID(fmt), 0, NULL)
+#define TRACE1(fmt, a) \
+	do { const uint32_t trace_args_[] = {(uint32_t) (a)}; Trace_Write(TRACE_ID(fmt), 1, trace_args_); } while (0)
+#define TRACE2(fmt, a, b) \
+	do { const uint32_t trace_args_[] = {(uint32_t) (a), (uint32_t) (b)}; Trace_Write(TRACE_ID(fmt), 2, trace_args_); } while (0)
+#define TRACE3(fmt, a, b, c) \
+	do { const uint32_t trace_args_[] = {(uint32_t) (a), (uint32_t) (b), (uint32_t) (c)}; \
+	Trace_Write(TRACE_ID(fmt), 3, trace_args_); } while (0)
+#define TRACE4(fmt, a, b, c, d) \
+	do { const uint32_t trace_args_[] = {(uint32_t) (a), (uint32_t) (b), (uint32_t) (c), (uint32_t) (d)}; \
+	Trace_Write(TRACE_ID(fmt), 4, trace_args_); } while (0)
+#else
+#define TRACE0(fmt)				do { } while (0)
+#define TRACE1(fmt, a)			do { (void) (a); } while (0)
+#define TRACE2(fmt, a, b)		do { (void) (a); (void) (b); } while (0)
+#define TRACE3(fmt, a, b, c)	do { (void) (a); (void) (b); (void) (c); } while (0)
+#define TRACE4(fmt, a, b, c, d)	do { (void) (a); (void) (b); (void) (c); (void) (d); } while (0)
+#endif
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t records;
+	uint32_t dropped;
+} sTraceStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool Trace_Init (void);
+void Trace_Write (uint16_t id, uint32_t arg_count, const uint32_t *args);
+/* Foreground: moves whole records into telemetry frames while the UART ring has room */
+bool Trace_Process (void);
+bool Trace_GetStats (sTraceStats_t *stats);
+
+#endif /* INC_TRACE_H_ */
@@ -0,0 +1,50 @@
+#ifndef INC_TRACE_FORMAT_H_
+#define INC_TRACE_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/*
+ * Trace records as they sit in the firmware ring and in telemetry trace frames, shared with the host decoder.
+ * Format strings live in an unloaded ELF section linked at address 0, so a string's address is its 16-bit ID and the
+ * host reads the dictionary straight from the firmware ELF.
+ * A record is a header word (ID in bits 0-15, argument count in bits 16-19), the low word of the microsecond timebase
+ * and the arguments. The timebase keeps its rate across clock point changes, unlike the cycle counter.
+ * A trace frame payload is a run of whole records, little-endian words.
+ */
+#define TRACE_FORMAT_SECTION	".trace_fmt"
+#define TRACE_MAX_ARGS			4U
+#define TRACE_HEADER_WORDS		2U
+#define TRACE_STAMP_HZ			1000000U
+#define TRACE_MAX_RECORD_WORDS	(TRACE_HEADER_WORDS + TRACE_MAX_ARGS)
+
+/* Inserted by the drainer ahead of the next record, its single argument is the number of records lost */
+#define TRACE_ID_DROPPED		0xFFFFU
+
+#define TRACE_HEADER(id, args)	((uint32_t) (id) | ((uint32_t) (args) << 16))
+#define TRACE_HEADER_ID(h)		((uint16_t) ((h) & 0xFFFFU))
+#define TRACE_HEADER_ARGS(h)	(((h) >> 16) & 0x0FU)
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TRACE_FORMAT_H_ */
@@ -0,0 +1,42 @@
+#ifndef INC_UART_DRIVER_H_
+#define INC_UART_DRIVER_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+typedef enum {
+	eUart_First = 0,
+	eUart_Debug = eUart_First,
+	eUart_Last
+} eUart_t;
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t tx_bytes;
+	uint32_t tx_dropped;
+	uint32_t rx_bytes;
+	uint32_t rx_overruns;
+	uint32_t line_errors;
+} sUartStats_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+bool UART_Driver_Init (eUart_t uart, uint32_t baudrate);
+/* Queues the whole buffer for DMA or nothing at all, never waits for the line; thread context only, drops in handlers */
+bool UART_Driver_Write (eUart_t uart, const uint8_t *data, size_t length);
+size_t UART_Driver_GetTxFree (eUart_t uart);
+size_t UART_Driver_Read (eUart_t uart, uint8_t *data, size_t max_length);
+bool UART_Driver_GetStats (eUart_t uart, sUartStats_t *stats);
+
+#endif /* INC_UART_DRIVER_H_ */
@@ -0,0 +1,56 @@
+#ifndef INC_WALL_CLOCK_H_
+#define INC_WALL_CLOCK_H_
+
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* The RTC calendar holds UTC, two year digits starting at 2000 */
+#define WALL_CLOCK_MIN_EPOCH_S	946684800UL
+#define WALL_CLOCK_MAX_EPOCH_S	4102444799UL
+/* Smooth calibration range, one step is 2^-20 */
+#define WALL_CLOCK_MIN_TRIM_PPB	(-487000)
+#define WALL_CLOCK_MAX_TRIM_PPB	488000
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef struct {
+	uint16_t year;
+	/* 1 to 12 */
+	uint8_t month;
+	/* 1 to 31 */
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t second;
+} sWallClockCalendar_t;
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/* Call after Timebase_Init; keeps a calendar that survived the reset, false if the LSE does not start */
+bool Wall_Clock_Init (void);
+/* True once a reference time was set since the backup domain was last powered */
+bool Wall_Clock_IsSet (void);
+/* UTC milliseconds since 1970; while the RTC is not running the uptime, and false */
+bool Wall_Clock_GetTime (uint64_t *epoch_ms);
+/* Converts a timebase timestamp from the last few minutes */
+bool Wall_Clock_TicksToTime (uint64_t ticks, uint64_t *epoch_ms);
+/* Steps to a reference taken on a second boundary; references at least six hours apart also retrim the drift */
+bool Wall_Clock_Sync (uint32_t epoch_s);
+/* Positive makes the clock faster; a manual trim restarts the drift measurement */
+bool Wall_Clock_SetTrim (int32_t trim_ppb);
+int32_t Wall_Clock_GetTrim (void);
+/* Call at least once a second, re-anchors the timebase on the RTC second */
+void Wall_Clock_Process (void);
+bool Wall_Clock_ToCalendar (uint32_t epoch_s, sWallClockCalendar_t *calendar);
+bool Wall_Clock_FromCalendar (const sWallClockCalendar_t *calendar, uint32_t *epoch_s);
+
+#endif /* INC_WALL_CLOCK_H_ */
@@ -1,8 +1,16 @@
 #include <stddef.h>
 #include "stm32f4xx_ll_adc.h"
 #include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
 #include "adc_driver.h"
 #include "dma_driver.h"
+#include "tim_driver.h"
+#include "clock_manager.h"
+#include "timebase.h"
+
+/* A 12 bit conversion takes the sampling time plus this many ADC clocks */
+#define ADC_CONVERSION_CYCLES	12U
+#define ADC_MAX_CLOCK_HZ		36000000U
 
 typedef struct {
 	 uint32_t common_clock;
@@ -29,8 +37,8 @@ typedef struct {
 	uint32_t continuous_mode;
 	uint32_t dma_transf;
 	bool dma_enabled;
-    IRQn_Type irqn;
-    uint32_t irqn_priority;
+	eDmaStream_t dma_stream;
+	eTim_t trigger_tim;
 } sAdcDesc_t;
 
 typedef struct {
@@ -40,12 +48,51 @@ typedef struct {
     uint32_t sampling_time;
 } sAdcChannel_t;
 
+typedef struct {
+	uint32_t divider;
+	uint32_t common_clock;
+} sAdcPrescaler_t;
+
+typedef struct {
+	uint32_t cycles;
+	uint32_t sampling_time;
+} sAdcSamplingTime_t;
+
+typedef struct {
+	uint16_t *buffer;
+	uint32_t sample_count;
+	AdcBlockCb_t block_cb;
+	bool is_streaming;
+	/* Timestamp of the block before, what an untimed block is extrapolated from */
+	uint64_t last_timestamp;
+	uint32_t untimed_blocks;
+} sAdcStream_t;
+
 static sAdcValue_t dyn_adc_val[eAdcChannel_Last];
+static sAdcStream_t dyn_adc_stream[eAdc_Last] = {0};
 
 static sAdcCommonDesc_t static_adc_common_lut = {
 	.common_clock = LL_ADC_CLOCK_SYNC_PCLK_DIV4,
 };
 
+static const sAdcPrescaler_t static_adc_prescaler_lut[] = {
+	{.divider = 2, .common_clock = LL_ADC_CLOCK_SYNC_PCLK_DIV2},
+	{.divider = 4, .common_clock = LL_ADC_CLOCK_SYNC_PCLK_DIV4},
+	{.divider = 6, .common_clock = LL_ADC_CLOCK_SYNC_PCLK_DIV6},
+	{.divider = 8, .common_clock = LL_ADC_CLOCK_SYNC_PCLK_DIV8}
+};
+
+static const sAdcSamplingTime_t static_adc_sampling_time_lut[] = {
+	{.cycles = 3, .sampling_time = LL_ADC_SAMPLINGTIME_3CYCLES},
+	{.cycles = 15, .sampling_time = LL_ADC_SAMPLINGTIME_15CYCLES},
+	{.cycles = 28, .sampling_time = LL_ADC_SAMPLINGTIME_28CYCLES},
+	{.cycles = 56, .sampling_time = LL_ADC_SAMPLINGTIME_56CYCLES},
+	{.cycles = 84, .sampling_time = LL_ADC_SAMPLINGTIME_84CYCLES},
+	{.cycles = 112, .sampling_time = LL_ADC_SAMPLINGTIME_112CYCLES},
+	{.cycles = 144, .sampling_time = LL_ADC_SAMPLINGTIME_144CYCLES},
+	{.cycles = 480, .sampling_time = LL_ADC_SAMPLINGTIME_480CYCLES}
+};
+
 static sAdcChannel_t static_adc_channel_lut[eAdcChannel_Last] = {
 	[eAdcChannel_1] = {
 		.adc = eAdc_1,
@@ -65,15 +112,98 @@ static sAdcDesc_t static_adc_lut[eAdc_Last] = {
 		.enable_clock = LL_APB2_GRP1_EnableClock,
 		.channel = LL_ADC_CHANNEL_0,
 		.rank = LL_ADC_REG_RANK_1,
-		.triggers_source = LL_ADC_REG_TRIG_SOFTWARE,
+		.triggers_source = LL_ADC_REG_TRIG_EXT_TIM3_TRGO,
 		.seq_length = LL_ADC_REG_SEQ_SCAN_DISABLE,
 		.seq_discont = LL_ADC_REG_SEQ_DISCONT_DISABLE,
 		.continuous_mode = LL_ADC_REG_CONV_SINGLE,
 		.dma_transf = LL_ADC_REG_DMA_TRANSFER_UNLIMITED,
 		.dma_enabled = true,
+		.dma_stream = eDmaStream_1,
+		.trigger_tim = eTim_AdcTrigger,
 	}
 };
 
+static void ADC_Driver_DmaCallback (eDmaStream_t dma_stream, eDmaEvent_t event) {
+	for (eAdc_t adc = eAdc_First; adc < eAdc_Last; adc++) {
+		if (!dyn_adc_stream[adc].is_streaming || (static_adc_lut[adc].dma_stream != dma_stream)) {
+			continue;
+		}
+
+		uint32_t half = dyn_adc_stream[adc].sample_count / 2;
+		uint32_t sample_rate = ADC_Driver_GetSampleRate(adc);
+		uint64_t timestamp = 0;
+
+		/* Its time was lost to coalesced interrupts: one block period on from the block before */
+		if (!DMA_Driver_GetEventTicks(dma_stream, event, &timestamp) && (sample_rate != 0)) {
+			timestamp = dyn_adc_stream[adc].last_timestamp + (((uint64_t) half * TIMEBASE_TICK_HZ) / sample_rate);
+			dyn_adc_stream[adc].untimed_blocks++;
+		}
+
+		dyn_adc_stream[adc].last_timestamp = timestamp;
+
+		switch (event) {
+			case eDmaEvent_HalfTransfer:
+				dyn_adc_stream[adc].block_cb(adc, &dyn_adc_stream[adc].buffer[0], half, timestamp);
+				break;
+			case eDmaEvent_TransferComplete:
+				dyn_adc_stream[adc].block_cb(adc, &dyn_adc_stream[adc].buffer[half], half, timestamp);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/* Fastest ADC clock the bus allows, then the longest sampling time that still finishes within one trigger period */
+static void ADC_Driver_FitTiming (eAdc_t adc) {
+	uint32_t sample_rate = TIM_Driver_GetFrequency(static_adc_lut[adc].trigger_tim);
+
+	if (sample_rate == 0) {
+		return;
+	}
+
+	LL_RCC_ClocksTypeDef clocks = {0};
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	size_t prescaler = 0;
+	size_t prescaler_count = sizeof(static_adc_prescaler_lut) / sizeof(static_adc_prescaler_lut[0]);
+
+	while (((clocks.PCLK2_Frequency / static_adc_prescaler_lut[prescaler].divider) > ADC_MAX_CLOCK_HZ) && (prescaler < (prescaler_count - 1))) {
+		prescaler++;
+	}
+
+	uint32_t period_cycles = (clocks.PCLK2_Frequency / static_adc_prescaler_lut[prescaler].divider) / sample_rate;
+	size_t sampling = 0;
+	size_t sampling_count = sizeof(static_adc_sampling_time_lut) / sizeof(static_adc_sampling_time_lut[0]);
+
+	while ((sampling < (sampling_count - 1)) && ((static_adc_sampling_time_lut[sampling + 1].cycles + ADC_CONVERSION_CYCLES) <= period_cycles)) {
+		sampling++;
+	}
+
+	ADC_Common_TypeDef *common = __LL_ADC_COMMON_INSTANCE(static_adc_lut[adc].adc);
+
+	/* The prescaler only changes with the ADC off; the conversion cut short is one lost sample */
+	if (LL_ADC_GetCommonClock(common) != static_adc_prescaler_lut[prescaler].common_clock) {
+		LL_ADC_Disable(static_adc_lut[adc].adc);
+		LL_ADC_SetCommonClock(common, static_adc_prescaler_lut[prescaler].common_clock);
+		LL_ADC_Enable(static_adc_lut[adc].adc);
+	}
+
+	for (eAdcChannel_t adc_ch = eAdcChannel_First; adc_ch < eAdcChannel_Last; adc_ch++) {
+		if (static_adc_channel_lut[adc_ch].adc == adc) {
+			LL_ADC_SetChannelSamplingTime(static_adc_lut[adc].adc, static_adc_channel_lut[adc_ch].channel, static_adc_sampling_time_lut[sampling].sampling_time);
+		}
+	}
+}
+
+static void ADC_Driver_OnClockChange (void) {
+	for (eAdc_t adc = eAdc_First; adc < eAdc_Last; adc++) {
+		if (dyn_adc_stream[adc].is_streaming) {
+			ADC_Driver_FitTiming(adc);
+		}
+	}
+}
+
 bool ADC_Driver_Init (eAdc_t adc) {
 	if ((eAdc_Last <= adc) || (eAdc_First > adc)) {
 		return false;
@@ -83,6 +213,7 @@ bool ADC_Driver_Init (eAdc_t adc) {
 	LL_ADC_REG_InitTypeDef ADC_REG_InitStruct = {0};
 
     static_adc_lut[adc].enable_clock(static_adc_lut[adc].clock);
+    Clock_Manager_SetCallback(eClockClient_Adc, ADC_Driver_OnClockChange);
 
     LL_ADC_SetCommonClock(__LL_ADC_COMMON_INSTANCE(static_adc_lut[adc].adc), static_adc_common_lut.common_clock);
 
@@ -116,15 +247,16 @@ bool ADC_Driver_Init (eAdc_t adc) {
 		dma_init.data_amount = eAdcChannel_Last;
 		dma_init.dest_addr = &dyn_adc_val;
 		dma_init.periph_or_src_addr = (void*) LL_ADC_DMA_GetRegAddr(static_adc_lut[adc].adc, LL_ADC_DMA_REG_REGULAR_DATA);
-		dma_init.dma_stream = eDmaStream_1;
+		dma_init.dma_stream = static_adc_lut[adc].dma_stream;
 		DMA_Driver_Init(&dma_init);
 	}
 
-	LL_ADC_Enable(static_adc_lut[adc].adc);
-	DMA_Driver_EnableStream(eDmaStream_1);
+	if (!TIM_Driver_Init(static_adc_lut[adc].trigger_tim)) {
+		return false;
+	}
 
-    NVIC_SetPriority(static_adc_lut[adc].irqn, static_adc_lut[adc].irqn_priority);
-    NVIC_EnableIRQ(static_adc_lut[adc].irqn);
+	LL_ADC_Enable(static_adc_lut[adc].adc);
+	DMA_Driver_EnableStream(static_adc_lut[adc].dma_stream);
 
 	return true;
 }
@@ -148,9 +280,93 @@ bool ADC_Driver_GetChannelValue (eAdcChannel_t channel, uint16_t *value) {
         return false;
     }
 
-    *value = dyn_adc_val[channel].value;
+    eAdc_t adc = static_adc_channel_lut[channel].adc;
+
+    if (!dyn_adc_stream[adc].is_streaming) {
+        *value = dyn_adc_val[channel].value;
+        return true;
+    }
+
+    /* Latest complete conversion is the one just before the DMA write pointer */
+    uint32_t count = dyn_adc_stream[adc].sample_count;
+    uint32_t position = count - DMA_Driver_GetRemaining(static_adc_lut[adc].dma_stream);
+    uint32_t index = (position + count - eAdcChannel_Last + channel) % count;
+
+    *value = dyn_adc_stream[adc].buffer[index];
 
     return true;
 }
 
+bool ADC_Driver_StartStream (eAdc_t adc, uint16_t *buffer, uint32_t sample_count, uint32_t sample_rate, AdcBlockCb_t block_cb) {
+	if ((eAdc_Last <= adc) || (eAdc_First > adc)) {
+		return false;
+	}
+
+	if ((buffer == NULL) || (block_cb == NULL) || (sample_count < 2) || ((sample_count % 2) != 0) || !static_adc_lut[adc].dma_enabled) {
+		return false;
+	}
+
+	ADC_Driver_StopStream(adc);
+
+	dyn_adc_stream[adc].buffer = buffer;
+	dyn_adc_stream[adc].sample_count = sample_count;
+	dyn_adc_stream[adc].block_cb = block_cb;
+
+	sDmaInit_t dma_init = {0};
+	dma_init.data_amount = sample_count;
+	dma_init.dest_addr = buffer;
+	dma_init.periph_or_src_addr = (void*) LL_ADC_DMA_GetRegAddr(static_adc_lut[adc].adc, LL_ADC_DMA_REG_REGULAR_DATA);
+	dma_init.dma_stream = static_adc_lut[adc].dma_stream;
+	dma_init.IT_cb = ADC_Driver_DmaCallback;
+
+	if (!DMA_Driver_Init(&dma_init)) {
+		return false;
+	}
+
+	if (!TIM_Driver_SetFrequency(static_adc_lut[adc].trigger_tim, sample_rate)) {
+		return false;
+	}
+
+	ADC_Driver_FitTiming(adc);
+
+	/* Re-arm DMA requests so the first conversion lands at buffer[0] */
+	LL_ADC_REG_SetDMATransfer(static_adc_lut[adc].adc, LL_ADC_REG_DMA_TRANSFER_NONE);
+	LL_ADC_REG_SetDMATransfer(static_adc_lut[adc].adc, static_adc_lut[adc].dma_transf);
 
+	dyn_adc_stream[adc].is_streaming = true;
+	dyn_adc_stream[adc].last_timestamp = Timebase_GetTicks();
+	DMA_Driver_EnableStream(static_adc_lut[adc].dma_stream);
+
+	return TIM_Driver_Start(static_adc_lut[adc].trigger_tim);
+}
+
+bool ADC_Driver_StopStream (eAdc_t adc) {
+	if ((eAdc_Last <= adc) || (eAdc_First > adc)) {
+		return false;
+	}
+
+	TIM_Driver_Stop(static_adc_lut[adc].trigger_tim);
+
+	if (dyn_adc_stream[adc].is_streaming) {
+		DMA_Driver_DisableStream(static_adc_lut[adc].dma_stream);
+		dyn_adc_stream[adc].is_streaming = false;
+	}
+
+	return true;
+}
+
+uint32_t ADC_Driver_GetSampleRate (eAdc_t adc) {
+	if ((eAdc_Last <= adc) || (eAdc_First > adc)) {
+		return 0;
+	}
+
+	return TIM_Driver_GetFrequency(static_adc_lut[adc].trigger_tim);
+}
+
+uint32_t ADC_Driver_GetUntimedBlocks (eAdc_t adc) {
+	if ((eAdc_Last <= adc) || (eAdc_First > adc)) {
+		return 0;
+	}
+
+	return dyn_adc_stream[adc].untimed_blocks;
+}
@@ -0,0 +1,760 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "fat32.h"
+#include "partition.h"
+#include "ima_adpcm.h"
+#include "rice_codec.h"
+#include "trace.h"
+#include "audio_recorder.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define AUDIO_RECORDER_BITS_PER_SAMPLE	16U
+#define AUDIO_RECORDER_CHANNELS			1U
+#define AUDIO_RECORDER_WAVE_FORMAT_PCM	1U
+
+/* One ADPCM block per sector keeps blocks aligned with card writes */
+#define AUDIO_RECORDER_ADPCM_SAMPLES	IMA_ADPCM_SAMPLES_PER_BLOCK(SD_CARD_SECTOR_SIZE)
+
+/* Lossless frames follow the DMA blocks, the extent is sized for the verbatim worst case */
+#define AUDIO_RECORDER_RICE_SAMPLES		AUDIO_STREAM_BLOCK_SAMPLES
+#define AUDIO_RECORDER_RICE_FRAME_BYTES	RICE_CODEC_MAX_FRAME_BYTES(AUDIO_RECORDER_RICE_SAMPLES)
+
+/* Header fills sector 0 exactly (JUNK padding), so audio starts sector aligned and closing only rewrites one sector */
+#define AUDIO_RECORDER_HEADER_SECTORS	1U
+#define AUDIO_RECORDER_DATA_CHUNK_AT	(SD_CARD_SECTOR_SIZE - 8U)
+
+/* A blank card is taken whole for raw extents, after the first MiB where a partition table would go */
+#define AUDIO_RECORDER_BLANK_FIRST_LBA	2048U
+
+#define AUDIO_RECORDER_NAME_DIGITS		5U
+#define AUDIO_RECORDER_MAX_FILE_NUMBER	99999UL
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	eSdCard_t card;
+	sAudioRecorderConfig_t config;
+	const sAudioRecorderStorage_t *storage;
+	bool is_recording;
+	bool is_file_open;
+	sAudioRecorderExtent_t extent;
+	uint32_t sample_rate;
+	uint32_t data_bytes;
+	uint32_t data_capacity;
+	uint32_t sector_fill;
+	uint32_t pcm_fill;
+	uint32_t sample_count;
+	uint32_t capacity_samples;
+	sImaAdpcmState_t adpcm;
+	uint32_t next_lba;
+	sPartition_t raw_partition;
+	uint32_t raw_next_lba;
+	uint32_t file_number;
+	uint32_t fat_active;
+	bool is_fat_spare_ready;
+	/* A failed prepare (card full) is not retried before the next file, each attempt scans the whole FAT */
+	bool is_prepare_blocked;
+	sAudioRecorderStats_t stats;
+} sAudioRecorder_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const uint8_t static_raw_partition_types[] = {AUDIO_RECORDER_PARTITION_TYPE};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sAudioRecorder_t dyn_recorder = {0};
+static uint8_t dyn_sector[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t dyn_header[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+static int16_t dyn_pcm[AUDIO_RECORDER_ADPCM_SAMPLES];
+static uint8_t dyn_frame[AUDIO_RECORDER_RICE_FRAME_BYTES];
+/* The open file and the spare the next roll takes, fat_active picks the open one */
+static sFat32File_t dyn_fat_files[2];
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static bool Audio_Recorder_RawOpen (eSdCard_t card, uint32_t sector_count, sAudioRecorderExtent_t *extent);
+static bool Audio_Recorder_RawClose (eSdCard_t card, const sAudioRecorderExtent_t *extent, uint32_t byte_count);
+static bool Audio_Recorder_FindRawPartition (eSdCard_t card);
+static void Audio_Recorder_FileName (uint32_t number, char *name);
+static uint32_t Audio_Recorder_FindNextNumber (void);
+static bool Audio_Recorder_FatCreate (sFat32File_t *file, uint32_t sector_count);
+static bool Audio_Recorder_FatOpen (eSdCard_t card, uint32_t sector_count, sAudioRecorderExtent_t *extent);
+static bool Audio_Recorder_FatClose (eSdCard_t card, const sAudioRecorderExtent_t *extent, uint32_t byte_count);
+static bool Audio_Recorder_FatPrepare (eSdCard_t card, uint32_t sector_count);
+static void Audio_Recorder_FatRelease (eSdCard_t card);
+static bool Audio_Recorder_WriteSector (void);
+static bool Audio_Recorder_WriteAdpcmBlock (void);
+static bool Audio_Recorder_PutBytes (const uint8_t *data, uint32_t length);
+static bool Audio_Recorder_WriteRiceFrame (void);
+static void Audio_Recorder_Put16 (uint8_t *dst, uint16_t value);
+static void Audio_Recorder_Put32 (uint8_t *dst, uint32_t value);
+static uint32_t Audio_Recorder_BytesPerSecond (void);
+static void Audio_Recorder_BuildHeader (uint32_t data_bytes, uint32_t sample_count);
+static void Audio_Recorder_BuildRiceHeader (uint32_t data_bytes, uint32_t sample_count);
+static uint32_t Audio_Recorder_DataSectors (void);
+static bool Audio_Recorder_OpenFile (void);
+static bool Audio_Recorder_CloseFile (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static const sAudioRecorderStorage_t static_raw_storage = {
+	.open = Audio_Recorder_RawOpen,
+	.close = Audio_Recorder_RawClose
+};
+
+static const sAudioRecorderStorage_t static_fat_storage = {
+	.open = Audio_Recorder_FatOpen,
+	.close = Audio_Recorder_FatClose,
+	.prepare = Audio_Recorder_FatPrepare,
+	.release = Audio_Recorder_FatRelease
+};
+
+/* Back-to-back extents that wrap around inside the raw partition, nothing outside it is ever written */
+static bool Audio_Recorder_RawOpen (eSdCard_t card, uint32_t sector_count, sAudioRecorderExtent_t *extent) {
+	uint32_t first_lba = dyn_recorder.raw_partition.first_lba;
+	uint32_t end_lba = first_lba + dyn_recorder.raw_partition.sector_count;
+	(void) card;
+
+	if ((first_lba == 0) || (sector_count > dyn_recorder.raw_partition.sector_count)) {
+		return false;
+	}
+
+	if ((dyn_recorder.raw_next_lba < first_lba) || ((end_lba - dyn_recorder.raw_next_lba) < sector_count)) {
+		dyn_recorder.raw_next_lba = first_lba;
+	}
+
+	extent->first_lba = dyn_recorder.raw_next_lba;
+	extent->sector_count = sector_count;
+	dyn_recorder.raw_next_lba += sector_count;
+
+	return true;
+}
+
+static bool Audio_Recorder_RawClose (eSdCard_t card, const sAudioRecorderExtent_t *extent, uint32_t byte_count) {
+	(void) card;
+	(void) extent;
+	(void) byte_count;
+
+	return true;
+}
+
+/*
+ * A FAT32 volume that did not mount may only be unreadable for the moment, or be exFAT; either way it is not ours to
+ * overwrite. Raw extents go to a dedicated partition, or to a card that holds nothing at all.
+ */
+static bool Audio_Recorder_FindRawPartition (eSdCard_t card) {
+	bool is_blank = false;
+
+	if (Partition_Find(card, static_raw_partition_types, sizeof(static_raw_partition_types), &dyn_recorder.raw_partition)) {
+		return true;
+	}
+
+	if (!Partition_IsBlank(card, &is_blank) || !is_blank) {
+		return false;
+	}
+
+	uint32_t card_sectors = SD_Card_Driver_GetSectorCount(card);
+
+	if (card_sectors <= AUDIO_RECORDER_BLANK_FIRST_LBA) {
+		return false;
+	}
+
+	dyn_recorder.raw_partition.type = AUDIO_RECORDER_PARTITION_TYPE;
+	dyn_recorder.raw_partition.first_lba = AUDIO_RECORDER_BLANK_FIRST_LBA;
+	dyn_recorder.raw_partition.sector_count = card_sectors - AUDIO_RECORDER_BLANK_FIRST_LBA;
+
+	return true;
+}
+
+static void Audio_Recorder_FileName (uint32_t number, char *name) {
+	memcpy(name, (dyn_recorder.config.codec == eAudioRecorderCodec_Rice) ? "REC00000.SLC" : "REC00000.WAV", 13);
+
+	for (uint32_t i = 0; i < AUDIO_RECORDER_NAME_DIGITS; i++) {
+		name[7U - i] = (char) ('0' + (number % 10U));
+		number /= 10U;
+	}
+}
+
+/* Files are numbered without gaps, so the first free number is found in O(log n) directory scans */
+static uint32_t Audio_Recorder_FindNextNumber (void) {
+	char name[13];
+	uint32_t low = 0;
+	uint32_t high = 1;
+
+	Audio_Recorder_FileName(high, name);
+
+	while ((high < AUDIO_RECORDER_MAX_FILE_NUMBER) && FAT32_Exists(name)) {
+		low = high;
+		high = (high * 2U > AUDIO_RECORDER_MAX_FILE_NUMBER) ? AUDIO_RECORDER_MAX_FILE_NUMBER : (high * 2U);
+		Audio_Recorder_FileName(high, name);
+	}
+
+	while ((high - low) > 1U) {
+		uint32_t middle = low + ((high - low) / 2U);
+
+		Audio_Recorder_FileName(middle, name);
+
+		if (FAT32_Exists(name)) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+
+	return high;
+}
+
+/* Numbers, creates and sizes one file; the directory and free-space scans make this too slow for the DSP task */
+static bool Audio_Recorder_FatCreate (sFat32File_t *file, uint32_t sector_count) {
+	char name[13];
+	uint32_t first_lba = 0;
+	uint32_t available = 0;
+
+	if (dyn_recorder.file_number == 0) {
+		dyn_recorder.file_number = Audio_Recorder_FindNextNumber();
+	}
+
+	for (; dyn_recorder.file_number <= AUDIO_RECORDER_MAX_FILE_NUMBER; dyn_recorder.file_number++) {
+		Audio_Recorder_FileName(dyn_recorder.file_number, name);
+
+		if (!FAT32_Exists(name)) {
+			break;
+		}
+	}
+
+	if (dyn_recorder.file_number > AUDIO_RECORDER_MAX_FILE_NUMBER) {
+		return false;
+	}
+
+	if (!FAT32_CreateFile(name, sector_count * SD_CARD_SECTOR_SIZE, true, file)) {
+		return false;
+	}
+
+	/* The recorder streams past the FAT layer, so the entry claims the whole extent up front and close trims it */
+	if (!FAT32_GetExtent(file, &first_lba, &available) || (available < sector_count) || !FAT32_SetSize(file, sector_count * SD_CARD_SECTOR_SIZE) || !FAT32_Flush(file)) {
+		FAT32_Discard(file);
+		return false;
+	}
+
+	dyn_recorder.file_number++;
+
+	return true;
+}
+
+/* A roll takes the spare the storage task prepared, only the first file after a start or format change is created here */
+static bool Audio_Recorder_FatOpen (eSdCard_t card, uint32_t sector_count, sAudioRecorderExtent_t *extent) {
+	uint32_t spare = dyn_recorder.fat_active ^ 1U;
+	uint32_t available = 0;
+
+	if (dyn_recorder.is_fat_spare_ready) {
+		if (FAT32_GetExtent(&dyn_fat_files[spare], &extent->first_lba, &available) && (available >= sector_count)) {
+			dyn_recorder.is_fat_spare_ready = false;
+			dyn_recorder.fat_active = spare;
+		} else {
+			/* Prepared at a lower sample rate */
+			Audio_Recorder_FatRelease(card);
+		}
+	}
+
+	sFat32File_t *file = &dyn_fat_files[dyn_recorder.fat_active];
+
+	if (!file->is_open && !Audio_Recorder_FatCreate(file, sector_count)) {
+		return false;
+	}
+
+	if (file->size != (sector_count * SD_CARD_SECTOR_SIZE)) {
+		if (!FAT32_SetSize(file, sector_count * SD_CARD_SECTOR_SIZE) || !FAT32_Flush(file)) {
+			FAT32_Discard(file);
+			return false;
+		}
+	}
+
+	if (!FAT32_GetExtent(file, &extent->first_lba, &available)) {
+		return false;
+	}
+
+	extent->sector_count = sector_count;
+
+	return true;
+}
+
+static bool Audio_Recorder_FatClose (eSdCard_t card, const sAudioRecorderExtent_t *extent, uint32_t byte_count) {
+	sFat32File_t *file = &dyn_fat_files[dyn_recorder.fat_active];
+	(void) card;
+	(void) extent;
+
+	return FAT32_SetSize(file, byte_count) && FAT32_Close(file);
+}
+
+/* A spare cut off by power loss is a full-size file of old card contents behind a blank header sector */
+static bool Audio_Recorder_FatPrepare (eSdCard_t card, uint32_t sector_count) {
+	sFat32File_t *file = &dyn_fat_files[dyn_recorder.fat_active ^ 1U];
+	uint32_t first_lba = 0;
+	uint32_t available = 0;
+
+	if (dyn_recorder.is_fat_spare_ready) {
+		return true;
+	}
+
+	if (!Audio_Recorder_FatCreate(file, sector_count) || !FAT32_GetExtent(file, &first_lba, &available)) {
+		return false;
+	}
+
+	memset(dyn_header, 0, sizeof(dyn_header));
+
+	if (!SD_Card_Driver_WriteBlocks(card, first_lba, dyn_header, AUDIO_RECORDER_HEADER_SECTORS)) {
+		FAT32_Discard(file);
+		return false;
+	}
+
+	dyn_recorder.is_fat_spare_ready = true;
+
+	return true;
+}
+
+/* The spare always carries the highest number, deleting it keeps the numbering free of gaps */
+static void Audio_Recorder_FatRelease (eSdCard_t card) {
+	(void) card;
+
+	if (!dyn_recorder.is_fat_spare_ready) {
+		return;
+	}
+
+	dyn_recorder.is_fat_spare_ready = false;
+
+	if (FAT32_Discard(&dyn_fat_files[dyn_recorder.fat_active ^ 1U])) {
+		dyn_recorder.file_number--;
+	}
+}
+
+static bool Audio_Recorder_WriteSector (void) {
+	uint32_t end_lba = dyn_recorder.extent.first_lba + dyn_recorder.extent.sector_count;
+
+	/* Anything else touching the card (FAT sync, log writes) ends the CMD25 burst, pick it up where it stopped */
+	if (!SD_Card_Driver_StreamOpen(dyn_recorder.card, dyn_recorder.next_lba, end_lba - dyn_recorder.next_lba)) {
+		return false;
+	}
+
+	if (!SD_Card_Driver_StreamWrite(dyn_recorder.card, dyn_sector, 1)) {
+		return false;
+	}
+
+	dyn_recorder.next_lba++;
+
+	return true;
+}
+
+static bool Audio_Recorder_WriteAdpcmBlock (void) {
+	IMA_ADPCM_EncodeBlock(&dyn_recorder.adpcm, dyn_pcm, SD_CARD_SECTOR_SIZE, dyn_sector);
+	dyn_recorder.pcm_fill = 0;
+	dyn_recorder.data_bytes += SD_CARD_SECTOR_SIZE;
+
+	return Audio_Recorder_WriteSector();
+}
+
+static bool Audio_Recorder_PutBytes (const uint8_t *data, uint32_t length) {
+	while (length > 0) {
+		uint32_t chunk = SD_CARD_SECTOR_SIZE - dyn_recorder.sector_fill;
+
+		if (chunk > length) {
+			chunk = length;
+		}
+
+		memcpy(&dyn_sector[dyn_recorder.sector_fill], data, chunk);
+		dyn_recorder.sector_fill += chunk;
+		dyn_recorder.data_bytes += chunk;
+		data += chunk;
+		length -= chunk;
+
+		if (dyn_recorder.sector_fill == SD_CARD_SECTOR_SIZE) {
+			dyn_recorder.sector_fill = 0;
+
+			if (!Audio_Recorder_WriteSector()) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool Audio_Recorder_WriteRiceFrame (void) {
+	size_t length = Rice_Codec_EncodeFrame(dyn_pcm, dyn_recorder.pcm_fill, dyn_frame, sizeof(dyn_frame));
+
+	dyn_recorder.pcm_fill = 0;
+
+	return (length != 0) && Audio_Recorder_PutBytes(dyn_frame, (uint32_t) length);
+}
+
+static void Audio_Recorder_Put16 (uint8_t *dst, uint16_t value) {
+	dst[0] = (uint8_t) value;
+	dst[1] = (uint8_t) (value >> 8);
+}
+
+static void Audio_Recorder_Put32 (uint8_t *dst, uint32_t value) {
+	dst[0] = (uint8_t) value;
+	dst[1] = (uint8_t) (value >> 8);
+	dst[2] = (uint8_t) (value >> 16);
+	dst[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t Audio_Recorder_BytesPerSecond (void) {
+	if (dyn_recorder.config.codec == eAudioRecorderCodec_ImaAdpcm) {
+		return (dyn_recorder.sample_rate * SD_CARD_SECTOR_SIZE) / AUDIO_RECORDER_ADPCM_SAMPLES;
+	}
+
+	if (dyn_recorder.config.codec == eAudioRecorderCodec_Rice) {
+		return ((dyn_recorder.sample_rate + AUDIO_RECORDER_RICE_SAMPLES - 1U) / AUDIO_RECORDER_RICE_SAMPLES) * AUDIO_RECORDER_RICE_FRAME_BYTES;
+	}
+
+	return dyn_recorder.sample_rate * AUDIO_RECORDER_CHANNELS * (AUDIO_RECORDER_BITS_PER_SAMPLE / 8U);
+}
+
+static void Audio_Recorder_BuildHeader (uint32_t data_bytes, uint32_t sample_count) {
+	bool is_adpcm = (dyn_recorder.config.codec == eAudioRecorderCodec_ImaAdpcm);
+	uint32_t block_align = is_adpcm ? SD_CARD_SECTOR_SIZE : (AUDIO_RECORDER_CHANNELS * (AUDIO_RECORDER_BITS_PER_SAMPLE / 8U));
+	uint32_t position = 36;
+
+	memset(dyn_header, 0, sizeof(dyn_header));
+
+	memcpy(&dyn_header[0], "RIFF", 4);
+	Audio_Recorder_Put32(&dyn_header[4], (SD_CARD_SECTOR_SIZE - 8U) + data_bytes);
+	memcpy(&dyn_header[8], "WAVE", 4);
+
+	memcpy(&dyn_header[12], "fmt ", 4);
+	Audio_Recorder_Put32(&dyn_header[16], is_adpcm ? 20U : 16U);
+	Audio_Recorder_Put16(&dyn_header[20], is_adpcm ? IMA_ADPCM_WAVE_FORMAT : AUDIO_RECORDER_WAVE_FORMAT_PCM);
+	Audio_Recorder_Put16(&dyn_header[22], AUDIO_RECORDER_CHANNELS);
+	Audio_Recorder_Put32(&dyn_header[24], dyn_recorder.sample_rate);
+	Audio_Recorder_Put32(&dyn_header[28], Audio_Recorder_BytesPerSecond());
+	Audio_Recorder_Put16(&dyn_header[32], (uint16_t) block_align);
+	Audio_Recorder_Put16(&dyn_header[34], is_adpcm ? IMA_ADPCM_BITS_PER_SAMPLE : AUDIO_RECORDER_BITS_PER_SAMPLE);
+
+	/* Compressed formats need the extension size, samples per block and a fact chunk with the true length */
+	if (is_adpcm) {
+		Audio_Recorder_Put16(&dyn_header[36], 2);
+		Audio_Recorder_Put16(&dyn_header[38], AUDIO_RECORDER_ADPCM_SAMPLES);
+
+		memcpy(&dyn_header[40], "fact", 4);
+		Audio_Recorder_Put32(&dyn_header[44], 4);
+		Audio_Recorder_Put32(&dyn_header[48], sample_count);
+		position = 52;
+	}
+
+	memcpy(&dyn_header[position], "JUNK", 4);
+	Audio_Recorder_Put32(&dyn_header[position + 4U], AUDIO_RECORDER_DATA_CHUNK_AT - (position + 8U));
+
+	memcpy(&dyn_header[AUDIO_RECORDER_DATA_CHUNK_AT], "data", 4);
+	Audio_Recorder_Put32(&dyn_header[AUDIO_RECORDER_DATA_CHUNK_AT + 4U], data_bytes);
+}
+
+static void Audio_Recorder_BuildRiceHeader (uint32_t data_bytes, uint32_t sample_count) {
+	sRiceFileHeader_t header = {
+		.magic = RICE_CODEC_FILE_MAGIC,
+		.version = RICE_CODEC_FILE_VERSION,
+		.channels = AUDIO_RECORDER_CHANNELS,
+		.sample_rate = dyn_recorder.sample_rate,
+		.frame_samples = AUDIO_RECORDER_RICE_SAMPLES,
+		.sample_count = sample_count,
+		.data_bytes = data_bytes,
+		.bits_per_sample = AUDIO_RECORDER_BITS_PER_SAMPLE
+	};
+
+	memset(dyn_header, 0, sizeof(dyn_header));
+	memcpy(dyn_header, &header, sizeof(header));
+}
+
+static uint32_t Audio_Recorder_DataSectors (void) {
+	uint32_t bytes_per_second = Audio_Recorder_BytesPerSecond();
+	uint32_t capacity = dyn_recorder.config.max_file_bytes;
+
+	if ((dyn_recorder.config.max_file_seconds != 0) && ((capacity == 0) || ((capacity / bytes_per_second) > dyn_recorder.config.max_file_seconds))) {
+		capacity = dyn_recorder.config.max_file_seconds * bytes_per_second;
+	}
+
+	return (capacity + SD_CARD_SECTOR_SIZE - 1U) / SD_CARD_SECTOR_SIZE;
+}
+
+static bool Audio_Recorder_OpenFile (void) {
+	uint32_t data_sectors = Audio_Recorder_DataSectors();
+
+	if (data_sectors == 0) {
+		return false;
+	}
+
+	if (!dyn_recorder.storage->open(dyn_recorder.card, AUDIO_RECORDER_HEADER_SECTORS + data_sectors, &dyn_recorder.extent)) {
+		return false;
+	}
+
+	dyn_recorder.data_bytes = 0;
+	dyn_recorder.sector_fill = 0;
+	dyn_recorder.pcm_fill = 0;
+	dyn_recorder.sample_count = 0;
+	dyn_recorder.data_capacity = data_sectors * SD_CARD_SECTOR_SIZE;
+
+	switch (dyn_recorder.config.codec) {
+		case eAudioRecorderCodec_ImaAdpcm: {
+			dyn_recorder.capacity_samples = data_sectors * AUDIO_RECORDER_ADPCM_SAMPLES;
+			break;
+		}
+		case eAudioRecorderCodec_Rice: {
+			dyn_recorder.capacity_samples = (dyn_recorder.data_capacity / AUDIO_RECORDER_RICE_FRAME_BYTES) * AUDIO_RECORDER_RICE_SAMPLES;
+			break;
+		}
+		default: {
+			dyn_recorder.capacity_samples = dyn_recorder.data_capacity / (AUDIO_RECORDER_BITS_PER_SAMPLE / 8U);
+			break;
+		}
+	}
+
+	if (dyn_recorder.capacity_samples == 0) {
+		return false;
+	}
+
+	/* Provisional header claims the whole extent so a file cut short by power loss still plays */
+	if (dyn_recorder.config.codec == eAudioRecorderCodec_Rice) {
+		Audio_Recorder_BuildRiceHeader(dyn_recorder.data_capacity, dyn_recorder.capacity_samples);
+	} else {
+		Audio_Recorder_BuildHeader(dyn_recorder.data_capacity, dyn_recorder.capacity_samples);
+	}
+
+	if (!SD_Card_Driver_WriteBlocks(dyn_recorder.card, dyn_recorder.extent.first_lba, dyn_header, AUDIO_RECORDER_HEADER_SECTORS)) {
+		return false;
+	}
+
+	dyn_recorder.next_lba = dyn_recorder.extent.first_lba + AUDIO_RECORDER_HEADER_SECTORS;
+
+	if (!SD_Card_Driver_StreamOpen(dyn_recorder.card, dyn_recorder.next_lba, data_sectors)) {
+		return false;
+	}
+
+	dyn_recorder.is_file_open = true;
+	dyn_recorder.is_prepare_blocked = false;
+
+	return true;
+}
+
+static bool Audio_Recorder_CloseFile (void) {
+	if (!dyn_recorder.is_file_open) {
+		return true;
+	}
+
+	bool is_close_successful = true;
+
+	if ((dyn_recorder.pcm_fill != 0) && (dyn_recorder.config.codec == eAudioRecorderCodec_Rice)) {
+		is_close_successful = Audio_Recorder_WriteRiceFrame() && is_close_successful;
+	}
+
+	/* The last ADPCM block is padded with its final sample, the fact chunk still carries the real length */
+	if (dyn_recorder.pcm_fill != 0) {
+		for (uint32_t i = dyn_recorder.pcm_fill; i < AUDIO_RECORDER_ADPCM_SAMPLES; i++) {
+			dyn_pcm[i] = dyn_pcm[dyn_recorder.pcm_fill - 1U];
+		}
+
+		is_close_successful = Audio_Recorder_WriteAdpcmBlock() && is_close_successful;
+	}
+
+	if (dyn_recorder.sector_fill != 0) {
+		memset(&dyn_sector[dyn_recorder.sector_fill], 0, SD_CARD_SECTOR_SIZE - dyn_recorder.sector_fill);
+		is_close_successful = Audio_Recorder_WriteSector() && is_close_successful;
+		dyn_recorder.sector_fill = 0;
+	}
+
+	is_close_successful = SD_Card_Driver_StreamClose(dyn_recorder.card) && is_close_successful;
+
+	if (dyn_recorder.config.codec == eAudioRecorderCodec_Rice) {
+		Audio_Recorder_BuildRiceHeader(dyn_recorder.data_bytes, dyn_recorder.sample_count);
+	} else {
+		Audio_Recorder_BuildHeader(dyn_recorder.data_bytes, dyn_recorder.sample_count);
+	}
+
+	is_close_successful = SD_Card_Driver_WriteBlocks(dyn_recorder.card, dyn_recorder.extent.first_lba, dyn_header, AUDIO_RECORDER_HEADER_SECTORS) && is_close_successful;
+	is_close_successful = dyn_recorder.storage->close(dyn_recorder.card, &dyn_recorder.extent, SD_CARD_SECTOR_SIZE + dyn_recorder.data_bytes) && is_close_successful;
+
+	dyn_recorder.is_file_open = false;
+	dyn_recorder.stats.files_closed++;
+
+	if (!is_close_successful) {
+		dyn_recorder.stats.write_errors++;
+	}
+
+	return is_close_successful;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Audio_Recorder_Init (eSdCard_t card, const sAudioRecorderConfig_t *config, const sAudioRecorderStorage_t *storage) {
+	if ((config == NULL) || ((config->max_file_bytes == 0) && (config->max_file_seconds == 0))) {
+		return false;
+	}
+
+	if ((config->codec < eAudioRecorderCodec_First) || (config->codec >= eAudioRecorderCodec_Last)) {
+		return false;
+	}
+
+	if (dyn_recorder.is_recording) {
+		Audio_Recorder_Stop();
+	}
+
+	memset(&dyn_recorder, 0, sizeof(dyn_recorder));
+
+	dyn_recorder.card = card;
+	dyn_recorder.config = *config;
+	dyn_recorder.storage = storage;
+
+	if (dyn_recorder.storage != NULL) {
+		return true;
+	}
+
+	if (FAT32_IsMounted()) {
+		dyn_recorder.storage = &static_fat_storage;
+	} else if (Audio_Recorder_FindRawPartition(card)) {
+		dyn_recorder.storage = &static_raw_storage;
+	} else {
+		/* Whatever is on the card belongs to someone else, recording stays off and counts as a storage error */
+		dyn_recorder.stats.write_errors++;
+		TRACE0("recorder: card is neither FAT32, blank nor raw partitioned, recording disabled");
+	}
+
+	return true;
+}
+
+bool Audio_Recorder_Start (void) {
+	if (dyn_recorder.storage == NULL) {
+		return false;
+	}
+
+	dyn_recorder.is_recording = true;
+
+	return true;
+}
+
+bool Audio_Recorder_Stop (void) {
+	dyn_recorder.is_recording = false;
+
+	bool is_close_successful = Audio_Recorder_CloseFile();
+
+	if ((dyn_recorder.storage != NULL) && (dyn_recorder.storage->release != NULL)) {
+		dyn_recorder.storage->release(dyn_recorder.card);
+	}
+
+	return is_close_successful;
+}
+
+bool Audio_Recorder_IsRecording (void) {
+	return dyn_recorder.is_recording;
+}
+
+bool Audio_Recorder_SetCodec (eAudioRecorderCodec_t codec) {
+	if ((codec < eAudioRecorderCodec_First) || (codec >= eAudioRecorderCodec_Last)) {
+		return false;
+	}
+
+	if (codec == dyn_recorder.config.codec) {
+		return true;
+	}
+
+	bool is_close_successful = Audio_Recorder_CloseFile();
+
+	/* The prepared file carries the old format's name and size */
+	if ((dyn_recorder.storage != NULL) && (dyn_recorder.storage->release != NULL)) {
+		dyn_recorder.storage->release(dyn_recorder.card);
+	}
+
+	dyn_recorder.config.codec = codec;
+
+	return is_close_successful;
+}
+
+bool Audio_Recorder_WriteBlock (const sAudioBlock_t *block) {
+	if ((block == NULL) || !dyn_recorder.is_recording) {
+		return false;
+	}
+
+	/* The header carries one sample rate, a restarted stream starts a new file */
+	if (dyn_recorder.is_file_open && (dyn_recorder.sample_rate != Audio_Stream_GetSampleRate())) {
+		Audio_Recorder_CloseFile();
+	}
+
+	if (!dyn_recorder.is_file_open) {
+		dyn_recorder.sample_rate = Audio_Stream_GetSampleRate();
+
+		if (!Audio_Recorder_OpenFile()) {
+			dyn_recorder.stats.write_errors++;
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < block->sample_count; i++) {
+		int16_t pcm = (int16_t) ((int32_t) (block->samples[i] - AUDIO_STREAM_ADC_MIDSCALE) * 16);
+		bool is_write_successful = true;
+
+		dyn_recorder.sample_count++;
+
+		if (dyn_recorder.config.codec == eAudioRecorderCodec_ImaAdpcm) {
+			dyn_pcm[dyn_recorder.pcm_fill++] = pcm;
+
+			if (dyn_recorder.pcm_fill == AUDIO_RECORDER_ADPCM_SAMPLES) {
+				is_write_successful = Audio_Recorder_WriteAdpcmBlock();
+			}
+		} else if (dyn_recorder.config.codec == eAudioRecorderCodec_Rice) {
+			dyn_pcm[dyn_recorder.pcm_fill++] = pcm;
+
+			if (dyn_recorder.pcm_fill == AUDIO_RECORDER_RICE_SAMPLES) {
+				is_write_successful = Audio_Recorder_WriteRiceFrame();
+			}
+		} else {
+			Audio_Recorder_Put16(&dyn_sector[dyn_recorder.sector_fill], (uint16_t) pcm);
+			dyn_recorder.sector_fill += 2;
+			dyn_recorder.data_bytes += 2;
+
+			if (dyn_recorder.sector_fill == SD_CARD_SECTOR_SIZE) {
+				dyn_recorder.sector_fill = 0;
+				is_write_successful = Audio_Recorder_WriteSector();
+			}
+		}
+
+		if (!is_write_successful) {
+			dyn_recorder.stats.write_errors++;
+			Audio_Recorder_CloseFile();
+			return false;
+		}
+
+		if (dyn_recorder.sample_count >= dyn_recorder.capacity_samples) {
+			Audio_Recorder_CloseFile();
+
+			if (!Audio_Recorder_OpenFile()) {
+				dyn_recorder.stats.write_errors++;
+				return false;
+			}
+		}
+	}
+
+	dyn_recorder.stats.blocks_written++;
+
+	return true;
+}
+
+void Audio_Recorder_Process (void) {
+	/* Sized for the open file, so the format and sample rate are settled */
+	if (!dyn_recorder.is_file_open || dyn_recorder.is_prepare_blocked || (dyn_recorder.storage->prepare == NULL)) {
+		return;
+	}
+
+	dyn_recorder.is_prepare_blocked = !dyn_recorder.storage->prepare(dyn_recorder.card, AUDIO_RECORDER_HEADER_SECTORS + Audio_Recorder_DataSectors());
+}
+
+bool Audio_Recorder_GetStats (sAudioRecorderStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_recorder.stats;
+
+	return true;
+}
@@ -0,0 +1,122 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "adc_driver.h"
+#include "audio_stream.h"
+#include "trace.h"
+#include "power_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static uint16_t dyn_audio_buffer[2 * AUDIO_STREAM_BLOCK_SAMPLES];
+static uint64_t dyn_block_timestamps[2] = {0};
+static volatile uint32_t dyn_produced_blocks = 0;
+static uint32_t dyn_consumed_blocks = 0;
+static uint32_t dyn_overrun_count = 0;
+static AudioStreamBlockCb_t dyn_block_cb = NULL;
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static void Audio_Stream_BlockCallback (eAdc_t adc, const uint16_t *samples, uint32_t sample_count, uint64_t timestamp);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static void Audio_Stream_BlockCallback (eAdc_t adc, const uint16_t *samples, uint32_t sample_count, uint64_t timestamp) {
+	(void) adc;
+	(void) samples;
+	(void) sample_count;
+
+	/* Half N of the double buffer always holds block N % 2, so a counter is all the ISR has to publish */
+	dyn_block_timestamps[dyn_produced_blocks & 1U] = timestamp;
+	dyn_produced_blocks++;
+	TRACE1("adc block %u", dyn_produced_blocks);
+
+	if (dyn_block_cb != NULL) {
+		dyn_block_cb();
+	}
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Audio_Stream_Start (uint32_t sample_rate) {
+	dyn_produced_blocks = 0;
+	dyn_consumed_blocks = 0;
+	dyn_overrun_count = 0;
+
+	if (!ADC_Driver_StartStream(eAdc_1, dyn_audio_buffer, 2 * AUDIO_STREAM_BLOCK_SAMPLES, sample_rate, Audio_Stream_BlockCallback)) {
+		return false;
+	}
+
+	Power_Manager_Hold(ePowerHold_Audio, true);
+
+	return true;
+}
+
+bool Audio_Stream_Stop (void) {
+	Power_Manager_Hold(ePowerHold_Audio, false);
+
+	return ADC_Driver_StopStream(eAdc_1);
+}
+
+bool Audio_Stream_SetBlockCallback (AudioStreamBlockCb_t block_cb) {
+	dyn_block_cb = block_cb;
+
+	return true;
+}
+
+bool Audio_Stream_GetBlock (sAudioBlock_t *block) {
+	if (block == NULL) {
+		return false;
+	}
+
+	uint32_t produced = dyn_produced_blocks;
+
+	if (produced == dyn_consumed_blocks) {
+		return false;
+	}
+
+	/* Anything older than the last completed half has already been overwritten by DMA */
+	if ((produced - dyn_consumed_blocks) > 1) {
+		dyn_overrun_count += produced - dyn_consumed_blocks - 1;
+		TRACE2("audio overrun: %u blocks lost at block %u", produced - dyn_consumed_blocks - 1, produced);
+		dyn_consumed_blocks = produced - 1;
+	}
+
+	block->samples = &dyn_audio_buffer[(dyn_consumed_blocks & 1U) * AUDIO_STREAM_BLOCK_SAMPLES];
+	block->sample_count = AUDIO_STREAM_BLOCK_SAMPLES;
+	block->sequence = dyn_consumed_blocks;
+	block->timestamp = dyn_block_timestamps[dyn_consumed_blocks & 1U];
+
+	return true;
+}
+
+void Audio_Stream_ReleaseBlock (void) {
+	if (dyn_consumed_blocks != dyn_produced_blocks) {
+		dyn_consumed_blocks++;
+	}
+}
+
+uint32_t Audio_Stream_GetSampleRate (void) {
+	return ADC_Driver_GetSampleRate(eAdc_1);
+}
+
+uint32_t Audio_Stream_GetOverrunCount (void) {
+	return dyn_overrun_count;
+}
+
+uint32_t Audio_Stream_GetUntimedCount (void) {
+	return ADC_Driver_GetUntimedBlocks(eAdc_1);
+}
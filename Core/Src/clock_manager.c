@@ -0,0 +1,383 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "irq_map.h"
+#include "power_manager.h"
+#include "trace.h"
+#include "clock_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define CLOCK_MANAGER_WINDOW_MS		1000U
+/* Above this the governor goes straight to full speed, an audio overrun costs more than the extra current */
+#define CLOCK_MANAGER_UP_PERCENT	60U
+/* One point down only if the load predicted there stays below this */
+#define CLOCK_MANAGER_DOWN_PERCENT	40U
+/* Nucleo boards feed HSE from the ST-LINK MCO; RCC_HSE_ON for a board with its own crystal */
+#define CLOCK_MANAGER_HSE_STATE		RCC_HSE_BYPASS
+/*
+ * Both sources divide down to a 1 MHz PLL input. Q gives 48 MHz from the 336 MHz VCO but only about 27.4 MHz at the HSE
+ * 16 MHz point (192 MHz VCO); nothing here runs on the 48 MHz domain (USB, SDIO, RNG), it only has to stay below it.
+ */
+#define CLOCK_MANAGER_PLL_Q			7U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t hclk_hz;
+	uint32_t voltage_scale;
+	bool is_pll;
+	uint32_t pll_m;
+	uint32_t pll_n;
+	uint32_t pll_p;
+	uint32_t ahb_divider;
+	uint32_t apb1_divider;
+	uint32_t flash_latency;
+} sClockPointDesc_t;
+
+typedef struct {
+	eClockSource_t source;
+	eClockPoint_t point;
+	eClockPoint_t floor;
+	ClockChangeCb_t callbacks[eClockClient_Last];
+	uint32_t window_start_tick;
+	uint32_t window_idle_us;
+	sClockStats_t stats;
+} sClockManager_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+/*
+ * Flash wait states for 2.7 V to 3.6 V, APB1 at or below 42 MHz, APB2 with the core. The F401 has no scale 1, scale 2
+ * is its top setting and covers 84 MHz. HSE reaches 16 MHz through the PLL so the ADC trigger stays crystal timed.
+ */
+static const sClockPointDesc_t static_clock_point_lut[eClockSource_Last][eClockPoint_Last] = {
+	[eClockSource_Hsi] = {
+		[eClockPoint_16MHz] = {
+			.hclk_hz = 16000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE3,
+			.is_pll = false,
+			.ahb_divider = RCC_SYSCLK_DIV1,
+			.apb1_divider = RCC_HCLK_DIV1,
+			.flash_latency = FLASH_LATENCY_0
+		},
+		[eClockPoint_42MHz] = {
+			.hclk_hz = 42000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE3,
+			.is_pll = true,
+			.pll_m = 16,
+			.pll_n = 336,
+			.pll_p = RCC_PLLP_DIV8,
+			.ahb_divider = RCC_SYSCLK_DIV1,
+			.apb1_divider = RCC_HCLK_DIV1,
+			.flash_latency = FLASH_LATENCY_1
+		},
+		[eClockPoint_84MHz] = {
+			.hclk_hz = 84000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE2,
+			.is_pll = true,
+			.pll_m = 16,
+			.pll_n = 336,
+			.pll_p = RCC_PLLP_DIV4,
+			.ahb_divider = RCC_SYSCLK_DIV1,
+			.apb1_divider = RCC_HCLK_DIV2,
+			.flash_latency = FLASH_LATENCY_2
+		}
+	},
+	[eClockSource_Hse] = {
+		[eClockPoint_16MHz] = {
+			.hclk_hz = 16000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE3,
+			.is_pll = true,
+			.pll_m = 8,
+			.pll_n = 192,
+			.pll_p = RCC_PLLP_DIV6,
+			.ahb_divider = RCC_SYSCLK_DIV2,
+			.apb1_divider = RCC_HCLK_DIV1,
+			.flash_latency = FLASH_LATENCY_0
+		},
+		[eClockPoint_42MHz] = {
+			.hclk_hz = 42000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE3,
+			.is_pll = true,
+			.pll_m = 8,
+			.pll_n = 336,
+			.pll_p = RCC_PLLP_DIV8,
+			.ahb_divider = RCC_SYSCLK_DIV1,
+			.apb1_divider = RCC_HCLK_DIV1,
+			.flash_latency = FLASH_LATENCY_1
+		},
+		[eClockPoint_84MHz] = {
+			.hclk_hz = 84000000U,
+			.voltage_scale = PWR_REGULATOR_VOLTAGE_SCALE2,
+			.is_pll = true,
+			.pll_m = 8,
+			.pll_n = 336,
+			.pll_p = RCC_PLLP_DIV4,
+			.ahb_divider = RCC_SYSCLK_DIV1,
+			.apb1_divider = RCC_HCLK_DIV2,
+			.flash_latency = FLASH_LATENCY_2
+		}
+	}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sClockManager_t dyn_clock = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static bool Clock_Manager_Apply (const sClockPointDesc_t *from, eClockSource_t source, const sClockPointDesc_t *to);
+static bool Clock_Manager_Switch (const sClockPointDesc_t *from, eClockSource_t source, eClockPoint_t point);
+static void Clock_Manager_ResetWindow (void);
+static bool Clock_Manager_Change (eClockPoint_t point);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static bool Clock_Manager_Apply (const sClockPointDesc_t *from, eClockSource_t source, const sClockPointDesc_t *to) {
+	RCC_ClkInitTypeDef clk_init = {0};
+	RCC_OscInitTypeDef osc_init = {0};
+
+	/* The regulator goes up before the clock rises and down only after it fell */
+	if (to->hclk_hz > from->hclk_hz) {
+		__HAL_PWR_VOLTAGESCALING_CONFIG(to->voltage_scale);
+	}
+
+	/* The PLL cannot be reprogrammed while it drives SYSCLK, HSI carries the core meanwhile */
+	clk_init.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+	clk_init.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+	clk_init.AHBCLKDivider = RCC_SYSCLK_DIV1;
+	clk_init.APB1CLKDivider = RCC_HCLK_DIV1;
+	clk_init.APB2CLKDivider = RCC_HCLK_DIV1;
+
+	if (HAL_RCC_ClockConfig(&clk_init, from->flash_latency) != HAL_OK) {
+		return false;
+	}
+
+	if (source == eClockSource_Hse) {
+		osc_init.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+		osc_init.HSEState = CLOCK_MANAGER_HSE_STATE;
+	} else {
+		osc_init.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+	}
+
+	osc_init.PLL.PLLState = to->is_pll ? RCC_PLL_ON : RCC_PLL_OFF;
+	osc_init.PLL.PLLSource = (source == eClockSource_Hse) ? RCC_PLLSOURCE_HSE : RCC_PLLSOURCE_HSI;
+	osc_init.PLL.PLLM = to->is_pll ? to->pll_m : 16U;
+	osc_init.PLL.PLLN = to->is_pll ? to->pll_n : 336U;
+	osc_init.PLL.PLLP = to->is_pll ? to->pll_p : RCC_PLLP_DIV4;
+	osc_init.PLL.PLLQ = CLOCK_MANAGER_PLL_Q;
+
+	if (HAL_RCC_OscConfig(&osc_init) != HAL_OK) {
+		return false;
+	}
+
+	/* Also moves the flash latency on the right side of the switch and retunes SysTick */
+	clk_init.SYSCLKSource = to->is_pll ? RCC_SYSCLKSOURCE_PLLCLK : RCC_SYSCLKSOURCE_HSI;
+	clk_init.AHBCLKDivider = to->ahb_divider;
+	clk_init.APB1CLKDivider = to->apb1_divider;
+
+	if (HAL_RCC_ClockConfig(&clk_init, to->flash_latency) != HAL_OK) {
+		return false;
+	}
+
+	if (to->hclk_hz < from->hclk_hz) {
+		__HAL_PWR_VOLTAGESCALING_CONFIG(to->voltage_scale);
+	}
+
+	return true;
+}
+
+static bool Clock_Manager_Switch (const sClockPointDesc_t *from, eClockSource_t source, eClockPoint_t point) {
+	/* PendSV held off: no bottom half starts a UART or SPI transfer at a baud rate about to change */
+	uint32_t basepri = __get_BASEPRI();
+
+	__set_BASEPRI(IRQ_Map_GetPriority(eIrqSource_PendSV) << (8U - __NVIC_PRIO_BITS));
+
+	bool is_applied = Clock_Manager_Apply(from, source, &static_clock_point_lut[source][point]);
+
+	/* A missing or dead external clock is not fatal, the logger keeps running on HSI with its drift */
+	if (!is_applied && (source == eClockSource_Hse)) {
+		TRACE0("clock: HSE did not start, falling back to HSI");
+		source = eClockSource_Hsi;
+		is_applied = Clock_Manager_Apply(from, source, &static_clock_point_lut[source][point]);
+	}
+
+	if (is_applied) {
+		dyn_clock.source = source;
+		dyn_clock.point = point;
+		dyn_clock.stats.switches++;
+	}
+
+	/* Also after a failed switch, HAL may have left the core on HSI */
+	for (eClockClient_t client = eClockClient_First; client < eClockClient_Last; client++) {
+		if (dyn_clock.callbacks[client] != NULL) {
+			dyn_clock.callbacks[client]();
+		}
+	}
+
+	__set_BASEPRI(basepri);
+
+	TRACE3("clock: source %u, point %u, %u Hz", dyn_clock.source, dyn_clock.point, SystemCoreClock);
+
+	return is_applied;
+}
+
+static void Clock_Manager_ResetWindow (void) {
+	sPowerStats_t power_stats = {0};
+
+	Power_Manager_GetStats(&power_stats);
+	dyn_clock.window_start_tick = HAL_GetTick();
+	dyn_clock.window_idle_us = power_stats.idle_us;
+}
+
+/* A baud rate change would garble the frame on the wire, the change is put off and decided again on the next call */
+static bool Clock_Manager_Change (eClockPoint_t point) {
+	if (Power_Manager_IsHeld(ePowerHold_UartTx)) {
+		dyn_clock.stats.deferred++;
+
+		return false;
+	}
+
+	Clock_Manager_SetPoint(point);
+
+	return true;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Clock_Manager_Init (eClockSource_t source) {
+	if ((eClockSource_Last <= source) || (eClockSource_First > source)) {
+		return false;
+	}
+
+	memset(&dyn_clock, 0, sizeof(dyn_clock));
+	dyn_clock.source = eClockSource_Hsi;
+	dyn_clock.point = eClockPoint_Last - 1;
+	dyn_clock.floor = eClockPoint_First;
+
+	const sClockPointDesc_t *startup = &static_clock_point_lut[eClockSource_Hsi][eClockPoint_Last - 1];
+
+	if (source == eClockSource_Hse) {
+		Clock_Manager_Switch(startup, eClockSource_Hse, eClockPoint_Last - 1);
+	}
+
+	Clock_Manager_ResetWindow();
+
+	return true;
+}
+
+eClockSource_t Clock_Manager_GetSource (void) {
+	return dyn_clock.source;
+}
+
+bool Clock_Manager_SetCallback (eClockClient_t client, ClockChangeCb_t callback) {
+	if ((eClockClient_Last <= client) || (eClockClient_First > client)) {
+		return false;
+	}
+
+	dyn_clock.callbacks[client] = callback;
+
+	return true;
+}
+
+bool Clock_Manager_SetFloor (eClockPoint_t floor) {
+	if ((eClockPoint_Last <= floor) || (eClockPoint_First > floor)) {
+		return false;
+	}
+
+	dyn_clock.floor = floor;
+
+	return true;
+}
+
+bool Clock_Manager_SetPoint (eClockPoint_t point) {
+	if ((eClockPoint_Last <= point) || (eClockPoint_First > point)) {
+		return false;
+	}
+
+	if (point < dyn_clock.floor) {
+		point = dyn_clock.floor;
+	}
+
+	if (point == dyn_clock.point) {
+		return true;
+	}
+
+	return Clock_Manager_Switch(&static_clock_point_lut[dyn_clock.source][dyn_clock.point], dyn_clock.source, point);
+}
+
+/* SystemClock_Config always leaves the HSI tree at full speed, whatever source and point were in use */
+void Clock_Manager_Resync (void) {
+	Clock_Manager_Switch(&static_clock_point_lut[eClockSource_Hsi][eClockPoint_Last - 1], dyn_clock.source, dyn_clock.point);
+}
+
+eClockPoint_t Clock_Manager_GetPoint (void) {
+	return dyn_clock.point;
+}
+
+uint32_t Clock_Manager_GetFrequency (eClockPoint_t point) {
+	if ((eClockPoint_Last <= point) || (eClockPoint_First > point)) {
+		return 0;
+	}
+
+	return static_clock_point_lut[dyn_clock.source][point].hclk_hz;
+}
+
+void Clock_Manager_Process (void) {
+	/* A raised floor is applied on the next call, not at the end of the window */
+	if (dyn_clock.point < dyn_clock.floor) {
+		if (Clock_Manager_Change(dyn_clock.floor)) {
+			Clock_Manager_ResetWindow();
+		}
+
+		return;
+	}
+
+	uint32_t elapsed_ms = HAL_GetTick() - dyn_clock.window_start_tick;
+
+	if (elapsed_ms < CLOCK_MANAGER_WINDOW_MS) {
+		return;
+	}
+
+	sPowerStats_t power_stats = {0};
+
+	Power_Manager_GetStats(&power_stats);
+
+	uint32_t idle_ms = (power_stats.idle_us - dyn_clock.window_idle_us) / 1000U;
+	uint32_t busy_percent = (idle_ms >= elapsed_ms) ? 0 : (((elapsed_ms - idle_ms) * 100U) / elapsed_ms);
+	eClockPoint_t point = dyn_clock.point;
+
+	dyn_clock.stats.busy_percent = busy_percent;
+
+	if (busy_percent > CLOCK_MANAGER_UP_PERCENT) {
+		point = eClockPoint_Last - 1;
+	} else if (point > dyn_clock.floor) {
+		const sClockPointDesc_t *points = static_clock_point_lut[dyn_clock.source];
+		uint64_t predicted_percent = ((uint64_t) busy_percent * points[point].hclk_hz) / points[point - 1].hclk_hz;
+
+		if (predicted_percent < CLOCK_MANAGER_DOWN_PERCENT) {
+			point--;
+		}
+	}
+
+	/* Put off, the window stays open */
+	if ((point != dyn_clock.point) && !Clock_Manager_Change(point)) {
+		return;
+	}
+
+	Clock_Manager_ResetWindow();
+}
+
+bool Clock_Manager_GetStats (sClockStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_clock.stats;
+
+	return true;
+}
@@ -0,0 +1,61 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include "cobs.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define COBS_MAX_RUN	0xFFU
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+size_t COBS_Encode (const uint8_t *in, size_t length, uint8_t *out) {
+	size_t code_index = 0;
+	size_t write = 1;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < length; i++) {
+		if (in[i] != 0) {
+			out[write++] = in[i];
+			code++;
+		}
+
+		/* A zero ends the run; so does a full run of 254 data bytes, unless it is the last byte */
+		if ((in[i] == 0) || ((code == COBS_MAX_RUN) && ((i + 1U) < length))) {
+			out[code_index] = code;
+			code_index = write++;
+			code = 1;
+		}
+	}
+
+	out[code_index] = code;
+
+	return write;
+}
+
+size_t COBS_Decode (const uint8_t *in, size_t length, uint8_t *out) {
+	size_t read = 0;
+	size_t write = 0;
+
+	while (read < length) {
+		uint8_t code = in[read++];
+
+		if ((code == 0) || ((read + code - 1U) > length)) {
+			return 0;
+		}
+
+		for (uint8_t i = 1; i < code; i++) {
+			if (in[read] == 0) {
+				return 0;
+			}
+
+			out[write++] = in[read++];
+		}
+
+		if ((code != COBS_MAX_RUN) && (read < length)) {
+			out[write++] = 0;
+		}
+	}
+
+	return write;
+}
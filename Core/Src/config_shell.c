@@ -0,0 +1,239 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "telemetry.h"
+#include "wall_clock.h"
+#include "config_shell.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* Bounds the foreground time spent per call when the host floods requests */
+#define CONFIG_SHELL_MAX_REQUESTS	4U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	int32_t min;
+	int32_t max;
+} sConfigShellRange_t;
+
+typedef struct {
+	bool is_init;
+	/* Settings in force, and what they become at the next block boundary */
+	sConfigShellSettings_t current;
+	sConfigShellSettings_t pending;
+	bool has_pending;
+} sConfigShell_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const sConfigShellRange_t static_range_lut[eTelemetryConfigKey_Last] = {
+	[eTelemetryConfigKey_SampleRate] = {.min = 8000, .max = 48000},
+	[eTelemetryConfigKey_Weighting] = {.min = eSoundLevelWeighting_First, .max = eSoundLevelWeighting_Last - 1},
+	[eTelemetryConfigKey_EventThreshold] = {.min = 3000, .max = 14000},
+	[eTelemetryConfigKey_Interval] = {.min = 100, .max = 60000},
+	[eTelemetryConfigKey_RecordingMode] = {.min = 0, .max = eAudioRecorderCodec_Last},
+	[eTelemetryConfigKey_Calibration] = {.min = 0, .max = 20000},
+	/* Bounded by the signed value field, 2038 */
+	[eTelemetryConfigKey_Time] = {.min = (int32_t) WALL_CLOCK_MIN_EPOCH_S, .max = INT32_MAX},
+	[eTelemetryConfigKey_ClockTrim] = {.min = WALL_CLOCK_MIN_TRIM_PPB, .max = WALL_CLOCK_MAX_TRIM_PPB}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sConfigShell_t dyn_shell = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static int32_t Config_Shell_GetValue (const sConfigShellSettings_t *settings, eTelemetryConfigKey_t key);
+static void Config_Shell_SetValue (sConfigShellSettings_t *settings, eTelemetryConfigKey_t key, int32_t value);
+static bool Config_Shell_HandleClock (const sTelemetryConfig_t *request, sTelemetryConfig_t *reply);
+static void Config_Shell_Handle (const sTelemetryConfig_t *request);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static int32_t Config_Shell_GetValue (const sConfigShellSettings_t *settings, eTelemetryConfigKey_t key) {
+	switch (key) {
+		case eTelemetryConfigKey_SampleRate: {
+			return (int32_t) settings->sample_rate;
+		}
+		case eTelemetryConfigKey_Weighting: {
+			return settings->weighting;
+		}
+		case eTelemetryConfigKey_EventThreshold: {
+			return settings->event_threshold_cdb;
+		}
+		case eTelemetryConfigKey_Interval: {
+			return (int32_t) settings->interval_ms;
+		}
+		case eTelemetryConfigKey_RecordingMode: {
+			/* 0 is off, the codecs follow in their enum order */
+			return settings->is_recording ? (int32_t) settings->codec + 1 : 0;
+		}
+		case eTelemetryConfigKey_Calibration: {
+			return settings->calibration_cdb;
+		}
+		default: {
+			return 0;
+		}
+	}
+}
+
+static void Config_Shell_SetValue (sConfigShellSettings_t *settings, eTelemetryConfigKey_t key, int32_t value) {
+	switch (key) {
+		case eTelemetryConfigKey_SampleRate: {
+			settings->sample_rate = (uint32_t) value;
+			break;
+		}
+		case eTelemetryConfigKey_Weighting: {
+			settings->weighting = (eSoundLevelWeighting_t) value;
+			break;
+		}
+		case eTelemetryConfigKey_EventThreshold: {
+			settings->event_threshold_cdb = (int16_t) value;
+			break;
+		}
+		case eTelemetryConfigKey_Interval: {
+			settings->interval_ms = (uint32_t) value;
+			break;
+		}
+		case eTelemetryConfigKey_RecordingMode: {
+			settings->is_recording = (value != 0);
+
+			if (value != 0) {
+				settings->codec = (eAudioRecorderCodec_t) (value - 1);
+			}
+			break;
+		}
+		case eTelemetryConfigKey_Calibration: {
+			settings->calibration_cdb = (int16_t) value;
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+/* The clock is not a staged setting: a reference time is only worth something the moment it arrives */
+static bool Config_Shell_HandleClock (const sTelemetryConfig_t *request, sTelemetryConfig_t *reply) {
+	eTelemetryConfigKey_t key = (eTelemetryConfigKey_t) request->key;
+
+	if ((key != eTelemetryConfigKey_Time) && (key != eTelemetryConfigKey_ClockTrim)) {
+		return false;
+	}
+
+	if (request->op == eTelemetryConfigOp_Set) {
+		const sConfigShellRange_t *range = &static_range_lut[key];
+
+		if ((request->value < range->min) || (request->value > range->max)) {
+			return true;
+		}
+
+		bool is_applied = (key == eTelemetryConfigKey_Time) ? Wall_Clock_Sync((uint32_t) request->value) : Wall_Clock_SetTrim(request->value);
+
+		if (!is_applied) {
+			return true;
+		}
+	} else if (request->op != eTelemetryConfigOp_Get) {
+		return true;
+	}
+
+	if (key == eTelemetryConfigKey_Time) {
+		uint64_t epoch_ms = 0;
+
+		Wall_Clock_GetTime(&epoch_ms);
+		reply->value = (int32_t) (epoch_ms / 1000U);
+	} else {
+		reply->value = Wall_Clock_GetTrim();
+	}
+
+	reply->op = eTelemetryConfigOp_Value;
+
+	return true;
+}
+
+/* Every request gets exactly one reply carrying the value that will be in force after the next block boundary */
+static void Config_Shell_Handle (const sTelemetryConfig_t *request) {
+	sConfigShellSettings_t *target = dyn_shell.has_pending ? &dyn_shell.pending : &dyn_shell.current;
+	eTelemetryConfigKey_t key = (eTelemetryConfigKey_t) request->key;
+	sTelemetryConfig_t reply = {
+		.op = eTelemetryConfigOp_Reject,
+		.key = request->key,
+		.value = request->value
+	};
+
+	if ((eTelemetryConfigKey_Last <= key) || (eTelemetryConfigKey_First > key) || Config_Shell_HandleClock(request, &reply)) {
+		Telemetry_SendConfig(&reply);
+		return;
+	}
+
+	if (request->op == eTelemetryConfigOp_Set) {
+		const sConfigShellRange_t *range = &static_range_lut[key];
+
+		if ((request->value >= range->min) && (request->value <= range->max)) {
+			if (!dyn_shell.has_pending) {
+				dyn_shell.pending = dyn_shell.current;
+				dyn_shell.has_pending = true;
+				target = &dyn_shell.pending;
+			}
+
+			Config_Shell_SetValue(target, key, request->value);
+			reply.op = eTelemetryConfigOp_Value;
+		}
+	} else if (request->op == eTelemetryConfigOp_Get) {
+		reply.op = eTelemetryConfigOp_Value;
+	}
+
+	if (reply.op == eTelemetryConfigOp_Value) {
+		reply.value = Config_Shell_GetValue(target, key);
+	}
+
+	Telemetry_SendConfig(&reply);
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Config_Shell_Init (const sConfigShellSettings_t *initial) {
+	if (initial == NULL) {
+		return false;
+	}
+
+	memset(&dyn_shell, 0, sizeof(dyn_shell));
+	dyn_shell.current = *initial;
+	dyn_shell.is_init = true;
+
+	return true;
+}
+
+bool Config_Shell_Process (void) {
+	if (!dyn_shell.is_init) {
+		return false;
+	}
+
+	sTelemetryConfig_t request = {0};
+
+	for (uint32_t i = 0; i < CONFIG_SHELL_MAX_REQUESTS; i++) {
+		if (!Telemetry_ReceiveConfig(&request)) {
+			break;
+		}
+
+		Config_Shell_Handle(&request);
+	}
+
+	return true;
+}
+
+bool Config_Shell_TakePending (sConfigShellSettings_t *settings) {
+	if ((settings == NULL) || !dyn_shell.has_pending) {
+		return false;
+	}
+
+	dyn_shell.current = dyn_shell.pending;
+	dyn_shell.has_pending = false;
+	*settings = dyn_shell.current;
+
+	return true;
+}
@@ -0,0 +1,118 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "irq_map.h"
+#include "deferred_work.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	DeferredWorkCb_t callbacks[eDeferredWork_Last];
+	/* Bit N set while work N waits for PendSV */
+	volatile uint32_t pending;
+	sDeferredWorkStats_t stats[eDeferredWork_Last];
+} sDeferredWork_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sDeferredWork_t dyn_deferred = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Deferred_Work_Init (void) {
+	memset(&dyn_deferred, 0, sizeof(dyn_deferred));
+	NVIC_SetPriority(PendSV_IRQn, IRQ_Map_GetPriority(eIrqSource_PendSV));
+
+	return true;
+}
+
+bool Deferred_Work_SetCallback (eDeferredWork_t work, DeferredWorkCb_t callback) {
+	if ((eDeferredWork_Last <= work) || (eDeferredWork_First > work)) {
+		return false;
+	}
+
+	dyn_deferred.callbacks[work] = callback;
+
+	return true;
+}
+
+void Deferred_Work_Post (eDeferredWork_t work) {
+	if ((eDeferredWork_Last <= work) || (eDeferredWork_First > work)) {
+		return;
+	}
+
+	Deferred_Work_Add(&dyn_deferred.stats[work].posts, 1);
+
+	/* Top halves of every priority post here, so the read-modify-write is masked */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	dyn_deferred.pending |= (1UL << work);
+	__set_PRIMASK(primask);
+
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void Deferred_Work_Run (void) {
+	uint32_t enter_cycles = IRQ_Map_Enter();
+	uint32_t pending;
+
+	/* A top half that fires meanwhile adds its bit back, so loop until the mask is seen empty */
+	while ((pending = Deferred_Work_Take(&dyn_deferred.pending)) != 0) {
+		for (eDeferredWork_t work = eDeferredWork_First; work < eDeferredWork_Last; work++) {
+			if (((pending & (1UL << work)) == 0) || (dyn_deferred.callbacks[work] == NULL)) {
+				continue;
+			}
+
+			dyn_deferred.stats[work].runs++;
+			dyn_deferred.callbacks[work]();
+		}
+	}
+
+	IRQ_Map_Exit(eIrqSource_PendSV, enter_cycles);
+}
+
+void Deferred_Work_Add (volatile uint32_t *counter, uint32_t value) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*counter += value;
+	__set_PRIMASK(primask);
+}
+
+uint32_t Deferred_Work_Take (volatile uint32_t *counter) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t current = *counter;
+	*counter = 0;
+	__set_PRIMASK(primask);
+
+	return current;
+}
+
+bool Deferred_Work_GetStats (eDeferredWork_t work, sDeferredWorkStats_t *stats) {
+	if ((eDeferredWork_Last <= work) || (eDeferredWork_First > work) || (stats == NULL)) {
+		return false;
+	}
+
+	*stats = dyn_deferred.stats[work];
+
+	return true;
+}
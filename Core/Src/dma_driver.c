@@ -3,6 +3,19 @@
 #include "stm32f4xx_ll_bus.h"
 #include "stm32f4xx_ll_dma.h"
 #include "dma_driver.h"
+#include "irq_map.h"
+#include "deferred_work.h"
+#include "timebase.h"
+
+#define DMA_FLAG_FE		0x01U
+#define DMA_FLAG_DME	0x04U
+#define DMA_FLAG_TE		0x08U
+#define DMA_FLAG_HT		0x10U
+#define DMA_FLAG_TC		0x20U
+#define DMA_FLAG_ALL	(DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+
+/* A circular stream has two buffer halves, more coalesced events than this already overwrote data */
+#define DMA_EVENT_QUEUE_LENGTH	4U
 
 typedef void (*EnableClock_t)(uint32_t periph);
 
@@ -20,45 +33,173 @@ typedef struct {
 	bool fifo;
 	bool dma_interrupt;
 	uint32_t dma_irq;
-	uint32_t irq_prio;
+	eIrqSource_t irq_source;
+	/* Half and full transfers take the time of this capture, the peripheral's trigger that finished the block */
+	bool is_timestamped;
+	eTimebaseCapture_t capture;
 	EnableClock_t enable_clock;
 	uint32_t clock;
 } sDmaDesc_t;
 
+typedef struct {
+	eDmaEvent_t event;
+	/* Timebase ticks, 0 where the top half could not tell */
+	uint64_t ticks;
+} sDmaEventRecord_t;
+
 typedef struct {
 	uint16_t buf_size;
 	void *periph_or_src_addr;
 	void *dst_addr;
-	void (*IT_cb)(eDmaStream_t);
+	void (*IT_cb)(eDmaStream_t, eDmaEvent_t);
+	/* Half and full transfers the bottom half has not delivered yet, in the order they happened */
+	sDmaEventRecord_t events[DMA_EVENT_QUEUE_LENGTH];
+	volatile uint32_t event_head;
+	volatile uint32_t event_tail;
+	/* What did not fit into the queue, delivered after it without order or time */
+	volatile uint32_t half_events;
+	volatile uint32_t complete_events;
+	volatile uint32_t error_events;
+	/* The event the callback is being called for */
+	sDmaEventRecord_t delivery;
 } sDmaDynamic_t;
 
+/* Bit offset of each stream's flag group inside LISR/HISR (streams 0-3 / 4-7) */
+static const uint8_t static_dma_flag_offset_lut[] = {0, 6, 16, 22, 0, 6, 16, 22};
+
 static const sDmaDesc_t static_dma_stream_lut[eDmaStream_Last] = {
 	[eDmaStream_1] = {
 		.dma = DMA2,
 		.dma_stream = LL_DMA_STREAM_0,
 		.dma_channel = LL_DMA_CHANNEL_0,
 		.direction = LL_DMA_DIRECTION_PERIPH_TO_MEMORY,
-		.priority = LL_DMA_PRIORITY_MEDIUM,
+		.priority = LL_DMA_PRIORITY_VERYHIGH,
 		.mode = LL_DMA_MODE_CIRCULAR,
 		.periph_inc_mode = LL_DMA_PERIPH_NOINCREMENT,
 		.mem_inc_mode = LL_DMA_MEMORY_INCREMENT,
 		.periph_size = LL_DMA_PDATAALIGN_HALFWORD,
 		.mem_size = LL_DMA_MDATAALIGN_HALFWORD,
 		.fifo = false,
-		.dma_interrupt = false,
+		.dma_interrupt = true,
 		.dma_irq = DMA2_Stream0_IRQn,
-		.irq_prio = 0,
+		.irq_source = eIrqSource_AdcDma,
+		.is_timestamped = true,
+		.capture = eTimebaseCapture_AdcTrigger,
 		.enable_clock = LL_AHB1_GRP1_EnableClock,
 		.clock = LL_AHB1_GRP1_PERIPH_DMA2
+	},
+	[eDmaStream_UartDebugTx] = {
+		.dma = DMA1,
+		.dma_stream = LL_DMA_STREAM_6,
+		.dma_channel = LL_DMA_CHANNEL_4,
+		.direction = LL_DMA_DIRECTION_MEMORY_TO_PERIPH,
+		.priority = LL_DMA_PRIORITY_LOW,
+		.mode = LL_DMA_MODE_NORMAL,
+		.periph_inc_mode = LL_DMA_PERIPH_NOINCREMENT,
+		.mem_inc_mode = LL_DMA_MEMORY_INCREMENT,
+		.periph_size = LL_DMA_PDATAALIGN_BYTE,
+		.mem_size = LL_DMA_MDATAALIGN_BYTE,
+		.fifo = false,
+		.dma_interrupt = true,
+		.dma_irq = DMA1_Stream6_IRQn,
+		.irq_source = eIrqSource_UartTxDma,
+		.is_timestamped = false,
+		.enable_clock = LL_AHB1_GRP1_EnableClock,
+		.clock = LL_AHB1_GRP1_PERIPH_DMA1
+	},
+	[eDmaStream_UartDebugRx] = {
+		.dma = DMA1,
+		.dma_stream = LL_DMA_STREAM_5,
+		.dma_channel = LL_DMA_CHANNEL_4,
+		.direction = LL_DMA_DIRECTION_PERIPH_TO_MEMORY,
+		.priority = LL_DMA_PRIORITY_LOW,
+		.mode = LL_DMA_MODE_CIRCULAR,
+		.periph_inc_mode = LL_DMA_PERIPH_NOINCREMENT,
+		.mem_inc_mode = LL_DMA_MEMORY_INCREMENT,
+		.periph_size = LL_DMA_PDATAALIGN_BYTE,
+		.mem_size = LL_DMA_MDATAALIGN_BYTE,
+		.fifo = false,
+		.dma_interrupt = true,
+		.dma_irq = DMA1_Stream5_IRQn,
+		.irq_source = eIrqSource_UartRx,
+		.is_timestamped = false,
+		.enable_clock = LL_AHB1_GRP1_EnableClock,
+		.clock = LL_AHB1_GRP1_PERIPH_DMA1
 	}
 };
 
 static sDmaDynamic_t dyn_dma_lut[eDmaStream_Last] = {
 	[eDmaStream_1] = {
 		.IT_cb = NULL,
+	},
+	[eDmaStream_UartDebugTx] = {
+		.IT_cb = NULL,
+	},
+	[eDmaStream_UartDebugRx] = {
+		.IT_cb = NULL,
 	}
 };
 
+/* Top half only, one stream's interrupt does not preempt itself */
+static void DMA_Driver_PushEvent (eDmaStream_t dma_stream, eDmaEvent_t event, uint64_t ticks) {
+	sDmaDynamic_t *dyn = &dyn_dma_lut[dma_stream];
+
+	if ((dyn->event_head - dyn->event_tail) < DMA_EVENT_QUEUE_LENGTH) {
+		dyn->events[dyn->event_head % DMA_EVENT_QUEUE_LENGTH] = (sDmaEventRecord_t) {.event = event, .ticks = ticks};
+		dyn->event_head++;
+
+		return;
+	}
+
+	Deferred_Work_Add((event == eDmaEvent_HalfTransfer) ? &dyn->half_events : &dyn->complete_events, 1);
+}
+
+static void DMA_Driver_Deliver (eDmaStream_t dma_stream, eDmaEvent_t event, uint64_t ticks) {
+	sDmaDynamic_t *dyn = &dyn_dma_lut[dma_stream];
+
+	dyn->delivery.event = event;
+	dyn->delivery.ticks = ticks;
+	dyn->IT_cb(dma_stream, event);
+}
+
+/* Errors are delivered first; queued events keep their order and time, the overflow only its counts */
+static void DMA_Driver_DeferredWork (void) {
+	for (eDmaStream_t dma_stream = eDmaStream_First; dma_stream < eDmaStream_Last; dma_stream++) {
+		sDmaDynamic_t *dyn = &dyn_dma_lut[dma_stream];
+		uint32_t errors = Deferred_Work_Take(&dyn->error_events);
+
+		if (dyn->IT_cb == NULL) {
+			continue;
+		}
+
+		while (errors-- > 0) {
+			DMA_Driver_Deliver(dma_stream, eDmaEvent_TransferError, 0);
+		}
+
+		while (dyn->event_tail != dyn->event_head) {
+			sDmaEventRecord_t record = dyn->events[dyn->event_tail % DMA_EVENT_QUEUE_LENGTH];
+
+			dyn->event_tail++;
+			DMA_Driver_Deliver(dma_stream, record.event, record.ticks);
+		}
+
+		uint32_t halves = Deferred_Work_Take(&dyn->half_events);
+		uint32_t completes = Deferred_Work_Take(&dyn->complete_events);
+
+		while ((halves > 0) || (completes > 0)) {
+			if (halves > 0) {
+				DMA_Driver_Deliver(dma_stream, eDmaEvent_HalfTransfer, 0);
+				halves--;
+			}
+
+			if (completes > 0) {
+				DMA_Driver_Deliver(dma_stream, eDmaEvent_TransferComplete, 0);
+				completes--;
+			}
+		}
+	}
+}
+
 bool DMA_Driver_Init (sDmaInit_t *dma_init_data) {
 	if ((eDmaStream_Last <= dma_init_data->dma_stream) || (eDmaStream_First > dma_init_data->dma_stream)) {
 		return false;
@@ -72,6 +213,8 @@ bool DMA_Driver_Init (sDmaInit_t *dma_init_data) {
     dyn_dma_lut[dma_stream].buf_size = dma_init_data->data_amount;
     dyn_dma_lut[dma_stream].periph_or_src_addr = dma_init_data->periph_or_src_addr;
     dyn_dma_lut[dma_stream].dst_addr = dma_init_data->dest_addr;
+    dyn_dma_lut[dma_stream].IT_cb = dma_init_data->IT_cb;
+    Deferred_Work_SetCallback(eDeferredWork_Dma, DMA_Driver_DeferredWork);
 
     DMA_InitStruct.Channel = static_dma_stream_lut[dma_stream].dma_channel;
     DMA_InitStruct.Direction = static_dma_stream_lut[dma_stream].direction;
@@ -97,7 +240,13 @@ bool DMA_Driver_Init (sDmaInit_t *dma_init_data) {
 
     if (static_dma_stream_lut[dma_stream].dma_interrupt) {
     	LL_DMA_EnableIT_TC(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
-    	NVIC_SetPriority(static_dma_stream_lut[dma_stream].dma_irq, static_dma_stream_lut[dma_stream].irq_prio);
+    	LL_DMA_EnableIT_TE(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
+
+    	if (static_dma_stream_lut[dma_stream].mode == LL_DMA_MODE_CIRCULAR) {
+    		LL_DMA_EnableIT_HT(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
+    	}
+
+    	NVIC_SetPriority(static_dma_stream_lut[dma_stream].dma_irq, IRQ_Map_GetPriority(static_dma_stream_lut[dma_stream].irq_source));
 		NVIC_EnableIRQ(static_dma_stream_lut[dma_stream].dma_irq);
     } else {
     	LL_DMA_DisableIT_TC(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
@@ -121,6 +270,114 @@ bool DMA_Driver_DisableStream (eDmaStream_t dma_stream) {
 	}
 
     LL_DMA_DisableStream(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
+
+    /* EN stays set until the ongoing beat completes, the stream can't be reprogrammed before that */
+    while (LL_DMA_IsEnabledStream(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream));
+
     return true;
 }
 
+/* Only valid while the stream is disabled, normal mode streams use it to queue their next transfer */
+bool DMA_Driver_SetMemory (eDmaStream_t dma_stream, void *memory_addr, uint32_t data_amount) {
+	if ((eDmaStream_Last <= dma_stream) || (eDmaStream_First > dma_stream) || (data_amount > UINT16_MAX)) {
+		return false;
+	}
+
+	DMA_TypeDef *dma = static_dma_stream_lut[dma_stream].dma;
+	uint32_t stream = static_dma_stream_lut[dma_stream].dma_stream;
+
+	if (LL_DMA_IsEnabledStream(dma, stream)) {
+		return false;
+	}
+
+	dyn_dma_lut[dma_stream].dst_addr = memory_addr;
+	dyn_dma_lut[dma_stream].buf_size = (uint16_t) data_amount;
+
+	LL_DMA_SetMemoryAddress(dma, stream, (uint32_t) memory_addr);
+	LL_DMA_SetDataLength(dma, stream, data_amount);
+
+	return true;
+}
+
+uint32_t DMA_Driver_GetRemaining (eDmaStream_t dma_stream) {
+	if ((eDmaStream_Last <= dma_stream) || (eDmaStream_First > dma_stream)) {
+		return 0;
+	}
+
+	return LL_DMA_GetDataLength(static_dma_stream_lut[dma_stream].dma, static_dma_stream_lut[dma_stream].dma_stream);
+}
+
+bool DMA_Driver_GetEventTicks (eDmaStream_t dma_stream, eDmaEvent_t event, uint64_t *ticks) {
+	if ((eDmaStream_Last <= dma_stream) || (eDmaStream_First > dma_stream) || (eDmaEvent_Last <= event) || (eDmaEvent_First > event)) {
+		return false;
+	}
+
+	if ((ticks == NULL) || !static_dma_stream_lut[dma_stream].is_timestamped) {
+		return false;
+	}
+
+	/* Written by the bottom half just before the callback, nothing preempting it changes the record */
+	const sDmaEventRecord_t *delivery = &dyn_dma_lut[dma_stream].delivery;
+
+	if ((delivery->event != event) || (delivery->ticks == 0)) {
+		return false;
+	}
+
+	*ticks = delivery->ticks;
+
+	return true;
+}
+
+void DMA_Driver_IRQHandler (eDmaStream_t dma_stream) {
+	if ((eDmaStream_Last <= dma_stream) || (eDmaStream_First > dma_stream)) {
+		return;
+	}
+
+	uint32_t enter_cycles = IRQ_Map_Enter();
+	DMA_TypeDef *dma = static_dma_stream_lut[dma_stream].dma;
+	uint32_t stream = static_dma_stream_lut[dma_stream].dma_stream;
+	uint32_t offset = static_dma_flag_offset_lut[stream];
+	uint32_t flags;
+
+	if (stream < LL_DMA_STREAM_4) {
+		flags = (dma->LISR >> offset) & DMA_FLAG_ALL;
+		dma->LIFCR = flags << offset;
+	} else {
+		flags = (dma->HISR >> offset) & DMA_FLAG_ALL;
+		dma->HIFCR = flags << offset;
+	}
+
+	/* Top half: flags are cleared and queued with their time, the callbacks run from PendSV */
+	if (dyn_dma_lut[dma_stream].IT_cb != NULL) {
+		bool is_half = ((flags & DMA_FLAG_HT) != 0) && LL_DMA_IsEnabledIT_HT(dma, stream);
+		bool is_complete = ((flags & DMA_FLAG_TC) != 0) && LL_DMA_IsEnabledIT_TC(dma, stream);
+		uint64_t ticks = 0;
+
+		if (static_dma_stream_lut[dma_stream].is_timestamped && (is_half || is_complete)) {
+			if (!Timebase_GetCapture(static_dma_stream_lut[dma_stream].capture, &ticks)) {
+				ticks = Timebase_GetTicks();
+			}
+		}
+
+		if ((flags & DMA_FLAG_TE) != 0) {
+			Deferred_Work_Add(&dyn_dma_lut[dma_stream].error_events, 1);
+		}
+
+		if (is_half && is_complete) {
+			/* Over half a buffer late: the position tells which came last, only that one has the capture's time */
+			bool is_complete_last = LL_DMA_GetDataLength(dma, stream) > (dyn_dma_lut[dma_stream].buf_size / 2U);
+			eDmaEvent_t last = is_complete_last ? eDmaEvent_TransferComplete : eDmaEvent_HalfTransfer;
+
+			DMA_Driver_PushEvent(dma_stream, is_complete_last ? eDmaEvent_HalfTransfer : eDmaEvent_TransferComplete, 0);
+			DMA_Driver_PushEvent(dma_stream, last, ticks);
+		} else if (is_half) {
+			DMA_Driver_PushEvent(dma_stream, eDmaEvent_HalfTransfer, ticks);
+		} else if (is_complete) {
+			DMA_Driver_PushEvent(dma_stream, eDmaEvent_TransferComplete, ticks);
+		}
+
+		Deferred_Work_Post(eDeferredWork_Dma);
+	}
+
+	IRQ_Map_Exit(static_dma_stream_lut[dma_stream].irq_source, enter_cycles);
+}
@@ -0,0 +1,943 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "partition.h"
+#include "wall_clock.h"
+#include "fat32.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define FAT32_FAT_CACHE_SECTORS		4U
+#define FAT32_ENTRIES_PER_SECTOR	(SD_CARD_SECTOR_SIZE / 4U)
+#define FAT32_ENTRY_MASK			0x0FFFFFFFUL
+#define FAT32_ENTRY_FREE			0x00000000UL
+#define FAT32_ENTRY_EOC				0x0FFFFFFFUL
+#define FAT32_ENTRY_EOC_MIN			0x0FFFFFF8UL
+#define FAT32_FIRST_CLUSTER			2U
+#define FAT32_MIN_CLUSTERS			65525UL
+
+#define FAT32_DIR_ENTRY_SIZE		32U
+#define FAT32_NAME_LENGTH			11U
+#define FAT32_ATTR_ARCHIVE			0x20U
+#define FAT32_ATTR_LFN				0x0FU
+#define FAT32_ENTRY_END				0x00U
+#define FAT32_ENTRY_DELETED			0xE5U
+
+#define FAT32_FSINFO_FREE_COUNT_AT	488U
+#define FAT32_FSINFO_NEXT_FREE_AT	492U
+#define FAT32_UNKNOWN				0xFFFFFFFFUL
+#define FAT32_NO_SECTOR				0xFFFFFFFFUL
+
+/* Stamped while the wall clock was never set */
+#define FAT32_DEFAULT_DATE			((uint16_t) (((2025U - 1980U) << 9) | (1U << 5) | 1U))
+#define FAT32_DEFAULT_TIME			((uint16_t) 0)
+#define FAT32_DATE_EPOCH_YEAR		1980U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t sector;
+	uint32_t last_use;
+	bool is_valid;
+	bool is_dirty;
+	uint8_t data[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+} sFat32CacheEntry_t;
+
+typedef struct {
+	eSdCard_t card;
+	sFat32Config_t config;
+	bool is_mounted;
+	uint32_t fat_lba;
+	uint32_t fat_sectors;
+	uint8_t fat_count;
+	uint32_t data_lba;
+	uint8_t sectors_per_cluster;
+	uint32_t cluster_bytes;
+	uint32_t root_cluster;
+	uint32_t max_cluster;
+	uint32_t fsinfo_lba;
+	uint32_t next_free;
+	uint32_t use_counter;
+	uint32_t last_sync_tick;
+	sFat32File_t *open_files[FAT32_MAX_OPEN_FILES];
+} sFat32Volume_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const uint8_t static_fat32_partition_types[] = {PARTITION_TYPE_FAT32_LBA, PARTITION_TYPE_FAT32_CHS};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sFat32Volume_t dyn_volume = {0};
+static sFat32CacheEntry_t dyn_fat_cache[FAT32_FAT_CACHE_SECTORS] = {0};
+static uint8_t dyn_meta_sector[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint32_t dyn_meta_lba = FAT32_NO_SECTOR;
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint16_t FAT32_Get16 (const uint8_t *src);
+static uint32_t FAT32_Get32 (const uint8_t *src);
+static void FAT32_Put16 (uint8_t *dst, uint16_t value);
+static void FAT32_Put32 (uint8_t *dst, uint32_t value);
+static uint32_t FAT32_ClusterToLba (uint32_t cluster);
+static bool FAT32_CacheFlush (sFat32CacheEntry_t *entry);
+static sFat32CacheEntry_t *FAT32_CacheLoad (uint32_t sector);
+static bool FAT32_CacheFlushAll (void);
+static bool FAT32_GetEntry (uint32_t cluster, uint32_t *value);
+static bool FAT32_SetEntry (uint32_t cluster, uint32_t value);
+static bool FAT32_IsFreeRun (uint32_t first, uint32_t count);
+static bool FAT32_AllocateRun (uint32_t count, uint32_t prefer, uint32_t *first);
+static bool FAT32_MetaLoad (uint32_t lba);
+static bool FAT32_MetaStore (void);
+static bool FAT32_ToShortName (const char *name, uint8_t *short_name);
+static bool FAT32_FindDirSlot (const uint8_t *short_name, bool is_grow_allowed, bool *is_found, uint32_t *lba, uint16_t *offset);
+static bool FAT32_FileAppendClusters (sFat32File_t *file, uint32_t count, bool is_contiguous);
+static bool FAT32_FileLba (const sFat32File_t *file, uint32_t offset, uint32_t *lba, uint32_t *run_sectors_left);
+static bool FAT32_FileFlushPartial (sFat32File_t *file);
+static bool FAT32_FileUpdateDir (sFat32File_t *file);
+static bool FAT32_FileTruncate (sFat32File_t *file);
+static bool FAT32_WriteFsInfo (void);
+static void FAT32_GetTimestamp (uint16_t *date, uint16_t *time);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint16_t FAT32_Get16 (const uint8_t *src) {
+	return (uint16_t) (src[0] | (src[1] << 8));
+}
+
+static uint32_t FAT32_Get32 (const uint8_t *src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+static void FAT32_Put16 (uint8_t *dst, uint16_t value) {
+	dst[0] = (uint8_t) value;
+	dst[1] = (uint8_t) (value >> 8);
+}
+
+static void FAT32_Put32 (uint8_t *dst, uint32_t value) {
+	dst[0] = (uint8_t) value;
+	dst[1] = (uint8_t) (value >> 8);
+	dst[2] = (uint8_t) (value >> 16);
+	dst[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t FAT32_ClusterToLba (uint32_t cluster) {
+	return dyn_volume.data_lba + ((cluster - FAT32_FIRST_CLUSTER) * dyn_volume.sectors_per_cluster);
+}
+
+static bool FAT32_CacheFlush (sFat32CacheEntry_t *entry) {
+	if (!entry->is_valid || !entry->is_dirty) {
+		return true;
+	}
+
+	/* Every FAT copy is kept identical so the card checks clean on a PC */
+	for (uint8_t fat = 0; fat < dyn_volume.fat_count; fat++) {
+		uint32_t lba = dyn_volume.fat_lba + (fat * dyn_volume.fat_sectors) + entry->sector;
+
+		if (!SD_Card_Driver_WriteBlocks(dyn_volume.card, lba, entry->data, 1)) {
+			return false;
+		}
+	}
+
+	entry->is_dirty = false;
+
+	return true;
+}
+
+static sFat32CacheEntry_t *FAT32_CacheLoad (uint32_t sector) {
+	sFat32CacheEntry_t *victim = &dyn_fat_cache[0];
+
+	dyn_volume.use_counter++;
+
+	for (uint32_t i = 0; i < FAT32_FAT_CACHE_SECTORS; i++) {
+		if (dyn_fat_cache[i].is_valid && (dyn_fat_cache[i].sector == sector)) {
+			dyn_fat_cache[i].last_use = dyn_volume.use_counter;
+			return &dyn_fat_cache[i];
+		}
+
+		if (!dyn_fat_cache[i].is_valid) {
+			victim = &dyn_fat_cache[i];
+		} else if (victim->is_valid && (dyn_fat_cache[i].last_use < victim->last_use)) {
+			victim = &dyn_fat_cache[i];
+		}
+	}
+
+	if (!FAT32_CacheFlush(victim)) {
+		return NULL;
+	}
+
+	victim->is_valid = false;
+
+	if (!SD_Card_Driver_ReadBlocks(dyn_volume.card, dyn_volume.fat_lba + sector, victim->data, 1)) {
+		return NULL;
+	}
+
+	victim->sector = sector;
+	victim->is_valid = true;
+	victim->is_dirty = false;
+	victim->last_use = dyn_volume.use_counter;
+
+	return victim;
+}
+
+static bool FAT32_CacheFlushAll (void) {
+	bool is_flush_successful = true;
+
+	for (uint32_t i = 0; i < FAT32_FAT_CACHE_SECTORS; i++) {
+		is_flush_successful = FAT32_CacheFlush(&dyn_fat_cache[i]) && is_flush_successful;
+	}
+
+	return is_flush_successful;
+}
+
+static bool FAT32_GetEntry (uint32_t cluster, uint32_t *value) {
+	sFat32CacheEntry_t *entry = FAT32_CacheLoad(cluster / FAT32_ENTRIES_PER_SECTOR);
+
+	if (entry == NULL) {
+		return false;
+	}
+
+	*value = FAT32_Get32(&entry->data[(cluster % FAT32_ENTRIES_PER_SECTOR) * 4U]) & FAT32_ENTRY_MASK;
+
+	return true;
+}
+
+static bool FAT32_SetEntry (uint32_t cluster, uint32_t value) {
+	sFat32CacheEntry_t *entry = FAT32_CacheLoad(cluster / FAT32_ENTRIES_PER_SECTOR);
+
+	if (entry == NULL) {
+		return false;
+	}
+
+	uint8_t *raw = &entry->data[(cluster % FAT32_ENTRIES_PER_SECTOR) * 4U];
+
+	/* Upper four bits are reserved and must be preserved */
+	FAT32_Put32(raw, (FAT32_Get32(raw) & ~FAT32_ENTRY_MASK) | (value & FAT32_ENTRY_MASK));
+	entry->is_dirty = true;
+
+	return true;
+}
+
+static bool FAT32_IsFreeRun (uint32_t first, uint32_t count) {
+	if ((first < FAT32_FIRST_CLUSTER) || ((first + count - 1U) > dyn_volume.max_cluster)) {
+		return false;
+	}
+
+	for (uint32_t cluster = first; cluster < (first + count); cluster++) {
+		uint32_t value = 0;
+
+		if (!FAT32_GetEntry(cluster, &value) || (value != FAT32_ENTRY_FREE)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool FAT32_AllocateRun (uint32_t count, uint32_t prefer, uint32_t *first) {
+	uint32_t run_first = 0;
+	uint32_t run_length = 0;
+
+	if ((prefer != 0) && FAT32_IsFreeRun(prefer, count)) {
+		run_first = prefer;
+		run_length = count;
+	}
+
+	uint32_t cluster = dyn_volume.next_free;
+	uint32_t total = dyn_volume.max_cluster - FAT32_FIRST_CLUSTER + 1U;
+
+	for (uint32_t scanned = 0; (run_length < count) && (scanned < total); scanned++, cluster++) {
+		if (cluster > dyn_volume.max_cluster) {
+			cluster = FAT32_FIRST_CLUSTER;
+			run_length = 0;
+		}
+
+		uint32_t value = 0;
+
+		if (!FAT32_GetEntry(cluster, &value)) {
+			return false;
+		}
+
+		if (value != FAT32_ENTRY_FREE) {
+			run_length = 0;
+			continue;
+		}
+
+		if (run_length == 0) {
+			run_first = cluster;
+		}
+
+		run_length++;
+	}
+
+	if (run_length < count) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t next = (i == (count - 1U)) ? FAT32_ENTRY_EOC : (run_first + i + 1U);
+
+		if (!FAT32_SetEntry(run_first + i, next)) {
+			return false;
+		}
+	}
+
+	dyn_volume.next_free = run_first + count;
+
+	if (dyn_volume.next_free > dyn_volume.max_cluster) {
+		dyn_volume.next_free = FAT32_FIRST_CLUSTER;
+	}
+
+	*first = run_first;
+
+	return true;
+}
+
+static bool FAT32_MetaLoad (uint32_t lba) {
+	if (dyn_meta_lba == lba) {
+		return true;
+	}
+
+	dyn_meta_lba = FAT32_NO_SECTOR;
+
+	if (!SD_Card_Driver_ReadBlocks(dyn_volume.card, lba, dyn_meta_sector, 1)) {
+		return false;
+	}
+
+	dyn_meta_lba = lba;
+
+	return true;
+}
+
+static bool FAT32_MetaStore (void) {
+	if (dyn_meta_lba == FAT32_NO_SECTOR) {
+		return false;
+	}
+
+	return SD_Card_Driver_WriteBlocks(dyn_volume.card, dyn_meta_lba, dyn_meta_sector, 1);
+}
+
+static bool FAT32_ToShortName (const char *name, uint8_t *short_name) {
+	uint32_t position = 0;
+	uint32_t limit = 8;
+
+	memset(short_name, ' ', FAT32_NAME_LENGTH);
+
+	for (; *name != '\0'; name++) {
+		char c = *name;
+
+		if (c == '.') {
+			if (limit == FAT32_NAME_LENGTH) {
+				return false;
+			}
+
+			position = 8;
+			limit = FAT32_NAME_LENGTH;
+			continue;
+		}
+
+		if ((position >= limit) || (c <= ' ') || (strchr("\"*+,/:;<=>?[\\]|", c) != NULL)) {
+			return false;
+		}
+
+		if ((c >= 'a') && (c <= 'z')) {
+			c = (char) (c - 'a' + 'A');
+		}
+
+		short_name[position++] = (uint8_t) c;
+	}
+
+	return short_name[0] != ' ';
+}
+
+static bool FAT32_FindDirSlot (const uint8_t *short_name, bool is_grow_allowed, bool *is_found, uint32_t *lba, uint16_t *offset) {
+	uint32_t cluster = dyn_volume.root_cluster;
+	uint32_t last_cluster = cluster;
+	bool is_slot_found = false;
+
+	*is_found = false;
+
+	while ((cluster >= FAT32_FIRST_CLUSTER) && (cluster < FAT32_ENTRY_EOC_MIN)) {
+		for (uint32_t sector = 0; sector < dyn_volume.sectors_per_cluster; sector++) {
+			uint32_t sector_lba = FAT32_ClusterToLba(cluster) + sector;
+
+			if (!FAT32_MetaLoad(sector_lba)) {
+				return false;
+			}
+
+			for (uint16_t at = 0; at < SD_CARD_SECTOR_SIZE; at += FAT32_DIR_ENTRY_SIZE) {
+				uint8_t first = dyn_meta_sector[at];
+
+				if ((first == FAT32_ENTRY_END) || (first == FAT32_ENTRY_DELETED)) {
+					if (!is_slot_found) {
+						*lba = sector_lba;
+						*offset = at;
+						is_slot_found = true;
+					}
+
+					if (first == FAT32_ENTRY_END) {
+						return true;
+					}
+
+					continue;
+				}
+
+				if ((dyn_meta_sector[at + 11U] != FAT32_ATTR_LFN) && (memcmp(&dyn_meta_sector[at], short_name, FAT32_NAME_LENGTH) == 0)) {
+					*is_found = true;
+					return true;
+				}
+			}
+		}
+
+		last_cluster = cluster;
+
+		if (!FAT32_GetEntry(cluster, &cluster)) {
+			return false;
+		}
+	}
+
+	if (is_slot_found || !is_grow_allowed) {
+		return true;
+	}
+
+	/* Root directory is full, grow it by one zeroed cluster */
+	uint32_t new_cluster = 0;
+
+	if (!FAT32_AllocateRun(1, last_cluster + 1U, &new_cluster) || !FAT32_SetEntry(last_cluster, new_cluster) || !FAT32_CacheFlushAll()) {
+		return false;
+	}
+
+	memset(dyn_meta_sector, 0, sizeof(dyn_meta_sector));
+
+	for (uint32_t sector = 0; sector < dyn_volume.sectors_per_cluster; sector++) {
+		dyn_meta_lba = FAT32_ClusterToLba(new_cluster) + sector;
+
+		if (!FAT32_MetaStore()) {
+			return false;
+		}
+	}
+
+	*lba = FAT32_ClusterToLba(new_cluster);
+	*offset = 0;
+	dyn_meta_lba = FAT32_NO_SECTOR;
+
+	return true;
+}
+
+static bool FAT32_FileAppendClusters (sFat32File_t *file, uint32_t count, bool is_contiguous) {
+	uint32_t last = 0;
+	uint32_t first = 0;
+
+	if (file->run_count != 0) {
+		sFat32Run_t *run = &file->runs[file->run_count - 1U];
+		last = run->first_cluster + run->cluster_count - 1U;
+	}
+
+	if (!FAT32_AllocateRun(count, (last != 0) ? (last + 1U) : 0, &first)) {
+		if (is_contiguous || (count == 1U)) {
+			return false;
+		}
+
+		count = 1;
+
+		if (!FAT32_AllocateRun(count, 0, &first)) {
+			return false;
+		}
+	}
+
+	if ((last != 0) && !FAT32_SetEntry(last, first)) {
+		return false;
+	}
+
+	if ((last != 0) && (first == (last + 1U))) {
+		file->runs[file->run_count - 1U].cluster_count += count;
+	} else if (file->run_count < FAT32_FILE_MAX_RUNS) {
+		file->runs[file->run_count].first_cluster = first;
+		file->runs[file->run_count].cluster_count = count;
+		file->run_count++;
+	} else {
+		return false;
+	}
+
+	file->allocated_clusters += count;
+
+	return true;
+}
+
+static bool FAT32_FileLba (const sFat32File_t *file, uint32_t offset, uint32_t *lba, uint32_t *run_sectors_left) {
+	uint32_t cluster_index = offset / dyn_volume.cluster_bytes;
+	uint32_t sector_in_cluster = (offset % dyn_volume.cluster_bytes) / SD_CARD_SECTOR_SIZE;
+
+	for (uint8_t i = 0; i < file->run_count; i++) {
+		if (cluster_index < file->runs[i].cluster_count) {
+			*lba = FAT32_ClusterToLba(file->runs[i].first_cluster + cluster_index) + sector_in_cluster;
+
+			if (run_sectors_left != NULL) {
+				*run_sectors_left = ((file->runs[i].cluster_count - cluster_index) * dyn_volume.sectors_per_cluster) - sector_in_cluster;
+			}
+
+			return true;
+		}
+
+		cluster_index -= file->runs[i].cluster_count;
+	}
+
+	return false;
+}
+
+static bool FAT32_FileFlushPartial (sFat32File_t *file) {
+	if (file->sector_fill == 0) {
+		return true;
+	}
+
+	uint32_t lba = 0;
+
+	if (!FAT32_FileLba(file, file->size - file->sector_fill, &lba, NULL)) {
+		return false;
+	}
+
+	memset(&file->sector[file->sector_fill], 0, SD_CARD_SECTOR_SIZE - file->sector_fill);
+
+	return SD_Card_Driver_WriteBlocks(dyn_volume.card, lba, file->sector, 1);
+}
+
+static bool FAT32_FileUpdateDir (sFat32File_t *file) {
+	if (!file->is_dir_dirty) {
+		return true;
+	}
+
+	if (!FAT32_MetaLoad(file->dir_lba)) {
+		return false;
+	}
+
+	uint8_t *entry = &dyn_meta_sector[file->dir_offset];
+	uint32_t first_cluster = (file->run_count != 0) ? file->runs[0].first_cluster : 0;
+	uint16_t date = 0;
+	uint16_t time = 0;
+
+	FAT32_GetTimestamp(&date, &time);
+
+	FAT32_Put16(&entry[20], (uint16_t) (first_cluster >> 16));
+	FAT32_Put16(&entry[22], time);
+	FAT32_Put16(&entry[24], date);
+	FAT32_Put16(&entry[26], (uint16_t) first_cluster);
+	FAT32_Put32(&entry[28], file->size);
+
+	if (!FAT32_MetaStore()) {
+		return false;
+	}
+
+	file->is_dir_dirty = false;
+
+	return true;
+}
+
+static bool FAT32_FileTruncate (sFat32File_t *file) {
+	uint32_t needed = (file->size + dyn_volume.cluster_bytes - 1U) / dyn_volume.cluster_bytes;
+	uint32_t kept = 0;
+	uint8_t run_count = 0;
+
+	if (needed >= file->allocated_clusters) {
+		return true;
+	}
+
+	for (uint8_t i = 0; i < file->run_count; i++) {
+		sFat32Run_t *run = &file->runs[i];
+		uint32_t run_length = run->cluster_count;
+
+		for (uint32_t c = 0; c < run_length; c++) {
+			uint32_t cluster = run->first_cluster + c;
+
+			if (kept < needed) {
+				kept++;
+
+				if ((kept == needed) && !FAT32_SetEntry(cluster, FAT32_ENTRY_EOC)) {
+					return false;
+				}
+
+				run->cluster_count = c + 1U;
+				run_count = i + 1U;
+				continue;
+			}
+
+			if (!FAT32_SetEntry(cluster, FAT32_ENTRY_FREE)) {
+				return false;
+			}
+
+			if (cluster < dyn_volume.next_free) {
+				dyn_volume.next_free = cluster;
+			}
+		}
+	}
+
+	file->run_count = run_count;
+	file->allocated_clusters = needed;
+	file->is_dir_dirty = true;
+
+	return true;
+}
+
+static bool FAT32_WriteFsInfo (void) {
+	if ((dyn_volume.fsinfo_lba == 0) || !FAT32_MetaLoad(dyn_volume.fsinfo_lba)) {
+		return false;
+	}
+
+	/* Free count is left unknown, hosts recount it and we never pay for keeping it exact */
+	FAT32_Put32(&dyn_meta_sector[FAT32_FSINFO_FREE_COUNT_AT], FAT32_UNKNOWN);
+	FAT32_Put32(&dyn_meta_sector[FAT32_FSINFO_NEXT_FREE_AT], dyn_volume.next_free);
+
+	return FAT32_MetaStore();
+}
+
+/* The card carries no time zone, so directory times are UTC like the log */
+static void FAT32_GetTimestamp (uint16_t *date, uint16_t *time) {
+	uint64_t epoch_ms = 0;
+	sWallClockCalendar_t calendar = {0};
+
+	*date = FAT32_DEFAULT_DATE;
+	*time = FAT32_DEFAULT_TIME;
+
+	if (!Wall_Clock_IsSet() || !Wall_Clock_GetTime(&epoch_ms) || !Wall_Clock_ToCalendar((uint32_t) (epoch_ms / 1000U), &calendar)) {
+		return;
+	}
+
+	*date = (uint16_t) (((calendar.year - FAT32_DATE_EPOCH_YEAR) << 9) | ((uint32_t) calendar.month << 5) | calendar.day);
+	*time = (uint16_t) (((uint32_t) calendar.hour << 11) | ((uint32_t) calendar.minute << 5) | (calendar.second / 2U));
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool FAT32_Mount (eSdCard_t card, const sFat32Config_t *config) {
+	if (config == NULL) {
+		return false;
+	}
+
+	sPartition_t partition = {0};
+
+	memset(&dyn_volume, 0, sizeof(dyn_volume));
+	memset(dyn_fat_cache, 0, sizeof(dyn_fat_cache));
+	dyn_meta_lba = FAT32_NO_SECTOR;
+
+	dyn_volume.card = card;
+	dyn_volume.config = *config;
+
+	/* Cards formatted without a partition table carry the boot sector at LBA 0 */
+	if (!Partition_Find(card, static_fat32_partition_types, sizeof(static_fat32_partition_types), &partition)) {
+		partition.first_lba = 0;
+	}
+
+	if (!FAT32_MetaLoad(partition.first_lba)) {
+		return false;
+	}
+
+	uint16_t bytes_per_sector = FAT32_Get16(&dyn_meta_sector[11]);
+	uint8_t sectors_per_cluster = dyn_meta_sector[13];
+	uint16_t reserved_sectors = FAT32_Get16(&dyn_meta_sector[14]);
+	uint8_t fat_count = dyn_meta_sector[16];
+	uint16_t root_entries = FAT32_Get16(&dyn_meta_sector[17]);
+	uint32_t total_sectors = FAT32_Get16(&dyn_meta_sector[19]);
+	uint32_t fat_sectors = FAT32_Get32(&dyn_meta_sector[36]);
+
+	if (total_sectors == 0) {
+		total_sectors = FAT32_Get32(&dyn_meta_sector[32]);
+	}
+
+	if ((bytes_per_sector != SD_CARD_SECTOR_SIZE) || (sectors_per_cluster == 0) || (fat_count == 0) || (root_entries != 0) || (fat_sectors == 0)) {
+		return false;
+	}
+
+	dyn_volume.sectors_per_cluster = sectors_per_cluster;
+	dyn_volume.cluster_bytes = (uint32_t) sectors_per_cluster * SD_CARD_SECTOR_SIZE;
+	dyn_volume.fat_count = fat_count;
+	dyn_volume.fat_sectors = fat_sectors;
+	dyn_volume.fat_lba = partition.first_lba + reserved_sectors;
+	dyn_volume.data_lba = dyn_volume.fat_lba + (fat_count * fat_sectors);
+	dyn_volume.root_cluster = FAT32_Get32(&dyn_meta_sector[44]);
+	dyn_volume.fsinfo_lba = partition.first_lba + FAT32_Get16(&dyn_meta_sector[48]);
+
+	uint32_t cluster_count = (total_sectors - (dyn_volume.data_lba - partition.first_lba)) / sectors_per_cluster;
+
+	if ((cluster_count < FAT32_MIN_CLUSTERS) || (cluster_count > ((fat_sectors * FAT32_ENTRIES_PER_SECTOR) - FAT32_FIRST_CLUSTER))) {
+		return false;
+	}
+
+	dyn_volume.max_cluster = cluster_count + 1U;
+	dyn_volume.next_free = FAT32_FIRST_CLUSTER;
+
+	if (FAT32_MetaLoad(dyn_volume.fsinfo_lba)) {
+		uint32_t hint = FAT32_Get32(&dyn_meta_sector[FAT32_FSINFO_NEXT_FREE_AT]);
+
+		if ((hint >= FAT32_FIRST_CLUSTER) && (hint <= dyn_volume.max_cluster)) {
+			dyn_volume.next_free = hint;
+		}
+	}
+
+	if (dyn_volume.config.prealloc_clusters == 0) {
+		dyn_volume.config.prealloc_clusters = 1;
+	}
+
+	dyn_volume.last_sync_tick = HAL_GetTick();
+	dyn_volume.is_mounted = true;
+
+	return true;
+}
+
+bool FAT32_IsMounted (void) {
+	return dyn_volume.is_mounted;
+}
+
+bool FAT32_CreateFile (const char *name, uint32_t prealloc_bytes, bool is_contiguous, sFat32File_t *file) {
+	uint8_t short_name[FAT32_NAME_LENGTH];
+	uint32_t slot = FAT32_MAX_OPEN_FILES;
+
+	if ((name == NULL) || (file == NULL) || !dyn_volume.is_mounted || !FAT32_ToShortName(name, short_name)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+		if (dyn_volume.open_files[i] == NULL) {
+			slot = i;
+			break;
+		}
+	}
+
+	if (slot == FAT32_MAX_OPEN_FILES) {
+		return false;
+	}
+
+	bool is_found = false;
+	uint32_t dir_lba = 0;
+	uint16_t dir_offset = 0;
+
+	if (file->is_open || !FAT32_FindDirSlot(short_name, true, &is_found, &dir_lba, &dir_offset) || is_found) {
+		return false;
+	}
+
+	memset(file, 0, sizeof(*file));
+	file->dir_lba = dir_lba;
+	file->dir_offset = dir_offset;
+
+	uint32_t clusters = (prealloc_bytes + dyn_volume.cluster_bytes - 1U) / dyn_volume.cluster_bytes;
+
+	if (clusters == 0) {
+		clusters = dyn_volume.config.prealloc_clusters;
+	}
+
+	if (!FAT32_FileAppendClusters(file, clusters, is_contiguous)) {
+		return false;
+	}
+
+	/* Chain goes to the card before the directory entry that points at it */
+	if (!FAT32_CacheFlushAll() || !FAT32_MetaLoad(file->dir_lba)) {
+		return false;
+	}
+
+	uint8_t *entry = &dyn_meta_sector[file->dir_offset];
+	uint16_t date = 0;
+	uint16_t time = 0;
+
+	FAT32_GetTimestamp(&date, &time);
+
+	memset(entry, 0, FAT32_DIR_ENTRY_SIZE);
+	memcpy(entry, short_name, FAT32_NAME_LENGTH);
+	entry[11] = FAT32_ATTR_ARCHIVE;
+	FAT32_Put16(&entry[14], time);
+	FAT32_Put16(&entry[16], date);
+	FAT32_Put16(&entry[18], date);
+	file->is_dir_dirty = true;
+
+	if (!FAT32_FileUpdateDir(file)) {
+		return false;
+	}
+
+	file->is_open = true;
+	dyn_volume.open_files[slot] = file;
+
+	return true;
+}
+
+bool FAT32_Exists (const char *name) {
+	uint8_t short_name[FAT32_NAME_LENGTH];
+	bool is_found = false;
+	uint32_t lba = 0;
+	uint16_t offset = 0;
+
+	if ((name == NULL) || !dyn_volume.is_mounted || !FAT32_ToShortName(name, short_name)) {
+		return false;
+	}
+
+	return FAT32_FindDirSlot(short_name, false, &is_found, &lba, &offset) && is_found;
+}
+
+bool FAT32_Write (sFat32File_t *file, const uint8_t *data, uint32_t byte_count) {
+	if ((file == NULL) || (data == NULL) || !file->is_open) {
+		return false;
+	}
+
+	while (byte_count != 0) {
+		uint32_t chunk = SD_CARD_SECTOR_SIZE - file->sector_fill;
+
+		if (chunk > byte_count) {
+			chunk = byte_count;
+		}
+
+		uint32_t offset = file->size - file->sector_fill;
+		uint32_t cluster_index = offset / dyn_volume.cluster_bytes;
+
+		/* Grow the chain ahead of the write pointer so the append path never waits for an allocation scan */
+		if (((cluster_index + 1U) >= file->allocated_clusters) && !FAT32_FileAppendClusters(file, dyn_volume.config.prealloc_clusters, false) && (cluster_index >= file->allocated_clusters)) {
+			return false;
+		}
+
+		memcpy(&file->sector[file->sector_fill], data, chunk);
+		file->sector_fill += chunk;
+		file->size += chunk;
+		file->is_dir_dirty = true;
+		data += chunk;
+		byte_count -= chunk;
+
+		if (file->sector_fill < SD_CARD_SECTOR_SIZE) {
+			continue;
+		}
+
+		uint32_t lba = 0;
+		uint32_t run_sectors_left = 0;
+
+		if (!FAT32_FileLba(file, offset, &lba, &run_sectors_left)) {
+			return false;
+		}
+
+		if (!SD_Card_Driver_StreamOpen(dyn_volume.card, lba, run_sectors_left) || !SD_Card_Driver_StreamWrite(dyn_volume.card, file->sector, 1)) {
+			return false;
+		}
+
+		file->sector_fill = 0;
+	}
+
+	return true;
+}
+
+bool FAT32_GetExtent (const sFat32File_t *file, uint32_t *first_lba, uint32_t *sector_count) {
+	if ((file == NULL) || (first_lba == NULL) || (sector_count == NULL) || !file->is_open || (file->run_count != 1U)) {
+		return false;
+	}
+
+	*first_lba = FAT32_ClusterToLba(file->runs[0].first_cluster);
+	*sector_count = file->runs[0].cluster_count * dyn_volume.sectors_per_cluster;
+
+	return true;
+}
+
+bool FAT32_SetSize (sFat32File_t *file, uint32_t size) {
+	if ((file == NULL) || !file->is_open || (size > (file->allocated_clusters * dyn_volume.cluster_bytes))) {
+		return false;
+	}
+
+	file->size = size;
+	file->sector_fill = 0;
+	file->is_dir_dirty = true;
+
+	return true;
+}
+
+bool FAT32_Flush (sFat32File_t *file) {
+	if ((file == NULL) || !file->is_open) {
+		return false;
+	}
+
+	bool is_flush_successful = FAT32_FileFlushPartial(file);
+
+	is_flush_successful = FAT32_CacheFlushAll() && is_flush_successful;
+
+	return FAT32_FileUpdateDir(file) && is_flush_successful;
+}
+
+bool FAT32_Close (sFat32File_t *file) {
+	if ((file == NULL) || !file->is_open) {
+		return false;
+	}
+
+	bool is_close_successful = FAT32_FileFlushPartial(file);
+
+	is_close_successful = FAT32_FileTruncate(file) && is_close_successful;
+	is_close_successful = FAT32_CacheFlushAll() && is_close_successful;
+	is_close_successful = FAT32_FileUpdateDir(file) && is_close_successful;
+
+	for (uint32_t i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+		if (dyn_volume.open_files[i] == file) {
+			dyn_volume.open_files[i] = NULL;
+		}
+	}
+
+	file->is_open = false;
+
+	return FAT32_WriteFsInfo() && is_close_successful;
+}
+
+bool FAT32_Discard (sFat32File_t *file) {
+	if ((file == NULL) || !file->is_open) {
+		return false;
+	}
+
+	file->size = 0;
+	file->sector_fill = 0;
+
+	/* The chain is freed before the entry goes, a cut in between leaves an empty file rather than lost clusters */
+	bool is_discard_successful = FAT32_FileTruncate(file) && FAT32_CacheFlushAll();
+
+	is_discard_successful = is_discard_successful && FAT32_FileUpdateDir(file) && FAT32_MetaLoad(file->dir_lba);
+
+	if (is_discard_successful) {
+		dyn_meta_sector[file->dir_offset] = FAT32_ENTRY_DELETED;
+		is_discard_successful = FAT32_MetaStore();
+	}
+
+	for (uint32_t i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+		if (dyn_volume.open_files[i] == file) {
+			dyn_volume.open_files[i] = NULL;
+		}
+	}
+
+	file->is_open = false;
+
+	return FAT32_WriteFsInfo() && is_discard_successful;
+}
+
+bool FAT32_Sync (void) {
+	if (!dyn_volume.is_mounted) {
+		return false;
+	}
+
+	bool is_sync_successful = true;
+
+	for (uint32_t i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+		if (dyn_volume.open_files[i] != NULL) {
+			is_sync_successful = FAT32_FileFlushPartial(dyn_volume.open_files[i]) && is_sync_successful;
+		}
+	}
+
+	is_sync_successful = FAT32_CacheFlushAll() && is_sync_successful;
+
+	for (uint32_t i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+		if (dyn_volume.open_files[i] != NULL) {
+			is_sync_successful = FAT32_FileUpdateDir(dyn_volume.open_files[i]) && is_sync_successful;
+		}
+	}
+
+	dyn_volume.last_sync_tick = HAL_GetTick();
+
+	return is_sync_successful;
+}
+
+void FAT32_Process (void) {
+	if (!dyn_volume.is_mounted || (dyn_volume.config.sync_interval_ms == 0)) {
+		return;
+	}
+
+	if ((HAL_GetTick() - dyn_volume.last_sync_tick) >= dyn_volume.config.sync_interval_ms) {
+		FAT32_Sync();
+	}
+}
@@ -6,8 +6,10 @@
 #include "stm32f4xx_ll_exti.h"
 #include "stm32f4xx_ll_system.h"
 #include "stm32f4xx_ll_bus.h"
-#include "adc_driver.h"
 #include "gpio_driver.h"
+#include "irq_map.h"
+#include "deferred_work.h"
+#include "timebase.h"
 /**********************************************************************************************************************
  * Private definitions and macros
  *********************************************************************************************************************/
@@ -117,15 +119,16 @@
 		.alternate = LL_GPIO_AF_0,
 		.is_interrupt = false,
 	},
+	/* TIM5_CH2 latches the edge for the timebase, EXTI still sees the input stage in alternate function mode */
 	[eGpioPin_SoundSensorDigital] = {
 		.port = GPIOA,
 		.pin = LL_GPIO_PIN_1,
-		.mode = LL_GPIO_MODE_INPUT,
+		.mode = LL_GPIO_MODE_ALTERNATE,
 		.speed = LL_GPIO_SPEED_FREQ_LOW,
 		.output = LL_GPIO_OUTPUT_OPENDRAIN,
 		.pull = LL_GPIO_PULL_NO,
 		.clock = LL_AHB1_GRP1_PERIPH_GPIOA,
-		.alternate = LL_GPIO_AF_0,
+		.alternate = LL_GPIO_AF_2,
 		.is_interrupt = true,
 		.line = LL_EXTI_LINE_1,
 		.line_command = ENABLE,
@@ -139,6 +142,11 @@
 /**********************************************************************************************************************
  * Private variables
  *********************************************************************************************************************/
+static GpioIrqCb_t dyn_gpio_irq_cb_lut[eGpioPin_Last] = {0};
+/* Edges counted by the EXTI top half, delivered to the callbacks from PendSV */
+static volatile uint32_t dyn_gpio_irq_events_lut[eGpioPin_Last] = {0};
+/* Timebase ticks of the latest edge */
+static uint64_t dyn_gpio_irq_ticks_lut[eGpioPin_Last] = {0};
 
 /**********************************************************************************************************************
  * Exported variables and references
@@ -147,10 +155,19 @@
 /**********************************************************************************************************************
  * Prototypes of private functions
  *********************************************************************************************************************/
-
+static void GPIO_Driver_DeferredWork (void);
 /**********************************************************************************************************************
  * Definitions of private functions
  *********************************************************************************************************************/
+static void GPIO_Driver_DeferredWork (void) {
+    for (eGpioPin_t pin = eGpioPin_First; pin < eGpioPin_Last; pin++) {
+        uint32_t events = Deferred_Work_Take(&dyn_gpio_irq_events_lut[pin]);
+
+        while ((events-- > 0) && (dyn_gpio_irq_cb_lut[pin] != NULL)) {
+            dyn_gpio_irq_cb_lut[pin](pin);
+        }
+    }
+}
 
 /**********************************************************************************************************************
  * Definitions of exported functions
@@ -159,6 +176,8 @@ bool GPIO_Driver_Init (void) {
     LL_GPIO_InitTypeDef gpio_init_struct = {0};
     bool is_init_successful = true;
 
+    Deferred_Work_SetCallback(eDeferredWork_Gpio, GPIO_Driver_DeferredWork);
+
     for (eGpioPin_t pin = eGpioPin_First; pin < eGpioPin_Last; pin++) {
         LL_AHB1_GRP1_EnableClock(g_static_gpio_lut[pin].clock);
         LL_GPIO_ResetOutputPin(g_static_gpio_lut[pin].port, g_static_gpio_lut[pin].pin);
@@ -185,7 +204,7 @@ bool GPIO_Driver_Init (void) {
 
         	LL_EXTI_Init(&exti_init_struct);
 
-        	NVIC_SetPriority(g_static_gpio_lut[pin].exti_irq, NVIC_EncodePriority(NVIC_GetPriorityGrouping(),0, 0));
+        	NVIC_SetPriority(g_static_gpio_lut[pin].exti_irq, IRQ_Map_GetPriority(eIrqSource_Exti));
         	NVIC_EnableIRQ(g_static_gpio_lut[pin].exti_irq);
         }
     }
@@ -213,6 +232,7 @@ bool GPIO_Driver_ReadPin (eGpioPin_t pin, bool *state) {
             *state = LL_GPIO_IsOutputPinSet(g_static_gpio_lut[pin].port, g_static_gpio_lut[pin].pin);
             return true;
         case LL_GPIO_MODE_INPUT:
+        case LL_GPIO_MODE_ALTERNATE:
             *state = LL_GPIO_IsInputPinSet(g_static_gpio_lut[pin].port, g_static_gpio_lut[pin].pin);
             return true;
         default:
@@ -235,14 +255,44 @@ bool GPIO_Driver_WritePin (eGpioPin_t pin, bool state) {
     return true;
 }
 
+bool GPIO_Driver_SetIrqCallback (eGpioPin_t pin, GpioIrqCb_t irq_cb) {
+    if ((pin < eGpioPin_First) || (pin >= eGpioPin_Last) || !g_static_gpio_lut[pin].is_interrupt) {
+        return false;
+    }
+
+    dyn_gpio_irq_cb_lut[pin] = irq_cb;
+
+    return true;
+}
+
+bool GPIO_Driver_GetIrqTicks (eGpioPin_t pin, uint64_t *ticks) {
+    if ((pin < eGpioPin_First) || (pin >= eGpioPin_Last) || !g_static_gpio_lut[pin].is_interrupt || (ticks == NULL)) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *ticks = dyn_gpio_irq_ticks_lut[pin];
+    __set_PRIMASK(primask);
+
+    return true;
+}
 
 void EXTI1_IRQHandler (void) {
+    uint32_t enter_cycles = IRQ_Map_Enter();
+
     if (LL_EXTI_IsActiveFlag_0_31(LL_EXTI_LINE_1)) {
         LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_1);
 
-        uint16_t value = 0;
+        /* The captured edge, not the interrupt's entry; before the timebase runs the current time is the best there is */
+        if (!Timebase_GetCapture(eTimebaseCapture_SoundSensor, &dyn_gpio_irq_ticks_lut[eGpioPin_SoundSensorDigital])) {
+            dyn_gpio_irq_ticks_lut[eGpioPin_SoundSensorDigital] = Timebase_GetTicks();
+        }
 
-        ADC_Driver_ReadChannels(eAdc_1);
-        ADC_Driver_GetChannelValue(eAdcChannel_1, &value);
+        Deferred_Work_Add(&dyn_gpio_irq_events_lut[eGpioPin_SoundSensorDigital], 1);
+        Deferred_Work_Post(eDeferredWork_Gpio);
     }
+
+    IRQ_Map_Exit(eIrqSource_Exti, enter_cycles);
 }
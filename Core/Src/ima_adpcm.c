@@ -0,0 +1,148 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "ima_adpcm.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define IMA_ADPCM_STEP_COUNT	89U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const int16_t static_step_table[IMA_ADPCM_STEP_COUNT] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+	118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+	6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+	32767
+};
+
+static const int8_t static_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static int32_t IMA_ADPCM_Clamp (int32_t value, int32_t low, int32_t high);
+static uint8_t IMA_ADPCM_EncodeSample (sImaAdpcmState_t *state, int16_t sample);
+static int16_t IMA_ADPCM_DecodeSample (sImaAdpcmState_t *state, uint8_t code);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static inline int32_t IMA_ADPCM_Clamp (int32_t value, int32_t low, int32_t high) {
+	value = (value < low) ? low : value;
+
+	return (value > high) ? high : value;
+}
+
+/* Successive approximation with masks instead of branches, three fixed steps per sample */
+static inline uint8_t IMA_ADPCM_EncodeSample (sImaAdpcmState_t *state, int16_t sample) {
+	int32_t step = static_step_table[state->step_index];
+	int32_t diff = (int32_t) sample - state->predictor;
+	int32_t sign_mask = diff >> 31;
+	uint32_t code = (uint32_t) sign_mask & 8U;
+
+	diff = (diff ^ sign_mask) - sign_mask;
+
+	int32_t delta = step >> 3;
+
+	for (uint32_t bit = 4U; bit != 0U; bit >>= 1) {
+		int32_t mask = -(int32_t) (diff >= step);
+
+		code |= bit & (uint32_t) mask;
+		diff -= step & mask;
+		delta += step & mask;
+		step >>= 1;
+	}
+
+	delta = (delta ^ sign_mask) - sign_mask;
+	state->predictor = (int16_t) IMA_ADPCM_Clamp(state->predictor + delta, INT16_MIN, INT16_MAX);
+	state->step_index = (uint8_t) IMA_ADPCM_Clamp((int32_t) state->step_index + static_index_table[code & 7U], 0, IMA_ADPCM_STEP_COUNT - 1);
+
+	return (uint8_t) code;
+}
+
+static inline int16_t IMA_ADPCM_DecodeSample (sImaAdpcmState_t *state, uint8_t code) {
+	int32_t step = static_step_table[state->step_index];
+	int32_t delta = step >> 3;
+
+	if (code & 4U) {
+		delta += step;
+	}
+
+	if (code & 2U) {
+		delta += step >> 1;
+	}
+
+	if (code & 1U) {
+		delta += step >> 2;
+	}
+
+	if (code & 8U) {
+		delta = -delta;
+	}
+
+	state->predictor = (int16_t) IMA_ADPCM_Clamp(state->predictor + delta, INT16_MIN, INT16_MAX);
+	state->step_index = (uint8_t) IMA_ADPCM_Clamp((int32_t) state->step_index + static_index_table[code & 7U], 0, IMA_ADPCM_STEP_COUNT - 1);
+
+	return state->predictor;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+/* Encodes IMA_ADPCM_SAMPLES_PER_BLOCK(block_size) samples into one WAV block, the step index carries over between blocks */
+bool IMA_ADPCM_EncodeBlock (sImaAdpcmState_t *state, const int16_t *pcm, uint32_t block_size, uint8_t *block) {
+	if ((state == NULL) || (pcm == NULL) || (block == NULL) || (block_size <= IMA_ADPCM_BLOCK_HEADER_SIZE)) {
+		return false;
+	}
+
+	if (state->step_index >= IMA_ADPCM_STEP_COUNT) {
+		state->step_index = 0;
+	}
+
+	state->predictor = pcm[0];
+
+	block[0] = (uint8_t) state->predictor;
+	block[1] = (uint8_t) ((uint16_t) state->predictor >> 8);
+	block[2] = state->step_index;
+	block[3] = 0;
+
+	const int16_t *sample = &pcm[1];
+
+	for (uint32_t i = IMA_ADPCM_BLOCK_HEADER_SIZE; i < block_size; i++) {
+		uint8_t low = IMA_ADPCM_EncodeSample(state, sample[0]);
+		uint8_t high = IMA_ADPCM_EncodeSample(state, sample[1]);
+
+		block[i] = (uint8_t) (low | (high << 4));
+		sample += 2;
+	}
+
+	return true;
+}
+
+bool IMA_ADPCM_DecodeBlock (const uint8_t *block, uint32_t block_size, int16_t *pcm) {
+	if ((block == NULL) || (pcm == NULL) || (block_size <= IMA_ADPCM_BLOCK_HEADER_SIZE) || (block[2] >= IMA_ADPCM_STEP_COUNT)) {
+		return false;
+	}
+
+	sImaAdpcmState_t state = {
+		.predictor = (int16_t) ((uint16_t) block[0] | ((uint16_t) block[1] << 8)),
+		.step_index = block[2]
+	};
+
+	*pcm++ = state.predictor;
+
+	for (uint32_t i = IMA_ADPCM_BLOCK_HEADER_SIZE; i < block_size; i++) {
+		*pcm++ = IMA_ADPCM_DecodeSample(&state, block[i] & 0x0FU);
+		*pcm++ = IMA_ADPCM_DecodeSample(&state, block[i] >> 4);
+	}
+
+	return true;
+}
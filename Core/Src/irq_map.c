@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx_hal.h"
+#include "trace.h"
+#include "profiler.h"
+#include "irq_map.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* Four preemption bits and no sub-priority bits, the grouping HAL_Init selects and the one the kernel port assumes */
+#define IRQ_MAP_GROUPING	NVIC_PRIORITYGROUP_4
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t preempt;
+	uint32_t sub;
+	/* Worst case allowed per entry, in CPU cycles */
+	uint32_t budget_cycles;
+	eProfilerProbe_t probe;
+} sIrqDesc_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+/*
+ * Sample DMA preempts everything: a half-buffer callback that waits past the next half loses audio. SD transfers are
+ * polled from thread context today, the SPI DMA level is kept free for them. The UART, sensor input and the tick can
+ * all wait a few microseconds, the timebase wrap even an hour. PendSV runs the deferred bottom halves below every
+ * hardware source.
+ */
+static const sIrqDesc_t static_irq_lut[eIrqSource_Last] = {
+	[eIrqSource_AdcDma] = {.preempt = 0, .sub = 0, .budget_cycles = 400, .probe = eProfilerProbe_AdcDmaIrq},
+	[eIrqSource_SpiDma] = {.preempt = 1, .sub = 0, .budget_cycles = 400, .probe = eProfilerProbe_SpiDmaIrq},
+	[eIrqSource_UartRx] = {.preempt = 3, .sub = 0, .budget_cycles = 300, .probe = eProfilerProbe_UartRxIrq},
+	[eIrqSource_UartTxDma] = {.preempt = 4, .sub = 0, .budget_cycles = 400, .probe = eProfilerProbe_UartTxDmaIrq},
+	[eIrqSource_Exti] = {.preempt = 5, .sub = 0, .budget_cycles = 200, .probe = eProfilerProbe_ExtiIrq},
+	[eIrqSource_SysTick] = {.preempt = 6, .sub = 0, .budget_cycles = 600, .probe = eProfilerProbe_SysTickIrq},
+	[eIrqSource_Timebase] = {.preempt = 7, .sub = 0, .budget_cycles = 200, .probe = eProfilerProbe_TimebaseIrq},
+	[eIrqSource_PendSV] = {.preempt = 15, .sub = 0, .budget_cycles = 4000, .probe = eProfilerProbe_PendSVIrq}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sIrqStats_t dyn_irq_stats_lut[eIrqSource_Last] = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool IRQ_Map_Init (void) {
+	NVIC_SetPriorityGrouping(IRQ_MAP_GROUPING);
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	NVIC_SetPriority(SysTick_IRQn, IRQ_Map_GetPriority(eIrqSource_SysTick));
+
+	return true;
+}
+
+uint32_t IRQ_Map_GetPriority (eIrqSource_t source) {
+	if ((eIrqSource_Last <= source) || (eIrqSource_First > source)) {
+		/* Unknown sources get the lowest level rather than preempting the sample path */
+		return (1UL << __NVIC_PRIO_BITS) - 1U;
+	}
+
+	return NVIC_EncodePriority(IRQ_MAP_GROUPING, static_irq_lut[source].preempt, static_irq_lut[source].sub);
+}
+
+uint32_t IRQ_Map_Enter (void) {
+	return DWT->CYCCNT;
+}
+
+void IRQ_Map_Exit (eIrqSource_t source, uint32_t enter_cycles) {
+	if ((eIrqSource_Last <= source) || (eIrqSource_First > source)) {
+		return;
+	}
+
+	uint32_t cycles = DWT->CYCCNT - enter_cycles;
+	sIrqStats_t *stats = &dyn_irq_stats_lut[source];
+
+	/* Only this source's handler writes its entry, and a source cannot preempt itself */
+	stats->count++;
+
+	if (cycles > stats->max_cycles) {
+		stats->max_cycles = cycles;
+	}
+
+	if (cycles > static_irq_lut[source].budget_cycles) {
+		stats->over_budget++;
+		TRACE2("irq %u over budget: %u cycles", source, cycles);
+	}
+
+	PROFILER_RECORD(static_irq_lut[source].probe, cycles);
+}
+
+bool IRQ_Map_GetStats (eIrqSource_t source, sIrqStats_t *stats) {
+	if ((eIrqSource_Last <= source) || (eIrqSource_First > source) || (stats == NULL)) {
+		return false;
+	}
+
+	*stats = dyn_irq_stats_lut[source];
+
+	return true;
+}
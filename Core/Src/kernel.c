@@ -0,0 +1,562 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "kernel.h"
+#include "kernel_port.h"
+#include "trace.h"
+#include "power_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define KERNEL_STACK_FILL		0xA5A5A5A5UL
+#define KERNEL_IDLE_STACK_BYTES	512U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	/* Saved by PendSV while the thread is switched out */
+	uint32_t *stack_pointer;
+	uint32_t *stack_base;
+	uint32_t *stack_top;
+	KernelThreadCb_t entry;
+	/* Its own priority, raised while it holds a mutex a higher priority thread waits for */
+	eKernelThread_t priority;
+	/* Semaphore, mutex or queue list the thread waits on, NULL when it only sleeps */
+	volatile uint32_t *wait_list;
+	uint32_t wake_tick;
+	uint32_t switches;
+} sKernelThread_t;
+
+typedef struct {
+	bool is_init;
+	volatile bool is_running;
+	eKernelThread_t current;
+	/* Bit N set while thread N can run; the idle thread never leaves */
+	volatile uint32_t ready;
+	/* Bit N set while thread N waits with a timeout */
+	volatile uint32_t delayed;
+	sKernelThread_t threads[eKernelThread_Last];
+} sKernel_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sKernel_t dyn_kernel = {0};
+static uint64_t dyn_idle_stack[KERNEL_IDLE_STACK_BYTES / sizeof(uint64_t)];
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static void Kernel_IdleThread (void);
+static void Kernel_ThreadExit (void);
+static eKernelThread_t Kernel_GetHighest (uint32_t mask);
+static eKernelThread_t Kernel_GetNext (uint32_t mask);
+static bool Kernel_CanBlock (void);
+static uint32_t Kernel_GetRemaining (uint32_t start_tick, uint32_t timeout_ms);
+static void Kernel_MakeReady (eKernelThread_t thread);
+static void Kernel_WakeOne (volatile uint32_t *wait_list);
+static void Kernel_Block (volatile uint32_t *wait_list, uint32_t timeout_ms);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+/* A thread made ready meanwhile has pended PendSV, which ends the sleep at once */
+static void Kernel_IdleThread (void) {
+	while (1) {
+		__disable_irq();
+		Power_Manager_Idle();
+		__enable_irq();
+	}
+}
+
+/* Where a thread that returns from its entry ends up: it is parked for good */
+static void Kernel_ThreadExit (void) {
+	TRACE1("kernel: thread %u returned", dyn_kernel.current);
+
+	while (1) {
+		__disable_irq();
+		dyn_kernel.ready &= ~(1UL << dyn_kernel.current);
+		Kernel_Port_Yield();
+		__enable_irq();
+	}
+}
+
+/* Lowest set bit is the highest priority */
+static eKernelThread_t Kernel_GetHighest (uint32_t mask) {
+	return (eKernelThread_t) __CLZ(__RBIT(mask));
+}
+
+/* By the priority the threads run at now, ties go to the thread that is higher by its own */
+static eKernelThread_t Kernel_GetNext (uint32_t mask) {
+	eKernelThread_t next = Kernel_GetHighest(mask);
+
+	mask &= ~(1UL << next);
+
+	while (mask != 0) {
+		eKernelThread_t thread = Kernel_GetHighest(mask);
+
+		mask &= ~(1UL << thread);
+
+		if (dyn_kernel.threads[thread].priority < dyn_kernel.threads[next].priority) {
+			next = thread;
+		}
+	}
+
+	return next;
+}
+
+static bool Kernel_CanBlock (void) {
+	return dyn_kernel.is_running && (__get_IPSR() == 0) && (dyn_kernel.current != eKernelThread_Idle);
+}
+
+static uint32_t Kernel_GetRemaining (uint32_t start_tick, uint32_t timeout_ms) {
+	if (timeout_ms == KERNEL_WAIT_FOREVER) {
+		return KERNEL_WAIT_FOREVER;
+	}
+
+	uint32_t elapsed_ms = HAL_GetTick() - start_tick;
+
+	return (elapsed_ms >= timeout_ms) ? 0 : (timeout_ms - elapsed_ms);
+}
+
+/* Interrupts masked */
+static void Kernel_MakeReady (eKernelThread_t thread) {
+	sKernelThread_t *entry = &dyn_kernel.threads[thread];
+	uint32_t mask = 1UL << thread;
+
+	if (entry->wait_list != NULL) {
+		*entry->wait_list &= ~mask;
+		entry->wait_list = NULL;
+	}
+
+	dyn_kernel.delayed &= ~mask;
+	dyn_kernel.ready |= mask;
+
+	if (entry->priority < dyn_kernel.threads[dyn_kernel.current].priority) {
+		Kernel_Port_Yield();
+	}
+}
+
+/* Interrupts masked */
+static void Kernel_WakeOne (volatile uint32_t *wait_list) {
+	if (*wait_list != 0) {
+		Kernel_MakeReady(Kernel_GetHighest(*wait_list));
+	}
+}
+
+/* Interrupts masked, thread context; returns with them masked again once the thread was woken or timed out */
+static void Kernel_Block (volatile uint32_t *wait_list, uint32_t timeout_ms) {
+	sKernelThread_t *entry = &dyn_kernel.threads[dyn_kernel.current];
+	uint32_t mask = 1UL << dyn_kernel.current;
+
+	dyn_kernel.ready &= ~mask;
+	entry->wait_list = wait_list;
+
+	if (wait_list != NULL) {
+		*wait_list |= mask;
+	}
+
+	if (timeout_ms != KERNEL_WAIT_FOREVER) {
+		entry->wake_tick = HAL_GetTick() + timeout_ms;
+		dyn_kernel.delayed |= mask;
+	}
+
+	Kernel_Port_Yield();
+
+	/* PendSV switches away as soon as the mask is lifted and comes back here when the thread is ready */
+	__enable_irq();
+	__disable_irq();
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Kernel_Init (void) {
+	if (dyn_kernel.is_running) {
+		return false;
+	}
+
+	memset(&dyn_kernel, 0, sizeof(dyn_kernel));
+	dyn_kernel.is_init = true;
+
+	return true;
+}
+
+bool Kernel_InitThread (const sKernelThreadInit_t *init) {
+	if ((init == NULL) || (init->entry == NULL) || (init->stack == NULL) || !dyn_kernel.is_init || dyn_kernel.is_running) {
+		return false;
+	}
+
+	if ((eKernelThread_Last <= init->thread) || (eKernelThread_First > init->thread)) {
+		return false;
+	}
+
+	if (init->stack_bytes < KERNEL_MIN_STACK_BYTES) {
+		return false;
+	}
+
+	sKernelThread_t *entry = &dyn_kernel.threads[init->thread];
+	/* Whole double words only, the top of the stack stays 8 byte aligned as AAPCS wants */
+	size_t words = (init->stack_bytes / sizeof(uint64_t)) * 2U;
+	uint32_t *stack = (uint32_t *) init->stack;
+
+	for (size_t i = 0; i < words; i++) {
+		stack[i] = KERNEL_STACK_FILL;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->entry = init->entry;
+	entry->priority = init->thread;
+	entry->stack_base = stack;
+	entry->stack_top = stack + words;
+	entry->stack_pointer = Kernel_Port_InitStack(entry->stack_top, init->entry, Kernel_ThreadExit);
+	dyn_kernel.ready |= (1UL << init->thread);
+
+	return true;
+}
+
+bool Kernel_Start (void) {
+	sKernelThreadInit_t idle = {
+		.thread = eKernelThread_Idle,
+		.entry = Kernel_IdleThread,
+		.stack = dyn_idle_stack,
+		.stack_bytes = sizeof(dyn_idle_stack)
+	};
+
+	if (!Kernel_InitThread(&idle)) {
+		return false;
+	}
+
+	__disable_irq();
+
+	dyn_kernel.current = Kernel_GetHighest(dyn_kernel.ready);
+	dyn_kernel.is_running = true;
+
+	sKernelThread_t *entry = &dyn_kernel.threads[dyn_kernel.current];
+
+	entry->switches++;
+	Kernel_Port_Start(entry->stack_top, entry->entry, Kernel_ThreadExit);
+
+	return false;
+}
+
+bool Kernel_IsRunning (void) {
+	return dyn_kernel.is_running;
+}
+
+void Kernel_OnTick (void) {
+	if (!dyn_kernel.is_running) {
+		return;
+	}
+
+	uint32_t now = HAL_GetTick();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint32_t delayed = dyn_kernel.delayed;
+
+	while (delayed != 0) {
+		eKernelThread_t thread = Kernel_GetHighest(delayed);
+
+		delayed &= ~(1UL << thread);
+
+		if ((int32_t) (now - dyn_kernel.threads[thread].wake_tick) >= 0) {
+			Kernel_MakeReady(thread);
+		}
+	}
+
+	__set_PRIMASK(primask);
+}
+
+void Kernel_Delay (uint32_t delay_ms) {
+	if ((delay_ms == 0) || !Kernel_CanBlock()) {
+		return;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	Kernel_Block(NULL, delay_ms);
+	__set_PRIMASK(primask);
+}
+
+void Kernel_DelayUntil (uint32_t *wake_tick, uint32_t period_ms) {
+	if (wake_tick == NULL) {
+		return;
+	}
+
+	*wake_tick += period_ms;
+
+	/* Already late: run again right away and catch up over the next periods */
+	int32_t remaining_ms = (int32_t) (*wake_tick - HAL_GetTick());
+
+	if (remaining_ms > 0) {
+		Kernel_Delay((uint32_t) remaining_ms);
+	}
+}
+
+/* Interrupts are masked around every check and update, threads and handlers see each change whole */
+bool Kernel_SemInit (sKernelSem_t *sem, uint32_t count, uint32_t max_count) {
+	if ((sem == NULL) || (max_count == 0) || (count > max_count)) {
+		return false;
+	}
+
+	sem->count = count;
+	sem->max_count = max_count;
+	sem->waiters = 0;
+
+	return true;
+}
+
+bool Kernel_SemTake (sKernelSem_t *sem, uint32_t timeout_ms) {
+	if (sem == NULL) {
+		return false;
+	}
+
+	uint32_t start_tick = HAL_GetTick();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	while (sem->count == 0) {
+		uint32_t remaining_ms = Kernel_GetRemaining(start_tick, timeout_ms);
+
+		if ((remaining_ms == 0) || !Kernel_CanBlock()) {
+			__set_PRIMASK(primask);
+
+			return false;
+		}
+
+		Kernel_Block(&sem->waiters, remaining_ms);
+	}
+
+	sem->count--;
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+bool Kernel_SemGive (sKernelSem_t *sem) {
+	if (sem == NULL) {
+		return false;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	bool is_given = (sem->count < sem->max_count);
+
+	if (is_given) {
+		sem->count++;
+		Kernel_WakeOne(&sem->waiters);
+	}
+
+	__set_PRIMASK(primask);
+
+	return is_given;
+}
+
+bool Kernel_MutexInit (sKernelMutex_t *mutex) {
+	if (mutex == NULL) {
+		return false;
+	}
+
+	mutex->owner = eKernelThread_Last;
+	mutex->waiters = 0;
+
+	return true;
+}
+
+bool Kernel_MutexLock (sKernelMutex_t *mutex, uint32_t timeout_ms) {
+	if ((mutex == NULL) || !dyn_kernel.is_running || (__get_IPSR() != 0)) {
+		return false;
+	}
+
+	uint32_t start_tick = HAL_GetTick();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	sKernelThread_t *entry = &dyn_kernel.threads[dyn_kernel.current];
+
+	while (mutex->owner != eKernelThread_Last) {
+		uint32_t remaining_ms = Kernel_GetRemaining(start_tick, timeout_ms);
+
+		if ((remaining_ms == 0) || !Kernel_CanBlock() || (mutex->owner == dyn_kernel.current)) {
+			__set_PRIMASK(primask);
+
+			return false;
+		}
+
+		/* Threads between the two priorities would otherwise keep the owner, and so this thread, waiting */
+		sKernelThread_t *owner = &dyn_kernel.threads[mutex->owner];
+
+		if (entry->priority < owner->priority) {
+			owner->priority = entry->priority;
+		}
+
+		Kernel_Block(&mutex->waiters, remaining_ms);
+	}
+
+	mutex->owner = dyn_kernel.current;
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+bool Kernel_MutexUnlock (sKernelMutex_t *mutex) {
+	if ((mutex == NULL) || (__get_IPSR() != 0)) {
+		return false;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	if (!dyn_kernel.is_running || (mutex->owner != dyn_kernel.current)) {
+		__set_PRIMASK(primask);
+
+		return false;
+	}
+
+	mutex->owner = eKernelThread_Last;
+	dyn_kernel.threads[dyn_kernel.current].priority = dyn_kernel.current;
+	Kernel_WakeOne(&mutex->waiters);
+
+	/* Back at its own priority, a thread it ran ahead of may be due even if none waited */
+	if (Kernel_GetNext(dyn_kernel.ready) != dyn_kernel.current) {
+		Kernel_Port_Yield();
+	}
+
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+bool Kernel_QueueInit (sKernelQueue_t *queue, void *buffer, size_t item_size, size_t capacity) {
+	if ((queue == NULL) || (buffer == NULL) || (item_size == 0) || (capacity == 0)) {
+		return false;
+	}
+
+	memset(queue, 0, sizeof(*queue));
+	queue->buffer = buffer;
+	queue->item_size = item_size;
+	queue->capacity = capacity;
+
+	return true;
+}
+
+/* Items are copied with interrupts masked, keep them small and pass pointers to anything larger */
+bool Kernel_QueueSend (sKernelQueue_t *queue, const void *item, uint32_t timeout_ms) {
+	if ((queue == NULL) || (item == NULL)) {
+		return false;
+	}
+
+	uint32_t start_tick = HAL_GetTick();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	while (queue->count == queue->capacity) {
+		uint32_t remaining_ms = Kernel_GetRemaining(start_tick, timeout_ms);
+
+		if ((remaining_ms == 0) || !Kernel_CanBlock()) {
+			__set_PRIMASK(primask);
+
+			return false;
+		}
+
+		Kernel_Block(&queue->tx_waiters, remaining_ms);
+	}
+
+	memcpy(&queue->buffer[queue->head * queue->item_size], item, queue->item_size);
+
+	if (++queue->head == queue->capacity) {
+		queue->head = 0;
+	}
+
+	queue->count++;
+	Kernel_WakeOne(&queue->rx_waiters);
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+bool Kernel_QueueReceive (sKernelQueue_t *queue, void *item, uint32_t timeout_ms) {
+	if ((queue == NULL) || (item == NULL)) {
+		return false;
+	}
+
+	uint32_t start_tick = HAL_GetTick();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	while (queue->count == 0) {
+		uint32_t remaining_ms = Kernel_GetRemaining(start_tick, timeout_ms);
+
+		if ((remaining_ms == 0) || !Kernel_CanBlock()) {
+			__set_PRIMASK(primask);
+
+			return false;
+		}
+
+		Kernel_Block(&queue->rx_waiters, remaining_ms);
+	}
+
+	memcpy(item, &queue->buffer[queue->tail * queue->item_size], queue->item_size);
+
+	if (++queue->tail == queue->capacity) {
+		queue->tail = 0;
+	}
+
+	queue->count--;
+	Kernel_WakeOne(&queue->tx_waiters);
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+/* Called from PendSV only, the stack pointer belongs to the thread that was running */
+uint32_t *Kernel_SwitchContext (uint32_t *stack_pointer) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	dyn_kernel.threads[dyn_kernel.current].stack_pointer = stack_pointer;
+
+	eKernelThread_t next = Kernel_GetNext(dyn_kernel.ready);
+
+	if (next != dyn_kernel.current) {
+		dyn_kernel.threads[next].switches++;
+		dyn_kernel.current = next;
+	}
+
+	stack_pointer = dyn_kernel.threads[next].stack_pointer;
+	__set_PRIMASK(primask);
+
+	return stack_pointer;
+}
+
+bool Kernel_GetStats (eKernelThread_t thread, sKernelThreadStats_t *stats) {
+	if ((eKernelThread_Last <= thread) || (eKernelThread_First > thread) || (stats == NULL)) {
+		return false;
+	}
+
+	sKernelThread_t *entry = &dyn_kernel.threads[thread];
+	const uint32_t *word = entry->stack_base;
+
+	stats->switches = entry->switches;
+	stats->stack_free_bytes = 0;
+
+	while ((word != NULL) && (word < entry->stack_top) && (*word == KERNEL_STACK_FILL)) {
+		stats->stack_free_bytes += sizeof(uint32_t);
+		word++;
+	}
+
+	return true;
+}
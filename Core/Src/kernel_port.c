@@ -0,0 +1,110 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "deferred_work.h"
+#include "kernel_port.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define KERNEL_PORT_INITIAL_XPSR	0x01000000UL
+/* Thread mode on the process stack without FPU context, what a thread that has not touched the FPU returns with */
+#define KERNEL_PORT_EXC_RETURN		0xFFFFFFFDUL
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static void Kernel_Port_EnterThread (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+/* CONTROL.SPSEL moves thread mode to the process stack, handlers stay on the main stack */
+__attribute__((naked)) static void Kernel_Port_EnterThread (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit) {
+	__asm volatile (
+		"	msr psp, r0				\n"
+		"	movs r0, #2				\n"
+		"	msr control, r0			\n"
+		"	isb						\n"
+		"	mov lr, r2				\n"
+		"	cpsie i					\n"
+		"	bx r1					\n"
+	);
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+uint32_t *Kernel_Port_InitStack (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit) {
+	uint32_t *stack_pointer = stack_top;
+
+	/* Hardware frame: xPSR, PC, LR, R12, R3 to R0 */
+	*--stack_pointer = KERNEL_PORT_INITIAL_XPSR;
+	*--stack_pointer = ((uint32_t) (uintptr_t) entry) & ~1UL;
+	*--stack_pointer = (uint32_t) (uintptr_t) exit;
+
+	for (size_t i = 0; i < 5U; i++) {
+		*--stack_pointer = 0;
+	}
+
+	/* Software frame as PendSV_Handler pops it: EXC_RETURN on top, R11 down to R4 */
+	*--stack_pointer = KERNEL_PORT_EXC_RETURN;
+
+	for (size_t i = 0; i < 8U; i++) {
+		*--stack_pointer = 0;
+	}
+
+	return stack_pointer;
+}
+
+void Kernel_Port_Start (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit) {
+	/* Lazy stacking: a handler preempting a thread that uses the FPU only reserves the space, PendSV saves S16-S31 */
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+
+	Kernel_Port_EnterThread(stack_top, entry, exit);
+}
+
+void Kernel_Port_Yield (void) {
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	__DSB();
+	__ISB();
+}
+
+/*
+ * The port owns PendSV, it is not generated in stm32f4xx_it.c. The deferred bottom halves run first, so a thread they
+ * make ready is switched to on the same exception. Until Kernel_Start that is all it does.
+ */
+__attribute__((naked)) void PendSV_Handler (void) {
+	__asm volatile (
+		"	push {r4, lr}			\n"
+		"	bl Deferred_Work_Run	\n"
+		"	bl Kernel_IsRunning		\n"
+		"	pop {r4, lr}			\n"
+		"	cbz r0, 1f				\n"
+		"	mrs r0, psp				\n"
+		"	isb						\n"
+		"	tst lr, #0x10			\n"
+		"	it eq					\n"
+		"	vstmdbeq r0!, {s16-s31}	\n"
+		"	stmdb r0!, {r4-r11, lr}	\n"
+		"	bl Kernel_SwitchContext	\n"
+		"	ldmia r0!, {r4-r11, lr}	\n"
+		"	tst lr, #0x10			\n"
+		"	it eq					\n"
+		"	vldmiaeq r0!, {s16-s31}	\n"
+		"	msr psp, r0				\n"
+		"	isb						\n"
+		"1:							\n"
+		"	bx lr					\n"
+	);
+}
@@ -0,0 +1,178 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <string.h>
+#include "level_codec.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static size_t Level_Codec_PutVarint (uint32_t value, uint8_t *out);
+static size_t Level_Codec_GetVarint (const uint8_t *in, size_t length, uint32_t *value);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static size_t Level_Codec_PutVarint (uint32_t value, uint8_t *out) {
+	size_t length = 0;
+
+	while (value >= 0x80U) {
+		out[length++] = (uint8_t) (value | 0x80U);
+		value >>= 7;
+	}
+
+	out[length++] = (uint8_t) value;
+
+	return length;
+}
+
+static size_t Level_Codec_GetVarint (const uint8_t *in, size_t length, uint32_t *value) {
+	uint32_t result = 0;
+
+	for (size_t i = 0; (i < length) && (i < LEVEL_CODEC_MAX_VARINT); i++) {
+		result |= (uint32_t) (in[i] & 0x7FU) << (7U * i);
+
+		if ((in[i] & 0x80U) == 0) {
+			*value = result;
+			return i + 1U;
+		}
+	}
+
+	return 0;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+int16_t Level_Codec_CdbToDdb (int16_t cdb) {
+	int32_t rounded = (cdb >= 0) ? (cdb + 5) : (cdb - 5);
+
+	return (int16_t) (rounded / 10);
+}
+
+/* Zig-zag deltas against the previous row; a keyframe (previous NULL) deltas each column against its neighbour instead */
+size_t Level_Codec_EncodeRow (const int16_t *values, const int16_t *previous, uint32_t count, uint8_t *out, size_t capacity) {
+	if ((values == NULL) || (out == NULL) || (capacity < (count * LEVEL_CODEC_MAX_VARINT))) {
+		return 0;
+	}
+
+	size_t length = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		int32_t reference = (previous != NULL) ? previous[i] : ((i != 0) ? values[i - 1U] : 0);
+		int32_t delta = values[i] - reference;
+		uint32_t zigzag = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+
+		length += Level_Codec_PutVarint(zigzag, &out[length]);
+	}
+
+	return length;
+}
+
+size_t Level_Codec_DecodeRow (const uint8_t *in, size_t length, const int16_t *previous, uint32_t count, int16_t *values) {
+	if ((in == NULL) || (values == NULL)) {
+		return 0;
+	}
+
+	size_t position = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t zigzag = 0;
+		size_t used = Level_Codec_GetVarint(&in[position], length - position, &zigzag);
+
+		if (used == 0) {
+			return 0;
+		}
+
+		int32_t delta = (int32_t) (zigzag >> 1) ^ -(int32_t) (zigzag & 1U);
+
+		int32_t reference = (previous != NULL) ? previous[i] : ((i != 0) ? values[i - 1U] : 0);
+
+		values[i] = (int16_t) (delta + reference);
+		position += used;
+	}
+
+	return position;
+}
+
+bool Level_Packer_Init (sLevelPacker_t *packer, uint8_t column_count, uint8_t first_band) {
+	if ((packer == NULL) || (column_count == 0) || (column_count > LEVEL_CODEC_MAX_COLUMNS)) {
+		return false;
+	}
+
+	memset(packer, 0, sizeof(*packer));
+	packer->header.column_count = column_count;
+	packer->header.first_band = first_band;
+
+	return true;
+}
+
+bool Level_Packer_IsEmpty (const sLevelPacker_t *packer) {
+	return (packer == NULL) || (packer->header.row_count == 0);
+}
+
+/* Returns false when the row does not continue the run or the record is full, finish the record and append again */
+bool Level_Packer_Append (sLevelPacker_t *packer, const int16_t *values_ddb, uint64_t timestamp_ms, uint32_t interval_ms) {
+	if ((packer == NULL) || (values_ddb == NULL) || (interval_ms == 0) || (interval_ms > UINT16_MAX)) {
+		return false;
+	}
+
+	bool is_keyframe = (packer->header.row_count == 0);
+
+	if (!is_keyframe) {
+		uint64_t expected_ms = packer->timestamp_ms + ((uint64_t) packer->header.row_count * packer->header.interval_ms);
+
+		if ((interval_ms != packer->header.interval_ms) || (timestamp_ms != expected_ms) || (packer->header.row_count == UINT8_MAX)) {
+			return false;
+		}
+	}
+
+	uint8_t row[LEVEL_CODEC_MAX_COLUMNS * LEVEL_CODEC_MAX_VARINT];
+	size_t length = Level_Codec_EncodeRow(values_ddb, is_keyframe ? NULL : packer->previous, packer->header.column_count, row, sizeof(row));
+
+	if ((length == 0) || ((packer->fill + length) > LEVEL_CODEC_MAX_DATA)) {
+		return false;
+	}
+
+	if (is_keyframe) {
+		packer->timestamp_ms = timestamp_ms;
+		packer->header.interval_ms = (uint16_t) interval_ms;
+	}
+
+	memcpy(&packer->record[sizeof(sLogLevels_t) + packer->fill], row, length);
+	memcpy(packer->previous, values_ddb, packer->header.column_count * sizeof(int16_t));
+	packer->fill += length;
+	packer->header.row_count++;
+
+	return true;
+}
+
+/* Lays out the finished record in packer->record and returns its length, the packer is then empty again */
+size_t Level_Packer_Finish (sLevelPacker_t *packer, uint64_t *timestamp_ms) {
+	if ((packer == NULL) || (timestamp_ms == NULL) || (packer->header.row_count == 0)) {
+		return 0;
+	}
+
+	size_t length = sizeof(sLogLevels_t) + packer->fill;
+
+	memcpy(packer->record, &packer->header, sizeof(sLogLevels_t));
+	*timestamp_ms = packer->timestamp_ms;
+
+	packer->header.row_count = 0;
+	packer->fill = 0;
+
+	return length;
+}
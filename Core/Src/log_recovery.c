@@ -0,0 +1,180 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "log_recovery.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	LogSectorReadCb_t read_cb;
+	void *context;
+	uint32_t data_count;
+	uint32_t reads;
+	uint8_t sector[LOG_SECTOR_SIZE];
+} sLogRecoveryScan_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint32_t Log_Recovery_SuperblockCrc (const sLogSuperblock_t *superblock);
+static bool Log_Recovery_IsValidSuperblock (const uint8_t *sector, sLogSuperblock_t *superblock);
+static bool Log_Recovery_IsWritten (sLogRecoveryScan_t *scan, const sLogPosition_t *checkpoint, uint32_t distance);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint32_t Log_Recovery_SuperblockCrc (const sLogSuperblock_t *superblock) {
+	static const uint8_t zero_crc[sizeof(superblock->crc32)] = {0};
+
+	uint32_t crc = CRC32_Update(CRC32_INIT, superblock, offsetof(sLogSuperblock_t, crc32));
+
+	return CRC32_Update(crc, zero_crc, sizeof(zero_crc)) ^ CRC32_INIT;
+}
+
+static bool Log_Recovery_IsValidSuperblock (const uint8_t *sector, sLogSuperblock_t *superblock) {
+	memcpy(superblock, sector, sizeof(*superblock));
+
+	if ((superblock->magic != LOG_SUPERBLOCK_MAGIC) || (superblock->version != LOG_SUPERBLOCK_VERSION)) {
+		return false;
+	}
+
+	if ((superblock->data_count == 0) || (superblock->head >= superblock->data_count)) {
+		return false;
+	}
+
+	return Log_Recovery_SuperblockCrc(superblock) == superblock->crc32;
+}
+
+/* True when the sector `distance` places after the checkpoint carries the sequence number it would have been given */
+static bool Log_Recovery_IsWritten (sLogRecoveryScan_t *scan, const sLogPosition_t *checkpoint, uint32_t distance) {
+	sLogSectorHeader_t header;
+	uint32_t index = (uint32_t) (((uint64_t) checkpoint->head + distance) % scan->data_count);
+
+	scan->reads++;
+
+	if (!scan->read_cb(scan->context, index, scan->sector) || !Log_Recovery_IsValidSector(scan->sector, &header)) {
+		return false;
+	}
+
+	return header.sequence == (checkpoint->sequence + distance);
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Log_Recovery_IsValidSector (const uint8_t *sector, sLogSectorHeader_t *header) {
+	if ((sector == NULL) || (header == NULL)) {
+		return false;
+	}
+
+	memcpy(header, sector, sizeof(*header));
+
+	if ((header->magic != LOG_SECTOR_MAGIC) || (header->payload_bytes > LOG_SECTOR_PAYLOAD_SIZE)) {
+		return false;
+	}
+
+	static const uint8_t zero_crc[sizeof(header->crc32)] = {0};
+
+	uint32_t crc = CRC32_Update(CRC32_INIT, sector, offsetof(sLogSectorHeader_t, crc32));
+
+	crc = CRC32_Update(crc, zero_crc, sizeof(zero_crc));
+	crc = CRC32_Update(crc, &sector[LOG_SECTOR_HEADER_SIZE], LOG_SECTOR_PAYLOAD_SIZE) ^ CRC32_INIT;
+
+	return crc == header->crc32;
+}
+
+void Log_Recovery_SealSuperblock (sLogSuperblock_t *superblock) {
+	if (superblock == NULL) {
+		return;
+	}
+
+	superblock->magic = LOG_SUPERBLOCK_MAGIC;
+	superblock->version = LOG_SUPERBLOCK_VERSION;
+	superblock->crc32 = Log_Recovery_SuperblockCrc(superblock);
+}
+
+/* Newest valid copy wins, a torn write only ever damages the copy that was being replaced */
+bool Log_Recovery_PickSuperblock (const uint8_t *copy_a, const uint8_t *copy_b, sLogSuperblock_t *superblock) {
+	sLogSuperblock_t a;
+	sLogSuperblock_t b;
+	bool is_a_valid = (copy_a != NULL) && Log_Recovery_IsValidSuperblock(copy_a, &a);
+	bool is_b_valid = (copy_b != NULL) && Log_Recovery_IsValidSuperblock(copy_b, &b);
+
+	if ((superblock == NULL) || (!is_a_valid && !is_b_valid)) {
+		return false;
+	}
+
+	if (is_a_valid && (!is_b_valid || ((int32_t) (a.generation - b.generation) >= 0))) {
+		*superblock = a;
+	} else {
+		*superblock = b;
+	}
+
+	return true;
+}
+
+/*
+ * Sectors after the checkpoint were written in order with consecutive sequence numbers, so "written since the
+ * checkpoint" holds for a prefix of the ring and fails after it. Binary search finds the end of that prefix in
+ * log2(ring) reads; a short forward probe then steps over sectors whose write was dropped.
+ */
+bool Log_Recovery_FindHead (LogSectorReadCb_t read_cb, void *context, uint32_t data_count, const sLogPosition_t *checkpoint, sLogPosition_t *head, uint32_t *reads) {
+	if ((read_cb == NULL) || (checkpoint == NULL) || (head == NULL) || (data_count == 0) || (checkpoint->head >= data_count)) {
+		return false;
+	}
+
+	static sLogRecoveryScan_t scan;
+
+	scan.read_cb = read_cb;
+	scan.context = context;
+	scan.data_count = data_count;
+	scan.reads = 0;
+
+	/* written(low - 1) is true by definition, written(high) is false */
+	uint32_t low = 0;
+	uint32_t high = data_count;
+
+	while (low < high) {
+		uint32_t middle = low + ((high - low) / 2U);
+
+		if (Log_Recovery_IsWritten(&scan, checkpoint, middle)) {
+			low = middle + 1U;
+		} else {
+			high = middle;
+		}
+	}
+
+	for (uint32_t probe = 1; probe <= LOG_RECOVERY_PROBE_SECTORS; probe++) {
+		uint32_t distance = low + probe;
+
+		if (distance >= data_count) {
+			break;
+		}
+
+		if (Log_Recovery_IsWritten(&scan, checkpoint, distance)) {
+			low = distance + 1U;
+			probe = 0;
+		}
+	}
+
+	head->head = (uint32_t) (((uint64_t) checkpoint->head + low) % data_count);
+	head->sequence = checkpoint->sequence + low;
+
+	if (reads != NULL) {
+		*reads = scan.reads;
+	}
+
+	return true;
+}
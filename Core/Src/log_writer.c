@@ -0,0 +1,325 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "partition.h"
+#include "log_recovery.h"
+#include "sector_cache.h"
+#include "log_writer.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	eSdCard_t card;
+	bool is_ready;
+	uint32_t partition_lba;
+	sLogSuperblock_t superblock;
+	uint32_t first_lba;
+	uint32_t sector_count;
+	uint32_t head;
+	uint32_t sequence;
+	uint32_t fill;
+	uint16_t record_count;
+	uint64_t sector_timestamp_ms;
+	sLogWriterStats_t stats;
+} sLogWriter_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const uint8_t static_log_partition_types[] = {LOG_PARTITION_TYPE};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sLogWriter_t dyn_log = {0};
+static uint8_t dyn_superblock_sector[LOG_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t dyn_superblock_other[LOG_SECTOR_SIZE] __attribute__((aligned(4)));
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static bool Log_Writer_ReadSector (void *context, uint32_t index, uint8_t *sector);
+static bool Log_Writer_WriteSuperblock (void);
+static bool Log_Writer_Format (uint32_t partition_sectors, uint32_t site_id);
+static void Log_Writer_UpdateIndex (void);
+static void Log_Writer_Advance (void);
+static void Log_Writer_Seal (uint8_t *sector);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static bool Log_Writer_ReadSector (void *context, uint32_t index, uint8_t *sector) {
+	(void) context;
+
+	return SD_Card_Driver_ReadBlocks(dyn_log.card, dyn_log.first_lba + index, sector, 1);
+}
+
+/* Generation n goes to copy n % 2, the other copy still holds generation n - 1 if this write is torn */
+static bool Log_Writer_WriteSuperblock (void) {
+	Log_Recovery_SealSuperblock(&dyn_log.superblock);
+
+	memset(dyn_superblock_sector, 0, sizeof(dyn_superblock_sector));
+	memcpy(dyn_superblock_sector, &dyn_log.superblock, sizeof(dyn_log.superblock));
+
+	uint32_t copy = dyn_log.superblock.generation % LOG_SUPERBLOCK_COPIES;
+
+	return SD_Card_Driver_WriteBlocks(dyn_log.card, dyn_log.partition_lba + copy, dyn_superblock_sector, 1);
+}
+
+static bool Log_Writer_Format (uint32_t partition_sectors, uint32_t site_id) {
+	memset(&dyn_log.superblock, 0, sizeof(dyn_log.superblock));
+
+	/* Sized for the whole remainder, which slightly over-provisions the index */
+	uint32_t usable = partition_sectors - LOG_INDEX_FIRST_SECTOR;
+	uint32_t entries = (usable + LOG_INDEX_INTERVAL - 1U) / LOG_INDEX_INTERVAL;
+	uint32_t index_sectors = (entries + LOG_INDEX_ENTRIES_PER_SECTOR - 1U) / LOG_INDEX_ENTRIES_PER_SECTOR;
+
+	if (usable <= index_sectors) {
+		return false;
+	}
+
+	dyn_log.superblock.site_id = site_id;
+	dyn_log.superblock.index_first = LOG_INDEX_FIRST_SECTOR;
+	dyn_log.superblock.index_sectors = index_sectors;
+	dyn_log.superblock.data_first = LOG_INDEX_FIRST_SECTOR + index_sectors;
+	dyn_log.superblock.data_count = usable - index_sectors;
+
+	/* Both copies, so a stale copy from an older layout can never outrank the new one */
+	for (uint32_t copy = 0; copy < LOG_SUPERBLOCK_COPIES; copy++) {
+		dyn_log.superblock.generation = copy;
+
+		if (!Log_Writer_WriteSuperblock()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Index sectors are read-modify-written through the cache, one sector absorbs 42 updates before it moves on */
+static void Log_Writer_UpdateIndex (void) {
+	uint32_t entry = dyn_log.head / LOG_INDEX_INTERVAL;
+	uint32_t lba = dyn_log.partition_lba + dyn_log.superblock.index_first + (entry / LOG_INDEX_ENTRIES_PER_SECTOR);
+	uint8_t *sector = Sector_Cache_Prepare(lba, false);
+
+	if (sector == NULL) {
+		dyn_log.stats.write_errors++;
+		return;
+	}
+
+	sLogIndexEntry_t index_entry = {
+		.timestamp_ms = dyn_log.sector_timestamp_ms,
+		.sequence = dyn_log.sequence
+	};
+	uint32_t crc = 0;
+
+	memcpy(&sector[(entry % LOG_INDEX_ENTRIES_PER_SECTOR) * sizeof(sLogIndexEntry_t)], &index_entry, sizeof(index_entry));
+	memcpy(&sector[offsetof(sLogIndexSector_t, crc32)], &crc, sizeof(crc));
+	crc = CRC32_Compute(sector, LOG_SECTOR_SIZE);
+	memcpy(&sector[offsetof(sLogIndexSector_t, crc32)], &crc, sizeof(crc));
+
+	Sector_Cache_Commit(lba);
+	dyn_log.stats.index_updates++;
+}
+
+/* The finished sector stays in the cache until it is flushed, only the bookkeeping moves on */
+static void Log_Writer_Advance (void) {
+	dyn_log.sequence++;
+	dyn_log.head++;
+
+	if (dyn_log.head >= dyn_log.sector_count) {
+		dyn_log.head = 0;
+	}
+
+	dyn_log.fill = 0;
+	dyn_log.record_count = 0;
+	dyn_log.stats.sectors_written++;
+}
+
+/* Resealed after every record, so whatever the cache flushes is a valid sector; a later flush rewrites it with more records */
+static void Log_Writer_Seal (uint8_t *sector) {
+	sLogSectorHeader_t header = {
+		.magic = LOG_SECTOR_MAGIC,
+		.sequence = dyn_log.sequence,
+		.timestamp_ms = dyn_log.sector_timestamp_ms,
+		.record_count = dyn_log.record_count,
+		.payload_bytes = (uint16_t) dyn_log.fill,
+		.crc32 = 0
+	};
+
+	memcpy(sector, &header, sizeof(header));
+	header.crc32 = CRC32_Compute(sector, LOG_SECTOR_SIZE);
+	memcpy(&sector[offsetof(sLogSectorHeader_t, crc32)], &header.crc32, sizeof(header.crc32));
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Log_Writer_Init (eSdCard_t card, uint32_t site_id) {
+	sPartition_t partition = {0};
+
+	memset(&dyn_log, 0, sizeof(dyn_log));
+	dyn_log.card = card;
+
+	if (!Partition_Find(card, static_log_partition_types, sizeof(static_log_partition_types), &partition)) {
+		return false;
+	}
+
+	if (partition.sector_count <= LOG_INDEX_FIRST_SECTOR) {
+		return false;
+	}
+
+	dyn_log.partition_lba = partition.first_lba;
+
+	if (!SD_Card_Driver_ReadBlocks(card, partition.first_lba, dyn_superblock_sector, 1) || !SD_Card_Driver_ReadBlocks(card, partition.first_lba + 1U, dyn_superblock_other, 1)) {
+		return false;
+	}
+
+	bool is_formatted = Log_Recovery_PickSuperblock(dyn_superblock_sector, dyn_superblock_other, &dyn_log.superblock);
+
+	if (is_formatted && (((uint64_t) dyn_log.superblock.data_first + dyn_log.superblock.data_count) > partition.sector_count)) {
+		is_formatted = false;
+	}
+
+	if (!is_formatted && !Log_Writer_Format(partition.sector_count, site_id)) {
+		return false;
+	}
+
+	dyn_log.first_lba = partition.first_lba + dyn_log.superblock.data_first;
+	dyn_log.sector_count = dyn_log.superblock.data_count;
+
+	sLogPosition_t checkpoint = {
+		.head = dyn_log.superblock.head,
+		.sequence = dyn_log.superblock.sequence
+	};
+	sLogPosition_t head = {0};
+
+	if (!Log_Recovery_FindHead(Log_Writer_ReadSector, NULL, dyn_log.sector_count, &checkpoint, &head, &dyn_log.stats.recovery_reads)) {
+		return false;
+	}
+
+	dyn_log.head = head.head;
+	dyn_log.sequence = head.sequence;
+	dyn_log.is_ready = true;
+
+	return true;
+}
+
+bool Log_Writer_IsReady (void) {
+	return dyn_log.is_ready;
+}
+
+bool Log_Writer_Append (eLogRecord_t type, const void *payload, uint8_t length, uint64_t timestamp_ms) {
+	if (!dyn_log.is_ready || (payload == NULL) || (type < eLogRecord_First) || (type >= eLogRecord_Last)) {
+		return false;
+	}
+
+	/* Payload length is bounded by uint8_t, so any record fits an empty sector */
+	if (length < sizeof(uint32_t)) {
+		return false;
+	}
+
+	if ((dyn_log.fill + LOG_RECORD_HEADER_SIZE + length) > LOG_SECTOR_PAYLOAD_SIZE) {
+		Log_Writer_Advance();
+	}
+
+	/* Offsets are signed 32 bit so late records (batched levels) can point back before the sector timestamp */
+	int64_t offset_ms = (int64_t) (timestamp_ms - dyn_log.sector_timestamp_ms);
+
+	if ((dyn_log.record_count != 0) && ((offset_ms > INT32_MAX) || (offset_ms < INT32_MIN))) {
+		Log_Writer_Advance();
+	}
+
+	uint32_t lba = dyn_log.first_lba + dyn_log.head;
+	uint8_t *sector = Sector_Cache_Prepare(lba, dyn_log.record_count == 0);
+
+	if (sector == NULL) {
+		dyn_log.stats.write_errors++;
+		return false;
+	}
+
+	if (dyn_log.record_count == 0) {
+		memset(sector, 0, LOG_SECTOR_SIZE);
+		dyn_log.sector_timestamp_ms = timestamp_ms;
+	}
+
+	bool is_index_due = (dyn_log.record_count == 0) && ((dyn_log.head % LOG_INDEX_INTERVAL) == 0);
+	uint8_t *record = &sector[LOG_SECTOR_HEADER_SIZE + dyn_log.fill];
+	int32_t time_offset_ms = (int32_t) (timestamp_ms - dyn_log.sector_timestamp_ms);
+
+	record[0] = (uint8_t) type;
+	record[1] = length;
+	memcpy(&record[LOG_RECORD_HEADER_SIZE], payload, length);
+	memcpy(&record[LOG_RECORD_HEADER_SIZE], &time_offset_ms, sizeof(time_offset_ms));
+
+	dyn_log.fill += LOG_RECORD_HEADER_SIZE + length;
+	dyn_log.record_count++;
+	dyn_log.stats.records_written++;
+
+	Log_Writer_Seal(sector);
+
+	if (!Sector_Cache_Commit(lba)) {
+		dyn_log.stats.write_errors++;
+		return false;
+	}
+
+	/* After the commit, the data sector pointer is not valid across another cache call */
+	if (is_index_due) {
+		Log_Writer_UpdateIndex();
+	}
+
+	return true;
+}
+
+/* Barrier: everything appended so far is on the card when this returns true */
+bool Log_Writer_Flush (void) {
+	if (!dyn_log.is_ready) {
+		return false;
+	}
+
+	return Sector_Cache_Barrier();
+}
+
+/* Makes everything appended so far durable, then records the position in the next superblock generation */
+bool Log_Writer_Checkpoint (uint64_t timestamp_ms) {
+	if (!dyn_log.is_ready) {
+		return false;
+	}
+
+	sLogCheckpoint_t checkpoint = {
+		.generation = dyn_log.superblock.generation + 1U,
+		.records_written = dyn_log.stats.records_written + 1U
+	};
+
+	bool is_checkpoint_successful = Log_Writer_Append(eLogRecord_Checkpoint, &checkpoint, sizeof(checkpoint), timestamp_ms);
+
+	if (!Sector_Cache_Barrier()) {
+		return false;
+	}
+
+	dyn_log.superblock.generation++;
+	dyn_log.superblock.head = dyn_log.head;
+	dyn_log.superblock.sequence = dyn_log.sequence;
+	dyn_log.superblock.timestamp_ms = timestamp_ms;
+
+	if (!Log_Writer_WriteSuperblock()) {
+		dyn_log.stats.write_errors++;
+		return false;
+	}
+
+	dyn_log.stats.checkpoints++;
+
+	return is_checkpoint_successful;
+}
+
+bool Log_Writer_GetStats (sLogWriterStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_log.stats;
+
+	return true;
+}
@@ -24,6 +24,27 @@
 #include "gpio_driver.h"
 #include "adc_driver.h"
 #include "spi_driver.h"
+#include "sd_card_driver.h"
+#include "fat32.h"
+#include "audio_stream.h"
+#include "audio_recorder.h"
+#include "sector_cache.h"
+#include "log_writer.h"
+#include "level_codec.h"
+#include "sound_level.h"
+#include "uart_driver.h"
+#include "telemetry.h"
+#include "config_shell.h"
+#include "trace.h"
+#include "scheduler.h"
+#include "irq_map.h"
+#include "deferred_work.h"
+#include "kernel.h"
+#include "power_manager.h"
+#include "clock_manager.h"
+#include "timebase.h"
+#include "wall_clock.h"
+#include "profiler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -33,6 +54,34 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define RECORDER_MAX_FILE_SECONDS	600U
+#define FAT_SYNC_INTERVAL_MS		2000U
+#define FAT_PREALLOC_CLUSTERS		32U
+#define LEVEL_INTERVAL_MS			1000U
+#define LEVEL_CALIBRATION_CDB		12000
+#define LEVEL_EVENT_THRESHOLD_CDB	8500
+#define LEVEL_WEIGHTING				eSoundLevelWeighting_Z
+#define LOG_STATUS_INTERVAL_MS		60000U
+#define LOG_FLUSH_DEADLINE_MS		5000U
+#define LOG_SITE_ID					1U
+#define TELEMETRY_BAUDRATE			921600U
+/* A 256 sample block lasts 5.3 ms at 48 kHz and the DMA overwrites it one block later */
+#define DSP_DEADLINE_MS				5U
+#define STORAGE_PERIOD_MS			10U
+#define TELEMETRY_PERIOD_MS			10U
+/* Event-only units keep the ADC off and sit in STOP until the sound sensor fires */
+#define POWER_MODE					ePowerMode_Continuous
+/* Recording needs full speed for the codec and the SD writes, level logging alone runs at whatever the load allows */
+#define CLOCK_FLOOR_RECORDING		eClockPoint_84MHz
+#define CLOCK_FLOOR_LEVELS			eClockPoint_16MHz
+/* The Nucleo's 8 MHz ST-LINK MCO on PH0, far tighter than the HSI for the sample rate; HSI is the fallback */
+#define CLOCK_SOURCE				eClockSource_Hse
+/* 1 runs the tasks below as threads of the preemptive kernel instead of on the cooperative scheduler */
+#define USE_PREEMPTIVE_KERNEL		0
+#define DSP_STACK_BYTES				2048U
+#define STORAGE_STACK_BYTES			2048U
+#define TELEMETRY_STACK_BYTES		1024U
+#define HOUSEKEEPING_STACK_BYTES	1536U
 
 /* USER CODE END PD */
 
@@ -44,17 +93,516 @@
 /* Private variables ---------------------------------------------------------*/
 
 /* USER CODE BEGIN PV */
+static const sFat32Config_t static_fat_config = {
+	.sync_interval_ms = FAT_SYNC_INTERVAL_MS,
+	.prealloc_clusters = FAT_PREALLOC_CLUSTERS
+};
+
+static const sAudioRecorderConfig_t static_recorder_config = {
+	.max_file_bytes = 0,
+	.max_file_seconds = RECORDER_MAX_FILE_SECONDS,
+	.codec = eAudioRecorderCodec_ImaAdpcm
+};
+
+static const sSectorCacheConfig_t static_cache_config = {
+	.flush_deadline_ms = LOG_FLUSH_DEADLINE_MS
+};
+
+static const sSoundLevelConfig_t static_level_config = {
+	.interval_ms = LEVEL_INTERVAL_MS,
+	.calibration_cdb = LEVEL_CALIBRATION_CDB,
+	.event_threshold_cdb = LEVEL_EVENT_THRESHOLD_CDB,
+	.weighting = LEVEL_WEIGHTING
+};
+
+static const sConfigShellSettings_t static_shell_settings = {
+	.sample_rate = AUDIO_STREAM_DEFAULT_RATE_HZ,
+	.weighting = LEVEL_WEIGHTING,
+	.event_threshold_cdb = LEVEL_EVENT_THRESHOLD_CDB,
+	.calibration_cdb = LEVEL_CALIBRATION_CDB,
+	.interval_ms = LEVEL_INTERVAL_MS,
+	.is_recording = true,
+	.codec = eAudioRecorderCodec_ImaAdpcm
+};
+
+static sLevelPacker_t dyn_level_packer;
+/* Sensor triggers counted in event-only mode, where no level interval picks them up */
+static volatile uint32_t dyn_standby_triggers = 0;
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+static uint64_t dyn_dsp_stack[DSP_STACK_BYTES / sizeof(uint64_t)];
+static uint64_t dyn_storage_stack[STORAGE_STACK_BYTES / sizeof(uint64_t)];
+static uint64_t dyn_telemetry_stack[TELEMETRY_STACK_BYTES / sizeof(uint64_t)];
+static uint64_t dyn_housekeeping_stack[HOUSEKEEPING_STACK_BYTES / sizeof(uint64_t)];
+/* Given per audio block, blocks that arrive while the DSP thread runs are drained by that same run */
+static sKernelSem_t dyn_dsp_sem;
+/* Storage, log, telemetry and wall clock state; the level meter is the DSP thread's own and runs outside it */
+static sKernelMutex_t dyn_pipeline_lock;
+#endif
 
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
+static uint64_t Main_GetUptimeMs (void);
+static uint64_t Main_GetTimeMs (void);
+static uint64_t Main_GetBlockTimeMs (const sAudioBlock_t *block);
+static void Main_OnSensorTrigger (eGpioPin_t pin);
+static void Main_FlushLevels (void);
+static void Main_LogLevels (void);
+static void Main_LogStandbyTriggers (void);
+static void Main_RestoreClocks (void);
+static void Main_ApplySettings (const sConfigShellSettings_t *settings);
+static void Main_PostDsp (void);
+static void Main_Lock (void);
+static void Main_Unlock (void);
+static void Main_DspTask (void);
+static void Main_StorageTask (void);
+static void Main_TelemetryTask (void);
+static void Main_HousekeepingTask (void);
+#if (USE_PREEMPTIVE_KERNEL == 1)
+static void Main_RunPeriodic (SchedulerTaskCb_t task, uint32_t period_ms);
+static void Main_DspThread (void);
+static void Main_StorageThread (void);
+static void Main_TelemetryThread (void);
+static void Main_HousekeepingThread (void);
+#endif
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/* Here rather than with the other private variables, the task functions have to be declared first */
+static const sSchedulerTaskInit_t static_task_lut[eSchedulerTask_Last] = {
+	[eSchedulerTask_Dsp] = {
+		.task = eSchedulerTask_Dsp,
+		.callback = Main_DspTask,
+		.period_ms = 0,
+		.deadline_ms = DSP_DEADLINE_MS
+	},
+	[eSchedulerTask_Storage] = {
+		.task = eSchedulerTask_Storage,
+		.callback = Main_StorageTask,
+		.period_ms = STORAGE_PERIOD_MS,
+		.deadline_ms = STORAGE_PERIOD_MS
+	},
+	[eSchedulerTask_Telemetry] = {
+		.task = eSchedulerTask_Telemetry,
+		.callback = Main_TelemetryTask,
+		.period_ms = TELEMETRY_PERIOD_MS,
+		.deadline_ms = TELEMETRY_PERIOD_MS
+	},
+	[eSchedulerTask_Housekeeping] = {
+		.task = eSchedulerTask_Housekeeping,
+		.callback = Main_HousekeepingTask,
+		.period_ms = LOG_STATUS_INTERVAL_MS,
+		.deadline_ms = 0
+	}
+};
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+static const sKernelThreadInit_t static_thread_lut[] = {
+	{.thread = eKernelThread_Dsp, .entry = Main_DspThread, .stack = dyn_dsp_stack, .stack_bytes = sizeof(dyn_dsp_stack)},
+	{.thread = eKernelThread_Storage, .entry = Main_StorageThread, .stack = dyn_storage_stack, .stack_bytes = sizeof(dyn_storage_stack)},
+	{.thread = eKernelThread_Telemetry, .entry = Main_TelemetryThread, .stack = dyn_telemetry_stack, .stack_bytes = sizeof(dyn_telemetry_stack)},
+	{.thread = eKernelThread_Housekeeping, .entry = Main_HousekeepingThread, .stack = dyn_housekeeping_stack, .stack_bytes = sizeof(dyn_housekeeping_stack)}
+};
+#endif
+
+static uint64_t Main_GetUptimeMs (void) {
+	return Timebase_GetTicks() / (TIMEBASE_TICK_HZ / 1000U);
+}
+
+/* Log and telemetry timestamps: UTC from the RTC, the uptime where it does not run */
+static uint64_t Main_GetTimeMs (void) {
+	uint64_t time_ms = 0;
+
+	Wall_Clock_GetTime(&time_ms);
+
+	return time_ms;
+}
+
+/* Level timestamps: the block's trigger capture on the wall clock, so intervals follow the RTC and not the ADC clock */
+static uint64_t Main_GetBlockTimeMs (const sAudioBlock_t *block) {
+	uint64_t time_ms = 0;
+
+	if (!Wall_Clock_TicksToTime(block->timestamp, &time_ms)) {
+		time_ms = block->timestamp / (TIMEBASE_TICK_HZ / 1000U);
+	}
+
+	return time_ms;
+}
+
+static void Main_OnSensorTrigger (eGpioPin_t pin) {
+	(void) pin;
+
+	if (Power_Manager_GetMode() != ePowerMode_EventOnly) {
+		Sound_Level_OnSensorTrigger();
+
+		return;
+	}
+
+	Deferred_Work_Add(&dyn_standby_triggers, 1);
+	Main_PostDsp();
+}
+
+static void Main_FlushLevels (void) {
+	uint64_t timestamp_ms = 0;
+	size_t length = Level_Packer_Finish(&dyn_level_packer, &timestamp_ms);
+
+	if (length != 0) {
+		Log_Writer_Append(eLogRecord_Levels, dyn_level_packer.record, (uint8_t) length, timestamp_ms);
+	}
+
+	/* Interval boundary: make the finished run durable instead of waiting for the cache deadline */
+	Log_Writer_Flush();
+}
+
+static void Main_LogLevels (void) {
+	sSoundLevelInterval_t interval = {0};
+	sSoundLevelEvent_t event = {0};
+
+	if (!Sound_Level_GetInterval(&interval)) {
+		return;
+	}
+
+	uint64_t end_ms = interval.end_ms;
+	int16_t levels_ddb[LEVEL_CODEC_FIXED_COLUMNS] = {
+		Level_Codec_CdbToDdb(interval.leq_cdb),
+		Level_Codec_CdbToDdb(interval.lmax_cdb),
+		Level_Codec_CdbToDdb(interval.lmin_cdb)
+	};
+
+	if (!Level_Packer_Append(&dyn_level_packer, levels_ddb, end_ms - interval.duration_ms, interval.duration_ms)) {
+		Main_FlushLevels();
+		Level_Packer_Append(&dyn_level_packer, levels_ddb, end_ms - interval.duration_ms, interval.duration_ms);
+	}
+
+	sTelemetryLevels_t live_levels = {
+		.end_ms = (uint32_t) end_ms,
+		.duration_ms = (uint16_t) interval.duration_ms,
+		.leq_ddb = levels_ddb[0],
+		.lmax_ddb = levels_ddb[1],
+		.lmin_ddb = levels_ddb[2]
+	};
+
+	Telemetry_SendLevels(&live_levels);
+
+	if (interval.sensor_triggers > 0) {
+		sLogEvent_t trigger = {
+			.duration_ms = interval.duration_ms,
+			.kind = eLogEvent_SensorTrigger,
+			.count = (interval.sensor_triggers > UINT8_MAX) ? UINT8_MAX : (uint8_t) interval.sensor_triggers
+		};
+
+		Log_Writer_Append(eLogRecord_Event, &trigger, sizeof(trigger), end_ms - interval.duration_ms);
+
+		sTelemetryEvent_t live_trigger = {
+			.start_ms = (uint32_t) (end_ms - interval.duration_ms),
+			.duration_ms = trigger.duration_ms,
+			.kind = trigger.kind,
+			.count = trigger.count
+		};
+
+		Telemetry_SendEvent(&live_trigger);
+	}
+
+	while (Sound_Level_GetEvent(&event)) {
+		sLogEvent_t threshold = {
+			.duration_ms = event.duration_ms,
+			.peak_cdb = event.peak_cdb,
+			.kind = eLogEvent_Threshold,
+			.count = 1
+		};
+
+		Log_Writer_Append(eLogRecord_Event, &threshold, sizeof(threshold), event.start_ms);
+
+		sTelemetryEvent_t live_threshold = {
+			.start_ms = (uint32_t) event.start_ms,
+			.duration_ms = event.duration_ms,
+			.peak_ddb = Level_Codec_CdbToDdb(event.peak_cdb),
+			.kind = threshold.kind,
+			.count = threshold.count
+		};
+
+		Telemetry_SendEvent(&live_threshold);
+	}
+}
+
+/* Logged and flushed right away, the core goes back to STOP as soon as the loop idles */
+static void Main_LogStandbyTriggers (void) {
+	uint32_t triggers = Deferred_Work_Take(&dyn_standby_triggers);
+
+	if (triggers == 0) {
+		return;
+	}
+
+	uint64_t trigger_ticks = 0;
+
+	/* Stamped with the latest edge as the timer captured it, not with when the log got to it */
+	GPIO_Driver_GetIrqTicks(eGpioPin_SoundSensorDigital, &trigger_ticks);
+
+	uint64_t trigger_ms = trigger_ticks / (TIMEBASE_TICK_HZ / 1000U);
+
+	Wall_Clock_TicksToTime(trigger_ticks, &trigger_ms);
+
+	sLogEvent_t trigger = {
+		.duration_ms = 0,
+		.kind = eLogEvent_SensorTrigger,
+		.count = (triggers > UINT8_MAX) ? UINT8_MAX : (uint8_t) triggers
+	};
+
+	Log_Writer_Append(eLogRecord_Event, &trigger, sizeof(trigger), trigger_ms);
+	Log_Writer_Flush();
+
+	sTelemetryEvent_t live_trigger = {
+		.start_ms = (uint32_t) trigger_ms,
+		.duration_ms = trigger.duration_ms,
+		.kind = trigger.kind,
+		.count = trigger.count
+	};
+
+	Telemetry_SendEvent(&live_trigger);
+}
+
+/* STOP wakes on HSI; SystemClock_Config brings the PLL back, the clock manager then returns to its operating point */
+static void Main_RestoreClocks (void) {
+	SystemClock_Config();
+	Clock_Manager_Resync();
+}
+
+static void Main_ApplySettings (const sConfigShellSettings_t *settings) {
+	sSoundLevelConfig_t level_config = {
+		.interval_ms = settings->interval_ms,
+		.calibration_cdb = settings->calibration_cdb,
+		.event_threshold_cdb = settings->event_threshold_cdb,
+		.weighting = settings->weighting
+	};
+
+	/* A changed interval length is split off by the level packer, which only holds equal intervals */
+	Sound_Level_SetConfig(&level_config);
+
+	Clock_Manager_SetFloor(settings->is_recording ? CLOCK_FLOOR_RECORDING : CLOCK_FLOOR_LEVELS);
+
+	if (!settings->is_recording) {
+		Audio_Recorder_Stop();
+	} else {
+		Audio_Recorder_SetCodec(settings->codec);
+		Audio_Recorder_Start();
+	}
+
+	uint32_t sample_rate = Audio_Stream_GetSampleRate();
+
+	if (settings->sample_rate == sample_rate) {
+		return;
+	}
+
+	/* The recorder starts a new file on its next block, the level meter redesigns its filters */
+	Audio_Stream_Stop();
+
+	if (!Audio_Stream_Start(settings->sample_rate)) {
+		Audio_Stream_Start(sample_rate);
+	}
+
+	/* Block deadlines scale with the rate, the profile restarts to cover a single one */
+	PROFILER_RESET();
+}
+
+static void Main_PostDsp (void) {
+#if (USE_PREEMPTIVE_KERNEL == 1)
+	Kernel_SemGive(&dyn_dsp_sem);
+#else
+	Scheduler_Post(eSchedulerTask_Dsp);
+#endif
+}
+
+/* Cooperative tasks never interleave, only the kernel threads need the lock */
+static void Main_Lock (void) {
+#if (USE_PREEMPTIVE_KERNEL == 1)
+	Kernel_MutexLock(&dyn_pipeline_lock, KERNEL_WAIT_FOREVER);
+#endif
+}
+
+static void Main_Unlock (void) {
+#if (USE_PREEMPTIVE_KERNEL == 1)
+	Kernel_MutexUnlock(&dyn_pipeline_lock);
+#endif
+}
+
+/* Settings change only here, between two blocks, so every block is measured and recorded under one configuration */
+static void Main_DspTask (void) {
+	PROFILER_BEGIN(eProfilerProbe_DspTask);
+
+	sAudioBlock_t block = {0};
+	sConfigShellSettings_t settings = {0};
+
+	Main_Lock();
+
+	if (Config_Shell_TakePending(&settings)) {
+		Main_ApplySettings(&settings);
+	}
+
+	Main_LogStandbyTriggers();
+	Main_Unlock();
+
+	while (Audio_Stream_GetBlock(&block)) {
+		PROFILER_BEGIN(eProfilerProbe_DspBlock);
+
+		/* The filters run unlocked, so a storage or housekeeping run only holds up the recorder and the logs */
+		Main_Lock();
+		PROFILER_BEGIN(eProfilerProbe_RecorderBlock);
+
+		Audio_Recorder_WriteBlock(&block);
+
+		PROFILER_END(eProfilerProbe_RecorderBlock);
+
+		uint64_t block_time_ms = Main_GetBlockTimeMs(&block);
+
+		Main_Unlock();
+		PROFILER_BEGIN(eProfilerProbe_LevelFilters);
+
+		bool is_interval_done = Sound_Level_ProcessBlock(&block, Audio_Stream_GetSampleRate(), block_time_ms);
+
+		PROFILER_END(eProfilerProbe_LevelFilters);
+
+		if (is_interval_done) {
+			Main_Lock();
+			Main_LogLevels();
+			Main_Unlock();
+		}
+
+		Audio_Stream_ReleaseBlock();
+
+		PROFILER_END(eProfilerProbe_DspBlock);
+	}
+
+	PROFILER_END(eProfilerProbe_DspTask);
+}
+
+static void Main_StorageTask (void) {
+	PROFILER_BEGIN(eProfilerProbe_StorageTask);
+
+	Audio_Recorder_Process();
+	FAT32_Process();
+	Sector_Cache_Process();
+
+	PROFILER_END(eProfilerProbe_StorageTask);
+}
+
+static void Main_TelemetryTask (void) {
+	PROFILER_BEGIN(eProfilerProbe_TelemetryTask);
+
+	Config_Shell_Process();
+	Wall_Clock_Process();
+	Trace_Process();
+	Clock_Manager_Process();
+
+	PROFILER_END(eProfilerProbe_TelemetryTask);
+}
+
+/* Status record and checkpoint; the level run is flushed first so the checkpoint covers it */
+static void Main_HousekeepingTask (void) {
+	PROFILER_BEGIN(eProfilerProbe_HousekeepingTask);
+
+	Main_FlushLevels();
+
+	sAudioRecorderStats_t recorder_stats = {0};
+	sLogWriterStats_t log_stats = {0};
+	sSectorCacheStats_t cache_stats = {0};
+
+	Audio_Recorder_GetStats(&recorder_stats);
+	Log_Writer_GetStats(&log_stats);
+	Sector_Cache_GetStats(&cache_stats);
+
+	uint64_t now_ms = Main_GetTimeMs();
+	sLogStatus_t status = {
+		.uptime_s = (uint32_t) (Main_GetUptimeMs() / 1000U),
+		.audio_overruns = Audio_Stream_GetOverrunCount(),
+		.storage_errors = recorder_stats.write_errors + log_stats.write_errors + cache_stats.write_errors,
+		.sectors_written = log_stats.sectors_written
+	};
+
+	Log_Writer_Append(eLogRecord_Status, &status, sizeof(status), now_ms);
+
+	sTelemetryStatus_t live_status = {
+		.uptime_s = status.uptime_s,
+		.audio_overruns = status.audio_overruns,
+		.storage_errors = status.storage_errors,
+		.sectors_written = status.sectors_written
+	};
+
+	Telemetry_SendStatus(&live_status);
+	Log_Writer_Checkpoint(now_ms);
+
+	for (eIrqSource_t source = eIrqSource_First; source < eIrqSource_Last; source++) {
+		sIrqStats_t irq_stats = {0};
+
+		IRQ_Map_GetStats(source, &irq_stats);
+		TRACE3("irq %u worst %u cycles, %u over budget", source, irq_stats.max_cycles, irq_stats.over_budget);
+	}
+
+	sClockStats_t clock_stats = {0};
+
+	Clock_Manager_GetStats(&clock_stats);
+	TRACE2("audio %u overruns, %u blocks untimed", Audio_Stream_GetOverrunCount(), Audio_Stream_GetUntimedCount());
+	TRACE3("clock %u Hz, %u %% busy, %u switches", Clock_Manager_GetFrequency(Clock_Manager_GetPoint()), clock_stats.busy_percent, clock_stats.switches);
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+	for (eKernelThread_t thread = eKernelThread_First; thread < eKernelThread_Last; thread++) {
+		sKernelThreadStats_t thread_stats = {0};
+
+		Kernel_GetStats(thread, &thread_stats);
+		TRACE3("thread %u: %u switches, %u stack bytes never used", thread, thread_stats.switches, thread_stats.stack_free_bytes);
+	}
+#endif
+
+#if PROFILER_ENABLED
+	/* Everything on the sample path has to fit into one block period at the current rate and clock */
+	uint32_t sample_rate = Audio_Stream_GetSampleRate();
+	uint32_t block_cycles = 0;
+
+	if (sample_rate != 0U) {
+		block_cycles = (uint32_t) (((uint64_t) Clock_Manager_GetFrequency(Clock_Manager_GetPoint()) * AUDIO_STREAM_BLOCK_SAMPLES) / sample_rate);
+	}
+
+	PROFILER_DUMP(block_cycles);
+#endif
+	PROFILER_END(eProfilerProbe_HousekeepingTask);
+}
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+/* The pipeline modules are not reentrant, a thread holds the lock for one task body and blocks freely outside it */
+static void Main_RunPeriodic (SchedulerTaskCb_t task, uint32_t period_ms) {
+	uint32_t wake_tick = HAL_GetTick();
+
+	while (1) {
+		Main_Lock();
+		task();
+		Main_Unlock();
+		Kernel_DelayUntil(&wake_tick, period_ms);
+	}
+}
+
+static void Main_DspThread (void) {
+	while (1) {
+		Kernel_SemTake(&dyn_dsp_sem, KERNEL_WAIT_FOREVER);
+		Main_DspTask();
+	}
+}
+
+static void Main_StorageThread (void) {
+	Main_RunPeriodic(Main_StorageTask, STORAGE_PERIOD_MS);
+}
+
+static void Main_TelemetryThread (void) {
+	Main_RunPeriodic(Main_TelemetryTask, TELEMETRY_PERIOD_MS);
+}
+
+static void Main_HousekeepingThread (void) {
+	Main_RunPeriodic(Main_HousekeepingTask, LOG_STATUS_INTERVAL_MS);
+}
+#endif
 
 /* USER CODE END 0 */
 
@@ -75,7 +623,10 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
-
+  /* First, so the clock and wall clock fallbacks are traced; records wait in the ring until telemetry drains them */
+  if (Trace_Init() != 1) {
+	  Error_Handler();
+  }
   /* USER CODE END Init */
 
   /* Configure the system clock */
@@ -92,10 +643,45 @@ int main(void)
 //  MX_ADC1_Init();
 //  MX_SPI2_Init();
   /* USER CODE BEGIN 2 */
+  if (IRQ_Map_Init() != 1) {
+	  Error_Handler();
+  }
+
+  if (Deferred_Work_Init() != 1) {
+	  Error_Handler();
+  }
+
+  if ((Power_Manager_Init(Main_RestoreClocks) != 1) || (Power_Manager_SetMode(POWER_MODE) != 1)) {
+	  Error_Handler();
+  }
+
+  if (Clock_Manager_Init(CLOCK_SOURCE) != 1) {
+	  Error_Handler();
+  }
+
+  if (Timebase_Init() != 1) {
+	  Error_Handler();
+  }
+
+  /* Without the LSE crystal the logger still runs, its timestamps stay on the uptime */
+  Wall_Clock_Init();
+
   if (GPIO_Driver_Init() != 1) {
 	  Error_Handler();
   }
 
+  if (UART_Driver_Init(eUart_Debug, TELEMETRY_BAUDRATE) != 1) {
+	  Error_Handler();
+  }
+
+  if (Telemetry_Init(eUart_Debug) != 1) {
+	  Error_Handler();
+  }
+
+  if (Config_Shell_Init(&static_shell_settings) != 1) {
+	  Error_Handler();
+  }
+
   if (ADC_Driver_Init(eAdc_1) != 1) {
 	  Error_Handler();
   }
@@ -104,12 +690,92 @@ int main(void)
 	  Error_Handler();
   }
 
+  if (SD_Card_Driver_Init(eSdCard_Main) != 1) {
+	  Error_Handler();
+  }
+
+  /* Without a FAT32 volume the recorder falls back to a raw audio partition or a blank card, or stays off */
+  FAT32_Mount(eSdCard_Main, &static_fat_config);
+
+  if (Audio_Recorder_Init(eSdCard_Main, &static_recorder_config, NULL) != 1) {
+	  Error_Handler();
+  }
+
+  if (Sector_Cache_Init(eSdCard_Main, &static_cache_config) != 1) {
+	  Error_Handler();
+  }
+
+  /* Level logging is optional, cards without a log partition only record audio */
+  Log_Writer_Init(eSdCard_Main, LOG_SITE_ID);
+
+  if (Sound_Level_Init(&static_level_config) != 1) {
+	  Error_Handler();
+  }
+
+  if (Level_Packer_Init(&dyn_level_packer, LEVEL_CODEC_FIXED_COLUMNS, 0) != 1) {
+	  Error_Handler();
+  }
+
+  if (GPIO_Driver_SetIrqCallback(eGpioPin_SoundSensorDigital, Main_OnSensorTrigger) != 1) {
+	  Error_Handler();
+  }
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+  if (Kernel_Init() != 1) {
+	  Error_Handler();
+  }
+
+  if ((Kernel_SemInit(&dyn_dsp_sem, 0, 1) != 1) || (Kernel_MutexInit(&dyn_pipeline_lock) != 1)) {
+	  Error_Handler();
+  }
+
+  for (size_t i = 0; i < (sizeof(static_thread_lut) / sizeof(static_thread_lut[0])); i++) {
+	  if (Kernel_InitThread(&static_thread_lut[i]) != 1) {
+		  Error_Handler();
+	  }
+  }
+#else
+  if (Scheduler_Init() != 1) {
+	  Error_Handler();
+  }
+
+  for (eSchedulerTask_t task = eSchedulerTask_First; task < eSchedulerTask_Last; task++) {
+	  if (Scheduler_InitTask(&static_task_lut[task]) != 1) {
+		  Error_Handler();
+	  }
+  }
+#endif
+
+  if (Audio_Stream_SetBlockCallback(Main_PostDsp) != 1) {
+	  Error_Handler();
+  }
+
+  if (Clock_Manager_SetFloor(static_shell_settings.is_recording ? CLOCK_FLOOR_RECORDING : CLOCK_FLOOR_LEVELS) != 1) {
+	  Error_Handler();
+  }
+
+  if (POWER_MODE != ePowerMode_EventOnly) {
+	  if (Audio_Stream_Start(static_shell_settings.sample_rate) != 1) {
+		  Error_Handler();
+	  }
+
+	  Audio_Recorder_Start();
+  }
+
+#if (USE_PREEMPTIVE_KERNEL == 1)
+  /* Only comes back if the kernel could not start, the loop below is the cooperative build's */
+  Kernel_Start();
+  Error_Handler();
+#endif
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   while (1)
   {
+	  /* DSP on every audio block, then storage, telemetry and housekeeping on their SysTick periods */
+	  Scheduler_Run();
 //	  ADC_Driver_ReadChannels(eAdc_1);
 //	  HAL_Delay(100);
 //	  ADC_Driver_GetChannelValue(eAdcChannel_1, &value);
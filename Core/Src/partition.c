@@ -0,0 +1,89 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "partition.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define PARTITION_TABLE_OFFSET	446U
+#define PARTITION_ENTRY_SIZE	16U
+#define PARTITION_ENTRY_COUNT	4U
+#define PARTITION_SIGNATURE_AT	510U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static uint8_t dyn_mbr[SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint32_t Partition_Get32 (const uint8_t *src);
+static bool Partition_ReadMbr (eSdCard_t card, bool *is_signed);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint32_t Partition_Get32 (const uint8_t *src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+static bool Partition_ReadMbr (eSdCard_t card, bool *is_signed) {
+	if (!SD_Card_Driver_ReadBlocks(card, 0, dyn_mbr, 1)) {
+		return false;
+	}
+
+	*is_signed = (dyn_mbr[PARTITION_SIGNATURE_AT] == 0x55U) && (dyn_mbr[PARTITION_SIGNATURE_AT + 1U] == 0xAAU);
+
+	return true;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Partition_Find (eSdCard_t card, const uint8_t *types, uint8_t type_count, sPartition_t *partition) {
+	if ((types == NULL) || (partition == NULL)) {
+		return false;
+	}
+
+	bool is_signed = false;
+
+	if (!Partition_ReadMbr(card, &is_signed) || !is_signed) {
+		return false;
+	}
+
+	for (uint32_t entry = 0; entry < PARTITION_ENTRY_COUNT; entry++) {
+		const uint8_t *raw = &dyn_mbr[PARTITION_TABLE_OFFSET + (entry * PARTITION_ENTRY_SIZE)];
+
+		for (uint8_t i = 0; i < type_count; i++) {
+			if (raw[4] != types[i]) {
+				continue;
+			}
+
+			partition->type = raw[4];
+			partition->first_lba = Partition_Get32(&raw[8]);
+			partition->sector_count = Partition_Get32(&raw[12]);
+
+			return partition->sector_count != 0;
+		}
+	}
+
+	return false;
+}
+
+bool Partition_IsBlank (eSdCard_t card, bool *is_blank) {
+	bool is_signed = false;
+
+	if ((is_blank == NULL) || !Partition_ReadMbr(card, &is_signed)) {
+		return false;
+	}
+
+	*is_blank = !is_signed;
+
+	return true;
+}
@@ -0,0 +1,147 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "irq_map.h"
+#include "timebase.h"
+#include "power_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	ePowerMode_t mode;
+	PowerRestoreClocksCb_t restore_clocks;
+	/* Bit N set while hold N is taken */
+	volatile uint32_t holds;
+	sPowerStats_t stats;
+} sPowerManager_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sPowerManager_t dyn_power = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Power_Manager_Init (PowerRestoreClocksCb_t restore_clocks) {
+	if (restore_clocks == NULL) {
+		return false;
+	}
+
+	uint32_t holds = dyn_power.holds;
+
+	/* Drivers may already hold the clocks, their holds are kept */
+	memset(&dyn_power, 0, sizeof(dyn_power));
+	dyn_power.mode = ePowerMode_Continuous;
+	dyn_power.restore_clocks = restore_clocks;
+	dyn_power.holds = holds;
+
+	/* The flash is idle while the core is stopped, powering it down costs only a few microseconds on wake */
+	HAL_PWREx_EnableFlashPowerDown();
+
+#ifdef DEBUG
+	/* Keeps the debug port alive, at the price of the power saving */
+	DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP | DBGMCU_CR_DBG_STOP;
+#endif
+
+	return true;
+}
+
+bool Power_Manager_SetMode (ePowerMode_t mode) {
+	if ((ePowerMode_Last <= mode) || (ePowerMode_First > mode)) {
+		return false;
+	}
+
+	dyn_power.mode = mode;
+
+	return true;
+}
+
+ePowerMode_t Power_Manager_GetMode (void) {
+	return dyn_power.mode;
+}
+
+void Power_Manager_Hold (ePowerHold_t hold, bool is_held) {
+	if ((ePowerHold_Last <= hold) || (ePowerHold_First > hold)) {
+		return;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	if (is_held) {
+		dyn_power.holds |= (1UL << hold);
+	} else {
+		dyn_power.holds &= ~(1UL << hold);
+	}
+
+	__set_PRIMASK(primask);
+}
+
+bool Power_Manager_IsHeld (ePowerHold_t hold) {
+	if ((ePowerHold_Last <= hold) || (ePowerHold_First > hold)) {
+		return false;
+	}
+
+	return (dyn_power.holds & (1UL << hold)) != 0;
+}
+
+/* WFI wakes on a pending interrupt even with PRIMASK set, the handler runs once the caller unmasks */
+void Power_Manager_Idle (void) {
+	if ((dyn_power.mode == ePowerMode_EventOnly) && (dyn_power.holds == 0) && (dyn_power.restore_clocks != NULL)) {
+		dyn_power.stats.stops++;
+		HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+		/*
+		 * Back on HSI with the PLL off; the tick did not advance while stopped. The oscillator waits time out on
+		 * SysTick, so the restore runs unmasked, with PendSV held off until the clocks are back.
+		 */
+		uint32_t basepri = __get_BASEPRI();
+
+		__set_BASEPRI(IRQ_Map_GetPriority(eIrqSource_PendSV) << (8U - __NVIC_PRIO_BITS));
+		__enable_irq();
+		dyn_power.restore_clocks();
+		__disable_irq();
+		__set_BASEPRI(basepri);
+
+		return;
+	}
+
+	/* The cycle counter stops with the core clock, the timebase keeps counting through sleep */
+	uint32_t enter_ticks = Timebase_GetTicks32();
+
+	dyn_power.stats.sleeps++;
+	__DSB();
+	__WFI();
+
+	/* Still masked, so the handler that ends the sleep is not counted as idle */
+	dyn_power.stats.idle_us += Timebase_GetTicks32() - enter_ticks;
+}
+
+bool Power_Manager_GetStats (sPowerStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_power.stats;
+
+	return true;
+}
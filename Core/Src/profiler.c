@@ -0,0 +1,100 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "trace.h"
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sProfilerStats_t dyn_profiler_stats_lut[eProfilerProbe_Last] = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+void Profiler_Record (eProfilerProbe_t probe, uint32_t cycles) {
+	if ((eProfilerProbe_Last <= probe) || (eProfilerProbe_First > probe)) {
+		return;
+	}
+
+	sProfilerStats_t *stats = &dyn_profiler_stats_lut[probe];
+
+	/* Single writer per probe, so no masking on the hot path; readers take a masked copy */
+	if ((stats->count == 0U) || (cycles < stats->min_cycles)) {
+		stats->min_cycles = cycles;
+	}
+
+	if (cycles > stats->max_cycles) {
+		stats->max_cycles = cycles;
+	}
+
+	stats->total_cycles += cycles;
+	stats->count++;
+}
+
+void Profiler_Reset (void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	memset(dyn_profiler_stats_lut, 0, sizeof(dyn_profiler_stats_lut));
+
+	__set_PRIMASK(primask);
+}
+
+bool Profiler_GetStats (eProfilerProbe_t probe, sProfilerStats_t *stats) {
+	if ((eProfilerProbe_Last <= probe) || (eProfilerProbe_First > probe) || (stats == NULL)) {
+		return false;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	*stats = dyn_profiler_stats_lut[probe];
+
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+void Profiler_Dump (uint32_t deadline_cycles) {
+	TRACE1("profile against a deadline of %u cycles", deadline_cycles);
+
+	for (eProfilerProbe_t probe = eProfilerProbe_First; probe < eProfilerProbe_Last; probe++) {
+		sProfilerStats_t stats = {0};
+
+		Profiler_GetStats(probe, &stats);
+
+		if (stats.count == 0U) {
+			continue;
+		}
+
+		uint32_t avg_cycles = (uint32_t) (stats.total_cycles / stats.count);
+		uint32_t deadline_percent = (deadline_cycles == 0U) ? 0U : (uint32_t) (((uint64_t) stats.max_cycles * 100U) / deadline_cycles);
+
+		TRACE4("profile %u: %u calls, %u min, %u avg cycles", probe, stats.count, stats.min_cycles, avg_cycles);
+		TRACE3("profile %u: %u max cycles, %u %% of deadline", probe, stats.max_cycles, deadline_percent);
+	}
+}
+#endif
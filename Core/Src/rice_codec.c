@@ -0,0 +1,325 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <string.h>
+#include "rice_codec.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define RICE_CODEC_FLAG_VERBATIM	0x80U
+#define RICE_CODEC_ORDER_MASK		0x03U
+#define RICE_CODEC_MAX_PARAMETER	15U
+
+/* Unary runs stop at the escape length, the value then follows as raw bits so no sample costs more than 36 bits */
+#define RICE_CODEC_ESCAPE_LENGTH	16U
+#define RICE_CODEC_ESCAPE_BITS		20U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	uint8_t *data;
+	size_t capacity;
+	size_t position;
+	uint32_t accumulator;
+	uint32_t bits;
+	bool is_overflow;
+} sRiceWriter_t;
+
+typedef struct {
+	const uint8_t *data;
+	size_t length;
+	size_t position;
+	uint32_t accumulator;
+	uint32_t bits;
+	bool is_underflow;
+} sRiceReader_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static int32_t Rice_Codec_Predict (const int16_t *pcm, uint32_t index, uint32_t order);
+static uint32_t Rice_Codec_ZigZag (int32_t value);
+static int32_t Rice_Codec_UnZigZag (uint32_t value);
+static uint32_t Rice_Codec_ChooseOrder (const int16_t *pcm, uint32_t sample_count);
+static uint32_t Rice_Codec_ChooseParameter (uint64_t sum, uint32_t count);
+static void Rice_Codec_PutBits (sRiceWriter_t *writer, uint32_t value, uint32_t bits);
+static void Rice_Codec_FlushBits (sRiceWriter_t *writer);
+static uint32_t Rice_Codec_GetBits (sRiceReader_t *reader, uint32_t bits);
+static size_t Rice_Codec_EncodeVerbatim (const int16_t *pcm, uint32_t sample_count, uint8_t *frame);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+/* FLAC fixed predictors, polynomial fits of order 0 to 3 over the previous samples */
+static inline int32_t Rice_Codec_Predict (const int16_t *pcm, uint32_t index, uint32_t order) {
+	switch (order) {
+		case 1:
+			return pcm[index - 1U];
+		case 2:
+			return (2 * pcm[index - 1U]) - pcm[index - 2U];
+		case 3:
+			return (3 * pcm[index - 1U]) - (3 * pcm[index - 2U]) + pcm[index - 3U];
+		default:
+			return 0;
+	}
+}
+
+static inline uint32_t Rice_Codec_ZigZag (int32_t value) {
+	return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static inline int32_t Rice_Codec_UnZigZag (uint32_t value) {
+	return (int32_t) (value >> 1) ^ -(int32_t) (value & 1U);
+}
+
+/* All four residual orders in one pass, the same estimate FLAC uses for its fixed subframes */
+static uint32_t Rice_Codec_ChooseOrder (const int16_t *pcm, uint32_t sample_count) {
+	uint64_t error[RICE_CODEC_MAX_ORDER + 1U] = {0};
+
+	if (sample_count <= RICE_CODEC_MAX_ORDER) {
+		return 0;
+	}
+
+	for (uint32_t i = RICE_CODEC_MAX_ORDER; i < sample_count; i++) {
+		int32_t e0 = pcm[i];
+		int32_t e1 = e0 - pcm[i - 1U];
+		int32_t e2 = e1 - (pcm[i - 1U] - pcm[i - 2U]);
+		int32_t e3 = e2 - ((pcm[i - 1U] - pcm[i - 2U]) - (pcm[i - 2U] - pcm[i - 3U]));
+
+		error[0] += (uint32_t) ((e0 < 0) ? -e0 : e0);
+		error[1] += (uint32_t) ((e1 < 0) ? -e1 : e1);
+		error[2] += (uint32_t) ((e2 < 0) ? -e2 : e2);
+		error[3] += (uint32_t) ((e3 < 0) ? -e3 : e3);
+	}
+
+	uint32_t order = 0;
+
+	for (uint32_t i = 1; i <= RICE_CODEC_MAX_ORDER; i++) {
+		if (error[i] < error[order]) {
+			order = i;
+		}
+	}
+
+	return order;
+}
+
+static uint32_t Rice_Codec_ChooseParameter (uint64_t sum, uint32_t count) {
+	uint32_t parameter = 0;
+
+	while ((parameter < RICE_CODEC_MAX_PARAMETER) && (((uint64_t) count << (parameter + 1U)) <= sum)) {
+		parameter++;
+	}
+
+	return parameter;
+}
+
+static void Rice_Codec_PutBits (sRiceWriter_t *writer, uint32_t value, uint32_t bits) {
+	writer->accumulator = (writer->accumulator << bits) | (value & ((1UL << bits) - 1U));
+	writer->bits += bits;
+
+	while (writer->bits >= 8U) {
+		writer->bits -= 8U;
+
+		if (writer->position >= writer->capacity) {
+			writer->is_overflow = true;
+			return;
+		}
+
+		writer->data[writer->position++] = (uint8_t) (writer->accumulator >> writer->bits);
+	}
+}
+
+static void Rice_Codec_FlushBits (sRiceWriter_t *writer) {
+	if (writer->bits != 0U) {
+		Rice_Codec_PutBits(writer, 0, 8U - writer->bits);
+	}
+}
+
+static uint32_t Rice_Codec_GetBits (sRiceReader_t *reader, uint32_t bits) {
+	while (reader->bits < bits) {
+		if (reader->position >= reader->length) {
+			reader->is_underflow = true;
+			return 0;
+		}
+
+		reader->accumulator = (reader->accumulator << 8) | reader->data[reader->position++];
+		reader->bits += 8U;
+	}
+
+	reader->bits -= bits;
+
+	return (reader->accumulator >> reader->bits) & ((1UL << bits) - 1U);
+}
+
+static size_t Rice_Codec_EncodeVerbatim (const int16_t *pcm, uint32_t sample_count, uint8_t *frame) {
+	uint32_t payload = sample_count * sizeof(int16_t);
+
+	frame[1] = RICE_CODEC_FLAG_VERBATIM;
+	frame[4] = (uint8_t) payload;
+	frame[5] = (uint8_t) (payload >> 8);
+	frame[6] = 0;
+	frame[7] = 0;
+
+	for (uint32_t i = 0; i < sample_count; i++) {
+		frame[RICE_CODEC_FRAME_HEADER_SIZE + (i * 2U)] = (uint8_t) pcm[i];
+		frame[RICE_CODEC_FRAME_HEADER_SIZE + (i * 2U) + 1U] = (uint8_t) ((uint16_t) pcm[i] >> 8);
+	}
+
+	return RICE_CODEC_FRAME_HEADER_SIZE + payload;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+/* Returns the frame length, never more than RICE_CODEC_MAX_FRAME_BYTES(sample_count), or 0 on bad arguments */
+size_t Rice_Codec_EncodeFrame (const int16_t *pcm, uint32_t sample_count, uint8_t *frame, size_t capacity) {
+	if ((pcm == NULL) || (frame == NULL) || (sample_count == 0) || (sample_count > RICE_CODEC_MAX_FRAME_SAMPLES) || (capacity < RICE_CODEC_MAX_FRAME_BYTES(sample_count))) {
+		return 0;
+	}
+
+	uint32_t order = Rice_Codec_ChooseOrder(pcm, sample_count);
+	uint32_t parameters[RICE_CODEC_PARTITIONS] = {0};
+
+	frame[0] = RICE_CODEC_FRAME_SYNC;
+	frame[1] = (uint8_t) order;
+	frame[2] = (uint8_t) sample_count;
+	frame[3] = (uint8_t) (sample_count >> 8);
+
+	for (uint32_t p = 0; p < RICE_CODEC_PARTITIONS; p++) {
+		uint32_t start = (p * sample_count) / RICE_CODEC_PARTITIONS;
+		uint32_t end = ((p + 1U) * sample_count) / RICE_CODEC_PARTITIONS;
+		uint64_t sum = 0;
+
+		start = (start < order) ? order : start;
+
+		for (uint32_t i = start; i < end; i++) {
+			sum += Rice_Codec_ZigZag(pcm[i] - Rice_Codec_Predict(pcm, i, order));
+		}
+
+		parameters[p] = (end > start) ? Rice_Codec_ChooseParameter(sum, end - start) : 0;
+	}
+
+	frame[6] = (uint8_t) (parameters[0] | (parameters[1] << 4));
+	frame[7] = (uint8_t) (parameters[2] | (parameters[3] << 4));
+
+	/* Capped at the verbatim size so a frame that does not compress costs nothing extra */
+	sRiceWriter_t writer = {
+		.data = &frame[RICE_CODEC_FRAME_HEADER_SIZE],
+		.capacity = sample_count * sizeof(int16_t),
+	};
+
+	for (uint32_t i = 0; i < order; i++) {
+		Rice_Codec_PutBits(&writer, (uint16_t) pcm[i], 16U);
+	}
+
+	for (uint32_t p = 0; (p < RICE_CODEC_PARTITIONS) && !writer.is_overflow; p++) {
+		uint32_t start = (p * sample_count) / RICE_CODEC_PARTITIONS;
+		uint32_t end = ((p + 1U) * sample_count) / RICE_CODEC_PARTITIONS;
+		uint32_t parameter = parameters[p];
+
+		start = (start < order) ? order : start;
+
+		for (uint32_t i = start; (i < end) && !writer.is_overflow; i++) {
+			uint32_t value = Rice_Codec_ZigZag(pcm[i] - Rice_Codec_Predict(pcm, i, order));
+			uint32_t quotient = value >> parameter;
+
+			if (quotient < RICE_CODEC_ESCAPE_LENGTH) {
+				/* quotient ones, a terminating zero, then the low bits */
+				Rice_Codec_PutBits(&writer, ((1UL << quotient) - 1U) << 1, quotient + 1U);
+				Rice_Codec_PutBits(&writer, value, parameter);
+			} else {
+				Rice_Codec_PutBits(&writer, (1UL << RICE_CODEC_ESCAPE_LENGTH) - 1U, RICE_CODEC_ESCAPE_LENGTH);
+				Rice_Codec_PutBits(&writer, value, RICE_CODEC_ESCAPE_BITS);
+			}
+		}
+	}
+
+	Rice_Codec_FlushBits(&writer);
+
+	if (writer.is_overflow || (writer.position >= writer.capacity)) {
+		return Rice_Codec_EncodeVerbatim(pcm, sample_count, frame);
+	}
+
+	frame[4] = (uint8_t) writer.position;
+	frame[5] = (uint8_t) (writer.position >> 8);
+
+	return RICE_CODEC_FRAME_HEADER_SIZE + writer.position;
+}
+
+/* Returns the number of bytes consumed, or 0 if the frame is damaged or truncated */
+size_t Rice_Codec_DecodeFrame (const uint8_t *frame, size_t length, int16_t *pcm, uint32_t capacity, uint32_t *sample_count) {
+	if ((frame == NULL) || (pcm == NULL) || (sample_count == NULL) || (length < RICE_CODEC_FRAME_HEADER_SIZE) || (frame[0] != RICE_CODEC_FRAME_SYNC)) {
+		return 0;
+	}
+
+	uint32_t count = (uint32_t) frame[2] | ((uint32_t) frame[3] << 8);
+	size_t payload = (size_t) frame[4] | ((size_t) frame[5] << 8);
+	uint32_t order = frame[1] & RICE_CODEC_ORDER_MASK;
+
+	if ((count == 0) || (count > capacity) || ((RICE_CODEC_FRAME_HEADER_SIZE + payload) > length)) {
+		return 0;
+	}
+
+	const uint8_t *data = &frame[RICE_CODEC_FRAME_HEADER_SIZE];
+
+	if (frame[1] & RICE_CODEC_FLAG_VERBATIM) {
+		if (payload != (count * sizeof(int16_t))) {
+			return 0;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			pcm[i] = (int16_t) ((uint16_t) data[i * 2U] | ((uint16_t) data[(i * 2U) + 1U] << 8));
+		}
+
+		*sample_count = count;
+
+		return RICE_CODEC_FRAME_HEADER_SIZE + payload;
+	}
+
+	uint32_t parameters[RICE_CODEC_PARTITIONS] = {frame[6] & 0x0FU, frame[6] >> 4, frame[7] & 0x0FU, frame[7] >> 4};
+	sRiceReader_t reader = {
+		.data = data,
+		.length = payload,
+	};
+
+	for (uint32_t i = 0; (i < order) && (i < count); i++) {
+		pcm[i] = (int16_t) Rice_Codec_GetBits(&reader, 16U);
+	}
+
+	for (uint32_t p = 0; (p < RICE_CODEC_PARTITIONS) && !reader.is_underflow; p++) {
+		uint32_t start = (p * count) / RICE_CODEC_PARTITIONS;
+		uint32_t end = ((p + 1U) * count) / RICE_CODEC_PARTITIONS;
+
+		start = (start < order) ? order : start;
+
+		for (uint32_t i = start; (i < end) && !reader.is_underflow; i++) {
+			uint32_t quotient = 0;
+			uint32_t value = 0;
+
+			while ((quotient < RICE_CODEC_ESCAPE_LENGTH) && (Rice_Codec_GetBits(&reader, 1U) == 1U)) {
+				quotient++;
+			}
+
+			if (quotient == RICE_CODEC_ESCAPE_LENGTH) {
+				value = Rice_Codec_GetBits(&reader, RICE_CODEC_ESCAPE_BITS);
+			} else {
+				value = (quotient << parameters[p]) | Rice_Codec_GetBits(&reader, parameters[p]);
+			}
+
+			pcm[i] = (int16_t) (Rice_Codec_UnZigZag(value) + Rice_Codec_Predict(pcm, i, order));
+		}
+	}
+
+	if (reader.is_underflow) {
+		return 0;
+	}
+
+	*sample_count = count;
+
+	return RICE_CODEC_FRAME_HEADER_SIZE + payload;
+}
@@ -0,0 +1,173 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "power_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	SchedulerTaskCb_t callback;
+	uint32_t period_ms;
+	uint32_t deadline_ms;
+	uint32_t countdown_ms;
+	/* Tick of the first post since the last run */
+	uint32_t posted_tick;
+	sSchedulerStats_t stats;
+} sSchedulerTask_t;
+
+typedef struct {
+	bool is_init;
+	/* Bit N set while task N waits to run */
+	volatile uint32_t pending;
+	sSchedulerTask_t tasks[eSchedulerTask_Last];
+} sScheduler_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sScheduler_t dyn_scheduler = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static void Scheduler_Dispatch (eSchedulerTask_t task, uint32_t posted_tick);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static void Scheduler_Dispatch (eSchedulerTask_t task, uint32_t posted_tick) {
+	sSchedulerTask_t *entry = &dyn_scheduler.tasks[task];
+	uint32_t latency_ms = HAL_GetTick() - posted_tick;
+
+	if (latency_ms > entry->stats.max_latency_ms) {
+		entry->stats.max_latency_ms = latency_ms;
+	}
+
+	if ((entry->deadline_ms != 0) && (latency_ms > entry->deadline_ms)) {
+		entry->stats.deadline_misses++;
+		TRACE2("deadline miss: task %u waited %u ms", task, latency_ms);
+	}
+
+	entry->stats.runs++;
+	entry->callback();
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Scheduler_Init (void) {
+	memset(&dyn_scheduler, 0, sizeof(dyn_scheduler));
+	dyn_scheduler.is_init = true;
+
+	return true;
+}
+
+bool Scheduler_InitTask (const sSchedulerTaskInit_t *init) {
+	if ((init == NULL) || (init->callback == NULL) || !dyn_scheduler.is_init) {
+		return false;
+	}
+
+	if ((eSchedulerTask_Last <= init->task) || (eSchedulerTask_First > init->task)) {
+		return false;
+	}
+
+	sSchedulerTask_t *entry = &dyn_scheduler.tasks[init->task];
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	memset(entry, 0, sizeof(*entry));
+	entry->callback = init->callback;
+	entry->period_ms = init->period_ms;
+	entry->deadline_ms = init->deadline_ms;
+	entry->countdown_ms = init->period_ms;
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+bool Scheduler_Post (eSchedulerTask_t task) {
+	if ((eSchedulerTask_Last <= task) || (eSchedulerTask_First > task)) {
+		return false;
+	}
+
+	sSchedulerTask_t *entry = &dyn_scheduler.tasks[task];
+	uint32_t mask = 1UL << task;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	if ((dyn_scheduler.pending & mask) != 0) {
+		entry->stats.coalesced++;
+	} else {
+		entry->posted_tick = HAL_GetTick();
+		dyn_scheduler.pending |= mask;
+	}
+
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+void Scheduler_OnTick (void) {
+	for (eSchedulerTask_t task = eSchedulerTask_First; task < eSchedulerTask_Last; task++) {
+		sSchedulerTask_t *entry = &dyn_scheduler.tasks[task];
+
+		if ((entry->period_ms == 0) || (--entry->countdown_ms != 0)) {
+			continue;
+		}
+
+		entry->countdown_ms = entry->period_ms;
+		Scheduler_Post(task);
+	}
+}
+
+void Scheduler_Run (void) {
+	while (1) {
+		uint32_t pending = dyn_scheduler.pending;
+
+		if (pending == 0) {
+			/* Masked so a post between the check and the sleep still wakes the core, its handler runs on unmask */
+			__disable_irq();
+
+			if (dyn_scheduler.pending == 0) {
+				Power_Manager_Idle();
+			}
+
+			__enable_irq();
+
+			continue;
+		}
+
+		/* Lowest set bit is the highest priority; rescanned after every run so a late DSP post still goes first */
+		eSchedulerTask_t task = (eSchedulerTask_t) __CLZ(__RBIT(pending));
+		uint32_t primask = __get_PRIMASK();
+
+		__disable_irq();
+		dyn_scheduler.pending &= ~(1UL << task);
+		uint32_t posted_tick = dyn_scheduler.tasks[task].posted_tick;
+		__set_PRIMASK(primask);
+
+		if (dyn_scheduler.tasks[task].callback != NULL) {
+			Scheduler_Dispatch(task, posted_tick);
+		}
+	}
+}
+
+bool Scheduler_GetStats (eSchedulerTask_t task, sSchedulerStats_t *stats) {
+	if ((eSchedulerTask_Last <= task) || (eSchedulerTask_First > task) || (stats == NULL)) {
+		return false;
+	}
+
+	*stats = dyn_scheduler.tasks[task].stats;
+
+	return true;
+}
@@ -0,0 +1,496 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx_hal.h"
+#include "spi_driver.h"
+#include "sd_card_driver.h"
+#include "kernel.h"
+#include "power_manager.h"
+#include "trace.h"
+#include "profiler.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define SD_CMD_GO_IDLE_STATE			0
+#define SD_CMD_SEND_IF_COND				8
+#define SD_CMD_SEND_CSD					9
+#define SD_CMD_STOP_TRANSMISSION		12
+#define SD_CMD_SET_BLOCKLEN				16
+#define SD_CMD_READ_SINGLE_BLOCK		17
+#define SD_CMD_READ_MULTIPLE_BLOCK		18
+#define SD_CMD_WRITE_BLOCK				24
+#define SD_CMD_WRITE_MULTIPLE_BLOCK		25
+#define SD_CMD_APP_CMD					55
+#define SD_CMD_READ_OCR					58
+#define SD_ACMD_SET_WR_BLK_ERASE_COUNT	23
+#define SD_ACMD_SD_SEND_OP_COND			41
+
+#define SD_R1_IDLE						0x01U
+#define SD_R1_ILLEGAL_COMMAND			0x04U
+#define SD_TOKEN_START_BLOCK			0xFEU
+#define SD_TOKEN_START_MULTI_WRITE		0xFCU
+#define SD_TOKEN_STOP_MULTI_WRITE		0xFDU
+#define SD_DATA_RESPONSE_MASK			0x1FU
+#define SD_DATA_RESPONSE_ACCEPTED		0x05U
+#define SD_OCR_CCS						0x40000000UL
+
+#define SD_INIT_TIMEOUT_MS				1000U
+#define SD_READ_TIMEOUT_MS				200U
+#define SD_WRITE_TIMEOUT_MS				500U
+/* Busy for longer than this, the polls are spaced a tick apart */
+#define SD_SPIN_MS						1U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	eSpi_t spi;
+	uint32_t init_frequency_hz;
+	uint32_t run_frequency_hz;
+} sSdCardDesc_t;
+
+typedef struct {
+	bool is_ready;
+	bool is_block_addressed;
+	uint32_t sector_count;
+	bool is_stream_open;
+	uint32_t stream_next_lba;
+} sSdCardDynamic_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const sSdCardDesc_t static_sd_card_lut[eSdCard_Last] = {
+	[eSdCard_Main] = {
+		.spi = eSpi_SdCardReader,
+		.init_frequency_hz = 400000,
+		.run_frequency_hz = 25000000
+	}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sSdCardDynamic_t dyn_sd_card_lut[eSdCard_Last] = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint8_t SD_Card_Driver_Exchange (eSdCard_t card);
+static void SD_Card_Driver_Backoff (uint32_t start);
+static bool SD_Card_Driver_WaitReady (eSdCard_t card, uint32_t timeout_ms);
+static uint8_t SD_Card_Driver_Command (eSdCard_t card, uint8_t command, uint32_t argument);
+static uint8_t SD_Card_Driver_AppCommand (eSdCard_t card, uint8_t command, uint32_t argument);
+static bool SD_Card_Driver_ReceiveData (eSdCard_t card, uint8_t *buffer, uint32_t byte_count);
+static bool SD_Card_Driver_SendData (eSdCard_t card, uint8_t token, const uint8_t *buffer);
+static bool SD_Card_Driver_ReadCapacity (eSdCard_t card);
+static uint32_t SD_Card_Driver_Address (eSdCard_t card, uint32_t lba);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint8_t SD_Card_Driver_Exchange (eSdCard_t card) {
+	uint8_t value = 0xFF;
+
+	SPI_Driver_Read(static_sd_card_lut[card].spi, &value, 1);
+
+	return value;
+}
+
+/* Under the kernel a long busy card sleeps the calling thread between polls, Kernel_Delay returns at once otherwise */
+static void SD_Card_Driver_Backoff (uint32_t start) {
+	if ((HAL_GetTick() - start) > SD_SPIN_MS) {
+		Power_Manager_Hold(ePowerHold_SdBusy, true);
+		Kernel_Delay(1);
+		Power_Manager_Hold(ePowerHold_SdBusy, false);
+	}
+}
+
+static bool SD_Card_Driver_WaitReady (eSdCard_t card, uint32_t timeout_ms) {
+	uint32_t start = HAL_GetTick();
+
+	while (SD_Card_Driver_Exchange(card) != 0xFF) {
+		if ((HAL_GetTick() - start) > timeout_ms) {
+			return false;
+		}
+
+		SD_Card_Driver_Backoff(start);
+	}
+
+	return true;
+}
+
+static uint8_t SD_Card_Driver_Command (eSdCard_t card, uint8_t command, uint32_t argument) {
+	uint8_t frame[6] = {
+		0x40U | command,
+		(uint8_t) (argument >> 24),
+		(uint8_t) (argument >> 16),
+		(uint8_t) (argument >> 8),
+		(uint8_t) argument,
+		0x01U
+	};
+
+	/* CRC is only checked for CMD0 and CMD8 while the card is still in native mode */
+	if (command == SD_CMD_GO_IDLE_STATE) {
+		frame[5] = 0x95U;
+	} else if (command == SD_CMD_SEND_IF_COND) {
+		frame[5] = 0x87U;
+	}
+
+	if ((command != SD_CMD_GO_IDLE_STATE) && !SD_Card_Driver_WaitReady(card, SD_WRITE_TIMEOUT_MS)) {
+		return 0xFF;
+	}
+
+	SPI_Driver_Write(static_sd_card_lut[card].spi, frame, sizeof(frame));
+
+	if (command == SD_CMD_STOP_TRANSMISSION) {
+		SD_Card_Driver_Exchange(card);
+	}
+
+	uint8_t response = 0xFF;
+
+	for (uint8_t retry = 0; (retry < 10) && ((response & 0x80U) != 0); retry++) {
+		response = SD_Card_Driver_Exchange(card);
+	}
+
+	return response;
+}
+
+static uint8_t SD_Card_Driver_AppCommand (eSdCard_t card, uint8_t command, uint32_t argument) {
+	uint8_t response = SD_Card_Driver_Command(card, SD_CMD_APP_CMD, 0);
+
+	if (response > SD_R1_IDLE) {
+		return response;
+	}
+
+	return SD_Card_Driver_Command(card, command, argument);
+}
+
+static bool SD_Card_Driver_ReceiveData (eSdCard_t card, uint8_t *buffer, uint32_t byte_count) {
+	uint32_t start = HAL_GetTick();
+	uint8_t token = 0xFF;
+
+	do {
+		token = SD_Card_Driver_Exchange(card);
+
+		if ((HAL_GetTick() - start) > SD_READ_TIMEOUT_MS) {
+			return false;
+		}
+
+		if (token == 0xFF) {
+			SD_Card_Driver_Backoff(start);
+		}
+	} while (token == 0xFF);
+
+	if (token != SD_TOKEN_START_BLOCK) {
+		return false;
+	}
+
+	SPI_Driver_Read(static_sd_card_lut[card].spi, buffer, byte_count);
+
+	/* CRC16 is not checked in SPI mode */
+	SD_Card_Driver_Exchange(card);
+	SD_Card_Driver_Exchange(card);
+
+	return true;
+}
+
+static bool SD_Card_Driver_SendData (eSdCard_t card, uint8_t token, const uint8_t *buffer) {
+	uint8_t crc[2] = {0xFF, 0xFF};
+
+	PROFILER_BEGIN(eProfilerProbe_SdWrite);
+
+	bool is_accepted = SD_Card_Driver_WaitReady(card, SD_WRITE_TIMEOUT_MS);
+
+	if (is_accepted) {
+		SPI_Driver_Write(static_sd_card_lut[card].spi, &token, 1);
+		SPI_Driver_Write(static_sd_card_lut[card].spi, (uint8_t *) buffer, SD_CARD_SECTOR_SIZE);
+		SPI_Driver_Write(static_sd_card_lut[card].spi, crc, sizeof(crc));
+
+		is_accepted = (SD_Card_Driver_Exchange(card) & SD_DATA_RESPONSE_MASK) == SD_DATA_RESPONSE_ACCEPTED;
+	}
+
+	PROFILER_END(eProfilerProbe_SdWrite);
+
+	return is_accepted;
+}
+
+static bool SD_Card_Driver_ReadCapacity (eSdCard_t card) {
+	uint8_t csd[16] = {0};
+
+	if (SD_Card_Driver_Command(card, SD_CMD_SEND_CSD, 0) != 0) {
+		return false;
+	}
+
+	if (!SD_Card_Driver_ReceiveData(card, csd, sizeof(csd))) {
+		return false;
+	}
+
+	if ((csd[0] >> 6) == 1) {
+		uint32_t c_size = ((uint32_t) (csd[7] & 0x3FU) << 16) | ((uint32_t) csd[8] << 8) | csd[9];
+		dyn_sd_card_lut[card].sector_count = (c_size + 1) << 10;
+	} else {
+		uint32_t read_bl_len = csd[5] & 0x0FU;
+		uint32_t c_size = ((uint32_t) (csd[6] & 0x03U) << 10) | ((uint32_t) csd[7] << 2) | (csd[8] >> 6);
+		uint32_t c_size_mult = ((csd[9] & 0x03U) << 1) | (csd[10] >> 7);
+		dyn_sd_card_lut[card].sector_count = (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+	}
+
+	return true;
+}
+
+static uint32_t SD_Card_Driver_Address (eSdCard_t card, uint32_t lba) {
+	return dyn_sd_card_lut[card].is_block_addressed ? lba : (lba * SD_CARD_SECTOR_SIZE);
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool SD_Card_Driver_Init (eSdCard_t card) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card)) {
+		return false;
+	}
+
+	eSpi_t spi = static_sd_card_lut[card].spi;
+	uint8_t response[4] = {0};
+	bool is_v2 = false;
+
+	dyn_sd_card_lut[card].is_ready = false;
+	dyn_sd_card_lut[card].is_stream_open = false;
+
+	SPI_Driver_SetBaudrate(spi, static_sd_card_lut[card].init_frequency_hz);
+	SPI_Driver_Deselect(spi);
+
+	/* At least 74 clocks with CS high to enter native mode */
+	for (uint8_t i = 0; i < 10; i++) {
+		SD_Card_Driver_Exchange(card);
+	}
+
+	SPI_Driver_Select(spi);
+
+	bool is_init_successful = false;
+
+	do {
+		if (SD_Card_Driver_Command(card, SD_CMD_GO_IDLE_STATE, 0) != SD_R1_IDLE) {
+			break;
+		}
+
+		if (SD_Card_Driver_Command(card, SD_CMD_SEND_IF_COND, 0x1AAU) == SD_R1_IDLE) {
+			SPI_Driver_Read(spi, response, sizeof(response));
+
+			if ((response[2] != 0x01U) || (response[3] != 0xAAU)) {
+				break;
+			}
+
+			is_v2 = true;
+		}
+
+		uint32_t start = HAL_GetTick();
+		uint8_t r1 = SD_R1_IDLE;
+
+		while (r1 == SD_R1_IDLE) {
+			r1 = SD_Card_Driver_AppCommand(card, SD_ACMD_SD_SEND_OP_COND, is_v2 ? 0x40000000UL : 0);
+
+			if ((HAL_GetTick() - start) > SD_INIT_TIMEOUT_MS) {
+				break;
+			}
+		}
+
+		if (r1 != 0) {
+			break;
+		}
+
+		dyn_sd_card_lut[card].is_block_addressed = false;
+
+		if (is_v2) {
+			if (SD_Card_Driver_Command(card, SD_CMD_READ_OCR, 0) != 0) {
+				break;
+			}
+
+			SPI_Driver_Read(spi, response, sizeof(response));
+
+			uint32_t ocr = ((uint32_t) response[0] << 24) | ((uint32_t) response[1] << 16) | ((uint32_t) response[2] << 8) | response[3];
+			dyn_sd_card_lut[card].is_block_addressed = (ocr & SD_OCR_CCS) != 0;
+		}
+
+		if (!dyn_sd_card_lut[card].is_block_addressed && (SD_Card_Driver_Command(card, SD_CMD_SET_BLOCKLEN, SD_CARD_SECTOR_SIZE) != 0)) {
+			break;
+		}
+
+		SPI_Driver_SetBaudrate(spi, static_sd_card_lut[card].run_frequency_hz);
+
+		is_init_successful = SD_Card_Driver_ReadCapacity(card);
+	} while (0);
+
+	SPI_Driver_Deselect(spi);
+	SD_Card_Driver_Exchange(card);
+
+	dyn_sd_card_lut[card].is_ready = is_init_successful;
+
+	return is_init_successful;
+}
+
+bool SD_Card_Driver_IsReady (eSdCard_t card) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card)) {
+		return false;
+	}
+
+	return dyn_sd_card_lut[card].is_ready;
+}
+
+uint32_t SD_Card_Driver_GetSectorCount (eSdCard_t card) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card)) {
+		return 0;
+	}
+
+	return dyn_sd_card_lut[card].sector_count;
+}
+
+bool SD_Card_Driver_ReadBlocks (eSdCard_t card, uint32_t lba, uint8_t *buffer, uint32_t sector_count) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card) || (buffer == NULL) || !dyn_sd_card_lut[card].is_ready) {
+		return false;
+	}
+
+	if (dyn_sd_card_lut[card].is_stream_open && !SD_Card_Driver_StreamClose(card)) {
+		return false;
+	}
+
+	eSpi_t spi = static_sd_card_lut[card].spi;
+	bool is_multi = sector_count > 1;
+	bool is_read_successful = true;
+
+	SPI_Driver_Select(spi);
+
+	if (SD_Card_Driver_Command(card, is_multi ? SD_CMD_READ_MULTIPLE_BLOCK : SD_CMD_READ_SINGLE_BLOCK, SD_Card_Driver_Address(card, lba)) != 0) {
+		is_read_successful = false;
+	}
+
+	for (uint32_t i = 0; is_read_successful && (i < sector_count); i++) {
+		is_read_successful = SD_Card_Driver_ReceiveData(card, &buffer[i * SD_CARD_SECTOR_SIZE], SD_CARD_SECTOR_SIZE);
+	}
+
+	if (is_multi) {
+		SD_Card_Driver_Command(card, SD_CMD_STOP_TRANSMISSION, 0);
+	}
+
+	SPI_Driver_Deselect(spi);
+	SD_Card_Driver_Exchange(card);
+
+	return is_read_successful;
+}
+
+bool SD_Card_Driver_WriteBlocks (eSdCard_t card, uint32_t lba, const uint8_t *buffer, uint32_t sector_count) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card) || (buffer == NULL) || !dyn_sd_card_lut[card].is_ready) {
+		return false;
+	}
+
+	if (sector_count > 1) {
+		return SD_Card_Driver_StreamOpen(card, lba, sector_count) && SD_Card_Driver_StreamWrite(card, buffer, sector_count) && SD_Card_Driver_StreamClose(card);
+	}
+
+	if (dyn_sd_card_lut[card].is_stream_open && !SD_Card_Driver_StreamClose(card)) {
+		return false;
+	}
+
+	eSpi_t spi = static_sd_card_lut[card].spi;
+	bool is_write_successful = false;
+
+	SPI_Driver_Select(spi);
+
+	if (SD_Card_Driver_Command(card, SD_CMD_WRITE_BLOCK, SD_Card_Driver_Address(card, lba)) == 0) {
+		is_write_successful = SD_Card_Driver_SendData(card, SD_TOKEN_START_BLOCK, buffer) && SD_Card_Driver_WaitReady(card, SD_WRITE_TIMEOUT_MS);
+	}
+
+	SPI_Driver_Deselect(spi);
+	SD_Card_Driver_Exchange(card);
+
+	return is_write_successful;
+}
+
+bool SD_Card_Driver_StreamOpen (eSdCard_t card, uint32_t lba, uint32_t pre_erase_count) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card) || !dyn_sd_card_lut[card].is_ready) {
+		return false;
+	}
+
+	if (dyn_sd_card_lut[card].is_stream_open) {
+		if (dyn_sd_card_lut[card].stream_next_lba == lba) {
+			return true;
+		}
+
+		if (!SD_Card_Driver_StreamClose(card)) {
+			return false;
+		}
+	}
+
+	eSpi_t spi = static_sd_card_lut[card].spi;
+
+	SPI_Driver_Select(spi);
+
+	/* Pre-erase hint lets the card prepare the whole extent instead of erasing per block */
+	if (pre_erase_count > 1) {
+		SD_Card_Driver_AppCommand(card, SD_ACMD_SET_WR_BLK_ERASE_COUNT, pre_erase_count & 0x007FFFFFUL);
+	}
+
+	if (SD_Card_Driver_Command(card, SD_CMD_WRITE_MULTIPLE_BLOCK, SD_Card_Driver_Address(card, lba)) != 0) {
+		SPI_Driver_Deselect(spi);
+		SD_Card_Driver_Exchange(card);
+		return false;
+	}
+
+	dyn_sd_card_lut[card].is_stream_open = true;
+	dyn_sd_card_lut[card].stream_next_lba = lba;
+	TRACE2("sd stream open at lba %u, pre-erase %u", lba, pre_erase_count);
+
+	return true;
+}
+
+bool SD_Card_Driver_StreamWrite (eSdCard_t card, const uint8_t *buffer, uint32_t sector_count) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card) || (buffer == NULL) || !dyn_sd_card_lut[card].is_stream_open) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < sector_count; i++) {
+		if (!SD_Card_Driver_SendData(card, SD_TOKEN_START_MULTI_WRITE, &buffer[i * SD_CARD_SECTOR_SIZE])) {
+			TRACE1("sd stream write failed at lba %u", dyn_sd_card_lut[card].stream_next_lba);
+			SD_Card_Driver_StreamClose(card);
+			return false;
+		}
+
+		dyn_sd_card_lut[card].stream_next_lba++;
+	}
+
+	return true;
+}
+
+bool SD_Card_Driver_StreamClose (eSdCard_t card) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card)) {
+		return false;
+	}
+
+	if (!dyn_sd_card_lut[card].is_stream_open) {
+		return true;
+	}
+
+	eSpi_t spi = static_sd_card_lut[card].spi;
+	uint8_t token = SD_TOKEN_STOP_MULTI_WRITE;
+	bool is_close_successful = SD_Card_Driver_WaitReady(card, SD_WRITE_TIMEOUT_MS);
+
+	SPI_Driver_Write(spi, &token, 1);
+	SD_Card_Driver_Exchange(card);
+	is_close_successful = SD_Card_Driver_WaitReady(card, SD_WRITE_TIMEOUT_MS) && is_close_successful;
+
+	SPI_Driver_Deselect(spi);
+	SD_Card_Driver_Exchange(card);
+
+	dyn_sd_card_lut[card].is_stream_open = false;
+	TRACE2("sd stream close at lba %u: ok %u", dyn_sd_card_lut[card].stream_next_lba, is_close_successful);
+
+	return is_close_successful;
+}
+
+bool SD_Card_Driver_IsStreamOpen (eSdCard_t card, uint32_t *next_lba) {
+	if ((eSdCard_Last <= card) || (eSdCard_First > card)) {
+		return false;
+	}
+
+	if (next_lba != NULL) {
+		*next_lba = dyn_sd_card_lut[card].stream_next_lba;
+	}
+
+	return dyn_sd_card_lut[card].is_stream_open;
+}
@@ -0,0 +1,316 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "sector_cache.h"
+#include "trace.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define SECTOR_CACHE_INVALID_LBA	0xFFFFFFFFUL
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef enum {
+	eSectorCacheFlush_First = 0,
+	eSectorCacheFlush_Deadline = eSectorCacheFlush_First,
+	eSectorCacheFlush_Full,
+	eSectorCacheFlush_Barrier,
+	eSectorCacheFlush_Last
+} eSectorCacheFlush_t;
+
+typedef struct {
+	uint32_t lba;
+	bool is_dirty;
+	uint32_t last_use;
+} sSectorCacheSlot_t;
+
+typedef struct {
+	eSdCard_t card;
+	bool is_ready;
+	sSectorCacheConfig_t config;
+	uint32_t use_counter;
+	uint32_t dirty_count;
+	uint32_t oldest_dirty_tick;
+	sSectorCacheSlot_t slots[SECTOR_CACHE_SLOTS];
+	sSectorCacheStats_t stats;
+} sSectorCache_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sSectorCache_t dyn_cache = {0};
+static uint8_t dyn_cache_data[SECTOR_CACHE_SLOTS][SD_CARD_SECTOR_SIZE] __attribute__((aligned(4)));
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static int32_t Sector_Cache_Find (uint32_t lba);
+static void Sector_Cache_Record (uint32_t run_length);
+static bool Sector_Cache_Flush (eSectorCacheFlush_t reason);
+static int32_t Sector_Cache_Evict (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static int32_t Sector_Cache_Find (uint32_t lba) {
+	for (uint32_t i = 0; i < SECTOR_CACHE_SLOTS; i++) {
+		if (dyn_cache.slots[i].lba == lba) {
+			return (int32_t) i;
+		}
+	}
+
+	return -1;
+}
+
+static void Sector_Cache_Record (uint32_t run_length) {
+	uint32_t bin = 0;
+
+	while (((1UL << bin) < run_length) && (bin < (SECTOR_CACHE_HISTOGRAM_BINS - 1U))) {
+		bin++;
+	}
+
+	dyn_cache.stats.flush_histogram[bin]++;
+	dyn_cache.stats.sectors_flushed += run_length;
+}
+
+/* Dirty slots are written in LBA order, each run of adjacent sectors as one multi-block command */
+static bool Sector_Cache_Flush (eSectorCacheFlush_t reason) {
+	if (dyn_cache.dirty_count == 0) {
+		return true;
+	}
+
+	bool is_flush_successful = true;
+
+	switch (reason) {
+		case eSectorCacheFlush_Deadline: {
+			dyn_cache.stats.deadline_flushes++;
+			break;
+		}
+		case eSectorCacheFlush_Full: {
+			dyn_cache.stats.full_flushes++;
+			break;
+		}
+		default: {
+			dyn_cache.stats.barrier_flushes++;
+			break;
+		}
+	}
+
+	while (dyn_cache.dirty_count > 0) {
+		int32_t first = -1;
+
+		for (uint32_t i = 0; i < SECTOR_CACHE_SLOTS; i++) {
+			if (dyn_cache.slots[i].is_dirty && ((first < 0) || (dyn_cache.slots[i].lba < dyn_cache.slots[first].lba))) {
+				first = (int32_t) i;
+			}
+		}
+
+		uint32_t run_lba = dyn_cache.slots[first].lba;
+		uint32_t run_length = 1;
+
+		while (true) {
+			int32_t next = Sector_Cache_Find(run_lba + run_length);
+
+			if ((next < 0) || !dyn_cache.slots[next].is_dirty) {
+				break;
+			}
+
+			run_length++;
+		}
+
+		TRACE3("cache flush: reason %u, run of %u at lba %u", reason, run_length, run_lba);
+
+		bool is_run_written = SD_Card_Driver_StreamOpen(dyn_cache.card, run_lba, run_length);
+
+		for (uint32_t i = 0; i < run_length; i++) {
+			int32_t slot = Sector_Cache_Find(run_lba + i);
+
+			is_run_written = is_run_written && SD_Card_Driver_StreamWrite(dyn_cache.card, dyn_cache_data[slot], 1);
+
+			/* A failed sector is dropped rather than retried forever, the owner sees the error and moves on */
+			dyn_cache.slots[slot].is_dirty = false;
+			dyn_cache.dirty_count--;
+		}
+
+		is_run_written = SD_Card_Driver_StreamClose(dyn_cache.card) && is_run_written;
+
+		TRACE1("cache flush done: ok %u", is_run_written);
+
+		if (!is_run_written) {
+			dyn_cache.stats.write_errors++;
+			is_flush_successful = false;
+		}
+
+		Sector_Cache_Record(run_length);
+	}
+
+	return is_flush_successful;
+}
+
+/* Least recently used clean slot; with none left everything is flushed first */
+static int32_t Sector_Cache_Evict (void) {
+	int32_t victim = -1;
+
+	for (uint32_t i = 0; i < SECTOR_CACHE_SLOTS; i++) {
+		if (dyn_cache.slots[i].lba == SECTOR_CACHE_INVALID_LBA) {
+			return (int32_t) i;
+		}
+
+		if (!dyn_cache.slots[i].is_dirty && ((victim < 0) || (dyn_cache.slots[i].last_use < dyn_cache.slots[victim].last_use))) {
+			victim = (int32_t) i;
+		}
+	}
+
+	if (victim >= 0) {
+		return victim;
+	}
+
+	if (!Sector_Cache_Flush(eSectorCacheFlush_Full)) {
+		return -1;
+	}
+
+	return Sector_Cache_Evict();
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Sector_Cache_Init (eSdCard_t card, const sSectorCacheConfig_t *config) {
+	if ((config == NULL) || (card < eSdCard_First) || (card >= eSdCard_Last)) {
+		return false;
+	}
+
+	if (dyn_cache.is_ready) {
+		Sector_Cache_Flush(eSectorCacheFlush_Barrier);
+	}
+
+	memset(&dyn_cache, 0, sizeof(dyn_cache));
+
+	for (uint32_t i = 0; i < SECTOR_CACHE_SLOTS; i++) {
+		dyn_cache.slots[i].lba = SECTOR_CACHE_INVALID_LBA;
+	}
+
+	dyn_cache.card = card;
+	dyn_cache.config = *config;
+	dyn_cache.is_ready = true;
+
+	return true;
+}
+
+/* Returns the cached sector for in-place edits, valid until the next cache call; is_overwrite skips reading the old contents */
+uint8_t *Sector_Cache_Prepare (uint32_t lba, bool is_overwrite) {
+	if (!dyn_cache.is_ready || (lba == SECTOR_CACHE_INVALID_LBA)) {
+		return NULL;
+	}
+
+	int32_t slot = Sector_Cache_Find(lba);
+
+	if (slot >= 0) {
+		dyn_cache.stats.hits++;
+	} else {
+		dyn_cache.stats.misses++;
+		slot = Sector_Cache_Evict();
+
+		if (slot < 0) {
+			return NULL;
+		}
+
+		dyn_cache.slots[slot].lba = SECTOR_CACHE_INVALID_LBA;
+
+		if (!is_overwrite && !SD_Card_Driver_ReadBlocks(dyn_cache.card, lba, dyn_cache_data[slot], 1)) {
+			return NULL;
+		}
+
+		dyn_cache.slots[slot].lba = lba;
+	}
+
+	dyn_cache.slots[slot].last_use = ++dyn_cache.use_counter;
+
+	return dyn_cache_data[slot];
+}
+
+bool Sector_Cache_Commit (uint32_t lba) {
+	int32_t slot = Sector_Cache_Find(lba);
+
+	if (!dyn_cache.is_ready || (slot < 0)) {
+		return false;
+	}
+
+	dyn_cache.stats.commits++;
+
+	if (!dyn_cache.slots[slot].is_dirty) {
+		if (dyn_cache.dirty_count == 0) {
+			dyn_cache.oldest_dirty_tick = HAL_GetTick();
+		}
+
+		dyn_cache.slots[slot].is_dirty = true;
+		dyn_cache.dirty_count++;
+	}
+
+	return true;
+}
+
+bool Sector_Cache_Write (uint32_t lba, uint32_t offset, const void *data, uint32_t length) {
+	if ((data == NULL) || (offset > SD_CARD_SECTOR_SIZE) || (length > (SD_CARD_SECTOR_SIZE - offset))) {
+		return false;
+	}
+
+	uint8_t *sector = Sector_Cache_Prepare(lba, (offset == 0) && (length == SD_CARD_SECTOR_SIZE));
+
+	if (sector == NULL) {
+		return false;
+	}
+
+	memcpy(&sector[offset], data, length);
+
+	return Sector_Cache_Commit(lba);
+}
+
+bool Sector_Cache_Read (uint32_t lba, uint32_t offset, void *data, uint32_t length) {
+	if ((data == NULL) || (offset > SD_CARD_SECTOR_SIZE) || (length > (SD_CARD_SECTOR_SIZE - offset))) {
+		return false;
+	}
+
+	uint8_t *sector = Sector_Cache_Prepare(lba, false);
+
+	if (sector == NULL) {
+		return false;
+	}
+
+	memcpy(data, &sector[offset], length);
+
+	return true;
+}
+
+bool Sector_Cache_Barrier (void) {
+	if (!dyn_cache.is_ready) {
+		return false;
+	}
+
+	return Sector_Cache_Flush(eSectorCacheFlush_Barrier);
+}
+
+bool Sector_Cache_Process (void) {
+	if (!dyn_cache.is_ready || (dyn_cache.dirty_count == 0)) {
+		return true;
+	}
+
+	if ((HAL_GetTick() - dyn_cache.oldest_dirty_tick) < dyn_cache.config.flush_deadline_ms) {
+		return true;
+	}
+
+	return Sector_Cache_Flush(eSectorCacheFlush_Deadline);
+}
+
+bool Sector_Cache_GetStats (sSectorCacheStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_cache.stats;
+
+	return true;
+}
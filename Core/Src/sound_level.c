@@ -0,0 +1,337 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "sound_level.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define SOUND_LEVEL_FAST_TIME_S		0.125f
+#define SOUND_LEVEL_DC_ALPHA		0.001f
+#define SOUND_LEVEL_FULL_SCALE_SQ	(32768.0f * 32768.0f)
+#define SOUND_LEVEL_FLOOR_CDB		(-32000)
+#define SOUND_LEVEL_EVENT_QUEUE		4U
+#define SOUND_LEVEL_MAX_BIQUADS		3U
+#define SOUND_LEVEL_PI				3.14159265358979f
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+/* Direct form II transposed */
+typedef struct {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+	float z1;
+	float z2;
+} sSoundLevelBiquad_t;
+
+typedef struct {
+	sSoundLevelConfig_t config;
+	uint32_t sample_rate;
+	sSoundLevelBiquad_t weighting[SOUND_LEVEL_MAX_BIQUADS];
+	uint32_t weighting_stages;
+	float dc;
+	float fast_ms;
+	double interval_energy;
+	uint32_t interval_samples;
+	uint64_t interval_start_ms;
+	/* False until the first block gives the running interval its start time */
+	bool is_interval_started;
+	int16_t lmax_cdb;
+	int16_t lmin_cdb;
+	uint32_t sensor_triggers_seen;
+	bool is_interval_ready;
+	sSoundLevelInterval_t interval;
+	bool is_event_active;
+	sSoundLevelEvent_t event;
+	sSoundLevelEvent_t event_queue[SOUND_LEVEL_EVENT_QUEUE];
+	uint32_t event_head;
+	uint32_t event_tail;
+} sSoundLevel_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sSoundLevel_t dyn_level = {0};
+static volatile uint32_t dyn_sensor_triggers = 0;
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static int16_t Sound_Level_ToCdb (float mean_square);
+static void Sound_Level_Bilinear (sSoundLevelBiquad_t *biquad, const float analog_b[3], const float analog_a[3], float k);
+static float Sound_Level_Gain (float frequency_hz);
+static void Sound_Level_DesignWeighting (void);
+static void Sound_Level_ResetInterval (uint64_t start_ms);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static int16_t Sound_Level_ToCdb (float mean_square) {
+	if (mean_square <= 0.0f) {
+		return SOUND_LEVEL_FLOOR_CDB;
+	}
+
+	float cdb = (1000.0f * log10f(mean_square / SOUND_LEVEL_FULL_SCALE_SQ)) + dyn_level.config.calibration_cdb;
+
+	if (cdb > INT16_MAX) {
+		return INT16_MAX;
+	}
+
+	if (cdb < SOUND_LEVEL_FLOOR_CDB) {
+		return SOUND_LEVEL_FLOOR_CDB;
+	}
+
+	return (int16_t) lrintf(cdb);
+}
+
+/* Maps H(s) = (b0 s^2 + b1 s + b2) / (a0 s^2 + a1 s + a2) to a biquad with s = k (z - 1) / (z + 1) */
+static void Sound_Level_Bilinear (sSoundLevelBiquad_t *biquad, const float analog_b[3], const float analog_a[3], float k) {
+	float k2 = k * k;
+	float a0 = (analog_a[0] * k2) + (analog_a[1] * k) + analog_a[2];
+
+	biquad->b0 = ((analog_b[0] * k2) + (analog_b[1] * k) + analog_b[2]) / a0;
+	biquad->b1 = (2.0f * (analog_b[2] - (analog_b[0] * k2))) / a0;
+	biquad->b2 = ((analog_b[0] * k2) - (analog_b[1] * k) + analog_b[2]) / a0;
+	biquad->a1 = (2.0f * (analog_a[2] - (analog_a[0] * k2))) / a0;
+	biquad->a2 = ((analog_a[0] * k2) - (analog_a[1] * k) + analog_a[2]) / a0;
+	biquad->z1 = 0.0f;
+	biquad->z2 = 0.0f;
+}
+
+static float Sound_Level_Gain (float frequency_hz) {
+	float omega = (2.0f * SOUND_LEVEL_PI * frequency_hz) / (float) dyn_level.sample_rate;
+	float c1 = cosf(omega);
+	float s1 = sinf(omega);
+	float c2 = cosf(2.0f * omega);
+	float s2 = sinf(2.0f * omega);
+	float gain = 1.0f;
+
+	for (uint32_t i = 0; i < dyn_level.weighting_stages; i++) {
+		const sSoundLevelBiquad_t *bq = &dyn_level.weighting[i];
+		float num_re = bq->b0 + (bq->b1 * c1) + (bq->b2 * c2);
+		float num_im = -((bq->b1 * s1) + (bq->b2 * s2));
+		float den_re = 1.0f + (bq->a1 * c1) + (bq->a2 * c2);
+		float den_im = -((bq->a1 * s1) + (bq->a2 * s2));
+
+		gain *= sqrtf(((num_re * num_re) + (num_im * num_im)) / ((den_re * den_re) + (den_im * den_im)));
+	}
+
+	return gain;
+}
+
+/*
+ * IEC 61672 A and C curves from their analog poles (20.6, 107.7, 737.9 and 12194 Hz) through the bilinear transform,
+ * normalised to 0 dB at 1 kHz. Without prewarping the top octave falls short at low sample rates, which the
+ * logger's microphone chain rolls off anyway.
+ */
+static void Sound_Level_DesignWeighting (void) {
+	float w1 = 2.0f * SOUND_LEVEL_PI * 20.598997f;
+	float w2 = 2.0f * SOUND_LEVEL_PI * 107.65265f;
+	float w3 = 2.0f * SOUND_LEVEL_PI * 737.86223f;
+	float w4 = 2.0f * SOUND_LEVEL_PI * 12194.217f;
+	float k = 2.0f * (float) dyn_level.sample_rate;
+	const float highpass_b[3] = {1.0f, 0.0f, 0.0f};
+	const float highpass_low_a[3] = {1.0f, 2.0f * w1, w1 * w1};
+	const float highpass_mid_a[3] = {1.0f, w2 + w3, w2 * w3};
+	const float lowpass_b[3] = {0.0f, 0.0f, w4 * w4};
+	const float lowpass_a[3] = {1.0f, 2.0f * w4, w4 * w4};
+
+	dyn_level.weighting_stages = 0;
+
+	if ((dyn_level.sample_rate == 0) || (dyn_level.config.weighting == eSoundLevelWeighting_Z)) {
+		return;
+	}
+
+	Sound_Level_Bilinear(&dyn_level.weighting[dyn_level.weighting_stages++], highpass_b, highpass_low_a, k);
+
+	if (dyn_level.config.weighting == eSoundLevelWeighting_A) {
+		Sound_Level_Bilinear(&dyn_level.weighting[dyn_level.weighting_stages++], highpass_b, highpass_mid_a, k);
+	}
+
+	Sound_Level_Bilinear(&dyn_level.weighting[dyn_level.weighting_stages++], lowpass_b, lowpass_a, k);
+
+	float gain = Sound_Level_Gain(1000.0f);
+
+	dyn_level.weighting[0].b0 /= gain;
+	dyn_level.weighting[0].b1 /= gain;
+	dyn_level.weighting[0].b2 /= gain;
+}
+
+static void Sound_Level_ResetInterval (uint64_t start_ms) {
+	dyn_level.interval_energy = 0.0;
+	dyn_level.interval_samples = 0;
+	dyn_level.interval_start_ms = start_ms;
+	dyn_level.lmax_cdb = INT16_MIN;
+	dyn_level.lmin_cdb = INT16_MAX;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Sound_Level_Init (const sSoundLevelConfig_t *config) {
+	if ((config == NULL) || (config->interval_ms == 0) || (config->weighting >= eSoundLevelWeighting_Last)) {
+		return false;
+	}
+
+	memset(&dyn_level, 0, sizeof(dyn_level));
+	dyn_level.config = *config;
+	dyn_level.dc = (float) AUDIO_STREAM_ADC_MIDSCALE;
+	dyn_level.sensor_triggers_seen = dyn_sensor_triggers;
+	Sound_Level_ResetInterval(0);
+
+	return true;
+}
+
+bool Sound_Level_SetConfig (const sSoundLevelConfig_t *config) {
+	if ((config == NULL) || (config->interval_ms == 0) || (config->weighting >= eSoundLevelWeighting_Last)) {
+		return false;
+	}
+
+	bool is_weighting_changed = (config->weighting != dyn_level.config.weighting);
+
+	dyn_level.config = *config;
+
+	if (is_weighting_changed) {
+		Sound_Level_DesignWeighting();
+	}
+
+	return true;
+}
+
+bool Sound_Level_ProcessBlock (const sAudioBlock_t *block, uint32_t sample_rate, uint64_t time_ms) {
+	if ((block == NULL) || (block->sample_count == 0) || (sample_rate == 0)) {
+		return false;
+	}
+
+	if (sample_rate != dyn_level.sample_rate) {
+		dyn_level.sample_rate = sample_rate;
+		Sound_Level_DesignWeighting();
+	}
+
+	uint64_t interval_ms = dyn_level.config.interval_ms;
+
+	if (!dyn_level.is_interval_started) {
+		Sound_Level_ResetInterval(time_ms - (((uint64_t) block->sample_count * 1000U) / sample_rate));
+		dyn_level.is_interval_started = true;
+	} else if (time_ms < dyn_level.interval_start_ms) {
+		/* The clock stepped back: the running interval restarts on the current boundary and keeps what it measured */
+		dyn_level.interval_start_ms = (time_ms / interval_ms) * interval_ms;
+	}
+
+	float dc = dyn_level.dc;
+	float sum_sq = 0.0f;
+
+	/* One-pole DC tracker, the ADC midpoint drifts with supply and temperature */
+	for (uint32_t i = 0; i < block->sample_count; i++) {
+		float x = (float) block->samples[i];
+		dc += (x - dc) * SOUND_LEVEL_DC_ALPHA;
+
+		float y = (x - dc) * 16.0f;
+
+		for (uint32_t stage = 0; stage < dyn_level.weighting_stages; stage++) {
+			sSoundLevelBiquad_t *bq = &dyn_level.weighting[stage];
+			float out = (bq->b0 * y) + bq->z1;
+
+			bq->z1 = (bq->b1 * y) - (bq->a1 * out) + bq->z2;
+			bq->z2 = (bq->b2 * y) - (bq->a2 * out);
+			y = out;
+		}
+
+		sum_sq += y * y;
+	}
+
+	dyn_level.dc = dc;
+
+	float block_ms = sum_sq / (float) block->sample_count;
+	float alpha = ((float) block->sample_count / (float) sample_rate) / SOUND_LEVEL_FAST_TIME_S;
+
+	if (alpha > 1.0f) {
+		alpha = 1.0f;
+	}
+
+	dyn_level.fast_ms += (block_ms - dyn_level.fast_ms) * alpha;
+	dyn_level.interval_energy += (double) sum_sq;
+	dyn_level.interval_samples += block->sample_count;
+
+	int16_t fast_cdb = Sound_Level_ToCdb(dyn_level.fast_ms);
+
+	if (fast_cdb > dyn_level.lmax_cdb) {
+		dyn_level.lmax_cdb = fast_cdb;
+	}
+
+	if (fast_cdb < dyn_level.lmin_cdb) {
+		dyn_level.lmin_cdb = fast_cdb;
+	}
+
+	if (fast_cdb >= dyn_level.config.event_threshold_cdb) {
+		if (!dyn_level.is_event_active) {
+			dyn_level.is_event_active = true;
+			dyn_level.event.start_ms = time_ms;
+			dyn_level.event.peak_cdb = fast_cdb;
+		} else if (fast_cdb > dyn_level.event.peak_cdb) {
+			dyn_level.event.peak_cdb = fast_cdb;
+		}
+	} else if (dyn_level.is_event_active) {
+		dyn_level.is_event_active = false;
+		uint64_t event_end_ms = (time_ms > dyn_level.event.start_ms) ? time_ms : dyn_level.event.start_ms;
+
+		dyn_level.event.duration_ms = (uint32_t) (event_end_ms - dyn_level.event.start_ms);
+
+		if ((dyn_level.event_head - dyn_level.event_tail) < SOUND_LEVEL_EVENT_QUEUE) {
+			dyn_level.event_queue[dyn_level.event_head % SOUND_LEVEL_EVENT_QUEUE] = dyn_level.event;
+			dyn_level.event_head++;
+		}
+	}
+
+	if ((time_ms / interval_ms) == (dyn_level.interval_start_ms / interval_ms)) {
+		return false;
+	}
+
+	/* Normally the boundary just crossed; after a step of the clock the last one before now, the gap goes to this interval */
+	uint64_t boundary_ms = (time_ms / interval_ms) * interval_ms;
+	uint32_t triggers = dyn_sensor_triggers;
+
+	dyn_level.interval.end_ms = boundary_ms;
+	dyn_level.interval.duration_ms = (uint32_t) (boundary_ms - dyn_level.interval_start_ms);
+	dyn_level.interval.leq_cdb = Sound_Level_ToCdb((float) (dyn_level.interval_energy / dyn_level.interval_samples));
+	dyn_level.interval.lmax_cdb = dyn_level.lmax_cdb;
+	dyn_level.interval.lmin_cdb = dyn_level.lmin_cdb;
+	dyn_level.interval.sensor_triggers = triggers - dyn_level.sensor_triggers_seen;
+	dyn_level.sensor_triggers_seen = triggers;
+	dyn_level.is_interval_ready = true;
+
+	Sound_Level_ResetInterval(boundary_ms);
+
+	return true;
+}
+
+bool Sound_Level_GetInterval (sSoundLevelInterval_t *interval) {
+	if ((interval == NULL) || !dyn_level.is_interval_ready) {
+		return false;
+	}
+
+	*interval = dyn_level.interval;
+	dyn_level.is_interval_ready = false;
+
+	return true;
+}
+
+bool Sound_Level_GetEvent (sSoundLevelEvent_t *event) {
+	if ((event == NULL) || (dyn_level.event_head == dyn_level.event_tail)) {
+		return false;
+	}
+
+	*event = dyn_level.event_queue[dyn_level.event_tail % SOUND_LEVEL_EVENT_QUEUE];
+	dyn_level.event_tail++;
+
+	return true;
+}
+
+void Sound_Level_OnSensorTrigger (void) {
+	dyn_sensor_triggers++;
+}
@@ -1,7 +1,9 @@
 #include "stm32f4xx_ll_spi.h"
 #include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
 #include "spi_driver.h"
 #include "gpio_driver.h"
+#include "clock_manager.h"
 
 typedef void (*EnableClock_t)(uint32_t periph);
 
@@ -21,8 +23,31 @@ typedef struct {
 	uint32_t standard;
 	EnableClock_t enable_clock;
 	uint32_t clock;
+	bool is_apb2;
 } sSpiDriver_t;
 
+static const uint32_t static_spi_prescaler_lut[] = {
+	LL_SPI_BAUDRATEPRESCALER_DIV2,
+	LL_SPI_BAUDRATEPRESCALER_DIV4,
+	LL_SPI_BAUDRATEPRESCALER_DIV8,
+	LL_SPI_BAUDRATEPRESCALER_DIV16,
+	LL_SPI_BAUDRATEPRESCALER_DIV32,
+	LL_SPI_BAUDRATEPRESCALER_DIV64,
+	LL_SPI_BAUDRATEPRESCALER_DIV128,
+	LL_SPI_BAUDRATEPRESCALER_DIV256
+};
+
+/* Last requested SCK limit, reapplied after a clock change */
+static uint32_t dyn_spi_max_frequency_lut[eSpi_Last] = {0};
+
+static void SPI_Driver_OnClockChange (void) {
+	for (eSpi_t spi = eSpi_First; spi < eSpi_Last; spi++) {
+		if (dyn_spi_max_frequency_lut[spi] != 0) {
+			SPI_Driver_SetBaudrate(spi, dyn_spi_max_frequency_lut[spi]);
+		}
+	}
+}
+
 static sSpiDriver_t static_spi_driver_lut[eSpi_Last] = {
 	[eSpi_SdCardReader] = {
 		.spi = SPI2,
@@ -39,7 +64,8 @@ static sSpiDriver_t static_spi_driver_lut[eSpi_Last] = {
 		.crc_poly = 10,
 		.standard = LL_SPI_PROTOCOL_MOTOROLA,
 		.enable_clock = LL_APB1_GRP1_EnableClock,
-		.clock = LL_APB1_GRP1_PERIPH_SPI2
+		.clock = LL_APB1_GRP1_PERIPH_SPI2,
+		.is_apb2 = false
 	}
 };
 
@@ -51,6 +77,7 @@ bool SPI_Driver_Init (eSpi_t spi) {
 	LL_SPI_InitTypeDef spi_init_struct = {0};
 
 	static_spi_driver_lut[spi].enable_clock(static_spi_driver_lut[spi].clock);
+	Clock_Manager_SetCallback(eClockClient_Spi, SPI_Driver_OnClockChange);
 
 	spi_init_struct.TransferDirection = static_spi_driver_lut[spi].transfer_direction;
 	spi_init_struct.Mode = static_spi_driver_lut[spi].mode;
@@ -68,6 +95,35 @@ bool SPI_Driver_Init (eSpi_t spi) {
 	}
 
 	LL_SPI_SetStandard(static_spi_driver_lut[spi].spi, static_spi_driver_lut[spi].standard);
+	LL_SPI_Enable(static_spi_driver_lut[spi].spi);
+
+	return true;
+}
+
+bool SPI_Driver_SetBaudrate (eSpi_t spi, uint32_t max_frequency_hz) {
+	if ((eSpi_Last <= spi) || (eSpi_First > spi) || (max_frequency_hz == 0)) {
+		return false;
+	}
+
+	LL_RCC_ClocksTypeDef clocks = {0};
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	uint32_t pclk = static_spi_driver_lut[spi].is_apb2 ? clocks.PCLK2_Frequency : clocks.PCLK1_Frequency;
+	uint32_t divider = 2;
+	size_t index = 0;
+
+	while (((pclk / divider) > max_frequency_hz) && (index < ((sizeof(static_spi_prescaler_lut) / sizeof(static_spi_prescaler_lut[0])) - 1))) {
+		divider <<= 1;
+		index++;
+	}
+
+	dyn_spi_max_frequency_lut[spi] = max_frequency_hz;
+
+	while (LL_SPI_IsActiveFlag_BSY(static_spi_driver_lut[spi].spi));
+
+	LL_SPI_Disable(static_spi_driver_lut[spi].spi);
+	LL_SPI_SetBaudRatePrescaler(static_spi_driver_lut[spi].spi, static_spi_prescaler_lut[index]);
+	LL_SPI_Enable(static_spi_driver_lut[spi].spi);
 
 	return true;
 }
@@ -29,6 +29,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include "telemetry.h"
 
 
 /* Variables */
@@ -77,14 +78,14 @@ __attribute__((weak)) int _read(int file, char *ptr, int len)
   return len;
 }
 
+/* stdout and stderr go out as telemetry text frames; never blocks, output that does not fit is counted and dropped */
 __attribute__((weak)) int _write(int file, char *ptr, int len)
 {
   (void)file;
-  int DataIdx;
 
-  for (DataIdx = 0; DataIdx < len; DataIdx++)
+  if (len > 0)
   {
-    __io_putchar(*ptr++);
+    Telemetry_SendText(ptr, (size_t) len);
   }
   return len;
 }
@@ -0,0 +1,242 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "cobs.h"
+#include "crc16.h"
+#include "telemetry.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	bool is_init;
+	eUart_t uart;
+	uint16_t sequence;
+	/* Encoded bytes of the frame being received, decoded in place on the delimiter */
+	uint8_t rx_frame[TELEMETRY_MAX_WIRE];
+	size_t rx_length;
+	bool is_rx_overlong;
+	sTelemetryStats_t stats;
+} sTelemetry_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sTelemetry_t dyn_telemetry = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static bool Telemetry_Send (eTelemetryFrame_t type, const void *payload, uint8_t length);
+static bool Telemetry_FinishRx (sTelemetryConfig_t *config);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static bool Telemetry_Send (eTelemetryFrame_t type, const void *payload, uint8_t length) {
+	if (!dyn_telemetry.is_init || (length > TELEMETRY_MAX_PAYLOAD)) {
+		return false;
+	}
+
+	uint8_t frame[TELEMETRY_MAX_FRAME];
+	uint8_t wire[TELEMETRY_MAX_WIRE];
+	sTelemetryHeader_t header = {
+		.type = (uint8_t) type,
+		.sequence = dyn_telemetry.sequence++
+	};
+	size_t size = TELEMETRY_HEADER_SIZE + length;
+
+	memcpy(frame, &header, sizeof(header));
+	memcpy(&frame[TELEMETRY_HEADER_SIZE], payload, length);
+
+	uint16_t crc = CRC16_Compute(frame, size);
+
+	frame[size++] = (uint8_t) crc;
+	frame[size++] = (uint8_t) (crc >> 8);
+
+	size_t wire_size = COBS_Encode(frame, size, wire);
+
+	wire[wire_size++] = TELEMETRY_DELIMITER;
+
+	if (!UART_Driver_Write(dyn_telemetry.uart, wire, wire_size)) {
+		dyn_telemetry.stats.frames_dropped++;
+		return false;
+	}
+
+	dyn_telemetry.stats.frames_sent++;
+
+	return true;
+}
+
+static bool Telemetry_FinishRx (sTelemetryConfig_t *config) {
+	size_t length = dyn_telemetry.rx_length;
+	bool is_overlong = dyn_telemetry.is_rx_overlong;
+
+	dyn_telemetry.rx_length = 0;
+	dyn_telemetry.is_rx_overlong = false;
+
+	/* Back-to-back delimiters are idle fill */
+	if ((length == 0) && !is_overlong) {
+		return false;
+	}
+
+	size_t size = is_overlong ? 0 : COBS_Decode(dyn_telemetry.rx_frame, length, dyn_telemetry.rx_frame);
+	const uint8_t *frame = dyn_telemetry.rx_frame;
+
+	if (size != (TELEMETRY_HEADER_SIZE + sizeof(*config) + TELEMETRY_CRC_SIZE)) {
+		dyn_telemetry.stats.rx_errors++;
+		return false;
+	}
+
+	uint16_t crc = (uint16_t) (frame[size - 2] | (frame[size - 1] << 8));
+
+	if ((CRC16_Compute(frame, size - TELEMETRY_CRC_SIZE) != crc) || (frame[0] != eTelemetryFrame_Config)) {
+		dyn_telemetry.stats.rx_errors++;
+		return false;
+	}
+
+	memcpy(config, &frame[TELEMETRY_HEADER_SIZE], sizeof(*config));
+	dyn_telemetry.stats.frames_received++;
+
+	return true;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Telemetry_Init (eUart_t uart) {
+	if ((eUart_Last <= uart) || (eUart_First > uart)) {
+		return false;
+	}
+
+	memset(&dyn_telemetry, 0, sizeof(dyn_telemetry));
+	dyn_telemetry.uart = uart;
+	dyn_telemetry.is_init = true;
+
+	return true;
+}
+
+bool Telemetry_SendLevels (const sTelemetryLevels_t *levels) {
+	if (levels == NULL) {
+		return false;
+	}
+
+	return Telemetry_Send(eTelemetryFrame_Levels, levels, sizeof(*levels));
+}
+
+bool Telemetry_SendSpectrum (const sTelemetrySpectrum_t *spectrum) {
+	if ((spectrum == NULL) || (spectrum->band_count > TELEMETRY_MAX_SPECTRUM_BANDS)) {
+		return false;
+	}
+
+	size_t length = offsetof(sTelemetrySpectrum_t, band_ddb) + (spectrum->band_count * sizeof(spectrum->band_ddb[0]));
+
+	return Telemetry_Send(eTelemetryFrame_Spectrum, spectrum, (uint8_t) length);
+}
+
+bool Telemetry_SendEvent (const sTelemetryEvent_t *event) {
+	if (event == NULL) {
+		return false;
+	}
+
+	return Telemetry_Send(eTelemetryFrame_Event, event, sizeof(*event));
+}
+
+/* Fills in the telemetry's own drop count */
+bool Telemetry_SendStatus (sTelemetryStatus_t *status) {
+	if (status == NULL) {
+		return false;
+	}
+
+	status->frames_dropped = dyn_telemetry.stats.frames_dropped;
+
+	return Telemetry_Send(eTelemetryFrame_Status, status, sizeof(*status));
+}
+
+bool Telemetry_SendConfig (const sTelemetryConfig_t *config) {
+	if (config == NULL) {
+		return false;
+	}
+
+	return Telemetry_Send(eTelemetryFrame_Config, config, sizeof(*config));
+}
+
+bool Telemetry_SendTrace (const uint32_t *words, size_t count) {
+	if ((words == NULL) || (count == 0) || ((count * sizeof(*words)) > TELEMETRY_MAX_PAYLOAD)) {
+		return false;
+	}
+
+	return Telemetry_Send(eTelemetryFrame_Trace, words, (uint8_t) (count * sizeof(*words)));
+}
+
+bool Telemetry_SendText (const char *text, size_t length) {
+	if (!dyn_telemetry.is_init || (text == NULL)) {
+		return false;
+	}
+
+	size_t frames = (length + TELEMETRY_MAX_PAYLOAD - 1U) / TELEMETRY_MAX_PAYLOAD;
+
+	/* Checked up front so a message is never cut off halfway by a full ring */
+	if ((frames * TELEMETRY_MAX_WIRE) > UART_Driver_GetTxFree(dyn_telemetry.uart)) {
+		dyn_telemetry.stats.text_bytes_dropped += length;
+		dyn_telemetry.stats.frames_dropped += frames;
+		dyn_telemetry.sequence += (uint16_t) frames;
+		return false;
+	}
+
+	while (length > 0) {
+		uint8_t piece = (length > TELEMETRY_MAX_PAYLOAD) ? TELEMETRY_MAX_PAYLOAD : (uint8_t) length;
+
+		if (!Telemetry_Send(eTelemetryFrame_Text, text, piece)) {
+			dyn_telemetry.stats.text_bytes_dropped += length;
+			return false;
+		}
+
+		text += piece;
+		length -= piece;
+	}
+
+	return true;
+}
+
+bool Telemetry_ReceiveConfig (sTelemetryConfig_t *config) {
+	if (!dyn_telemetry.is_init || (config == NULL)) {
+		return false;
+	}
+
+	uint8_t byte;
+
+	/* One byte at a time so a frame is handed out as soon as its delimiter is in */
+	while (UART_Driver_Read(dyn_telemetry.uart, &byte, sizeof(byte)) == sizeof(byte)) {
+		if (byte == TELEMETRY_DELIMITER) {
+			if (Telemetry_FinishRx(config)) {
+				return true;
+			}
+
+			continue;
+		}
+
+		if (dyn_telemetry.rx_length >= sizeof(dyn_telemetry.rx_frame)) {
+			dyn_telemetry.is_rx_overlong = true;
+			continue;
+		}
+
+		dyn_telemetry.rx_frame[dyn_telemetry.rx_length++] = byte;
+	}
+
+	return false;
+}
+
+bool Telemetry_GetStats (sTelemetryStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	*stats = dyn_telemetry.stats;
+
+	return true;
+}
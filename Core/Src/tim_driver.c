@@ -0,0 +1,143 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "tim_driver.h"
+#include "clock_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+#define TIM_MMS_UPDATE	(TIM_CR2_MMS_1)
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef void (*EnableClock_t)(uint32_t periph);
+
+typedef struct {
+	TIM_TypeDef *tim;
+	bool is_apb2;
+	uint32_t master_mode;
+	EnableClock_t enable_clock;
+	uint32_t clock;
+} sTimDesc_t;
+
+typedef struct {
+	uint32_t frequency_hz;
+	/* What the caller asked for, reapplied after a clock change */
+	uint32_t requested_hz;
+} sTimDynamic_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const sTimDesc_t static_tim_lut[eTim_Last] = {
+	[eTim_AdcTrigger] = {
+		.tim = TIM3,
+		.is_apb2 = false,
+		.master_mode = TIM_MMS_UPDATE,
+		.enable_clock = LL_APB1_GRP1_EnableClock,
+		.clock = LL_APB1_GRP1_PERIPH_TIM3
+	}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sTimDynamic_t dyn_tim_lut[eTim_Last] = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint32_t TIM_Driver_GetKernelClock (eTim_t tim);
+static void TIM_Driver_OnClockChange (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint32_t TIM_Driver_GetKernelClock (eTim_t tim) {
+	LL_RCC_ClocksTypeDef clocks = {0};
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	/* Timers run at twice the bus clock whenever the APB prescaler is not 1 */
+	if (static_tim_lut[tim].is_apb2) {
+		return (LL_RCC_GetAPB2Prescaler() == LL_RCC_APB2_DIV_1) ? clocks.PCLK2_Frequency : (clocks.PCLK2_Frequency * 2);
+	}
+
+	return (LL_RCC_GetAPB1Prescaler() == LL_RCC_APB1_DIV_1) ? clocks.PCLK1_Frequency : (clocks.PCLK1_Frequency * 2);
+}
+
+static void TIM_Driver_OnClockChange (void) {
+	for (eTim_t tim = eTim_First; tim < eTim_Last; tim++) {
+		if (dyn_tim_lut[tim].requested_hz != 0) {
+			TIM_Driver_SetFrequency(tim, dyn_tim_lut[tim].requested_hz);
+		}
+	}
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool TIM_Driver_Init (eTim_t tim) {
+	if ((eTim_Last <= tim) || (eTim_First > tim)) {
+		return false;
+	}
+
+	static_tim_lut[tim].enable_clock(static_tim_lut[tim].clock);
+	Clock_Manager_SetCallback(eClockClient_Tim, TIM_Driver_OnClockChange);
+
+	TIM_TypeDef *regs = static_tim_lut[tim].tim;
+	regs->CR1 = TIM_CR1_ARPE;
+	regs->CR2 = static_tim_lut[tim].master_mode;
+	regs->DIER = 0;
+	regs->CNT = 0;
+
+	return true;
+}
+
+bool TIM_Driver_SetFrequency (eTim_t tim, uint32_t frequency_hz) {
+	if ((eTim_Last <= tim) || (eTim_First > tim) || (frequency_hz == 0)) {
+		return false;
+	}
+
+	uint32_t ticks = (TIM_Driver_GetKernelClock(tim) + (frequency_hz / 2)) / frequency_hz;
+	uint32_t prescaler = ticks / 0x10000U;
+
+	if (prescaler > 0xFFFFU) {
+		return false;
+	}
+
+	uint32_t reload = (ticks / (prescaler + 1)) - 1;
+	TIM_TypeDef *regs = static_tim_lut[tim].tim;
+
+	regs->PSC = prescaler;
+	regs->ARR = reload;
+	regs->EGR = TIM_EGR_UG;
+
+	dyn_tim_lut[tim].frequency_hz = TIM_Driver_GetKernelClock(tim) / ((prescaler + 1) * (reload + 1));
+	dyn_tim_lut[tim].requested_hz = frequency_hz;
+
+	return true;
+}
+
+bool TIM_Driver_Start (eTim_t tim) {
+	if ((eTim_Last <= tim) || (eTim_First > tim)) {
+		return false;
+	}
+
+	static_tim_lut[tim].tim->CR1 |= TIM_CR1_CEN;
+	return true;
+}
+
+bool TIM_Driver_Stop (eTim_t tim) {
+	if ((eTim_Last <= tim) || (eTim_First > tim)) {
+		return false;
+	}
+
+	static_tim_lut[tim].tim->CR1 &= ~TIM_CR1_CEN;
+	return true;
+}
+
+uint32_t TIM_Driver_GetFrequency (eTim_t tim) {
+	if ((eTim_Last <= tim) || (eTim_First > tim)) {
+		return 0;
+	}
+
+	return dyn_tim_lut[tim].frequency_hz;
+}
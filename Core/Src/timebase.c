@@ -0,0 +1,169 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "clock_manager.h"
+#include "irq_map.h"
+#include "timebase.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* 32 bit free-running counter, the update interrupt extends it to 64 bits once every 71 minutes */
+#define TIMEBASE_TIM		TIM5
+#define TIMEBASE_IRQ		TIM5_IRQn
+/* ITR1 is TIM3 TRGO on TIM5 */
+#define TIMEBASE_TS_ITR1	(TIM_SMCR_TS_0)
+#define TIMEBASE_TI4_RTC	(TIM_OR_TI4_RMP_0 | TIM_OR_TI4_RMP_1)
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	volatile uint32_t *ccr;
+	uint32_t flag;
+} sTimebaseCaptureDesc_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const sTimebaseCaptureDesc_t static_capture_lut[eTimebaseCapture_Last] = {
+	[eTimebaseCapture_AdcTrigger] = {.ccr = &TIMEBASE_TIM->CCR1, .flag = TIM_SR_CC1IF},
+	[eTimebaseCapture_SoundSensor] = {.ccr = &TIMEBASE_TIM->CCR2, .flag = TIM_SR_CC2IF},
+	[eTimebaseCapture_RtcWakeup] = {.ccr = &TIMEBASE_TIM->CCR4, .flag = TIM_SR_CC4IF}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static volatile uint32_t dyn_timebase_high = 0;
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint32_t Timebase_GetPrescaler (void);
+static void Timebase_OnClockChange (void);
+static uint64_t Timebase_Read (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint32_t Timebase_GetPrescaler (void) {
+	LL_RCC_ClocksTypeDef clocks = {0};
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	/* Timers run at twice the bus clock whenever the APB prescaler is not 1 */
+	uint32_t kernel_hz = (LL_RCC_GetAPB1Prescaler() == LL_RCC_APB1_DIV_1) ? clocks.PCLK1_Frequency : (clocks.PCLK1_Frequency * 2);
+
+	/* Every clock point gives a whole number of megahertz */
+	return (kernel_hz / TIMEBASE_TICK_HZ) - 1;
+}
+
+/* The prescaler is preloaded; UG loads it at once and the count is put back, URS keeps that from looking like a wrap */
+static void Timebase_OnClockChange (void) {
+	uint32_t prescaler = Timebase_GetPrescaler();
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint32_t counter = TIMEBASE_TIM->CNT;
+
+	TIMEBASE_TIM->PSC = prescaler;
+	TIMEBASE_TIM->EGR = TIM_EGR_UG;
+	TIMEBASE_TIM->CNT = counter;
+
+	__set_PRIMASK(primask);
+}
+
+/* Interrupts masked: a wrap not yet handled is still pending, and only counts if the low word was read after it */
+static uint64_t Timebase_Read (void) {
+	uint32_t high = dyn_timebase_high;
+	uint32_t low = TIMEBASE_TIM->CNT;
+
+	if (((TIMEBASE_TIM->SR & TIM_SR_UIF) != 0) && (low < 0x80000000UL)) {
+		high++;
+	}
+
+	return ((uint64_t) high << 32) | low;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Timebase_Init (void) {
+	LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM5);
+	Clock_Manager_SetCallback(eClockClient_Timebase, Timebase_OnClockChange);
+
+	dyn_timebase_high = 0;
+
+	TIMEBASE_TIM->CR1 = TIM_CR1_URS;
+	TIMEBASE_TIM->SMCR = TIMEBASE_TS_ITR1;
+	TIMEBASE_TIM->OR = TIMEBASE_TI4_RTC;
+	/* CH1 on TRC, CH2 on TI2, CH4 on TI4; rising edges, no filter */
+	TIMEBASE_TIM->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC1S_1 | TIM_CCMR1_CC2S_0;
+	TIMEBASE_TIM->CCMR2 = TIM_CCMR2_CC4S_0;
+	TIMEBASE_TIM->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC4E;
+	TIMEBASE_TIM->ARR = UINT32_MAX;
+	TIMEBASE_TIM->PSC = Timebase_GetPrescaler();
+	TIMEBASE_TIM->EGR = TIM_EGR_UG;
+	TIMEBASE_TIM->SR = 0;
+	TIMEBASE_TIM->DIER = TIM_DIER_UIE;
+
+	NVIC_SetPriority(TIMEBASE_IRQ, IRQ_Map_GetPriority(eIrqSource_Timebase));
+	NVIC_EnableIRQ(TIMEBASE_IRQ);
+
+	TIMEBASE_TIM->CR1 |= TIM_CR1_CEN;
+
+	return true;
+}
+
+uint64_t Timebase_GetTicks (void) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint64_t ticks = Timebase_Read();
+
+	__set_PRIMASK(primask);
+
+	return ticks;
+}
+
+uint32_t Timebase_GetTicks32 (void) {
+	return TIMEBASE_TIM->CNT;
+}
+
+bool Timebase_GetCapture (eTimebaseCapture_t capture, uint64_t *ticks) {
+	if ((eTimebaseCapture_Last <= capture) || (eTimebaseCapture_First > capture) || (ticks == NULL)) {
+		return false;
+	}
+
+	const sTimebaseCaptureDesc_t *desc = &static_capture_lut[capture];
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	bool is_captured = (TIMEBASE_TIM->SR & desc->flag) != 0;
+	/* Reading CCR clears the capture flag */
+	uint32_t captured = *desc->ccr;
+	uint64_t now = Timebase_Read();
+
+	__set_PRIMASK(primask);
+
+	/* The capture lies behind now by less than a wrap, the distance in the low word is exact */
+	*ticks = now - (uint32_t) ((uint32_t) now - captured);
+
+	return is_captured;
+}
+
+void TIM5_IRQHandler (void) {
+	uint32_t enter_cycles = IRQ_Map_Enter();
+	uint32_t primask = __get_PRIMASK();
+
+	/* Readers at higher priorities must never see the flag cleared and the high word not yet advanced */
+	__disable_irq();
+
+	if ((TIMEBASE_TIM->SR & TIM_SR_UIF) != 0) {
+		TIMEBASE_TIM->SR = (uint32_t) ~TIM_SR_UIF;
+		dyn_timebase_high++;
+	}
+
+	__set_PRIMASK(primask);
+
+	IRQ_Map_Exit(eIrqSource_Timebase, enter_cycles);
+}
@@ -0,0 +1,146 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "telemetry.h"
+#include "timebase.h"
+#include "trace.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* Power of two, the ring indices are free running and masked on use */
+#define TRACE_RING_WORDS		1024U
+#define TRACE_FRAME_WORDS		(TELEMETRY_MAX_PAYLOAD / sizeof(uint32_t))
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	bool is_init;
+	uint32_t words[TRACE_RING_WORDS];
+	/* A record is written whole with interrupts masked, so everything below head is complete */
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+	/* Part of dropped already reported to the host */
+	uint32_t dropped_reported;
+	uint32_t records;
+} sTrace_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sTrace_t dyn_trace = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Trace_Init (void) {
+	memset(&dyn_trace, 0, sizeof(dyn_trace));
+
+	dyn_trace.is_init = true;
+
+	return true;
+}
+
+void Trace_Write (uint16_t id, uint32_t arg_count, const uint32_t *args) {
+	if (!dyn_trace.is_init || (arg_count > TRACE_MAX_ARGS)) {
+		return;
+	}
+
+	uint32_t size = TRACE_HEADER_WORDS + arg_count;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint32_t head = dyn_trace.head;
+
+	if ((TRACE_RING_WORDS - (head - dyn_trace.tail)) < size) {
+		dyn_trace.dropped++;
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	dyn_trace.words[head & (TRACE_RING_WORDS - 1U)] = TRACE_HEADER(id, arg_count);
+	dyn_trace.words[(head + 1U) & (TRACE_RING_WORDS - 1U)] = Timebase_GetTicks32();
+
+	for (uint32_t i = 0; i < arg_count; i++) {
+		dyn_trace.words[(head + TRACE_HEADER_WORDS + i) & (TRACE_RING_WORDS - 1U)] = args[i];
+	}
+
+	dyn_trace.head = head + size;
+	__set_PRIMASK(primask);
+}
+
+bool Trace_Process (void) {
+	if (!dyn_trace.is_init) {
+		return false;
+	}
+
+	uint32_t frame[TRACE_FRAME_WORDS];
+
+	while (UART_Driver_GetTxFree(eUart_Debug) >= TELEMETRY_MAX_WIRE) {
+		uint32_t head = dyn_trace.head;
+		uint32_t tail = dyn_trace.tail;
+		uint32_t length = 0;
+		uint32_t records = 0;
+		uint32_t dropped = dyn_trace.dropped - dyn_trace.dropped_reported;
+
+		if (dropped != 0) {
+			frame[length++] = TRACE_HEADER(TRACE_ID_DROPPED, 1);
+			frame[length++] = Timebase_GetTicks32();
+			frame[length++] = dropped;
+		}
+
+		while (tail != head) {
+			uint32_t size = TRACE_HEADER_WORDS + TRACE_HEADER_ARGS(dyn_trace.words[tail & (TRACE_RING_WORDS - 1U)]);
+
+			if ((length + size) > TRACE_FRAME_WORDS) {
+				break;
+			}
+
+			for (uint32_t i = 0; i < size; i++) {
+				frame[length++] = dyn_trace.words[(tail + i) & (TRACE_RING_WORDS - 1U)];
+			}
+
+			tail += size;
+			records++;
+		}
+
+		if (length == 0) {
+			break;
+		}
+
+		if (!Telemetry_SendTrace(frame, length)) {
+			return false;
+		}
+
+		dyn_trace.dropped_reported += dropped;
+		dyn_trace.records += records;
+		dyn_trace.tail = tail;
+	}
+
+	return true;
+}
+
+bool Trace_GetStats (sTraceStats_t *stats) {
+	if (stats == NULL) {
+		return false;
+	}
+
+	stats->records = dyn_trace.records;
+	stats->dropped = dyn_trace.dropped;
+
+	return true;
+}
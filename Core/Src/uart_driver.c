@@ -0,0 +1,365 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "stm32f4xx_ll_usart.h"
+#include "dma_driver.h"
+#include "uart_driver.h"
+#include "irq_map.h"
+#include "deferred_work.h"
+#include "power_manager.h"
+#include "clock_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* Powers of two, the ring indices are free running and masked on use */
+#define UART_TX_BUFFER_SIZE		1024U
+#define UART_RX_BUFFER_SIZE		256U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef void (*EnableClock_t)(uint32_t periph);
+
+typedef struct {
+	USART_TypeDef *usart;
+	eDmaStream_t tx_stream;
+	eDmaStream_t rx_stream;
+	IRQn_Type irqn;
+	eIrqSource_t irq_source;
+	EnableClock_t enable_clock;
+	uint32_t clock;
+	bool is_apb2;
+} sUartDesc_t;
+
+typedef struct {
+	uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+	uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+	/* Written only by the producer */
+	volatile uint32_t tx_head;
+	/* Written only from the DMA completion path */
+	volatile uint32_t tx_tail;
+	volatile uint32_t tx_in_flight;
+	/* Bytes the DMA has put into rx_buffer, advanced from the interrupts and the reader */
+	volatile uint32_t rx_written;
+	uint32_t rx_dma_position;
+	uint32_t rx_read;
+	uint32_t baudrate;
+	sUartStats_t stats;
+} sUartDynamic_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const sUartDesc_t static_uart_lut[eUart_Last] = {
+	[eUart_Debug] = {
+		.usart = USART2,
+		.tx_stream = eDmaStream_UartDebugTx,
+		.rx_stream = eDmaStream_UartDebugRx,
+		.irqn = USART2_IRQn,
+		.irq_source = eIrqSource_UartRx,
+		.enable_clock = LL_APB1_GRP1_EnableClock,
+		.clock = LL_APB1_GRP1_PERIPH_USART2,
+		.is_apb2 = false
+	}
+};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sUartDynamic_t dyn_uart_lut[eUart_Last] = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static eUart_t UART_Driver_FromStream (eDmaStream_t dma_stream);
+static void UART_Driver_StartTx (eUart_t uart);
+static void UART_Driver_UpdateRx (eUart_t uart);
+static void UART_Driver_DmaCallback (eDmaStream_t dma_stream, eDmaEvent_t event);
+static void UART_Driver_DeferredWork (void);
+static void UART_Driver_OnClockChange (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static eUart_t UART_Driver_FromStream (eDmaStream_t dma_stream) {
+	for (eUart_t uart = eUart_First; uart < eUart_Last; uart++) {
+		if ((static_uart_lut[uart].tx_stream == dma_stream) || (static_uart_lut[uart].rx_stream == dma_stream)) {
+			return uart;
+		}
+	}
+
+	return eUart_Last;
+}
+
+/* Called with the UART interrupts masked or from them; sends the contiguous run up to the head or the buffer end */
+static void UART_Driver_StartTx (eUart_t uart) {
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+	uint32_t pending = dyn->tx_head - dyn->tx_tail;
+
+	if ((dyn->tx_in_flight != 0) || (pending == 0)) {
+		return;
+	}
+
+	uint32_t start = dyn->tx_tail & (UART_TX_BUFFER_SIZE - 1U);
+	uint32_t length = UART_TX_BUFFER_SIZE - start;
+
+	if (length > pending) {
+		length = pending;
+	}
+
+	if (!DMA_Driver_SetMemory(static_uart_lut[uart].tx_stream, &dyn->tx_buffer[start], length)) {
+		return;
+	}
+
+	dyn->tx_in_flight = length;
+	Power_Manager_Hold(ePowerHold_UartTx, true);
+	DMA_Driver_EnableStream(static_uart_lut[uart].tx_stream);
+}
+
+/* The circular RX stream only exposes its write position, so progress is accumulated at least twice per lap */
+static void UART_Driver_UpdateRx (eUart_t uart) {
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+	uint32_t position = UART_RX_BUFFER_SIZE - DMA_Driver_GetRemaining(static_uart_lut[uart].rx_stream);
+
+	if (position >= UART_RX_BUFFER_SIZE) {
+		position = 0;
+	}
+
+	uint32_t received = (position - dyn->rx_dma_position) & (UART_RX_BUFFER_SIZE - 1U);
+
+	dyn->rx_dma_position = position;
+	dyn->rx_written += received;
+	dyn->stats.rx_bytes += received;
+}
+
+static void UART_Driver_DmaCallback (eDmaStream_t dma_stream, eDmaEvent_t event) {
+	eUart_t uart = UART_Driver_FromStream(dma_stream);
+
+	if (uart == eUart_Last) {
+		return;
+	}
+
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+
+	if (dma_stream == static_uart_lut[uart].rx_stream) {
+		UART_Driver_UpdateRx(uart);
+		return;
+	}
+
+	if (event == eDmaEvent_TransferError) {
+		/* The failed run is dropped so the ring keeps moving */
+		dyn->stats.tx_dropped += dyn->tx_in_flight;
+	} else if (event == eDmaEvent_TransferComplete) {
+		dyn->stats.tx_bytes += dyn->tx_in_flight;
+	} else {
+		return;
+	}
+
+	dyn->tx_tail += dyn->tx_in_flight;
+	dyn->tx_in_flight = 0;
+	Power_Manager_Hold(ePowerHold_UartTx, false);
+
+	UART_Driver_StartTx(uart);
+}
+/* Idle-line bottom half; the DMA callbacks above also run from PendSV, so none of them preempt each other */
+static void UART_Driver_DeferredWork (void) {
+	for (eUart_t uart = eUart_First; uart < eUart_Last; uart++) {
+		UART_Driver_UpdateRx(uart);
+	}
+}
+
+/* Same baud rate from the new bus clock; the clock manager switches only while no transmit DMA runs */
+static void UART_Driver_OnClockChange (void) {
+	LL_RCC_ClocksTypeDef clocks = {0};
+
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	for (eUart_t uart = eUart_First; uart < eUart_Last; uart++) {
+		const sUartDesc_t *desc = &static_uart_lut[uart];
+
+		if (dyn_uart_lut[uart].baudrate == 0) {
+			continue;
+		}
+
+		uint32_t pclk = desc->is_apb2 ? clocks.PCLK2_Frequency : clocks.PCLK1_Frequency;
+
+		LL_USART_SetBaudRate(desc->usart, pclk, LL_USART_OVERSAMPLING_8, dyn_uart_lut[uart].baudrate);
+	}
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool UART_Driver_Init (eUart_t uart, uint32_t baudrate) {
+	if ((eUart_Last <= uart) || (eUart_First > uart) || (baudrate == 0)) {
+		return false;
+	}
+
+	const sUartDesc_t *desc = &static_uart_lut[uart];
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+	LL_RCC_ClocksTypeDef clocks = {0};
+	LL_USART_InitTypeDef usart_init_struct = {0};
+
+	memset(dyn, 0, sizeof(*dyn));
+	desc->enable_clock(desc->clock);
+	Deferred_Work_SetCallback(eDeferredWork_Uart, UART_Driver_DeferredWork);
+	Clock_Manager_SetCallback(eClockClient_Uart, UART_Driver_OnClockChange);
+	LL_RCC_GetSystemClocksFreq(&clocks);
+
+	dyn->baudrate = baudrate;
+	usart_init_struct.BaudRate = baudrate;
+	usart_init_struct.DataWidth = LL_USART_DATAWIDTH_8B;
+	usart_init_struct.StopBits = LL_USART_STOPBITS_1;
+	usart_init_struct.Parity = LL_USART_PARITY_NONE;
+	usart_init_struct.TransferDirection = LL_USART_DIRECTION_TX_RX;
+	usart_init_struct.HardwareFlowControl = LL_USART_HWCONTROL_NONE;
+	/* 8x oversampling keeps the divider error under 1 % at 921600 baud from a 42 MHz APB1 */
+	usart_init_struct.OverSampling = LL_USART_OVERSAMPLING_8;
+
+	LL_USART_Disable(desc->usart);
+
+	if (LL_USART_Init(desc->usart, &usart_init_struct) != SUCCESS) {
+		return false;
+	}
+
+	LL_USART_ConfigAsyncMode(desc->usart);
+
+	sDmaInit_t tx_init = {
+		.dma_stream = desc->tx_stream,
+		.periph_or_src_addr = (void *) &desc->usart->DR,
+		.dest_addr = dyn->tx_buffer,
+		.data_amount = 0,
+		.IT_cb = UART_Driver_DmaCallback
+	};
+	sDmaInit_t rx_init = {
+		.dma_stream = desc->rx_stream,
+		.periph_or_src_addr = (void *) &desc->usart->DR,
+		.dest_addr = dyn->rx_buffer,
+		.data_amount = UART_RX_BUFFER_SIZE,
+		.IT_cb = UART_Driver_DmaCallback
+	};
+
+	if (!DMA_Driver_Init(&tx_init) || !DMA_Driver_Init(&rx_init)) {
+		return false;
+	}
+
+	LL_USART_EnableDMAReq_TX(desc->usart);
+	LL_USART_EnableDMAReq_RX(desc->usart);
+	LL_USART_EnableIT_IDLE(desc->usart);
+	LL_USART_EnableIT_ERROR(desc->usart);
+	NVIC_SetPriority(desc->irqn, IRQ_Map_GetPriority(desc->irq_source));
+	NVIC_EnableIRQ(desc->irqn);
+
+	LL_USART_Enable(desc->usart);
+
+	return DMA_Driver_EnableStream(desc->rx_stream);
+}
+
+bool UART_Driver_Write (eUart_t uart, const uint8_t *data, size_t length) {
+	if ((eUart_Last <= uart) || (eUart_First > uart) || (data == NULL)) {
+		return false;
+	}
+
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+	uint32_t head = dyn->tx_head;
+
+	/* The ring has a single producer, a write from an interrupt could interleave with the one it preempted */
+	if (__get_IPSR() != 0) {
+		dyn->stats.tx_dropped += length;
+		return false;
+	}
+
+	if (length > (UART_TX_BUFFER_SIZE - (head - dyn->tx_tail))) {
+		dyn->stats.tx_dropped += length;
+		return false;
+	}
+
+	uint32_t start = head & (UART_TX_BUFFER_SIZE - 1U);
+	size_t first = UART_TX_BUFFER_SIZE - start;
+
+	if (first > length) {
+		first = length;
+	}
+
+	memcpy(&dyn->tx_buffer[start], data, first);
+	memcpy(dyn->tx_buffer, &data[first], length - first);
+
+	/* The bytes must be in RAM before the head lets the DMA path see them */
+	__DMB();
+	dyn->tx_head = head + length;
+
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	UART_Driver_StartTx(uart);
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+size_t UART_Driver_GetTxFree (eUart_t uart) {
+	if ((eUart_Last <= uart) || (eUart_First > uart)) {
+		return 0;
+	}
+
+	return UART_TX_BUFFER_SIZE - (dyn_uart_lut[uart].tx_head - dyn_uart_lut[uart].tx_tail);
+}
+
+size_t UART_Driver_Read (eUart_t uart, uint8_t *data, size_t max_length) {
+	if ((eUart_Last <= uart) || (eUart_First > uart) || (data == NULL)) {
+		return 0;
+	}
+
+	sUartDynamic_t *dyn = &dyn_uart_lut[uart];
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	UART_Driver_UpdateRx(uart);
+	__set_PRIMASK(primask);
+
+	uint32_t available = dyn->rx_written - dyn->rx_read;
+
+	/* Lapped by the DMA: what is left in the buffer is a mix of two laps, drop it */
+	if (available > UART_RX_BUFFER_SIZE) {
+		dyn->stats.rx_overruns++;
+		dyn->rx_read = dyn->rx_written;
+		return 0;
+	}
+
+	size_t count = (available < max_length) ? available : max_length;
+
+	for (size_t i = 0; i < count; i++) {
+		data[i] = dyn->rx_buffer[(dyn->rx_read + i) & (UART_RX_BUFFER_SIZE - 1U)];
+	}
+
+	dyn->rx_read += count;
+
+	return count;
+}
+
+bool UART_Driver_GetStats (eUart_t uart, sUartStats_t *stats) {
+	if ((eUart_Last <= uart) || (eUart_First > uart) || (stats == NULL)) {
+		return false;
+	}
+
+	*stats = dyn_uart_lut[uart].stats;
+
+	return true;
+}
+
+/* Idle line ends a burst before the half/full transfer interrupts would fire, errors are counted and cleared */
+void USART2_IRQHandler (void) {
+	uint32_t enter_cycles = IRQ_Map_Enter();
+	USART_TypeDef *usart = static_uart_lut[eUart_Debug].usart;
+	uint32_t status = usart->SR;
+
+	if ((status & (USART_SR_ORE | USART_SR_NE | USART_SR_FE)) != 0) {
+		dyn_uart_lut[eUart_Debug].stats.line_errors++;
+	}
+
+	if ((status & (USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE)) != 0) {
+		/* SR then DR read clears these flags, the DMA already took any pending data byte */
+		(void) usart->DR;
+		Deferred_Work_Post(eDeferredWork_Uart);
+	}
+
+	IRQ_Map_Exit(static_uart_lut[eUart_Debug].irq_source, enter_cycles);
+}
@@ -0,0 +1,434 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stddef.h>
+#include "stm32f4xx_hal.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "stm32f4xx_ll_pwr.h"
+#include "power_manager.h"
+#include "timebase.h"
+#include "trace.h"
+#include "wall_clock.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* 32768 Hz / 128 / 256: the calendar ticks on ck_spre, the sub-second counter has 3.9 ms steps */
+#define WALL_CLOCK_PREDIV_A			127U
+#define WALL_CLOCK_PREDIV_S			255U
+#define WALL_CLOCK_RTC_TIMEOUT_MS	10U
+/* BKP0R: the calendar was initialised by this firmware since the backup domain was powered */
+#define WALL_CLOCK_MAGIC			0x57434C4BUL
+/* Shorter spans let the reference's latency dominate the drift estimate */
+#define WALL_CLOCK_TRIM_SPAN_S		21600U
+#define WALL_CLOCK_DAYS_TO_1970		719468UL
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	bool is_running;
+	/* Timebase ticks of an RTC second edge and its time; invalid after a STOP, the timebase does not count there */
+	bool is_anchored;
+	uint64_t anchor_ticks;
+	uint64_t anchor_ms;
+	uint32_t anchor_stops;
+} sWallClock_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+static const uint8_t static_days_in_month_lut[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sWallClock_t dyn_clock = {0};
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static uint32_t Wall_Clock_ToBcd (uint32_t value);
+static uint32_t Wall_Clock_FromBcd (uint32_t bcd);
+static bool Wall_Clock_WaitFlag (uint32_t flag, bool is_set);
+static bool Wall_Clock_StartLse (void);
+static bool Wall_Clock_WriteCalendar (uint32_t epoch_s);
+static void Wall_Clock_StartWakeup (void);
+static uint64_t Wall_Clock_ReadRtc (void);
+static uint32_t Wall_Clock_GetStops (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static uint32_t Wall_Clock_ToBcd (uint32_t value) {
+	return ((value / 10U) << 4) | (value % 10U);
+}
+
+static uint32_t Wall_Clock_FromBcd (uint32_t bcd) {
+	return ((bcd >> 4) * 10U) + (bcd & 0x0FU);
+}
+
+static bool Wall_Clock_WaitFlag (uint32_t flag, bool is_set) {
+	uint32_t start_tick = HAL_GetTick();
+
+	while (((RTC->ISR & flag) != 0) != is_set) {
+		if ((HAL_GetTick() - start_tick) > WALL_CLOCK_RTC_TIMEOUT_MS) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* RTCSEL can only be changed through a backup domain reset, which also clears the calendar */
+static bool Wall_Clock_StartLse (void) {
+	if (LL_RCC_GetRTCClockSource() != LL_RCC_RTC_CLKSOURCE_LSE) {
+		LL_RCC_ForceBackupDomainReset();
+		LL_RCC_ReleaseBackupDomainReset();
+	}
+
+	LL_RCC_LSE_DisableBypass();
+	LL_RCC_LSE_Enable();
+
+	uint32_t start_tick = HAL_GetTick();
+
+	while (!LL_RCC_LSE_IsReady()) {
+		if ((HAL_GetTick() - start_tick) > LSE_STARTUP_TIMEOUT) {
+			return false;
+		}
+	}
+
+	LL_RCC_SetRTCClockSource(LL_RCC_RTC_CLKSOURCE_LSE);
+	LL_RCC_EnableRTC();
+
+	return true;
+}
+
+/* Leaving init mode restarts the sub-second counter, the new second begins right here */
+static bool Wall_Clock_WriteCalendar (uint32_t epoch_s) {
+	sWallClockCalendar_t calendar = {0};
+
+	if (!Wall_Clock_ToCalendar(epoch_s, &calendar)) {
+		return false;
+	}
+
+	/* 1970-01-01 was a Thursday, the RTC counts Monday as 1 */
+	uint32_t weekday = (((epoch_s / 86400U) + 3U) % 7U) + 1U;
+	uint32_t time = (Wall_Clock_ToBcd(calendar.hour) << RTC_TR_HU_Pos) | (Wall_Clock_ToBcd(calendar.minute) << RTC_TR_MNU_Pos) | (Wall_Clock_ToBcd(calendar.second) << RTC_TR_SU_Pos);
+	uint32_t date = (Wall_Clock_ToBcd(calendar.year - 2000U) << RTC_DR_YU_Pos) | (weekday << RTC_DR_WDU_Pos) | (Wall_Clock_ToBcd(calendar.month) << RTC_DR_MU_Pos) | (Wall_Clock_ToBcd(calendar.day) << RTC_DR_DU_Pos);
+
+	RTC->WPR = 0xCAU;
+	RTC->WPR = 0x53U;
+	RTC->ISR |= RTC_ISR_INIT;
+
+	bool is_written = Wall_Clock_WaitFlag(RTC_ISR_INITF, true);
+
+	if (is_written) {
+		/* Synchronous divider first, the reference manual wants two separate writes */
+		RTC->PRER = WALL_CLOCK_PREDIV_S << RTC_PRER_PREDIV_S_Pos;
+		RTC->PRER |= WALL_CLOCK_PREDIV_A << RTC_PRER_PREDIV_A_Pos;
+		RTC->TR = time;
+		RTC->DR = date;
+		/* 24 hour format; shadow registers bypassed, so no resynchronisation wait after STOP */
+		RTC->CR = (RTC->CR & ~RTC_CR_FMT) | RTC_CR_BYPSHAD;
+	}
+
+	RTC->ISR &= ~RTC_ISR_INIT;
+	RTC->WPR = 0xFFU;
+
+	return is_written;
+}
+
+/* A 1 Hz wakeup on ck_spre marks every calendar second for TIM5 CH4; the EXTI line stays off, the core is not woken */
+static void Wall_Clock_StartWakeup (void) {
+	RTC->WPR = 0xCAU;
+	RTC->WPR = 0x53U;
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+
+	if (Wall_Clock_WaitFlag(RTC_ISR_WUTWF, true)) {
+		RTC->WUTR = 0;
+		RTC->CR = (RTC->CR & ~RTC_CR_WUCKSEL) | RTC_CR_WUCKSEL_2;
+		RTC->CR |= RTC_CR_WUTE | RTC_CR_WUTIE;
+	}
+
+	RTC->WPR = 0xFFU;
+}
+
+/* Without shadow registers a read can straddle a tick, it is repeated until two agree */
+static uint64_t Wall_Clock_ReadRtc (void) {
+	uint32_t ssr = 0;
+	uint32_t time = 0;
+	uint32_t date = 0;
+
+	do {
+		ssr = RTC->SSR;
+		time = RTC->TR;
+		date = RTC->DR;
+	} while ((ssr != RTC->SSR) || (time != RTC->TR) || (date != RTC->DR));
+
+	sWallClockCalendar_t calendar = {
+		.year = (uint16_t) (2000U + Wall_Clock_FromBcd((date & (RTC_DR_YT | RTC_DR_YU)) >> RTC_DR_YU_Pos)),
+		.month = (uint8_t) Wall_Clock_FromBcd((date & (RTC_DR_MT | RTC_DR_MU)) >> RTC_DR_MU_Pos),
+		.day = (uint8_t) Wall_Clock_FromBcd((date & (RTC_DR_DT | RTC_DR_DU)) >> RTC_DR_DU_Pos),
+		.hour = (uint8_t) Wall_Clock_FromBcd((time & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos),
+		.minute = (uint8_t) Wall_Clock_FromBcd((time & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos),
+		.second = (uint8_t) Wall_Clock_FromBcd((time & (RTC_TR_ST | RTC_TR_SU)) >> RTC_TR_SU_Pos)
+	};
+	uint32_t epoch_s = 0;
+
+	Wall_Clock_FromCalendar(&calendar, &epoch_s);
+
+	/* The sub-second counter runs down from PREDIV_S */
+	uint32_t fraction_ms = ((WALL_CLOCK_PREDIV_S - (ssr & RTC_SSR_SS)) * 1000U) / (WALL_CLOCK_PREDIV_S + 1U);
+
+	return ((uint64_t) epoch_s * 1000U) + fraction_ms;
+}
+
+static uint32_t Wall_Clock_GetStops (void) {
+	sPowerStats_t power_stats = {0};
+
+	Power_Manager_GetStats(&power_stats);
+
+	return power_stats.stops;
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+bool Wall_Clock_Init (void) {
+	dyn_clock.is_running = false;
+	dyn_clock.is_anchored = false;
+
+	LL_PWR_EnableBkUpAccess();
+
+	bool is_kept = LL_RCC_IsEnabledRTC() && LL_RCC_LSE_IsReady() && (LL_RCC_GetRTCClockSource() == LL_RCC_RTC_CLKSOURCE_LSE) && ((RTC->ISR & RTC_ISR_INITS) != 0) && (RTC->BKP0R == WALL_CLOCK_MAGIC);
+
+	if (!is_kept) {
+		if (!Wall_Clock_StartLse()) {
+			TRACE0("wall clock: LSE did not start");
+
+			return false;
+		}
+
+		if (!Wall_Clock_WriteCalendar(WALL_CLOCK_MIN_EPOCH_S)) {
+			return false;
+		}
+
+		RTC->BKP0R = WALL_CLOCK_MAGIC;
+		/* BKP1R: start of the drift measurement in epoch seconds, 0 while the time was never set; BKP2R: steps since, ms */
+		RTC->BKP1R = 0;
+		RTC->BKP2R = 0;
+	}
+
+	Wall_Clock_StartWakeup();
+	dyn_clock.is_running = true;
+
+	return true;
+}
+
+bool Wall_Clock_IsSet (void) {
+	return dyn_clock.is_running && (RTC->BKP1R != 0);
+}
+
+bool Wall_Clock_GetTime (uint64_t *epoch_ms) {
+	if (epoch_ms == NULL) {
+		return false;
+	}
+
+	if (!dyn_clock.is_running) {
+		*epoch_ms = Timebase_GetTicks() / (TIMEBASE_TICK_HZ / 1000U);
+
+		return false;
+	}
+
+	return Wall_Clock_TicksToTime(Timebase_GetTicks(), epoch_ms);
+}
+
+bool Wall_Clock_TicksToTime (uint64_t ticks, uint64_t *epoch_ms) {
+	if ((epoch_ms == NULL) || !dyn_clock.is_running) {
+		return false;
+	}
+
+	if (dyn_clock.is_anchored && (dyn_clock.anchor_stops == Wall_Clock_GetStops())) {
+		int64_t offset_ticks = (int64_t) (ticks - dyn_clock.anchor_ticks);
+
+		*epoch_ms = dyn_clock.anchor_ms + (offset_ticks / (int64_t) (TIMEBASE_TICK_HZ / 1000U));
+
+		return true;
+	}
+
+	/* No anchor yet or a STOP since: back from the RTC's reading, at its sub-second resolution */
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint64_t now_ticks = Timebase_GetTicks();
+	uint64_t now_ms = Wall_Clock_ReadRtc();
+
+	__set_PRIMASK(primask);
+
+	*epoch_ms = now_ms - (int64_t) (now_ticks - ticks) / (int64_t) (TIMEBASE_TICK_HZ / 1000U);
+
+	return true;
+}
+
+bool Wall_Clock_Sync (uint32_t epoch_s) {
+	if (!dyn_clock.is_running || (epoch_s < WALL_CLOCK_MIN_EPOCH_S) || (epoch_s > WALL_CLOCK_MAX_EPOCH_S)) {
+		return false;
+	}
+
+	uint64_t clock_ms = Wall_Clock_ReadRtc();
+	int64_t error_ms = (int64_t) (clock_ms - ((uint64_t) epoch_s * 1000U));
+	uint32_t span_start_s = RTC->BKP1R;
+	int32_t span_steps_ms = (int32_t) RTC->BKP2R;
+
+	if (!Wall_Clock_WriteCalendar(epoch_s)) {
+		return false;
+	}
+
+	if ((span_start_s == 0) || (epoch_s <= span_start_s)) {
+		RTC->BKP1R = epoch_s;
+		RTC->BKP2R = 0;
+	} else if ((epoch_s - span_start_s) >= WALL_CLOCK_TRIM_SPAN_S) {
+		/* What the clock gained over the span had it never been stepped, at the trim in force */
+		int64_t drift_ppb = ((error_ms - span_steps_ms) * 1000000LL) / (int64_t) (epoch_s - span_start_s);
+
+		Wall_Clock_SetTrim((int32_t) (Wall_Clock_GetTrim() - drift_ppb));
+		RTC->BKP1R = epoch_s;
+		RTC->BKP2R = 0;
+		TRACE2("wall clock: drift %d ppb, trim %d ppb", (int32_t) drift_ppb, Wall_Clock_GetTrim());
+	} else {
+		RTC->BKP2R = (uint32_t) (span_steps_ms - (int32_t) error_ms);
+	}
+
+	dyn_clock.is_anchored = false;
+	TRACE1("wall clock: stepped %d ms", (int32_t) -error_ms);
+
+	return true;
+}
+
+bool Wall_Clock_SetTrim (int32_t trim_ppb) {
+	if (!dyn_clock.is_running) {
+		return false;
+	}
+
+	if (trim_ppb < WALL_CLOCK_MIN_TRIM_PPB) {
+		trim_ppb = WALL_CLOCK_MIN_TRIM_PPB;
+	} else if (trim_ppb > WALL_CLOCK_MAX_TRIM_PPB) {
+		trim_ppb = WALL_CLOCK_MAX_TRIM_PPB;
+	}
+
+	/* Pulses added (CALP, 512 per 32 s) less pulses masked (CALM) in a 2^20 cycle window */
+	int32_t pulses = (int32_t) ((((int64_t) trim_ppb * (1 << 20)) + ((trim_ppb >= 0) ? 500000000LL : -500000000LL)) / 1000000000LL);
+	uint32_t calibration = (pulses > 0) ? (RTC_CALR_CALP | (uint32_t) (512 - pulses)) : (uint32_t) -pulses;
+
+	if (!Wall_Clock_WaitFlag(RTC_ISR_RECALPF, false)) {
+		return false;
+	}
+
+	RTC->WPR = 0xCAU;
+	RTC->WPR = 0x53U;
+	RTC->CALR = calibration;
+	RTC->WPR = 0xFFU;
+
+	/* A span that ran partly at the old trim would misread the drift */
+	if (RTC->BKP1R != 0) {
+		RTC->BKP1R = 0;
+		RTC->BKP2R = 0;
+	}
+
+	return true;
+}
+
+int32_t Wall_Clock_GetTrim (void) {
+	if (!dyn_clock.is_running) {
+		return 0;
+	}
+
+	uint32_t calibration = RTC->CALR;
+	int32_t pulses = (((calibration & RTC_CALR_CALP) != 0) ? 512 : 0) - (int32_t) (calibration & RTC_CALR_CALM);
+
+	return (int32_t) (((int64_t) pulses * 1000000000LL) / (1 << 20));
+}
+
+void Wall_Clock_Process (void) {
+	uint64_t edge_ticks = 0;
+
+	if (!dyn_clock.is_running || ((RTC->ISR & RTC_ISR_WUTF) == 0)) {
+		return;
+	}
+
+	bool is_captured = Timebase_GetCapture(eTimebaseCapture_RtcWakeup, &edge_ticks);
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	uint64_t now_ticks = Timebase_GetTicks();
+	uint64_t now_ms = Wall_Clock_ReadRtc();
+
+	__set_PRIMASK(primask);
+
+	/* Clearing the flag lets the next second make a new edge */
+	RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0x0000FFFFU) | (RTC->ISR & RTC_ISR_INIT);
+
+	if (!is_captured) {
+		return;
+	}
+
+	/* The edge was on a whole second; which one follows from the time since it, rounded to whole seconds */
+	uint64_t second_ms = now_ms - (now_ms % 1000U);
+	int64_t behind_ms = (int64_t) ((now_ticks - edge_ticks) / (TIMEBASE_TICK_HZ / 1000U)) - (int64_t) (now_ms % 1000U);
+	uint64_t seconds_back = (behind_ms <= 0) ? 0 : (uint64_t) ((behind_ms + 500) / 1000);
+
+	dyn_clock.anchor_ticks = edge_ticks;
+	dyn_clock.anchor_ms = second_ms - (seconds_back * 1000U);
+	dyn_clock.anchor_stops = Wall_Clock_GetStops();
+	dyn_clock.is_anchored = true;
+}
+
+bool Wall_Clock_ToCalendar (uint32_t epoch_s, sWallClockCalendar_t *calendar) {
+	if ((calendar == NULL) || (epoch_s < WALL_CLOCK_MIN_EPOCH_S) || (epoch_s > WALL_CLOCK_MAX_EPOCH_S)) {
+		return false;
+	}
+
+	/* Civil from days, on eras of 400 years counted from 0000-03-01 */
+	uint32_t days = (epoch_s / 86400U) + WALL_CLOCK_DAYS_TO_1970;
+	uint32_t seconds = epoch_s % 86400U;
+	uint32_t era = days / 146097U;
+	uint32_t day_of_era = days - (era * 146097U);
+	uint32_t year_of_era = (day_of_era - (day_of_era / 1460U) + (day_of_era / 36524U) - (day_of_era / 146096U)) / 365U;
+	uint32_t day_of_year = day_of_era - ((365U * year_of_era) + (year_of_era / 4U) - (year_of_era / 100U));
+	uint32_t month_from_march = ((5U * day_of_year) + 2U) / 153U;
+	uint32_t month = (month_from_march < 10U) ? (month_from_march + 3U) : (month_from_march - 9U);
+
+	calendar->year = (uint16_t) (year_of_era + (era * 400U) + ((month <= 2U) ? 1U : 0U));
+	calendar->month = (uint8_t) month;
+	calendar->day = (uint8_t) (day_of_year - (((153U * month_from_march) + 2U) / 5U) + 1U);
+	calendar->hour = (uint8_t) (seconds / 3600U);
+	calendar->minute = (uint8_t) ((seconds / 60U) % 60U);
+	calendar->second = (uint8_t) (seconds % 60U);
+
+	return true;
+}
+
+bool Wall_Clock_FromCalendar (const sWallClockCalendar_t *calendar, uint32_t *epoch_s) {
+	if ((calendar == NULL) || (epoch_s == NULL) || (calendar->year < 2000U) || (calendar->year > 2099U)) {
+		return false;
+	}
+
+	if ((calendar->month < 1U) || (calendar->month > 12U) || (calendar->day < 1U) || (calendar->hour > 23U) || (calendar->minute > 59U) || (calendar->second > 59U)) {
+		return false;
+	}
+
+	/* Within 2000 to 2099 every fourth year is a leap year */
+	uint32_t days_in_month = static_days_in_month_lut[calendar->month - 1U] + (((calendar->month == 2U) && ((calendar->year % 4U) == 0)) ? 1U : 0U);
+
+	if (calendar->day > days_in_month) {
+		return false;
+	}
+
+	uint32_t year = calendar->year - ((calendar->month <= 2U) ? 1U : 0U);
+	uint32_t era = year / 400U;
+	uint32_t year_of_era = year - (era * 400U);
+	uint32_t month_from_march = (calendar->month > 2U) ? (calendar->month - 3U) : (calendar->month + 9U);
+	uint32_t day_of_year = ((((153U * month_from_march) + 2U) / 5U) + calendar->day) - 1U;
+	uint32_t day_of_era = (year_of_era * 365U) + (year_of_era / 4U) - (year_of_era / 100U) + day_of_year;
+	uint32_t days = (era * 146097U) + day_of_era - WALL_CLOCK_DAYS_TO_1970;
+
+	*epoch_s = (days * 86400U) + (calendar->hour * 3600U) + (calendar->minute * 60U) + calendar->second;
+
+	return true;
+}
@@ -0,0 +1,208 @@
+#include "audio_decode.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "ima_adpcm.h"
+#include "rice_codec.h"
+
+namespace {
+
+constexpr uint16_t kWaveFormatPcm = 1;
+
+uint16_t ReadLe16 (const uint8_t *p) {
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLe32 (const uint8_t *p) {
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+void PutLe16 (std::vector<uint8_t> &out, uint16_t value) {
+	out.push_back((uint8_t) value);
+	out.push_back((uint8_t) (value >> 8));
+}
+
+void PutLe32 (std::vector<uint8_t> &out, uint32_t value) {
+	PutLe16(out, (uint16_t) value);
+	PutLe16(out, (uint16_t) (value >> 16));
+}
+
+bool ReadFile (const std::string &path, std::vector<uint8_t> &data, std::string &error) {
+	std::ifstream in(path, std::ios::binary);
+
+	if (!in) {
+		error = "cannot open " + path;
+		return false;
+	}
+
+	data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+	return true;
+}
+
+bool DecodeRice (const std::string &path, const std::vector<uint8_t> &file, DecodedAudio &audio, std::string &error) {
+	sRiceFileHeader_t header;
+
+	memcpy(&header, file.data(), sizeof(header));
+
+	if ((header.version != RICE_CODEC_FILE_VERSION) || (header.channels != 1) || (header.bits_per_sample != 16)) {
+		error = path + " has an unsupported .SLC layout";
+		return false;
+	}
+
+	size_t end = RICE_CODEC_FILE_HEADER_SIZE + std::min<size_t>(header.data_bytes, file.size() - RICE_CODEC_FILE_HEADER_SIZE);
+	std::vector<int16_t> pcm(RICE_CODEC_MAX_FRAME_SAMPLES);
+
+	audio.sample_rate = header.sample_rate;
+	audio.samples.clear();
+
+	/* A file cut short by power loss keeps its provisional length, stop at the first frame that does not decode */
+	for (size_t position = RICE_CODEC_FILE_HEADER_SIZE; position < end;) {
+		uint32_t count = 0;
+		size_t used = Rice_Codec_DecodeFrame(&file[position], end - position, pcm.data(), (uint32_t) pcm.size(), &count);
+
+		if (used == 0) {
+			break;
+		}
+
+		audio.samples.insert(audio.samples.end(), pcm.begin(), pcm.begin() + count);
+		position += used;
+	}
+
+	if (audio.samples.size() > header.sample_count) {
+		audio.samples.resize(header.sample_count);
+	}
+
+	return true;
+}
+
+}
+
+bool Audio_DecodeRecording (const std::string &path, DecodedAudio &audio, std::string &error) {
+	std::vector<uint8_t> file;
+
+	if (!ReadFile(path, file, error)) {
+		return false;
+	}
+
+	if ((file.size() >= RICE_CODEC_FILE_HEADER_SIZE) && (ReadLe32(&file[0]) == RICE_CODEC_FILE_MAGIC)) {
+		return DecodeRice(path, file, audio, error);
+	}
+
+	if ((file.size() < 12) || (memcmp(&file[0], "RIFF", 4) != 0) || (memcmp(&file[8], "WAVE", 4) != 0)) {
+		error = path + " is not a recording";
+		return false;
+	}
+
+	const uint8_t *fmt = nullptr;
+	const uint8_t *data = nullptr;
+	uint32_t data_size = 0;
+	uint32_t fact_samples = 0;
+	bool has_fact = false;
+
+	for (size_t position = 12; (position + 8) <= file.size();) {
+		uint32_t size = ReadLe32(&file[position + 4]);
+		const uint8_t *body = &file[position + 8];
+		size_t available = file.size() - (position + 8);
+
+		if (memcmp(&file[position], "fmt ", 4) == 0) {
+			fmt = (size >= 16) ? body : nullptr;
+		} else if ((memcmp(&file[position], "fact", 4) == 0) && (size >= 4)) {
+			fact_samples = ReadLe32(body);
+			has_fact = true;
+		} else if (memcmp(&file[position], "data", 4) == 0) {
+			data = body;
+			/* A file cut short by power loss still claims its full extent */
+			data_size = (uint32_t) std::min<size_t>(size, available);
+			break;
+		}
+
+		position += 8 + size + (size & 1U);
+	}
+
+	if ((fmt == nullptr) || (data == nullptr)) {
+		error = path + " has no fmt or data chunk";
+		return false;
+	}
+
+	uint16_t format = ReadLe16(&fmt[0]);
+	uint16_t channels = ReadLe16(&fmt[2]);
+	uint16_t block_align = ReadLe16(&fmt[12]);
+	uint16_t bits = ReadLe16(&fmt[14]);
+
+	audio.sample_rate = ReadLe32(&fmt[4]);
+	audio.samples.clear();
+
+	if (channels != 1) {
+		error = "only mono recordings are supported";
+		return false;
+	}
+
+	if ((format == kWaveFormatPcm) && (bits == 16)) {
+		for (uint32_t i = 0; (i + 1) < data_size; i += 2) {
+			audio.samples.push_back((int16_t) ReadLe16(&data[i]));
+		}
+
+		return true;
+	}
+
+	if ((format == IMA_ADPCM_WAVE_FORMAT) && (bits == IMA_ADPCM_BITS_PER_SAMPLE) && (block_align > IMA_ADPCM_BLOCK_HEADER_SIZE)) {
+		uint32_t block_samples = IMA_ADPCM_SAMPLES_PER_BLOCK(block_align);
+		std::vector<int16_t> pcm(block_samples);
+
+		for (uint32_t offset = 0; (offset + block_align) <= data_size; offset += block_align) {
+			if (!IMA_ADPCM_DecodeBlock(&data[offset], block_align, pcm.data())) {
+				error = "corrupt ADPCM block at data offset " + std::to_string(offset);
+				return false;
+			}
+
+			audio.samples.insert(audio.samples.end(), pcm.begin(), pcm.end());
+		}
+
+		if (has_fact && (fact_samples < audio.samples.size())) {
+			audio.samples.resize(fact_samples);
+		}
+
+		return true;
+	}
+
+	error = "unsupported WAV format " + std::to_string(format);
+
+	return false;
+}
+
+bool Audio_WritePcmWav (const std::string &path, const DecodedAudio &audio, std::string &error) {
+	std::vector<uint8_t> out;
+	uint32_t data_bytes = (uint32_t) (audio.samples.size() * sizeof(int16_t));
+
+	out.insert(out.end(), {'R', 'I', 'F', 'F'});
+	PutLe32(out, 36 + data_bytes);
+	out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+	PutLe32(out, 16);
+	PutLe16(out, kWaveFormatPcm);
+	PutLe16(out, 1);
+	PutLe32(out, audio.sample_rate);
+	PutLe32(out, audio.sample_rate * 2);
+	PutLe16(out, 2);
+	PutLe16(out, 16);
+	out.insert(out.end(), {'d', 'a', 't', 'a'});
+	PutLe32(out, data_bytes);
+
+	for (int16_t sample : audio.samples) {
+		PutLe16(out, (uint16_t) sample);
+	}
+
+	std::ofstream file(path, std::ios::binary);
+
+	file.write((const char *) out.data(), (std::streamsize) out.size());
+
+	if (!file) {
+		error = "cannot write " + path;
+		return false;
+	}
+
+	return true;
+}
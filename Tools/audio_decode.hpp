@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DecodedAudio {
+	uint32_t sample_rate = 0;
+	std::vector<int16_t> samples;
+};
+
+/* Reads a recorder file (PCM or IMA-ADPCM WAV, lossless .SLC) into 16-bit PCM */
+bool Audio_DecodeRecording (const std::string &path, DecodedAudio &audio, std::string &error);
+bool Audio_WritePcmWav (const std::string &path, const DecodedAudio &audio, std::string &error);
@@ -0,0 +1,222 @@
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+/* ucontext is an XSI interface, hidden by the strict C11 mode the host objects build in */
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "stm32f4xx_hal.h"
+#include "kernel_port.h"
+#include "kernel_port_host.h"
+#include "power_manager.h"
+/**********************************************************************************************************************
+ * Private definitions and macros
+ *********************************************************************************************************************/
+/* The host runs the thread bodies with printf and friends, far more than the firmware stacks hold */
+#define KERNEL_PORT_HOST_STACK_BYTES	(64U * 1024U)
+/* What the Cortex-M4 port stacks for a thread that was never run: hardware frame, EXC_RETURN and R4 to R11 */
+#define KERNEL_PORT_HOST_FRAME_WORDS	17U
+/**********************************************************************************************************************
+ * Private typedef
+ *********************************************************************************************************************/
+typedef struct {
+	uint32_t *stack_top;
+	/* What the kernel saves and hands back for the thread, it identifies the context below */
+	uint32_t *stack_pointer;
+	KernelThreadCb_t entry;
+	KernelThreadCb_t exit;
+	ucontext_t context;
+} sKernelPortHostThread_t;
+
+typedef struct {
+	uint32_t primask;
+	uint32_t ipsr;
+	bool is_switch_pending;
+	uint32_t tick;
+	/* The running thread's saved stack pointer as the kernel knows it, NULL outside Kernel_Start */
+	uint32_t *stack_pointer;
+	size_t thread_count;
+	sKernelPortHostThread_t threads[eKernelThread_Last];
+	ucontext_t host_context;
+} sKernelPortHost_t;
+/**********************************************************************************************************************
+ * Private constants
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Private variables
+ *********************************************************************************************************************/
+static sKernelPortHost_t dyn_port = {0};
+static uint8_t dyn_thread_stacks[eKernelThread_Last][KERNEL_PORT_HOST_STACK_BYTES] __attribute__((aligned(16)));
+/**********************************************************************************************************************
+ * Prototypes of private functions
+ *********************************************************************************************************************/
+static sKernelPortHostThread_t *Kernel_Port_Host_Find (const uint32_t *stack_pointer);
+static void Kernel_Port_Host_EnterThread (void);
+static void Kernel_Port_Host_PendSV (void);
+static void Kernel_Port_Host_TakePending (void);
+/**********************************************************************************************************************
+ * Definitions of private functions
+ *********************************************************************************************************************/
+static sKernelPortHostThread_t *Kernel_Port_Host_Find (const uint32_t *stack_pointer) {
+	for (size_t i = 0; i < dyn_port.thread_count; i++) {
+		if (dyn_port.threads[i].stack_pointer == stack_pointer) {
+			return &dyn_port.threads[i];
+		}
+	}
+
+	fprintf(stderr, "kernel port: no thread saved at %p\n", (const void *) stack_pointer);
+	abort();
+}
+
+/* The first switch to a thread returns to thread mode unmasked, like the exception return on the target */
+static void Kernel_Port_Host_EnterThread (void) {
+	sKernelPortHostThread_t *thread = Kernel_Port_Host_Find(dyn_port.stack_pointer);
+
+	dyn_port.ipsr = 0;
+	dyn_port.primask = 0;
+	thread->entry();
+	thread->exit();
+}
+
+/* The kernel picks the incoming thread exactly as from the target's PendSV_Handler; the bottom halves are left out */
+static void Kernel_Port_Host_PendSV (void) {
+	uint32_t *outgoing = dyn_port.stack_pointer;
+
+	dyn_port.is_switch_pending = false;
+	dyn_port.ipsr = KERNEL_PORT_HOST_PENDSV_IRQ;
+
+	uint32_t *incoming = Kernel_SwitchContext(outgoing);
+
+	if (incoming != outgoing) {
+		sKernelPortHostThread_t *from = Kernel_Port_Host_Find(outgoing);
+		sKernelPortHostThread_t *to = Kernel_Port_Host_Find(incoming);
+
+		dyn_port.stack_pointer = incoming;
+		swapcontext(&from->context, &to->context);
+	}
+
+	/* Back on this thread: whoever switched here did so from its own PendSV, with the mask clear */
+	dyn_port.ipsr = 0;
+	dyn_port.primask = 0;
+}
+
+/* PendSV has the lowest priority: taken only from thread mode with the mask clear */
+static void Kernel_Port_Host_TakePending (void) {
+	bool is_thread_mode = (dyn_port.stack_pointer != NULL) && (dyn_port.ipsr == 0U);
+
+	while (dyn_port.is_switch_pending && is_thread_mode && (dyn_port.primask == 0U)) {
+		Kernel_Port_Host_PendSV();
+	}
+}
+/**********************************************************************************************************************
+ * Definitions of exported functions
+ *********************************************************************************************************************/
+uint32_t *Kernel_Port_InitStack (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit) {
+	sKernelPortHostThread_t *thread = NULL;
+
+	/* A thread created again after Kernel_Init reuses its slot */
+	for (size_t i = 0; i < dyn_port.thread_count; i++) {
+		if (dyn_port.threads[i].stack_top == stack_top) {
+			thread = &dyn_port.threads[i];
+		}
+	}
+
+	if (thread == NULL) {
+		if (dyn_port.thread_count == eKernelThread_Last) {
+			fprintf(stderr, "kernel port: more than %u thread stacks\n", (unsigned) eKernelThread_Last);
+			abort();
+		}
+
+		thread = &dyn_port.threads[dyn_port.thread_count++];
+	}
+
+	uint8_t *host_stack = dyn_thread_stacks[thread - dyn_port.threads];
+
+	thread->stack_top = stack_top;
+	thread->stack_pointer = stack_top - KERNEL_PORT_HOST_FRAME_WORDS;
+	thread->entry = entry;
+	thread->exit = exit;
+	memset(thread->stack_pointer, 0, KERNEL_PORT_HOST_FRAME_WORDS * sizeof(uint32_t));
+
+	getcontext(&thread->context);
+	thread->context.uc_stack.ss_sp = host_stack;
+	thread->context.uc_stack.ss_size = KERNEL_PORT_HOST_STACK_BYTES;
+	thread->context.uc_link = NULL;
+	makecontext(&thread->context, Kernel_Port_Host_EnterThread, 0);
+
+	return thread->stack_pointer;
+}
+
+void Kernel_Port_Start (uint32_t *stack_top, KernelThreadCb_t entry, KernelThreadCb_t exit) {
+	(void) entry;
+	(void) exit;
+
+	sKernelPortHostThread_t *thread = Kernel_Port_Host_Find(stack_top - KERNEL_PORT_HOST_FRAME_WORDS);
+
+	dyn_port.is_switch_pending = false;
+	dyn_port.stack_pointer = thread->stack_pointer;
+	swapcontext(&dyn_port.host_context, &thread->context);
+}
+
+void Kernel_Port_Yield (void) {
+	dyn_port.is_switch_pending = true;
+	Kernel_Port_Host_TakePending();
+}
+
+void Kernel_Port_Host_Interrupt (uint32_t irq, KernelPortHostIrqCb_t handler) {
+	uint32_t preempted_ipsr = dyn_port.ipsr;
+	uint32_t preempted_primask = dyn_port.primask;
+
+	dyn_port.ipsr = irq;
+	dyn_port.primask = 0;
+	handler();
+	dyn_port.ipsr = preempted_ipsr;
+	dyn_port.primask = preempted_primask;
+
+	Kernel_Port_Host_TakePending();
+}
+
+void Kernel_Port_Host_Tick (void) {
+	dyn_port.tick++;
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_SYSTICK_IRQ, Kernel_OnTick);
+}
+
+void Kernel_Port_Host_Stop (void) {
+	sKernelPortHostThread_t *thread = Kernel_Port_Host_Find(dyn_port.stack_pointer);
+
+	dyn_port.stack_pointer = NULL;
+	dyn_port.primask = 0;
+	swapcontext(&thread->context, &dyn_port.host_context);
+}
+
+uint32_t HAL_GetTick (void) {
+	return dyn_port.tick;
+}
+
+uint32_t Kernel_Port_Host_GetPrimask (void) {
+	return dyn_port.primask;
+}
+
+void Kernel_Port_Host_SetPrimask (uint32_t primask) {
+	dyn_port.primask = primask;
+	Kernel_Port_Host_TakePending();
+}
+
+uint32_t Kernel_Port_Host_GetIpsr (void) {
+	return dyn_port.ipsr;
+}
+
+/* Stands in for the idle thread's WFI: nothing else raises interrupts on the host, so the next one is SysTick */
+void Power_Manager_Idle (void) {
+	if (dyn_port.tick >= KERNEL_PORT_HOST_MAX_TICKS) {
+		fprintf(stderr, "kernel port: still running after %u ticks\n", (unsigned) dyn_port.tick);
+		exit(EXIT_FAILURE);
+	}
+
+	Kernel_Port_Host_Tick();
+}
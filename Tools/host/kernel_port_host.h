@@ -0,0 +1,49 @@
+#ifndef HOST_KERNEL_PORT_HOST_H_
+#define HOST_KERNEL_PORT_HOST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+#include "kernel_port.h"
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Exception numbers the simulated IPSR reads while a handler runs */
+#define KERNEL_PORT_HOST_PENDSV_IRQ		14U
+#define KERNEL_PORT_HOST_SYSTICK_IRQ	15U
+#define KERNEL_PORT_HOST_EXTERNAL_IRQ	16U
+
+/* Idle sleeps one tick at a time; a run that has not stopped after this long is treated as hung */
+#define KERNEL_PORT_HOST_MAX_TICKS		600000U
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+typedef void (*KernelPortHostIrqCb_t) (void);
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+/*
+ * The host port: threads run on ucontext stacks of their own, the firmware stacks only carry the initial frame so the
+ * stack statistics match the target. A switch happens where PendSV would be taken: when an interrupt returns or the
+ * mask is lifted with a yield pending.
+ */
+/* Runs handler as interrupt irq on top of whatever runs now; a switch it pends is taken once it returns, if unmasked */
+void Kernel_Port_Host_Interrupt (uint32_t irq, KernelPortHostIrqCb_t handler);
+/* Advances HAL_GetTick by one and runs Kernel_OnTick as SysTick */
+void Kernel_Port_Host_Tick (void);
+/* Thread context: leaves the kernel for good, Kernel_Start returns to its caller */
+void Kernel_Port_Host_Stop (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_KERNEL_PORT_HOST_H_ */
@@ -0,0 +1,55 @@
+#ifndef HOST_STM32F4XX_HAL_H_
+#define HOST_STM32F4XX_HAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**********************************************************************************************************************
+ * Includes
+ *********************************************************************************************************************/
+#include <stdint.h>
+/**********************************************************************************************************************
+ * Exported definitions and macros
+ *********************************************************************************************************************/
+/* Just the CMSIS intrinsics and HAL calls the kernel uses, on the simulated core of kernel_port_host.c */
+#define __disable_irq()				Kernel_Port_Host_SetPrimask(1U)
+#define __enable_irq()				Kernel_Port_Host_SetPrimask(0U)
+#define __get_PRIMASK()				Kernel_Port_Host_GetPrimask()
+#define __set_PRIMASK(primask)		Kernel_Port_Host_SetPrimask(primask)
+#define __get_IPSR()				Kernel_Port_Host_GetIpsr()
+/**********************************************************************************************************************
+ * Exported types
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Exported variables
+ *********************************************************************************************************************/
+
+/**********************************************************************************************************************
+ * Prototypes of exported functions
+ *********************************************************************************************************************/
+uint32_t HAL_GetTick (void);
+uint32_t Kernel_Port_Host_GetPrimask (void);
+/* Clearing the mask takes a pending switch, as the core would once PendSV is no longer masked */
+void Kernel_Port_Host_SetPrimask (uint32_t primask);
+uint32_t Kernel_Port_Host_GetIpsr (void);
+
+static inline uint32_t __RBIT (uint32_t value) {
+	uint32_t result = 0;
+
+	for (uint32_t bit = 0; bit < 32U; bit++) {
+		result = (result << 1) | ((value >> bit) & 1U);
+	}
+
+	return result;
+}
+
+static inline uint8_t __CLZ (uint32_t value) {
+	return (value == 0U) ? 32U : (uint8_t) __builtin_clz(value);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_STM32F4XX_HAL_H_ */
@@ -0,0 +1,207 @@
+/* kernel_test - runs the firmware kernel on the host port, checks wakeups from interrupts, preemption and mutexes */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "kernel.h"
+#include "kernel_port_host.h"
+#include "stm32f4xx_hal.h"
+
+namespace {
+
+constexpr size_t kStackBytes = 1024;
+constexpr size_t kInitialFrameBytes = 17 * sizeof(uint32_t);
+constexpr uint32_t kStorageItem = 42;
+
+uint64_t dsp_stack[kStackBytes / sizeof(uint64_t)];
+uint64_t storage_stack[kStackBytes / sizeof(uint64_t)];
+uint64_t telemetry_stack[kStackBytes / sizeof(uint64_t)];
+uint64_t housekeeping_stack[kStackBytes / sizeof(uint64_t)];
+
+sKernelSem_t dsp_sem;
+sKernelSem_t never_sem;
+sKernelMutex_t mutex;
+uint32_t storage_items[4];
+sKernelQueue_t storage_queue;
+uint32_t full_items[2];
+sKernelQueue_t full_queue;
+
+/* One letter per thread step in the order they ran: D and S on a wakeup, T and t around the telemetry timeout, M once
+ * the DSP thread got the mutex */
+std::string order;
+std::vector<uint32_t> received;
+uint32_t telemetry_wake_tick = 0;
+uint32_t telemetry_timeout_tick = 0;
+bool is_timeout_taken = true;
+bool is_mutex_phase = false;
+unsigned failures = 0;
+
+void Check (bool condition, const char *text, int line) {
+	if (!condition) {
+		fprintf(stderr, "kernel_test.cpp:%d: check failed: %s\n", line, text);
+		failures++;
+	}
+}
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+void DspThread () {
+	while (true) {
+		if (Kernel_SemTake(&dsp_sem, KERNEL_WAIT_FOREVER)) {
+			order += 'D';
+
+			if (is_mutex_phase) {
+				CHECK(Kernel_MutexLock(&mutex, KERNEL_WAIT_FOREVER));
+				order += 'M';
+				CHECK(Kernel_MutexUnlock(&mutex));
+			}
+		}
+	}
+}
+
+void StorageThread () {
+	while (true) {
+		uint32_t item = 0;
+
+		if (Kernel_QueueReceive(&storage_queue, &item, KERNEL_WAIT_FOREVER)) {
+			order += 'S';
+			received.push_back(item);
+		}
+	}
+}
+
+void TelemetryThread () {
+	Kernel_Delay(10);
+	telemetry_wake_tick = HAL_GetTick();
+	order += 'T';
+
+	is_timeout_taken = Kernel_SemTake(&never_sem, 5);
+	telemetry_timeout_tick = HAL_GetTick();
+	order += 't';
+
+	while (true) {
+		Kernel_Delay(KERNEL_WAIT_FOREVER);
+	}
+}
+
+/* Handlers never switch themselves, the thread they wake runs once the interrupt has returned */
+void GiveDspIsr () {
+	size_t length = order.size();
+
+	CHECK(Kernel_SemGive(&dsp_sem));
+	CHECK(order.size() == length);
+	/* Would block in a thread, from an interrupt it fails right away */
+	CHECK(!Kernel_SemTake(&never_sem, 100));
+}
+
+void SendStorageIsr () {
+	CHECK(Kernel_QueueSend(&storage_queue, &kStorageItem, KERNEL_WAIT_FOREVER));
+	CHECK(order.size() == 1);
+}
+
+/* Wakes the DSP thread above the mutex owner and the storage thread in between */
+void WakeBothIsr () {
+	CHECK(Kernel_QueueSend(&storage_queue, &kStorageItem, 0));
+	CHECK(Kernel_SemGive(&dsp_sem));
+	CHECK(!Kernel_MutexLock(&mutex, 100));
+}
+
+void FillQueueIsr () {
+	uint32_t item = 0;
+
+	CHECK(Kernel_QueueSend(&full_queue, &item, 0));
+	CHECK(Kernel_QueueSend(&full_queue, &item, 0));
+	CHECK(!Kernel_QueueSend(&full_queue, &item, KERNEL_WAIT_FOREVER));
+}
+
+/* Lowest priority but the idle thread, so it only runs while every other thread waits */
+void HousekeepingThread () {
+	CHECK(order.empty());
+	CHECK(HAL_GetTick() == 0);
+
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_EXTERNAL_IRQ, GiveDspIsr);
+	CHECK(order == "D");
+
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_EXTERNAL_IRQ, SendStorageIsr);
+	CHECK(order == "DS");
+	CHECK((received.size() == 1) && (received[0] == kStorageItem));
+
+	/* Masked, the wakeup waits for the mask to be lifted */
+	__disable_irq();
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_EXTERNAL_IRQ, GiveDspIsr);
+	CHECK(order == "DS");
+	__enable_irq();
+	CHECK(order == "DSD");
+
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_EXTERNAL_IRQ, FillQueueIsr);
+	CHECK(order == "DSD");
+
+	/* Ticks only pass in the idle thread, the telemetry thread wakes and times out meanwhile */
+	Kernel_Delay(20);
+	CHECK(HAL_GetTick() == 20);
+	CHECK(order == "DSDTt");
+	CHECK(telemetry_wake_tick == 10);
+	CHECK(telemetry_timeout_tick == 15);
+	CHECK(!is_timeout_taken);
+
+	/* A give from a thread preempts it before the call returns */
+	CHECK(Kernel_SemGive(&dsp_sem));
+	CHECK(order == "DSDTtD");
+
+	sKernelThreadStats_t stats = {};
+
+	CHECK(Kernel_GetStats(eKernelThread_Dsp, &stats));
+	CHECK(stats.switches == 4);
+	CHECK(stats.stack_free_bytes == (kStackBytes - kInitialFrameBytes));
+
+	/* Holding the mutex the DSP thread waits for, this thread runs ahead of the storage thread until it unlocks */
+	CHECK(!Kernel_MutexUnlock(&mutex));
+	CHECK(Kernel_MutexLock(&mutex, KERNEL_WAIT_FOREVER));
+	CHECK(!Kernel_MutexLock(&mutex, 0));
+	is_mutex_phase = true;
+	Kernel_Port_Host_Interrupt(KERNEL_PORT_HOST_EXTERNAL_IRQ, WakeBothIsr);
+	CHECK(order == "DSDTtDD");
+	CHECK(Kernel_MutexUnlock(&mutex));
+	CHECK(order == "DSDTtDDMS");
+
+	Kernel_Port_Host_Stop();
+}
+
+}
+
+int main () {
+	const sKernelThreadInit_t threads[] = {
+		{eKernelThread_Dsp, DspThread, dsp_stack, sizeof(dsp_stack)},
+		{eKernelThread_Storage, StorageThread, storage_stack, sizeof(storage_stack)},
+		{eKernelThread_Telemetry, TelemetryThread, telemetry_stack, sizeof(telemetry_stack)},
+		{eKernelThread_Housekeeping, HousekeepingThread, housekeeping_stack, sizeof(housekeeping_stack)}
+	};
+
+	CHECK(Kernel_Init());
+
+	for (const sKernelThreadInit_t &thread : threads) {
+		CHECK(Kernel_InitThread(&thread));
+	}
+
+	CHECK(Kernel_SemInit(&dsp_sem, 0, 1));
+	CHECK(Kernel_SemInit(&never_sem, 0, 1));
+	CHECK(Kernel_MutexInit(&mutex));
+	CHECK(Kernel_QueueInit(&storage_queue, storage_items, sizeof(storage_items[0]), 4));
+	CHECK(Kernel_QueueInit(&full_queue, full_items, sizeof(full_items[0]), 2));
+
+	/* Returns once the housekeeping thread stops the host port */
+	Kernel_Start();
+
+	CHECK(order == "DSDTtDDMS");
+
+	if (failures != 0) {
+		fprintf(stderr, "kernel_test: %u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("kernel_test: ok\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,364 @@
+#include "log_image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32.h"
+
+namespace {
+
+constexpr size_t kMbrTableOffset = 446;
+constexpr size_t kMbrEntrySize = 16;
+constexpr size_t kMbrEntryCount = 4;
+
+uint32_t ReadLe32 (const uint8_t *p) {
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+}
+
+LogImage::~LogImage () {
+	if (m_data != nullptr) {
+		munmap((void *) m_data, m_size);
+	}
+
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+bool LogImage::Open (const std::string &path, std::string &error) {
+	m_fd = open(path.c_str(), O_RDONLY);
+
+	if (m_fd < 0) {
+		error = "cannot open " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(m_fd, &st) != 0) {
+		error = "cannot stat " + path;
+		return false;
+	}
+
+	off_t size = st.st_size;
+
+	/* Block devices report a zero st_size, ask the device instead */
+	if (size == 0) {
+		size = lseek(m_fd, 0, SEEK_END);
+	}
+
+	if (size < (off_t) LOG_SECTOR_SIZE) {
+		error = path + " is too small to hold a log";
+		return false;
+	}
+
+	void *data = mmap(nullptr, (size_t) size, PROT_READ, MAP_SHARED, m_fd, 0);
+
+	if (data == MAP_FAILED) {
+		error = "cannot map " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	m_data = (const uint8_t *) data;
+	m_size = (size_t) size;
+	madvise(data, m_size, MADV_SEQUENTIAL);
+
+	return true;
+}
+
+bool LogImage::SelectPartition (int64_t first_lba, std::string &error) {
+	uint64_t image_sectors = m_size / LOG_SECTOR_SIZE;
+
+	if (first_lba >= 0) {
+		if ((uint64_t) first_lba >= image_sectors) {
+			error = "offset is past the end of the image";
+			return false;
+		}
+
+		m_first_lba = (uint64_t) first_lba;
+		m_sector_count = image_sectors - m_first_lba;
+		LoadSuperblock();
+
+		return true;
+	}
+
+	const uint8_t *mbr = m_data;
+
+	if ((mbr[510] != 0x55) || (mbr[511] != 0xAA)) {
+		error = "no MBR signature, pass --offset to read a bare partition";
+		return false;
+	}
+
+	for (size_t i = 0; i < kMbrEntryCount; i++) {
+		const uint8_t *entry = &mbr[kMbrTableOffset + (i * kMbrEntrySize)];
+
+		if (entry[4] != LOG_PARTITION_TYPE) {
+			continue;
+		}
+
+		m_first_lba = ReadLe32(&entry[8]);
+		m_sector_count = ReadLe32(&entry[12]);
+
+		if ((m_first_lba + m_sector_count) > image_sectors) {
+			/* Truncated image, keep what is there */
+			m_sector_count = (m_first_lba < image_sectors) ? (image_sectors - m_first_lba) : 0;
+		}
+
+		LoadSuperblock();
+
+		return m_sector_count > 0;
+	}
+
+	error = "no log partition (type 0xDA) in the MBR";
+
+	return false;
+}
+
+void LogImage::LoadSuperblock () {
+	m_data_lba = m_first_lba;
+
+	if (m_sector_count <= LOG_INDEX_FIRST_SECTOR) {
+		return;
+	}
+
+	const uint8_t *copy_a = &m_data[m_first_lba * LOG_SECTOR_SIZE];
+	const uint8_t *copy_b = copy_a + LOG_SECTOR_SIZE;
+
+	if (!Log_Recovery_PickSuperblock(copy_a, copy_b, &m_superblock) || ((m_superblock.data_first + (uint64_t) m_superblock.data_count) > m_sector_count)) {
+		return;
+	}
+
+	m_has_superblock = true;
+	m_data_lba = m_first_lba + m_superblock.data_first;
+	m_sector_count = m_superblock.data_count;
+}
+
+const uint8_t *LogImage::Sector (uint64_t index) const {
+	return &m_data[(m_data_lba + index) * LOG_SECTOR_SIZE];
+}
+
+uint32_t LogImage::IndexEntryCount () const {
+	if (!m_has_superblock) {
+		return 0;
+	}
+
+	return (m_superblock.data_count + LOG_INDEX_INTERVAL - 1U) / LOG_INDEX_INTERVAL;
+}
+
+bool LogImage::IndexEntry (uint32_t entry, sLogIndexEntry_t &out) const {
+	uint32_t sector_number = entry / LOG_INDEX_ENTRIES_PER_SECTOR;
+
+	if ((entry >= IndexEntryCount()) || (sector_number >= m_superblock.index_sectors)) {
+		return false;
+	}
+
+	const uint8_t *sector = &m_data[(m_first_lba + m_superblock.index_first + sector_number) * LOG_SECTOR_SIZE];
+	sLogIndexSector_t index;
+
+	memcpy(&index, sector, sizeof(index));
+
+	uint32_t expected = index.crc32;
+
+	index.crc32 = 0;
+
+	if (CRC32_Compute(&index, sizeof(index)) != expected) {
+		return false;
+	}
+
+	out = index.entries[entry % LOG_INDEX_ENTRIES_PER_SECTOR];
+
+	return true;
+}
+
+void Log_DecodeSector (const uint8_t *sector, const sLogSectorHeader_t &header, std::vector<LogRecord> &records) {
+	const uint8_t *payload = &sector[LOG_SECTOR_HEADER_SIZE];
+	size_t position = 0;
+
+	while ((position + LOG_RECORD_HEADER_SIZE) <= header.payload_bytes) {
+		uint8_t type = payload[position];
+		uint8_t length = payload[position + 1];
+
+		if ((type == eLogRecord_End) || ((position + LOG_RECORD_HEADER_SIZE + length) > header.payload_bytes)) {
+			break;
+		}
+
+		const uint8_t *body = &payload[position + LOG_RECORD_HEADER_SIZE];
+		LogRecord record;
+
+		record.type = type;
+		record.payload.assign(body, body + length);
+		record.timestamp_ms = header.timestamp_ms + ((length >= 4) ? (int64_t) (int32_t) ReadLe32(body) : 0);
+		records.push_back(std::move(record));
+
+		position += LOG_RECORD_HEADER_SIZE + length;
+	}
+}
+
+namespace {
+
+bool ReadImageSector (void *context, uint32_t index, uint8_t *sector) {
+	const LogImage *image = (const LogImage *) context;
+
+	memcpy(sector, image->Sector(index), LOG_SECTOR_SIZE);
+
+	return true;
+}
+
+bool LoadSector (const LogImage &image, uint64_t index, LogSector &sector) {
+	if (!Log_Recovery_IsValidSector(image.Sector(index), &sector.header)) {
+		return false;
+	}
+
+	sector.index = index;
+	Log_DecodeSector(image.Sector(index), sector.header, sector.records);
+
+	return true;
+}
+
+}
+
+bool Log_RecoverHead (const LogImage &image, LogTimelineInfo &info) {
+	info = LogTimelineInfo();
+
+	if (image.HasSuperblock()) {
+		sLogPosition_t checkpoint = {image.Superblock().head, image.Superblock().sequence};
+
+		info.is_recovered = Log_Recovery_FindHead(ReadImageSector, (void *) &image, (uint32_t) image.SectorCount(), &checkpoint, &info.head, &info.recovery_reads);
+	}
+
+	return info.is_recovered;
+}
+
+bool Log_IsCurrent (const LogImage &image, const sLogPosition_t &head, uint64_t index, uint32_t sequence) {
+	uint64_t count = image.SectorCount();
+	uint32_t age = head.sequence - sequence;
+
+	if ((age == 0) || (age > count)) {
+		return false;
+	}
+
+	return index == ((head.head + count - age) % count);
+}
+
+std::vector<LogSector> Log_ReadTimeline (const LogImage &image, LogTimelineInfo &info) {
+	std::vector<LogSector> sectors;
+
+	if (Log_RecoverHead(image, info)) {
+		uint64_t count = image.SectorCount();
+
+		/* Walk back from the head while sequence numbers stay consecutive; dropped sectors end the chain */
+		for (uint64_t back = 1; back <= count; back++) {
+			LogSector sector;
+			uint64_t index = (info.head.head + count - (back % count)) % count;
+
+			if (!LoadSector(image, index, sector) || (sector.header.sequence != (uint32_t) (info.head.sequence - back))) {
+				break;
+			}
+
+			sectors.push_back(std::move(sector));
+		}
+
+		std::reverse(sectors.begin(), sectors.end());
+		info.invalid_sectors = count - sectors.size();
+
+		return sectors;
+	}
+
+	for (uint64_t index = 0; index < image.SectorCount(); index++) {
+		LogSector sector;
+
+		if (!LoadSector(image, index, sector)) {
+			info.invalid_sectors++;
+			continue;
+		}
+
+		sectors.push_back(std::move(sector));
+	}
+
+	std::sort(sectors.begin(), sectors.end(), [] (const LogSector &a, const LogSector &b) {
+		return a.header.sequence < b.header.sequence;
+	});
+
+	return sectors;
+}
+
+/*
+ * Index entries in ring order from the oldest slot are sorted by time, with never-written or overwritten entries only
+ * at the old end, so a binary search finds the last slot starting at or before from_ms in log2(entries) index reads.
+ */
+std::vector<LogSector> Log_ReadRange (const LogImage &image, uint64_t from_ms, uint64_t to_ms, LogTimelineInfo &info) {
+	std::vector<LogSector> sectors;
+
+	if (!Log_RecoverHead(image, info) || (image.IndexEntryCount() == 0)) {
+		for (LogSector &sector : Log_ReadTimeline(image, info)) {
+			if (sector.header.timestamp_ms <= to_ms) {
+				sectors.push_back(std::move(sector));
+			}
+		}
+
+		return sectors;
+	}
+
+	uint64_t count = image.SectorCount();
+	uint32_t entries = image.IndexEntryCount();
+	uint32_t head_entry = info.head.head / LOG_INDEX_INTERVAL;
+	auto entry_at = [&] (uint32_t position) {
+		return (head_entry + 1U + position) % entries;
+	};
+	auto is_before = [&] (uint32_t position) {
+		sLogIndexEntry_t entry;
+		uint32_t slot = entry_at(position);
+
+		info.sector_reads++;
+
+		if (!image.IndexEntry(slot, entry) || !Log_IsCurrent(image, info.head, (uint64_t) slot * LOG_INDEX_INTERVAL, entry.sequence)) {
+			return true;
+		}
+
+		return entry.timestamp_ms <= from_ms;
+	};
+
+	uint32_t low = 0;
+	uint32_t high = entries;
+
+	while (low < high) {
+		uint32_t middle = low + ((high - low) / 2U);
+
+		if (is_before(middle)) {
+			low = middle + 1U;
+		} else {
+			high = middle;
+		}
+	}
+
+	/* Start at the last slot that begins no later than from_ms, or at the oldest slot if none does */
+	uint64_t index = (uint64_t) entry_at((low == 0) ? 0 : (low - 1U)) * LOG_INDEX_INTERVAL;
+
+	for (uint64_t step = 0; step < count; step++, index = (index + 1) % count) {
+		LogSector sector;
+
+		if (index == info.head.head) {
+			break;
+		}
+
+		info.sector_reads++;
+
+		if (!LoadSector(image, index, sector) || !Log_IsCurrent(image, info.head, index, sector.header.sequence)) {
+			continue;
+		}
+
+		if (sector.header.timestamp_ms > to_ms) {
+			break;
+		}
+
+		sectors.push_back(std::move(sector));
+	}
+
+	return sectors;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log_format.h"
+#include "log_recovery.h"
+
+/* Read-only view of a card image (or block device) holding a raw log partition */
+class LogImage {
+public:
+	~LogImage ();
+
+	bool Open (const std::string &path, std::string &error);
+	/* Locates the log partition through the MBR unless an explicit start LBA is given */
+	bool SelectPartition (int64_t first_lba, std::string &error);
+
+	uint64_t PartitionLba () const { return m_first_lba; }
+	/* Ring geometry: from the superblock when there is one, otherwise the whole partition */
+	bool HasSuperblock () const { return m_has_superblock; }
+	const sLogSuperblock_t &Superblock () const { return m_superblock; }
+	uint64_t DataLba () const { return m_data_lba; }
+	uint64_t SectorCount () const { return m_sector_count; }
+	const uint8_t *Sector (uint64_t index) const;
+	/* Entry from a CRC-valid index sector; whether it is still current is up to the caller */
+	bool IndexEntry (uint32_t entry, sLogIndexEntry_t &out) const;
+	uint32_t IndexEntryCount () const;
+
+private:
+	void LoadSuperblock ();
+
+	bool m_has_superblock = false;
+	sLogSuperblock_t m_superblock = {};
+	uint64_t m_data_lba = 0;
+	int m_fd = -1;
+	const uint8_t *m_data = nullptr;
+	size_t m_size = 0;
+	uint64_t m_first_lba = 0;
+	uint64_t m_sector_count = 0;
+};
+
+struct LogRecord {
+	uint8_t type;
+	uint64_t timestamp_ms;
+	std::vector<uint8_t> payload;
+};
+
+struct LogSector {
+	uint64_t index;
+	sLogSectorHeader_t header;
+	std::vector<LogRecord> records;
+};
+
+/* Splits a validated sector into records with absolute timestamps */
+void Log_DecodeSector (const uint8_t *sector, const sLogSectorHeader_t &header, std::vector<LogRecord> &records);
+struct LogTimelineInfo {
+	uint64_t invalid_sectors = 0;
+	bool is_recovered = false;
+	sLogPosition_t head = {};
+	uint32_t recovery_reads = 0;
+	/* Data and index sectors touched by a range query, on top of the recovery reads */
+	uint64_t sector_reads = 0;
+};
+
+/* Finds the head from the superblock checkpoint; false when there is no superblock or the chain is broken */
+bool Log_RecoverHead (const LogImage &image, LogTimelineInfo &info);
+/* True when a sector with this sequence at this ring index belongs to the lap ending at the head */
+bool Log_IsCurrent (const LogImage &image, const sLogPosition_t &head, uint64_t index, uint32_t sequence);
+
+/*
+ * Returns the current log oldest first. With a superblock this is the chain of consecutive sequence numbers ending
+ * at the recovered head, the same walk the firmware does at boot; without one every valid sector is sorted.
+ */
+std::vector<LogSector> Log_ReadTimeline (const LogImage &image, LogTimelineInfo &info);
+/* Sectors overlapping [from_ms, to_ms], located through the sparse index when the log has one */
+std::vector<LogSector> Log_ReadRange (const LogImage &image, uint64_t from_ms, uint64_t to_ms, LogTimelineInfo &info);
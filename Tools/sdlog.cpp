@@ -0,0 +1,513 @@
+/* sdlog - inspect and export the raw log partition written by the sound logger */
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "audio_decode.hpp"
+#include "level_codec.h"
+#include "log_image.hpp"
+
+namespace {
+
+struct Options {
+	std::string image;
+	std::string outdir;
+	std::string format = "csv";
+	int64_t offset = -1;
+	bool has_range = false;
+	uint64_t from_ms = 0;
+	uint64_t to_ms = UINT64_MAX;
+};
+
+/* One exported table: named columns filled row by row, written as CSV or one raw file per column */
+class Table {
+public:
+	enum class Kind { U64, U32, I32 };
+
+	void AddColumn (const std::string &name, Kind kind) {
+		m_columns.push_back({name, kind, {}});
+	}
+
+	void AddRow (const std::vector<int64_t> &values) {
+		for (size_t i = 0; i < m_columns.size(); i++) {
+			m_columns[i].values.push_back(values[i]);
+		}
+	}
+
+	size_t Rows () const {
+		return m_columns.empty() ? 0 : m_columns[0].values.size();
+	}
+
+	bool WriteCsv (const std::string &path) const;
+	bool WriteColumnar (const std::string &dir) const;
+
+private:
+	struct Column {
+		std::string name;
+		Kind kind;
+		std::vector<int64_t> values;
+	};
+
+	std::vector<Column> m_columns;
+};
+
+bool Table::WriteCsv (const std::string &path) const {
+	FILE *file = fopen(path.c_str(), "w");
+
+	if (file == nullptr) {
+		return false;
+	}
+
+	for (size_t c = 0; c < m_columns.size(); c++) {
+		fprintf(file, "%s%s", (c == 0) ? "" : ",", m_columns[c].name.c_str());
+	}
+
+	fputc('\n', file);
+
+	for (size_t r = 0; r < Rows(); r++) {
+		for (size_t c = 0; c < m_columns.size(); c++) {
+			fprintf(file, "%s%" PRId64, (c == 0) ? "" : ",", m_columns[c].values[r]);
+		}
+
+		fputc('\n', file);
+	}
+
+	return fclose(file) == 0;
+}
+
+bool Table::WriteColumnar (const std::string &dir) const {
+	if ((mkdir(dir.c_str(), 0755) != 0) && (errno != EEXIST)) {
+		return false;
+	}
+
+	std::ofstream schema(dir + "/schema.txt");
+
+	schema << "rows " << Rows() << "\n";
+
+	for (const Column &column : m_columns) {
+		std::ofstream out(dir + "/" + column.name + ".bin", std::ios::binary);
+		const char *type = "i32";
+
+		/* Little-endian fixed-width arrays, directly loadable with numpy.fromfile */
+		for (int64_t value : column.values) {
+			if (column.kind == Kind::U64) {
+				uint64_t v = (uint64_t) value;
+				out.write((const char *) &v, sizeof(v));
+			} else if (column.kind == Kind::U32) {
+				uint32_t v = (uint32_t) value;
+				out.write((const char *) &v, sizeof(v));
+			} else {
+				int32_t v = (int32_t) value;
+				out.write((const char *) &v, sizeof(v));
+			}
+		}
+
+		if (column.kind == Kind::U64) {
+			type = "u64";
+		} else if (column.kind == Kind::U32) {
+			type = "u32";
+		}
+
+		schema << column.name << " " << type << "\n";
+
+		if (!out) {
+			return false;
+		}
+	}
+
+	return (bool) schema;
+}
+
+template <typename T>
+bool ReadPayload (const LogRecord &record, T &out) {
+	if (record.payload.size() < sizeof(T)) {
+		return false;
+	}
+
+	memcpy(&out, record.payload.data(), sizeof(T));
+
+	return true;
+}
+
+struct LevelRow {
+	uint64_t timestamp_ms;
+	uint32_t interval_ms;
+	uint8_t first_band;
+	std::vector<int16_t> values;
+};
+
+/* Expands one packed levels record: the first row is absolute, every later row a delta on the one before */
+bool DecodeLevels (const LogRecord &record, std::vector<LevelRow> &rows) {
+	sLogLevels_t header;
+
+	if (!ReadPayload(record, header) || (header.column_count == 0) || (header.column_count > LEVEL_CODEC_MAX_COLUMNS)) {
+		return false;
+	}
+
+	const uint8_t *data = record.payload.data() + sizeof(header);
+	size_t length = record.payload.size() - sizeof(header);
+	std::vector<int16_t> previous;
+
+	for (uint32_t r = 0; r < header.row_count; r++) {
+		LevelRow row;
+
+		row.timestamp_ms = record.timestamp_ms + ((uint64_t) r * header.interval_ms);
+		row.interval_ms = header.interval_ms;
+		row.first_band = header.first_band;
+		row.values.resize(header.column_count);
+
+		size_t used = Level_Codec_DecodeRow(data, length, previous.empty() ? nullptr : previous.data(), header.column_count, row.values.data());
+
+		if (used == 0) {
+			return false;
+		}
+
+		data += used;
+		length -= used;
+		previous = row.values;
+		rows.push_back(std::move(row));
+	}
+
+	return true;
+}
+
+void Usage () {
+	fprintf(stderr,
+		"usage: sdlog scan <image> [--offset lba]\n"
+		"       sdlog export <image> <outdir> [--format csv|columnar] [--from ms] [--to ms] [--offset lba]\n"
+		"       sdlog decode <recording> <out.wav>\n");
+}
+
+bool ParseOptions (int argc, char **argv, int positional, Options &options) {
+	std::vector<std::string> args;
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if ((arg == "--offset") && ((i + 1) < argc)) {
+			options.offset = strtoll(argv[++i], nullptr, 0);
+		} else if ((arg == "--from") && ((i + 1) < argc)) {
+			options.from_ms = strtoull(argv[++i], nullptr, 0);
+			options.has_range = true;
+		} else if ((arg == "--to") && ((i + 1) < argc)) {
+			options.to_ms = strtoull(argv[++i], nullptr, 0);
+			options.has_range = true;
+		} else if ((arg == "--format") && ((i + 1) < argc)) {
+			options.format = argv[++i];
+		} else {
+			args.push_back(arg);
+		}
+	}
+
+	if ((int) args.size() != positional) {
+		return false;
+	}
+
+	options.image = args[0];
+
+	if (positional > 1) {
+		options.outdir = args[1];
+	}
+
+	return (options.format == "csv") || (options.format == "columnar");
+}
+
+bool OpenImage (const Options &options, LogImage &image) {
+	std::string error;
+
+	if (!image.Open(options.image, error) || !image.SelectPartition(options.offset, error)) {
+		fprintf(stderr, "sdlog: %s\n", error.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int Scan (const Options &options) {
+	LogImage image;
+	LogTimelineInfo info;
+
+	if (!OpenImage(options, image)) {
+		return 1;
+	}
+
+	std::vector<LogSector> sectors = Log_ReadTimeline(image, info);
+	std::map<uint8_t, uint64_t> record_counts;
+
+	printf("partition: lba %" PRIu64 ", ring of %" PRIu64 " sectors at lba %" PRIu64 "\n", image.PartitionLba(), image.SectorCount(), image.DataLba());
+
+	if (image.HasSuperblock()) {
+		const sLogSuperblock_t &superblock = image.Superblock();
+
+		printf("superblock: generation %u, site %u, checkpoint at sector %u sequence %u, %" PRIu64 " ms\n", superblock.generation, superblock.site_id, superblock.head, superblock.sequence, superblock.timestamp_ms);
+		printf("recovered head: sector %u sequence %u in %u reads\n", info.head.head, info.head.sequence, info.recovery_reads);
+		printf("index: %u entries in %u sectors, one per %u data sectors\n", image.IndexEntryCount(), superblock.index_sectors, LOG_INDEX_INTERVAL);
+	} else {
+		printf("superblock: none, falling back to a full scan\n");
+	}
+
+	printf("log sectors: %zu, other: %" PRIu64 "\n", sectors.size(), info.invalid_sectors);
+
+	if (sectors.empty()) {
+		return 0;
+	}
+
+	const LogSector &oldest = sectors.front();
+	const LogSector &newest = sectors.back();
+
+	printf("sequence: %u .. %u\n", oldest.header.sequence, newest.header.sequence);
+	printf("time: %" PRIu64 " .. %" PRIu64 " ms\n", oldest.header.timestamp_ms, newest.header.timestamp_ms);
+
+	for (size_t i = 1; i < sectors.size(); i++) {
+		uint32_t expected = sectors[i - 1].header.sequence + 1U;
+
+		if (sectors[i].header.sequence != expected) {
+			printf("gap: sequence %u .. %u missing\n", expected, sectors[i].header.sequence - 1U);
+		}
+	}
+
+	for (const LogSector &sector : sectors) {
+		for (const LogRecord &record : sector.records) {
+			record_counts[record.type]++;
+		}
+	}
+
+	for (const auto &entry : record_counts) {
+		printf("records of type %u: %" PRIu64 "\n", entry.first, entry.second);
+	}
+
+	return 0;
+}
+
+int Export (const Options &options) {
+	LogImage image;
+	LogTimelineInfo info;
+
+	if (!OpenImage(options, image)) {
+		return 1;
+	}
+
+	if ((mkdir(options.outdir.c_str(), 0755) != 0) && (errno != EEXIST)) {
+		fprintf(stderr, "sdlog: cannot create %s\n", options.outdir.c_str());
+		return 1;
+	}
+
+	std::map<std::string, Table> tables;
+	Table &leq = tables["leq"];
+	Table &events = tables["events"];
+	Table &spectrum = tables["spectrum"];
+	Table &status = tables["status"];
+	std::vector<LevelRow> level_rows;
+	uint64_t damaged_levels = 0;
+
+	leq.AddColumn("timestamp_ms", Table::Kind::U64);
+	leq.AddColumn("duration_ms", Table::Kind::U32);
+	leq.AddColumn("leq_cdb", Table::Kind::I32);
+	leq.AddColumn("lmax_cdb", Table::Kind::I32);
+	leq.AddColumn("lmin_cdb", Table::Kind::I32);
+
+	events.AddColumn("timestamp_ms", Table::Kind::U64);
+	events.AddColumn("duration_ms", Table::Kind::U32);
+	events.AddColumn("peak_cdb", Table::Kind::I32);
+	events.AddColumn("kind", Table::Kind::U32);
+	events.AddColumn("count", Table::Kind::U32);
+
+	spectrum.AddColumn("timestamp_ms", Table::Kind::U64);
+	spectrum.AddColumn("band", Table::Kind::U32);
+	spectrum.AddColumn("level_cdb", Table::Kind::I32);
+
+	status.AddColumn("timestamp_ms", Table::Kind::U64);
+	status.AddColumn("uptime_s", Table::Kind::U32);
+	status.AddColumn("audio_overruns", Table::Kind::U32);
+	status.AddColumn("storage_errors", Table::Kind::U32);
+	status.AddColumn("sectors_written", Table::Kind::U32);
+
+	std::vector<LogSector> sectors = options.has_range ? Log_ReadRange(image, options.from_ms, options.to_ms, info) : Log_ReadTimeline(image, info);
+
+	for (const LogSector &sector : sectors) {
+		for (const LogRecord &record : sector.records) {
+			int64_t t = (int64_t) record.timestamp_ms;
+
+			/* Level records carry rows past their own timestamp and are trimmed per row below */
+			bool is_outside = (record.timestamp_ms < options.from_ms) || (record.timestamp_ms > options.to_ms);
+
+			if (options.has_range && is_outside && (record.type != eLogRecord_Levels)) {
+				continue;
+			}
+
+			switch (record.type) {
+				case eLogRecord_LeqInterval: {
+					sLogLeqInterval_t v;
+
+					if (ReadPayload(record, v)) {
+						leq.AddRow({t, v.duration_ms, v.leq_cdb, v.lmax_cdb, v.lmin_cdb});
+					}
+					break;
+				}
+				case eLogRecord_Event: {
+					sLogEvent_t v;
+
+					if (ReadPayload(record, v)) {
+						events.AddRow({t, v.duration_ms, v.peak_cdb, v.kind, v.count});
+					}
+					break;
+				}
+				case eLogRecord_Spectrum: {
+					sLogSpectrum_t v = {};
+					size_t header = offsetof(sLogSpectrum_t, band_cdb);
+
+					if (record.payload.size() < header) {
+						break;
+					}
+
+					memcpy(&v, record.payload.data(), std::min(record.payload.size(), sizeof(v)));
+
+					size_t bands = std::min<size_t>({v.band_count, LOG_SPECTRUM_MAX_BANDS, (record.payload.size() - header) / sizeof(int16_t)});
+
+					for (size_t b = 0; b < bands; b++) {
+						spectrum.AddRow({t, (int64_t) (v.first_band + b), v.band_cdb[b]});
+					}
+					break;
+				}
+				case eLogRecord_Levels: {
+					if (!DecodeLevels(record, level_rows)) {
+						damaged_levels++;
+					}
+					break;
+				}
+				case eLogRecord_Status: {
+					sLogStatus_t v;
+
+					if (ReadPayload(record, v)) {
+						status.AddRow({t, v.uptime_s, v.audio_overruns, v.storage_errors, v.sectors_written});
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+
+	if (options.has_range) {
+		level_rows.erase(std::remove_if(level_rows.begin(), level_rows.end(), [&] (const LevelRow &row) {
+			return (row.timestamp_ms < options.from_ms) || (row.timestamp_ms > options.to_ms);
+		}), level_rows.end());
+
+		fprintf(stderr, "sdlog: %zu sectors in range, %" PRIu64 " sectors read\n", sectors.size(), info.recovery_reads + info.sector_reads);
+	}
+
+	/* Bands present anywhere in the run become columns, rows that lack them carry INT16_MIN */
+	size_t band_count = 0;
+	uint8_t first_band = UINT8_MAX;
+
+	for (const LevelRow &row : level_rows) {
+		if (row.values.size() > LEVEL_CODEC_FIXED_COLUMNS) {
+			first_band = std::min(first_band, row.first_band);
+		}
+	}
+
+	for (const LevelRow &row : level_rows) {
+		if (row.values.size() > LEVEL_CODEC_FIXED_COLUMNS) {
+			band_count = std::max(band_count, row.first_band - first_band + row.values.size() - LEVEL_CODEC_FIXED_COLUMNS);
+		}
+	}
+
+	Table &levels = tables["levels"];
+
+	levels.AddColumn("timestamp_ms", Table::Kind::U64);
+	levels.AddColumn("interval_ms", Table::Kind::U32);
+	levels.AddColumn("leq_ddb", Table::Kind::I32);
+	levels.AddColumn("lmax_ddb", Table::Kind::I32);
+	levels.AddColumn("lmin_ddb", Table::Kind::I32);
+
+	for (size_t b = 0; b < band_count; b++) {
+		levels.AddColumn("band_" + std::to_string(first_band + b) + "_ddb", Table::Kind::I32);
+	}
+
+	for (const LevelRow &row : level_rows) {
+		std::vector<int64_t> values(5 + band_count, INT16_MIN);
+
+		values[0] = (int64_t) row.timestamp_ms;
+		values[1] = row.interval_ms;
+
+		for (size_t c = 0; c < row.values.size(); c++) {
+			size_t column = (c < LEVEL_CODEC_FIXED_COLUMNS) ? (2 + c) : (5 + (row.first_band - first_band) + (c - LEVEL_CODEC_FIXED_COLUMNS));
+
+			values[column] = row.values[c];
+		}
+
+		levels.AddRow(values);
+	}
+
+	if (damaged_levels != 0) {
+		fprintf(stderr, "sdlog: %" PRIu64 " damaged level records skipped\n", damaged_levels);
+	}
+
+	for (const auto &entry : tables) {
+		std::string base = options.outdir + "/" + entry.first;
+		bool is_written = (options.format == "csv") ? entry.second.WriteCsv(base + ".csv") : entry.second.WriteColumnar(base);
+
+		if (!is_written) {
+			fprintf(stderr, "sdlog: failed to write %s\n", base.c_str());
+			return 1;
+		}
+
+		printf("%s: %zu rows\n", entry.first.c_str(), entry.second.Rows());
+	}
+
+	return 0;
+}
+
+int Decode (const Options &options) {
+	DecodedAudio audio;
+	std::string error;
+
+	if (!Audio_DecodeRecording(options.image, audio, error) || !Audio_WritePcmWav(options.outdir, audio, error)) {
+		fprintf(stderr, "sdlog: %s\n", error.c_str());
+		return 1;
+	}
+
+	printf("%zu samples at %u Hz\n", audio.samples.size(), audio.sample_rate);
+
+	return 0;
+}
+
+}
+
+int main (int argc, char **argv) {
+	Options options;
+
+	if (argc < 2) {
+		Usage();
+		return 2;
+	}
+
+	std::string command = argv[1];
+
+	if ((command == "scan") && ParseOptions(argc, argv, 1, options)) {
+		return Scan(options);
+	}
+
+	if ((command == "export") && ParseOptions(argc, argv, 2, options)) {
+		return Export(options);
+	}
+
+	if ((command == "decode") && ParseOptions(argc, argv, 2, options)) {
+		return Decode(options);
+	}
+
+	Usage();
+
+	return 2;
+}
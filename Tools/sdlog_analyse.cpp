@@ -0,0 +1,494 @@
+/* sdlog_analyse - decode many card images in parallel and report daily noise indicators per site */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "level_codec.h"
+#include "log_image.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+/* Large enough to amortise the task overhead, small enough that 32 GB splits into thousands of stealable pieces */
+constexpr uint64_t kChunkSectors = 8192;
+constexpr int64_t kHourMs = 3600000;
+constexpr int64_t kDayMs = 24 * kHourMs;
+/* Report days run 07:00 to 07:00 local time so each one holds a contiguous day, evening and night period */
+constexpr int64_t kDayStartMs = 7 * kHourMs;
+/* Widest offset in use, UTC-12 to UTC+14 */
+constexpr int64_t kMaxUtcOffsetMs = 14 * kHourMs;
+/* Histogram of levels in 0.1 dB from 0 to 150 dB, weighted by the time spent at each level */
+constexpr int kHistogramBins = 1501;
+
+enum Period {
+	kPeriodDay = 0,
+	kPeriodEvening,
+	kPeriodNight,
+	kPeriodCount
+};
+
+/* Lden penalties in dB and nominal lengths in hours for the day, evening and night periods */
+constexpr double kPeriodPenaltyDb[kPeriodCount] = {0.0, 5.0, 10.0};
+constexpr double kPeriodHours[kPeriodCount] = {12.0, 4.0, 8.0};
+
+struct DayStats {
+	double energy_s[kPeriodCount] = {};
+	double seconds[kPeriodCount] = {};
+	std::vector<uint64_t> histogram_ms = std::vector<uint64_t>(kHistogramBins, 0);
+	uint64_t events[eLogEvent_Last] = {};
+
+	void Merge (const DayStats &other) {
+		for (int p = 0; p < kPeriodCount; p++) {
+			energy_s[p] += other.energy_s[p];
+			seconds[p] += other.seconds[p];
+		}
+
+		for (int b = 0; b < kHistogramBins; b++) {
+			histogram_ms[b] += other.histogram_ms[b];
+		}
+
+		for (int e = 0; e < eLogEvent_Last; e++) {
+			events[e] += other.events[e];
+		}
+	}
+};
+
+/* Site and report day */
+using DayKey = std::pair<uint32_t, int64_t>;
+
+/* Filled by one worker only, merged once all tasks are done */
+struct Partial {
+	std::map<DayKey, DayStats> days;
+	uint64_t sectors = 0;
+	uint64_t records = 0;
+	uint64_t damaged = 0;
+};
+
+struct Source {
+	std::string path;
+	LogImage image;
+	LogTimelineInfo info;
+	uint32_t site = 0;
+	/* Added to the UTC log time before it is split into days and periods */
+	int64_t utc_offset_ms = 0;
+};
+
+struct Options {
+	unsigned threads = 0;
+	int64_t utc_offset_ms = 0;
+	std::string out;
+	std::vector<std::string> images;
+};
+
+/* 10^(L/10) for every histogram bin, so the hot loop never calls pow */
+std::array<double, kHistogramBins> g_energy_lut;
+
+void InitEnergyLut () {
+	for (int b = 0; b < kHistogramBins; b++) {
+		g_energy_lut[b] = std::pow(10.0, b / 100.0);
+	}
+}
+
+int64_t ReportDay (uint64_t timestamp_ms) {
+	int64_t t = (int64_t) timestamp_ms - kDayStartMs;
+
+	return (t >= 0) ? (t / kDayMs) : (((t + 1) / kDayMs) - 1);
+}
+
+Period PeriodOf (uint64_t timestamp_ms) {
+	int64_t hour = (int64_t) ((timestamp_ms % (uint64_t) kDayMs) / (uint64_t) kHourMs);
+
+	if ((hour >= 7) && (hour < 19)) {
+		return kPeriodDay;
+	}
+
+	return ((hour >= 19) && (hour < 23)) ? kPeriodEvening : kPeriodNight;
+}
+
+void AddLevel (Partial &partial, uint32_t site, uint64_t timestamp_ms, uint32_t duration_ms, int32_t level_ddb) {
+	if ((level_ddb == INT16_MIN) || (duration_ms == 0)) {
+		return;
+	}
+
+	DayStats &day = partial.days[{site, ReportDay(timestamp_ms)}];
+	int bin = std::clamp(level_ddb, 0, kHistogramBins - 1);
+	Period period = PeriodOf(timestamp_ms);
+	double seconds = duration_ms / 1000.0;
+
+	day.energy_s[period] += seconds * g_energy_lut[bin];
+	day.seconds[period] += seconds;
+	day.histogram_ms[bin] += duration_ms;
+}
+
+/* Walks the records in place rather than through Log_DecodeSector, which allocates per record */
+void AnalyseSector (const Source &source, uint64_t index, Partial &partial) {
+	const uint8_t *sector = source.image.Sector(index);
+	sLogSectorHeader_t header;
+
+	if (!Log_Recovery_IsValidSector(sector, &header)) {
+		return;
+	}
+
+	if (source.info.is_recovered && !Log_IsCurrent(source.image, source.info.head, index, header.sequence)) {
+		return;
+	}
+
+	partial.sectors++;
+
+	const uint8_t *payload = &sector[LOG_SECTOR_HEADER_SIZE];
+	size_t position = 0;
+
+	while ((position + LOG_RECORD_HEADER_SIZE) <= header.payload_bytes) {
+		uint8_t type = payload[position];
+		uint8_t length = payload[position + 1];
+		const uint8_t *body = &payload[position + LOG_RECORD_HEADER_SIZE];
+
+		if ((type == eLogRecord_End) || ((position + LOG_RECORD_HEADER_SIZE + length) > header.payload_bytes)) {
+			break;
+		}
+
+		position += LOG_RECORD_HEADER_SIZE + length;
+		partial.records++;
+
+		int32_t offset_ms = 0;
+
+		if (length >= sizeof(offset_ms)) {
+			memcpy(&offset_ms, body, sizeof(offset_ms));
+		}
+
+		uint64_t timestamp_ms = header.timestamp_ms + (int64_t) offset_ms + source.utc_offset_ms;
+
+		switch (type) {
+			case eLogRecord_LeqInterval: {
+				sLogLeqInterval_t v;
+
+				if (length >= sizeof(v)) {
+					memcpy(&v, body, sizeof(v));
+					AddLevel(partial, source.site, timestamp_ms, v.duration_ms, v.leq_cdb / 10);
+				}
+				break;
+			}
+			case eLogRecord_Levels: {
+				sLogLevels_t v;
+				int16_t rows[2][LEVEL_CODEC_MAX_COLUMNS];
+
+				if (length < sizeof(v)) {
+					partial.damaged++;
+					break;
+				}
+
+				memcpy(&v, body, sizeof(v));
+
+				if ((v.column_count == 0) || (v.column_count > LEVEL_CODEC_MAX_COLUMNS)) {
+					partial.damaged++;
+					break;
+				}
+
+				const uint8_t *data = body + sizeof(v);
+				size_t remaining = length - sizeof(v);
+
+				for (uint32_t r = 0; r < v.row_count; r++) {
+					int16_t *row = rows[r & 1U];
+					size_t used = Level_Codec_DecodeRow(data, remaining, (r == 0) ? nullptr : rows[(r - 1U) & 1U], v.column_count, row);
+
+					if (used == 0) {
+						partial.damaged++;
+						break;
+					}
+
+					data += used;
+					remaining -= used;
+					AddLevel(partial, source.site, timestamp_ms + ((uint64_t) r * v.interval_ms), v.interval_ms, row[0]);
+				}
+				break;
+			}
+			case eLogRecord_Event: {
+				sLogEvent_t v;
+
+				if (length < sizeof(v)) {
+					break;
+				}
+
+				memcpy(&v, body, sizeof(v));
+
+				if (v.kind < eLogEvent_Last) {
+					partial.days[{source.site, ReportDay(timestamp_ms)}].events[v.kind] += std::max<uint8_t>(v.count, 1);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+}
+
+/* Keeps halving its range and hands the upper halves to the pool, so idle workers always find something to steal */
+void AnalyseRange (ThreadPool &pool, std::vector<Partial> &partials, const Source &source, uint64_t first, uint64_t last) {
+	while ((last - first) > kChunkSectors) {
+		uint64_t middle = first + ((last - first) / 2);
+
+		pool.Submit([&pool, &partials, &source, middle, last] {
+			AnalyseRange(pool, partials, source, middle, last);
+		});
+
+		last = middle;
+	}
+
+	Partial &partial = partials[ThreadPool::CurrentWorker()];
+
+	for (uint64_t index = first; index < last; index++) {
+		AnalyseSector(source, index, partial);
+	}
+}
+
+/* Level exceeded for the given fraction of the measured time */
+double Exceeded (const std::vector<uint64_t> &histogram_ms, double fraction) {
+	uint64_t total = 0;
+
+	for (uint64_t ms : histogram_ms) {
+		total += ms;
+	}
+
+	uint64_t above = 0;
+
+	for (int b = kHistogramBins - 1; b >= 0; b--) {
+		above += histogram_ms[b];
+
+		if ((double) above >= (fraction * (double) total)) {
+			return b / 10.0;
+		}
+	}
+
+	return 0.0;
+}
+
+std::string Level (double energy_s, double seconds, double penalty_db = 0.0) {
+	if (seconds <= 0.0) {
+		return "";
+	}
+
+	char text[16];
+
+	snprintf(text, sizeof(text), "%.1f", (10.0 * std::log10(energy_s / seconds)) + penalty_db);
+
+	return text;
+}
+
+void WriteReport (FILE *out, const std::map<DayKey, DayStats> &days) {
+	fprintf(out, "site,day,hours,ld_db,le_db,ln_db,lden_db,l10_db,l90_db,threshold_events,trigger_events\n");
+
+	for (const auto &entry : days) {
+		const DayStats &day = entry.second;
+		double seconds = day.seconds[kPeriodDay] + day.seconds[kPeriodEvening] + day.seconds[kPeriodNight];
+		std::string lden;
+
+		/* Each period is represented by its own measured mean, Lden is left empty unless all three were covered */
+		if ((day.seconds[kPeriodDay] > 0.0) && (day.seconds[kPeriodEvening] > 0.0) && (day.seconds[kPeriodNight] > 0.0)) {
+			double weighted = 0.0;
+
+			for (int p = 0; p < kPeriodCount; p++) {
+				weighted += kPeriodHours[p] * (day.energy_s[p] / day.seconds[p]) * std::pow(10.0, kPeriodPenaltyDb[p] / 10.0);
+			}
+
+			lden = Level(weighted, 24.0);
+		}
+
+		fprintf(out, "%u,%" PRId64 ",%.2f,%s,%s,%s,%s", entry.first.first, entry.first.second, seconds / 3600.0,
+			Level(day.energy_s[kPeriodDay], day.seconds[kPeriodDay]).c_str(),
+			Level(day.energy_s[kPeriodEvening], day.seconds[kPeriodEvening]).c_str(),
+			Level(day.energy_s[kPeriodNight], day.seconds[kPeriodNight]).c_str(), lden.c_str());
+
+		if (seconds > 0.0) {
+			fprintf(out, ",%.1f,%.1f", Exceeded(day.histogram_ms, 0.10), Exceeded(day.histogram_ms, 0.90));
+		} else {
+			fprintf(out, ",,");
+		}
+
+		fprintf(out, ",%" PRIu64 ",%" PRIu64 "\n", day.events[eLogEvent_Threshold], day.events[eLogEvent_SensorTrigger]);
+	}
+}
+
+void Usage () {
+	fprintf(stderr,
+		"usage: sdlog_analyse [--threads n] [--utc-offset +hh[:mm]] [--out report.csv] <image>...\n"
+		"       images are card images with a log partition or bare log partition dumps;\n"
+		"       the log keeps UTC, --utc-offset gives the site's local time (default +00:00);\n"
+		"       days are numbered from 1970-01-01 in local time and run from 07:00 to 07:00\n");
+}
+
+/* +hh, -hh:mm or hh; no daylight saving, a report spanning a change needs two runs */
+bool ParseUtcOffset (const std::string &text, int64_t &offset_ms) {
+	size_t position = 0;
+	int64_t sign = 1;
+
+	if ((position < text.size()) && ((text[position] == '+') || (text[position] == '-'))) {
+		sign = (text[position] == '-') ? -1 : 1;
+		position++;
+	}
+
+	char *end = nullptr;
+	const char *digits = text.c_str() + position;
+	long hours = strtol(digits, &end, 10);
+	long minutes = 0;
+
+	if ((end == digits) || (hours < 0)) {
+		return false;
+	}
+
+	if (*end == ':') {
+		const char *minute_digits = end + 1;
+
+		minutes = strtol(minute_digits, &end, 10);
+
+		if ((end == minute_digits) || (minutes < 0) || (minutes > 59)) {
+			return false;
+		}
+	}
+
+	if (*end != '\0') {
+		return false;
+	}
+
+	offset_ms = sign * ((hours * kHourMs) + (minutes * 60000));
+
+	return std::llabs(offset_ms) <= kMaxUtcOffsetMs;
+}
+
+bool ParseOptions (int argc, char **argv, Options &options) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if ((arg == "--threads") && ((i + 1) < argc)) {
+			options.threads = (unsigned) strtoul(argv[++i], nullptr, 0);
+		} else if ((arg == "--utc-offset") && ((i + 1) < argc)) {
+			if (!ParseUtcOffset(argv[++i], options.utc_offset_ms)) {
+				return false;
+			}
+		} else if ((arg == "--out") && ((i + 1) < argc)) {
+			options.out = argv[++i];
+		} else if (arg.rfind("--", 0) == 0) {
+			return false;
+		} else {
+			options.images.push_back(arg);
+		}
+	}
+
+	return !options.images.empty();
+}
+
+bool OpenSource (Source &source, std::string &error) {
+	if (!source.image.Open(source.path, error)) {
+		return false;
+	}
+
+	/* No MBR means a bare partition dump */
+	if (!source.image.SelectPartition(-1, error) && !source.image.SelectPartition(0, error)) {
+		return false;
+	}
+
+	Log_RecoverHead(source.image, source.info);
+
+	if (source.image.HasSuperblock()) {
+		source.site = source.image.Superblock().site_id;
+	}
+
+	return true;
+}
+
+}
+
+int main (int argc, char **argv) {
+	Options options;
+
+	if (!ParseOptions(argc, argv, options)) {
+		Usage();
+		return 2;
+	}
+
+	InitEnergyLut();
+
+	std::vector<std::unique_ptr<Source>> sources;
+	uint64_t total_sectors = 0;
+
+	for (const std::string &path : options.images) {
+		auto source = std::make_unique<Source>();
+		std::string error;
+
+		source->path = path;
+		source->utc_offset_ms = options.utc_offset_ms;
+
+		if (!OpenSource(*source, error)) {
+			fprintf(stderr, "sdlog_analyse: %s: %s\n", path.c_str(), error.c_str());
+			return 1;
+		}
+
+		total_sectors += source->image.SectorCount();
+		sources.push_back(std::move(source));
+	}
+
+	unsigned threads = (options.threads != 0) ? options.threads : std::max(1U, std::thread::hardware_concurrency());
+	auto start = std::chrono::steady_clock::now();
+	ThreadPool pool(threads);
+	std::vector<Partial> partials(pool.ThreadCount());
+
+	for (const auto &source : sources) {
+		const Source *s = source.get();
+
+		pool.Submit([&pool, &partials, s] {
+			AnalyseRange(pool, partials, *s, 0, s->image.SectorCount());
+		});
+	}
+
+	pool.Wait();
+
+	Partial result;
+
+	for (Partial &partial : partials) {
+		for (auto &entry : partial.days) {
+			auto found = result.days.find(entry.first);
+
+			if (found == result.days.end()) {
+				result.days.emplace(entry.first, std::move(entry.second));
+			} else {
+				found->second.Merge(entry.second);
+			}
+		}
+
+		result.sectors += partial.sectors;
+		result.records += partial.records;
+		result.damaged += partial.damaged;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE *out = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+
+	if (out == nullptr) {
+		fprintf(stderr, "sdlog_analyse: cannot write %s\n", options.out.c_str());
+		return 1;
+	}
+
+	WriteReport(out, result.days);
+
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	fprintf(stderr, "sdlog_analyse: %zu images, %" PRIu64 " of %" PRIu64 " sectors current, %" PRIu64 " records, %" PRIu64 " damaged\n",
+		sources.size(), result.sectors, total_sectors, result.records, result.damaged);
+	fprintf(stderr, "sdlog_analyse: %u threads, %" PRIu64 " steals, %.2f s, %.0f MB/s\n", pool.ThreadCount(), pool.Steals(), seconds,
+		((double) total_sectors * LOG_SECTOR_SIZE) / (seconds * 1e6));
+
+	return 0;
+}
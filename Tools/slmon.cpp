@@ -0,0 +1,180 @@
+/* slmon - print live telemetry from a logger's debug UART, or decode a capture of it */
+
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "telemetry_client.hpp"
+
+namespace {
+
+constexpr uint32_t kDefaultBaudrate = 921600;
+constexpr int kPollMs = 200;
+/* "time=now", out of the logger's range: filled in on the next second boundary, just before the request is sent */
+constexpr int32_t kTimeNow = 0;
+
+volatile sig_atomic_t g_is_stopping = 0;
+
+void OnSignal (int) {
+	g_is_stopping = 1;
+}
+
+void Usage () {
+	fprintf(stderr,
+		"usage: slmon <serial device | pty | capture file> [--baud rate] [--get key]... [--set key=value]...\n"
+		"             [--elf firmware.elf]\n"
+		"       terminals are read until interrupted, anything else until end of file\n"
+		"       keys: sample_rate (Hz), weighting (Z|A|C), event_threshold (0.01 dB), interval (ms),\n"
+		"             recording (off|pcm|adpcm|rice), calibration (0.01 dB), time (UTC seconds | now),\n"
+		"             clock_trim (ppb)\n"
+		"       with --elf, trace frames are rendered from the format strings in the firmware image\n");
+}
+
+/* Parses "key" for --get or "key=value" for --set into a request frame */
+bool ParseRequest (const std::string &arg, bool is_set, sTelemetryConfig_t &request) {
+	size_t equals = arg.find('=');
+	std::string key = is_set ? arg.substr(0, equals) : arg;
+
+	request = {};
+	request.op = is_set ? eTelemetryConfigOp_Set : eTelemetryConfigOp_Get;
+
+	uint8_t key_index = 0;
+
+	if (!Telemetry_ParseConfigKey(key, key_index)) {
+		fprintf(stderr, "slmon: unknown config key '%s'\n", key.c_str());
+		return false;
+	}
+
+	request.key = key_index;
+
+	if (!is_set) {
+		return true;
+	}
+
+	int32_t value = 0;
+
+	if ((key_index == eTelemetryConfigKey_Time) && (equals != std::string::npos) && (arg.substr(equals + 1) == "now")) {
+		request.value = kTimeNow;
+		return true;
+	}
+
+	if ((equals == std::string::npos) || !Telemetry_ParseConfigValue(key_index, arg.substr(equals + 1), value)) {
+		fprintf(stderr, "slmon: bad value in '%s'\n", arg.c_str());
+		return false;
+	}
+
+	request.value = value;
+
+	return true;
+}
+
+}
+
+int main (int argc, char **argv) {
+	std::string path;
+	uint32_t baudrate = kDefaultBaudrate;
+	std::vector<sTelemetryConfig_t> requests;
+	std::string elf_path;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if ((arg == "--baud") && ((i + 1) < argc)) {
+			baudrate = (uint32_t) strtoul(argv[++i], nullptr, 0);
+		} else if ((arg == "--elf") && ((i + 1) < argc)) {
+			elf_path = argv[++i];
+		} else if (((arg == "--get") || (arg == "--set")) && ((i + 1) < argc)) {
+			sTelemetryConfig_t request;
+
+			if (!ParseRequest(argv[++i], arg == "--set", request)) {
+				return 2;
+			}
+
+			requests.push_back(request);
+		} else if (path.empty() && (arg.rfind("--", 0) != 0)) {
+			path = arg;
+		} else {
+			Usage();
+			return 2;
+		}
+	}
+
+	if (path.empty()) {
+		Usage();
+		return 2;
+	}
+
+	SerialPort port;
+	TraceDecoder trace;
+	std::string error;
+
+	if (!elf_path.empty() && !trace.Load(elf_path, error)) {
+		fprintf(stderr, "slmon: %s\n", error.c_str());
+		return 1;
+	}
+
+	if (!port.Open(path, baudrate, error)) {
+		fprintf(stderr, "slmon: %s\n", error.c_str());
+		return 1;
+	}
+
+	/* The logger answers each request with a config value or reject frame in the normal stream */
+	for (size_t i = 0; i < requests.size(); i++) {
+		/* The logger starts its new second on arrival, so the reference is sent as the host's second begins */
+		if ((requests[i].key == eTelemetryConfigKey_Time) && (requests[i].op == eTelemetryConfigOp_Set) && (requests[i].value == kTimeNow)) {
+			timespec now = {};
+
+			clock_gettime(CLOCK_REALTIME, &now);
+
+			timespec wait = {0, 1000000000L - now.tv_nsec};
+
+			nanosleep(&wait, nullptr);
+			requests[i].value = (int32_t) (now.tv_sec + 1);
+		}
+
+		std::vector<uint8_t> wire = Telemetry_EncodeFrame(eTelemetryFrame_Config, (uint16_t) i, &requests[i], sizeof(requests[i]));
+
+		if (!port.IsTerminal() || !port.Write(wire.data(), wire.size())) {
+			fprintf(stderr, "slmon: cannot send config requests to %s\n", path.c_str());
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	TelemetryDecoder decoder;
+	uint8_t buffer[4096];
+
+	while (!g_is_stopping) {
+		long count = port.Read(buffer, sizeof(buffer), kPollMs);
+
+		if ((count < 0) || ((count == 0) && !port.IsTerminal())) {
+			break;
+		}
+
+		decoder.Feed(buffer, (size_t) count, [&] (const TelemetryMessage &message) {
+			if (elf_path.empty() || (message.type != eTelemetryFrame_Trace)) {
+				printf("#%u %s\n", message.sequence, Telemetry_Describe(message).c_str());
+				return;
+			}
+
+			for (const std::string &line : trace.Decode(message)) {
+				printf("#%u %s\n", message.sequence, line.c_str());
+			}
+		});
+
+		fflush(stdout);
+	}
+
+	const TelemetryStats &stats = decoder.Stats();
+
+	fprintf(stderr, "slmon: %" PRIu64 " bytes, %" PRIu64 " frames, %" PRIu64 " lost, %" PRIu64 " crc errors, %" PRIu64 " framing errors\n",
+		stats.bytes, stats.frames, stats.lost_frames, stats.crc_errors, stats.framing_errors);
+
+	return 0;
+}
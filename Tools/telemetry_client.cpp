@@ -0,0 +1,561 @@
+#include "telemetry_client.hpp"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "trace_format.h"
+
+namespace {
+
+struct BaudRate {
+	uint32_t rate;
+	speed_t speed;
+};
+
+constexpr BaudRate kBaudRates[] = {
+	{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+	{230400, B230400}, {460800, B460800}, {921600, B921600}, {1000000, B1000000}, {2000000, B2000000}
+};
+
+constexpr const char *kConfigKeyNames[eTelemetryConfigKey_Last] = {
+	"sample_rate", "weighting", "event_threshold", "interval", "recording", "calibration", "time", "clock_trim"
+};
+
+constexpr const char *kConfigOpNames[eTelemetryConfigOp_Last] = {"get", "set", "value", "reject"};
+
+constexpr const char *kWeightingNames[] = {"Z", "A", "C"};
+
+constexpr const char *kRecordingNames[] = {"off", "pcm", "adpcm", "rice"};
+
+/* Little-endian field of an ELF header or table entry */
+uint64_t ElfField (const std::vector<char> &elf, size_t offset, size_t size) {
+	uint64_t value = 0;
+
+	for (size_t i = 0; (i < size) && ((offset + i) < elf.size()); i++) {
+		value |= (uint64_t) (uint8_t) elf[offset + i] << (8 * i);
+	}
+
+	return value;
+}
+
+/* Index of text in names, or -1 */
+template <size_t N>
+int FindName (const char *const (&names)[N], const std::string &text) {
+	for (size_t i = 0; i < N; i++) {
+		if (strcasecmp(names[i], text.c_str()) == 0) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+}
+
+void TelemetryDecoder::Feed (const uint8_t *data, size_t length, const Handler &handler) {
+	m_stats.bytes += length;
+
+	for (size_t i = 0; i < length; i++) {
+		if (data[i] == TELEMETRY_DELIMITER) {
+			Finish(handler);
+			continue;
+		}
+
+		/* Noise or a lost delimiter: keep discarding until the next one */
+		if (m_frame.size() >= COBS_MAX_ENCODED(TELEMETRY_MAX_FRAME)) {
+			m_is_overlong = true;
+			continue;
+		}
+
+		m_frame.push_back(data[i]);
+	}
+}
+
+void TelemetryDecoder::Finish (const Handler &handler) {
+	std::vector<uint8_t> frame(m_frame.size());
+	size_t length = m_frame.empty() ? 0 : COBS_Decode(m_frame.data(), m_frame.size(), frame.data());
+	bool is_overlong = m_is_overlong;
+
+	m_frame.clear();
+	m_is_overlong = false;
+
+	/* Back-to-back delimiters are idle fill, not errors */
+	if (frame.empty() && !is_overlong) {
+		return;
+	}
+
+	if (is_overlong || (length < (TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE))) {
+		m_stats.framing_errors++;
+		return;
+	}
+
+	uint16_t crc = (uint16_t) (frame[length - 2] | (frame[length - 1] << 8));
+
+	if (CRC16_Compute(frame.data(), length - TELEMETRY_CRC_SIZE) != crc) {
+		m_stats.crc_errors++;
+		return;
+	}
+
+	sTelemetryHeader_t header;
+	TelemetryMessage message;
+
+	memcpy(&header, frame.data(), sizeof(header));
+	message.type = header.type;
+	message.sequence = header.sequence;
+	message.payload.assign(frame.begin() + TELEMETRY_HEADER_SIZE, frame.begin() + (long) (length - TELEMETRY_CRC_SIZE));
+
+	if (m_has_sequence) {
+		m_stats.lost_frames += (uint16_t) (header.sequence - m_next_sequence);
+	}
+
+	m_has_sequence = true;
+	m_next_sequence = (uint16_t) (header.sequence + 1U);
+	m_stats.frames++;
+
+	handler(message);
+}
+
+std::vector<uint8_t> Telemetry_EncodeFrame (uint8_t type, uint16_t sequence, const void *payload, size_t length) {
+	std::vector<uint8_t> frame(TELEMETRY_HEADER_SIZE);
+	sTelemetryHeader_t header = {type, sequence};
+
+	memcpy(frame.data(), &header, sizeof(header));
+	frame.insert(frame.end(), (const uint8_t *) payload, (const uint8_t *) payload + length);
+
+	uint16_t crc = CRC16_Compute(frame.data(), frame.size());
+
+	frame.push_back((uint8_t) crc);
+	frame.push_back((uint8_t) (crc >> 8));
+
+	std::vector<uint8_t> wire(COBS_MAX_ENCODED(frame.size()) + 1);
+	size_t wire_length = COBS_Encode(frame.data(), frame.size(), wire.data());
+
+	wire[wire_length++] = TELEMETRY_DELIMITER;
+	wire.resize(wire_length);
+
+	return wire;
+}
+
+const char *Telemetry_ConfigKeyName (uint8_t key) {
+	return (key < eTelemetryConfigKey_Last) ? kConfigKeyNames[key] : "unknown";
+}
+
+bool Telemetry_ParseConfigKey (const std::string &name, uint8_t &key) {
+	int index = FindName(kConfigKeyNames, name);
+
+	if (index < 0) {
+		return false;
+	}
+
+	key = (uint8_t) index;
+
+	return true;
+}
+
+bool Telemetry_ParseConfigValue (uint8_t key, const std::string &text, int32_t &value) {
+	int index = -1;
+
+	if (key == eTelemetryConfigKey_Weighting) {
+		index = FindName(kWeightingNames, text);
+	} else if (key == eTelemetryConfigKey_RecordingMode) {
+		index = FindName(kRecordingNames, text);
+	}
+
+	if (index >= 0) {
+		value = index;
+		return true;
+	}
+
+	char *end = nullptr;
+	long number = strtol(text.c_str(), &end, 0);
+
+	if (text.empty() || (*end != '\0') || (number < INT32_MIN) || (number > INT32_MAX)) {
+		return false;
+	}
+
+	value = (int32_t) number;
+
+	return true;
+}
+
+std::string Telemetry_Describe (const TelemetryMessage &message) {
+	char text[512];
+
+	switch (message.type) {
+		case eTelemetryFrame_Levels: {
+			sTelemetryLevels_t v;
+
+			if (message.As(v)) {
+				snprintf(text, sizeof(text), "levels t=%u dur=%u leq=%.1f lmax=%.1f lmin=%.1f", v.end_ms, v.duration_ms,
+					v.leq_ddb / 10.0, v.lmax_ddb / 10.0, v.lmin_ddb / 10.0);
+				return text;
+			}
+			break;
+		}
+		case eTelemetryFrame_Spectrum: {
+			sTelemetrySpectrum_t v;
+
+			if (message.As(v, offsetof(sTelemetrySpectrum_t, band_ddb)) && (v.band_count <= TELEMETRY_MAX_SPECTRUM_BANDS)) {
+				std::string line = "spectrum t=" + std::to_string(v.end_ms) + " first=" + std::to_string(v.first_band);
+
+				for (uint32_t b = 0; b < v.band_count; b++) {
+					snprintf(text, sizeof(text), " %.1f", v.band_ddb[b] / 10.0);
+					line += text;
+				}
+
+				return line;
+			}
+			break;
+		}
+		case eTelemetryFrame_Event: {
+			sTelemetryEvent_t v;
+
+			if (message.As(v)) {
+				snprintf(text, sizeof(text), "event t=%u dur=%u kind=%u count=%u peak=%.1f", v.start_ms, v.duration_ms, v.kind, v.count,
+					v.peak_ddb / 10.0);
+				return text;
+			}
+			break;
+		}
+		case eTelemetryFrame_Status: {
+			sTelemetryStatus_t v;
+
+			if (message.As(v)) {
+				snprintf(text, sizeof(text), "status uptime=%us overruns=%u storage_errors=%u sectors=%u dropped=%u", v.uptime_s,
+					v.audio_overruns, v.storage_errors, v.sectors_written, v.frames_dropped);
+				return text;
+			}
+			break;
+		}
+		case eTelemetryFrame_Config: {
+			sTelemetryConfig_t v;
+
+			if (message.As(v) && (v.op < eTelemetryConfigOp_Last)) {
+				std::string value = std::to_string(v.value);
+
+				if ((v.key == eTelemetryConfigKey_Weighting) && (v.value >= 0) && ((size_t) v.value < std::size(kWeightingNames))) {
+					value = kWeightingNames[v.value];
+				} else if ((v.key == eTelemetryConfigKey_RecordingMode) && (v.value >= 0) && ((size_t) v.value < std::size(kRecordingNames))) {
+					value = kRecordingNames[v.value];
+				}
+
+				snprintf(text, sizeof(text), "config %s %s=%s", kConfigOpNames[v.op], Telemetry_ConfigKeyName(v.key), value.c_str());
+				return text;
+			}
+			break;
+		}
+		case eTelemetryFrame_Trace: {
+			snprintf(text, sizeof(text), "trace %zu words", message.payload.size() / sizeof(uint32_t));
+			return text;
+		}
+		case eTelemetryFrame_Text: {
+			std::string line = "text \"";
+
+			for (uint8_t c : message.payload) {
+				if (c == '\n') {
+					line += "\\n";
+				} else if (c == '\r') {
+					line += "\\r";
+				} else if ((c < 0x20) || (c >= 0x7F)) {
+					snprintf(text, sizeof(text), "\\x%02X", c);
+					line += text;
+				} else {
+					line += (char) c;
+				}
+			}
+
+			return line + "\"";
+		}
+		default:
+			break;
+	}
+
+	snprintf(text, sizeof(text), "type %u, %zu bytes", message.type, message.payload.size());
+
+	return text;
+}
+
+bool TraceDecoder::Load (const std::string &elf_path, std::string &error) {
+	std::ifstream file(elf_path, std::ios::binary);
+	std::vector<char> elf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (!file.good() && !file.eof()) {
+		error = "cannot read " + elf_path;
+		return false;
+	}
+
+	/* Little-endian ELF32 from the firmware build, ELF64 accepted as well */
+	if ((elf.size() < 52) || (memcmp(elf.data(), "\x7F" "ELF", 4) != 0) || (elf[5] != 1)) {
+		error = elf_path + " is not a little-endian ELF file";
+		return false;
+	}
+
+	bool is_64 = (elf[4] == 2);
+	uint64_t section_table = ElfField(elf, is_64 ? 0x28 : 0x20, is_64 ? 8 : 4);
+	size_t entry_size = (size_t) ElfField(elf, is_64 ? 0x3A : 0x2E, 2);
+	size_t section_count = (size_t) ElfField(elf, is_64 ? 0x3C : 0x30, 2);
+	size_t names_index = (size_t) ElfField(elf, is_64 ? 0x3E : 0x32, 2);
+	size_t word = is_64 ? 8 : 4;
+	auto section_offset = [&] (size_t index) { return (size_t) ElfField(elf, section_table + (index * entry_size) + (is_64 ? 0x18 : 0x10), word); };
+	auto section_size = [&] (size_t index) { return (size_t) ElfField(elf, section_table + (index * entry_size) + (is_64 ? 0x20 : 0x14), word); };
+
+	if ((names_index >= section_count) || ((section_table + (section_count * entry_size)) > elf.size())) {
+		error = elf_path + " has no usable section table";
+		return false;
+	}
+
+	size_t names = section_offset(names_index);
+
+	for (size_t i = 0; i < section_count; i++) {
+		size_t name = names + (size_t) ElfField(elf, section_table + (i * entry_size), 4);
+		size_t offset = section_offset(i);
+		size_t size = section_size(i);
+
+		if ((name >= elf.size()) || (strncmp(&elf[name], TRACE_FORMAT_SECTION, elf.size() - name) != 0)) {
+			continue;
+		}
+
+		if ((offset + size) > elf.size()) {
+			break;
+		}
+
+		/* Linked at address 0, so offsets into the section are the IDs */
+		m_formats.assign(elf.begin() + (long) offset, elf.begin() + (long) (offset + size));
+		m_formats.push_back('\0');
+
+		return true;
+	}
+
+	error = elf_path + " has no " TRACE_FORMAT_SECTION " section";
+
+	return false;
+}
+
+std::vector<std::string> TraceDecoder::Decode (const TelemetryMessage &message) {
+	std::vector<std::string> lines;
+	size_t count = message.payload.size() / sizeof(uint32_t);
+	std::vector<uint32_t> words(count);
+
+	memcpy(words.data(), message.payload.data(), count * sizeof(uint32_t));
+
+	for (size_t i = 0; (i + TRACE_HEADER_WORDS) <= count;) {
+		uint16_t id = TRACE_HEADER_ID(words[i]);
+		uint32_t arg_count = TRACE_HEADER_ARGS(words[i]);
+		uint32_t stamp_ticks = words[i + 1];
+
+		if ((arg_count > TRACE_MAX_ARGS) || ((i + TRACE_HEADER_WORDS + arg_count) > count)) {
+			lines.push_back("trace: malformed record");
+			break;
+		}
+
+		/* The 32-bit stamp wraps every ~71 min; records arrive in order, so one wrap per gap is assumed */
+		if (m_has_time) {
+			m_ticks += (uint32_t) (stamp_ticks - m_last_stamp);
+		}
+
+		m_has_time = true;
+		m_last_stamp = stamp_ticks;
+
+		char stamp[32];
+
+		snprintf(stamp, sizeof(stamp), "[%12.3f us] ", (double) m_ticks * 1e6 / TRACE_STAMP_HZ);
+		lines.push_back(stamp + Render(id, &words[i + TRACE_HEADER_WORDS], arg_count));
+		i += TRACE_HEADER_WORDS + arg_count;
+	}
+
+	return lines;
+}
+
+std::string TraceDecoder::Render (uint16_t id, const uint32_t *args, uint32_t arg_count) const {
+	char text[256];
+
+	if (id == TRACE_ID_DROPPED) {
+		snprintf(text, sizeof(text), "(%u trace records dropped)", (arg_count > 0) ? args[0] : 0);
+		return text;
+	}
+
+	if (id >= m_formats.size()) {
+		std::string line = "trace id " + std::to_string(id);
+
+		for (uint32_t i = 0; i < arg_count; i++) {
+			snprintf(text, sizeof(text), " 0x%08X", args[i]);
+			line += text;
+		}
+
+		return line;
+	}
+
+	const char *format = &m_formats[id];
+	std::string line;
+	uint32_t next = 0;
+
+	while (*format != '\0') {
+		if (*format != '%') {
+			line += *format++;
+			continue;
+		}
+
+		/* Flags, width and precision are passed through, length modifiers dropped since every argument is one word */
+		std::string spec = "%";
+
+		format++;
+
+		while ((*format != '\0') && (strchr("-+ #0123456789.", *format) != nullptr)) {
+			spec += *format++;
+		}
+
+		while ((*format != '\0') && (strchr("hlLqjzt", *format) != nullptr)) {
+			format++;
+		}
+
+		char conversion = *format;
+
+		if (conversion == '\0') {
+			break;
+		}
+
+		format++;
+
+		if (conversion == '%') {
+			line += '%';
+			continue;
+		}
+
+		uint32_t value = (next < arg_count) ? args[next++] : 0;
+
+		switch (conversion) {
+			case 'd':
+			case 'i': {
+				snprintf(text, sizeof(text), (spec + "d").c_str(), (int32_t) value);
+				break;
+			}
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+			case 'c': {
+				snprintf(text, sizeof(text), (spec + conversion).c_str(), value);
+				break;
+			}
+			case 'p': {
+				snprintf(text, sizeof(text), "0x%08X", value);
+				break;
+			}
+			default: {
+				snprintf(text, sizeof(text), "<%%%c 0x%08X>", conversion, value);
+				break;
+			}
+		}
+
+		line += text;
+	}
+
+	return line;
+}
+
+SerialPort::~SerialPort () {
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+bool SerialPort::Open (const std::string &path, uint32_t baudrate, std::string &error) {
+	m_fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+
+	if ((m_fd < 0) && (errno == EACCES)) {
+		m_fd = open(path.c_str(), O_RDONLY);
+	}
+
+	if (m_fd < 0) {
+		error = "cannot open " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	m_is_terminal = isatty(m_fd);
+
+	if (!m_is_terminal) {
+		return true;
+	}
+
+	speed_t speed = 0;
+
+	for (const BaudRate &entry : kBaudRates) {
+		if (entry.rate == baudrate) {
+			speed = entry.speed;
+		}
+	}
+
+	if (speed == 0) {
+		error = "unsupported baud rate " + std::to_string(baudrate);
+		return false;
+	}
+
+	struct termios tio;
+
+	if (tcgetattr(m_fd, &tio) != 0) {
+		error = "cannot read terminal settings of " + path;
+		return false;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	if (tcsetattr(m_fd, TCSANOW, &tio) != 0) {
+		error = "cannot configure " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	tcflush(m_fd, TCIFLUSH);
+
+	return true;
+}
+
+long SerialPort::Read (uint8_t *data, size_t length, int timeout_ms) {
+	if (m_is_terminal) {
+		struct pollfd pfd = {m_fd, POLLIN, 0};
+		int ready = poll(&pfd, 1, timeout_ms);
+
+		if (ready <= 0) {
+			return (ready == 0) ? 0 : -1;
+		}
+	}
+
+	ssize_t count = read(m_fd, data, length);
+
+	if ((count < 0) && (errno == EINTR)) {
+		return 0;
+	}
+
+	return (long) count;
+}
+
+bool SerialPort::Write (const uint8_t *data, size_t length) {
+	while (length > 0) {
+		ssize_t count = write(m_fd, data, length);
+
+		if (count <= 0) {
+			return false;
+		}
+
+		data += count;
+		length -= (size_t) count;
+	}
+
+	return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "telemetry_format.h"
+
+struct TelemetryMessage {
+	uint8_t type = 0;
+	uint16_t sequence = 0;
+	std::vector<uint8_t> payload;
+
+	/* Copies the payload into a packed struct; shorter payloads (a spectrum with fewer bands) are zero filled */
+	template <typename T>
+	bool As (T &out, size_t min_length = sizeof(T)) const {
+		if ((payload.size() < min_length) || (payload.size() > sizeof(T))) {
+			return false;
+		}
+
+		memset(&out, 0, sizeof(out));
+		memcpy(&out, payload.data(), payload.size());
+
+		return true;
+	}
+};
+
+struct TelemetryStats {
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	uint64_t crc_errors = 0;
+	uint64_t framing_errors = 0;
+	/* Sum of sequence gaps, i.e. frames the logger built that never arrived intact */
+	uint64_t lost_frames = 0;
+};
+
+/* Splits a byte stream on the delimiter, undoes COBS and checks the CRC; can be fed in arbitrary pieces */
+class TelemetryDecoder {
+public:
+	using Handler = std::function<void (const TelemetryMessage &)>;
+
+	void Feed (const uint8_t *data, size_t length, const Handler &handler);
+	const TelemetryStats &Stats () const { return m_stats; }
+
+private:
+	void Finish (const Handler &handler);
+
+	std::vector<uint8_t> m_frame;
+	bool m_is_overlong = false;
+	bool m_has_sequence = false;
+	uint16_t m_next_sequence = 0;
+	TelemetryStats m_stats;
+};
+
+/* Builds the wire form of one frame, delimiter included */
+std::vector<uint8_t> Telemetry_EncodeFrame (uint8_t type, uint16_t sequence, const void *payload, size_t length);
+/* Config keys and the symbolic values some of them take (weighting Z/A/C, recording off/pcm/adpcm/rice) */
+const char *Telemetry_ConfigKeyName (uint8_t key);
+bool Telemetry_ParseConfigKey (const std::string &name, uint8_t &key);
+bool Telemetry_ParseConfigValue (uint8_t key, const std::string &text, int32_t &value);
+/* One human-readable line per message */
+std::string Telemetry_Describe (const TelemetryMessage &message);
+
+/* Renders trace frames with the format strings from the firmware ELF (see trace_format.h) */
+class TraceDecoder {
+public:
+	bool Load (const std::string &elf_path, std::string &error);
+	/* One line per record, time in microseconds since the first record seen */
+	std::vector<std::string> Decode (const TelemetryMessage &message);
+	std::string Render (uint16_t id, const uint32_t *args, uint32_t arg_count) const;
+
+private:
+	std::vector<char> m_formats;
+	bool m_has_time = false;
+	uint32_t m_last_stamp = 0;
+	uint64_t m_ticks = 0;
+};
+
+/* Raw 8N1 serial port, or any readable file such as a capture or a pty */
+class SerialPort {
+public:
+	~SerialPort ();
+
+	/* baudrate is applied only when the path is a terminal */
+	bool Open (const std::string &path, uint32_t baudrate, std::string &error);
+	bool IsTerminal () const { return m_is_terminal; }
+	/* Returns bytes read, 0 on timeout or end of file, -1 on error */
+	long Read (uint8_t *data, size_t length, int timeout_ms);
+	bool Write (const uint8_t *data, size_t length);
+
+private:
+	int m_fd = -1;
+	bool m_is_terminal = false;
+};
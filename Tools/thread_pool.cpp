@@ -0,0 +1,132 @@
+#include "thread_pool.hpp"
+
+namespace {
+
+constexpr unsigned kNotWorker = ~0U;
+
+thread_local unsigned tls_worker = kNotWorker;
+
+}
+
+ThreadPool::ThreadPool (unsigned thread_count) {
+	if (thread_count == 0) {
+		thread_count = 1;
+	}
+
+	for (unsigned i = 0; i < thread_count; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+
+	for (unsigned i = 0; i < thread_count; i++) {
+		m_threads.emplace_back(&ThreadPool::Run, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool () {
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stop = true;
+	}
+
+	m_wake.notify_all();
+
+	for (std::thread &thread : m_threads) {
+		thread.join();
+	}
+}
+
+unsigned ThreadPool::CurrentWorker () {
+	return tls_worker;
+}
+
+void ThreadPool::Submit (Task task) {
+	unsigned worker = tls_worker;
+
+	if ((worker == kNotWorker) || (worker >= m_queues.size())) {
+		worker = m_next.fetch_add(1) % (unsigned) m_queues.size();
+	}
+
+	m_pending.fetch_add(1);
+
+	{
+		std::lock_guard<std::mutex> guard(m_queues[worker]->lock);
+		m_queues[worker]->tasks.push_back(std::move(task));
+	}
+
+	/* Counted after the push, so a worker that sees m_queued > 0 will find the task in some deque */
+	m_queued.fetch_add(1);
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+	}
+
+	m_wake.notify_one();
+}
+
+void ThreadPool::Wait () {
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	m_idle.wait(lock, [this] {
+		return m_pending.load() == 0;
+	});
+}
+
+bool ThreadPool::Pop (unsigned worker, Task &task) {
+	{
+		Queue &own = *m_queues[worker];
+		std::lock_guard<std::mutex> guard(own.lock);
+
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			m_queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < m_queues.size(); i++) {
+		Queue &victim = *m_queues[(worker + i) % m_queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			m_queued.fetch_sub(1);
+			m_steals.fetch_add(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::Run (unsigned worker) {
+	tls_worker = worker;
+
+	while (true) {
+		Task task;
+
+		if (Pop(worker, task)) {
+			task();
+
+			if (m_pending.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> guard(m_lock);
+				m_idle.notify_all();
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		m_wake.wait(lock, [this] {
+			return m_stop || (m_queued.load() > 0);
+		});
+
+		if (m_stop && (m_queued.load() == 0)) {
+			return;
+		}
+	}
+}
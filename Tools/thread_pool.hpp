@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of workers, each owning a deque. A worker runs its newest task first and, when its own deque is empty,
+ * steals the oldest task of another worker, which is usually the largest piece of work left to split.
+ */
+class ThreadPool {
+public:
+	using Task = std::function<void ()>;
+
+	explicit ThreadPool (unsigned thread_count);
+	~ThreadPool ();
+
+	ThreadPool (const ThreadPool &) = delete;
+	ThreadPool &operator= (const ThreadPool &) = delete;
+
+	/* From a worker the task goes to its own deque, from outside the deques are filled round robin */
+	void Submit (Task task);
+	/* Blocks until every submitted task, including the ones submitted by tasks, has finished */
+	void Wait ();
+
+	unsigned ThreadCount () const { return (unsigned) m_threads.size(); }
+	uint64_t Steals () const { return m_steals.load(); }
+	/* Index of the calling worker, so tasks can keep per-worker results without locking */
+	static unsigned CurrentWorker ();
+
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	void Run (unsigned worker);
+	bool Pop (unsigned worker, Task &task);
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::atomic<size_t> m_queued {0};
+	std::atomic<size_t> m_pending {0};
+	std::atomic<unsigned> m_next {0};
+	std::atomic<uint64_t> m_steals {0};
+	bool m_stop = false;
+};